@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""SFUSE 메타데이터 워크로드 (mdtest 방식)
+
+마운트된 디렉터리 아래에 디렉터리 트리를 만들고 파일 N개에 대해
+create → stat → readdir → unlink 단계를 차례로 실행하여 단계별 처리량과
+지연 시간(p50/p99)을 JSON으로 출력한다.
+
+SFUSE 디렉터리는 직접 블록 하나(항목 13개)로 시작하므로, mdtest의 -b/-z와
+같이 디렉터리마다 --fanout개 이하의 항목만 두는 트리로 파일을 분산한다.
+
+사용법: mdtest.py [--files N] [--fanout F] <mountpoint>
+"""
+
+import argparse
+import json
+import os
+import sys
+import time
+
+
+def percentile(sorted_ns, pct):
+    """정렬된 지연 시간 목록의 백분위 값 (nearest-rank)"""
+    if not sorted_ns:
+        return 0
+    rank = max(0, min(len(sorted_ns) - 1,
+                      int(round(pct / 100.0 * len(sorted_ns) + 0.5)) - 1))
+    return sorted_ns[rank]
+
+
+def timed(items, fn):
+    """items 각각에 fn을 실행하고 단계 결과를 돌려준다."""
+    lat = []
+    start = time.perf_counter_ns()
+    for item in items:
+        t = time.perf_counter_ns()
+        fn(item)
+        lat.append(time.perf_counter_ns() - t)
+    total = time.perf_counter_ns() - start
+    lat.sort()
+    return {
+        "ops": len(lat),
+        "seconds": total / 1e9,
+        "ops_per_sec": len(lat) / (total / 1e9) if total else 0.0,
+        "p50_us": percentile(lat, 50) / 1000.0,
+        "p99_us": percentile(lat, 99) / 1000.0,
+    }
+
+
+def build_tree(root, nleaves, fanout):
+    """리프 디렉터리가 nleaves개인 트리의 경로 목록 (부모 먼저)"""
+    dirs, level = [], [root]
+    while len(level) < nleaves:
+        nxt = []
+        for parent in level:
+            for i in range(fanout):
+                if len(nxt) >= nleaves:
+                    break
+                nxt.append(os.path.join(parent, "d%d" % i))
+        dirs.extend(nxt)
+        level = nxt
+    return dirs, level
+
+
+def drop_caches(mountpoint):
+    """/.sfuse/control로 더티 데이터를 기록하고 장치 캐시를 비운다."""
+    try:
+        with open(os.path.join(mountpoint, ".sfuse", "control"), "w") as f:
+            f.write("drop_caches\n")
+    except OSError:
+        pass
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--files", type=int, default=100000, help="파일 수")
+    ap.add_argument("--fanout", type=int, default=10,
+                    help="디렉터리당 항목 수 (최대 13)")
+    ap.add_argument("mountpoint")
+    args = ap.parse_args()
+
+    root = os.path.join(args.mountpoint, "mdtest.%d" % os.getpid())
+    os.mkdir(root)
+    nleaves = max(1, -(-args.files // args.fanout))
+    dirs, leaves = build_tree(root, nleaves, args.fanout)
+    files = [os.path.join(leaves[i // args.fanout], "f%d" % i)
+             for i in range(args.files)]
+
+    def create(path):
+        os.close(os.open(path, os.O_CREAT | os.O_EXCL | os.O_WRONLY, 0o644))
+
+    result = {"files": args.files, "fanout": args.fanout, "phases": {}}
+    phases = result["phases"]
+    phases["mkdir"] = timed(dirs, os.mkdir)
+    phases["create"] = timed(files, create)
+    drop_caches(args.mountpoint)
+    phases["stat"] = timed(files, os.stat)
+    phases["readdir"] = timed(leaves, os.listdir)
+    phases["unlink"] = timed(files, os.unlink)
+    phases["rmdir"] = timed(reversed(dirs), os.rmdir)
+    os.rmdir(root)
+
+    json.dump(result, sys.stdout, indent=2)
+    print()
+
+
+if __name__ == "__main__":
+    main()
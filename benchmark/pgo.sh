@@ -0,0 +1,68 @@
+#!/bin/bash
+# SFUSE 프로파일 기반 최적화(PGO) 빌드 스크립트
+#
+# 1) -DSFUSE_PGO=GENERATE로 계측 빌드
+# 2) 장치를 포맷·마운트하고 workflow.md의 fio 워크로드(순차/랜덤 읽기·쓰기)로 학습
+# 3) 언마운트하여 프로파일을 기록한 뒤, 같은 빌드 디렉터리에서 -DSFUSE_PGO=USE로
+#    다시 빌드
+#
+# 사용법: sudo ./benchmark/pgo.sh <device> <mountpoint> [build_dir]
+# (장치의 기존 데이터는 모두 지워진다.)
+
+set -e
+
+if [ $# -lt 2 ]; then
+  echo "사용법: sudo $0 <device> <mountpoint> [build_dir]"
+  exit 1
+fi
+
+DEV="$1"
+MNT="$2"
+BUILD_DIR="${3:-build}"
+PGO_DIR="$(realpath -m "$BUILD_DIR")/pgo"
+SRC_DIR="$(dirname "$(realpath "$0")")/.."
+
+# 1) 계측 빌드 (이전 프로파일은 지움)
+rm -rf "$PGO_DIR"
+cmake -S "$SRC_DIR" -B "$BUILD_DIR" -DCMAKE_BUILD_TYPE=Release \
+  -DSFUSE_PGO=GENERATE -DSFUSE_PGO_DIR="$PGO_DIR"
+cmake --build "$BUILD_DIR" -j"$(nproc)"
+
+# 2) 포맷 후 마운트
+"$BUILD_DIR/mkfs.sfuse" "$DEV"
+mkdir -p "$MNT"
+"$BUILD_DIR/sfuse" "$DEV" "$MNT" -f >/dev/null 2>&1 &
+SFUSE_PID=$!
+for _ in $(seq 50); do
+  mountpoint -q "$MNT" && break
+  sleep 0.1
+done
+mountpoint -q "$MNT" || { echo "마운트 실패"; kill "$SFUSE_PID"; exit 1; }
+
+# 3) 학습 워크로드 (benchmark/workflow.md와 같은 fio 작업)
+FIO="fio --directory=$MNT --size=100M --direct=1"
+$FIO --name=seq-write --filename=fiotest.dat --bs=1M --rw=write \
+  --ioengine=sync --iodepth=1
+echo 3 >/proc/sys/vm/drop_caches
+$FIO --name=seq-read --filename=fiotest.dat --bs=1M --rw=read \
+  --ioengine=sync --iodepth=1
+$FIO --name=rand-write --filename=fiotest-rand.dat --bs=4k --rw=randwrite \
+  --ioengine=libaio --iodepth=16
+echo 3 >/proc/sys/vm/drop_caches
+$FIO --name=rand-read --filename=fiotest-rand.dat --bs=4k --rw=randread \
+  --ioengine=libaio --iodepth=16
+rm -f "$MNT/fiotest.dat" "$MNT/fiotest-rand.dat"
+
+# 4) 언마운트: sfuse가 정상 종료해야 프로파일이 기록된다.
+fusermount3 -u "$MNT"
+wait "$SFUSE_PID" || true
+
+# clang은 .profraw를 하나의 .profdata로 합쳐야 한다.
+if ls "$PGO_DIR"/*.profraw >/dev/null 2>&1; then
+  llvm-profdata merge -o "$PGO_DIR/sfuse.profdata" "$PGO_DIR"/*.profraw
+fi
+
+# 5) 프로파일을 적용하여 다시 빌드 (같은 빌드 디렉터리여야 gcc가 찾는다)
+cmake -S "$SRC_DIR" -B "$BUILD_DIR" -DSFUSE_PGO=USE
+cmake --build "$BUILD_DIR" -j"$(nproc)"
+echo "PGO 빌드 완료: $BUILD_DIR/sfuse"
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""SFUSE 벤치마크 결과 요약 및 기준선 비교
+
+  report.py summarize [--label L] [--meta meta.json] <fio.json...>
+      fio(--output-format=json) 결과와 mdtest.py 결과를 하나의 요약 JSON으로
+      합쳐 표준 출력에 쓴다.
+  report.py compare [--threshold PCT] <baseline.json> <current.json>
+      두 요약을 비교한 마크다운 표를 출력한다. 처리량이 PCT% 넘게 줄거나
+      p99 지연 시간이 PCT% 넘게 늘어난 항목이 있으면 종료 코드 1을 돌려준다.
+"""
+
+import argparse
+import json
+import os
+import sys
+import time
+
+# 지표 이름과 방향 (True: 클수록 좋음)
+METRICS = {
+    "bw_mib": True,
+    "iops": True,
+    "ops_per_sec": True,
+    "p50_us": False,
+    "p99_us": False,
+}
+
+
+def fio_summary(path):
+    """fio JSON 출력 하나를 {작업 이름: 지표} 로 요약한다."""
+    with open(path) as f:
+        data = json.load(f)
+    out = {}
+    for job in data["jobs"]:
+        side = job["read"] if job["read"]["io_bytes"] else job["write"]
+        pct = side["clat_ns"].get("percentile", {})
+        out[job["jobname"]] = {
+            "bw_mib": side["bw"] / 1024.0,
+            "iops": side["iops"],
+            "p50_us": pct.get("50.000000", 0) / 1000.0,
+            "p99_us": pct.get("99.000000", 0) / 1000.0,
+        }
+    return out
+
+
+def summarize(args):
+    result = {
+        "label": args.label,
+        "date": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+        "host": os.uname().nodename,
+        "fio": {},
+        "meta": {},
+    }
+    for path in args.fio:
+        result["fio"].update(fio_summary(path))
+    if args.meta:
+        with open(args.meta) as f:
+            result["meta"] = json.load(f)["phases"]
+    json.dump(result, sys.stdout, indent=2, sort_keys=True)
+    print()
+    return 0
+
+
+def compare(args):
+    with open(args.baseline) as f:
+        base = json.load(f)
+    with open(args.current) as f:
+        cur = json.load(f)
+
+    print("| 항목 | 지표 | %s | %s | 변화 |" %
+          (base.get("label") or "baseline", cur.get("label") or "current"))
+    print("|---|---|---:|---:|---:|")
+    regressions = 0
+    for group in ("fio", "meta"):
+        for name in sorted(cur.get(group, {})):
+            old = base.get(group, {}).get(name)
+            if old is None:
+                continue
+            for metric, higher_better in METRICS.items():
+                if metric not in cur[group][name] or metric not in old:
+                    continue
+                a, b = old[metric], cur[group][name][metric]
+                change = (b - a) / a * 100.0 if a else 0.0
+                worse = -change if higher_better else change
+                mark = ""
+                # p50은 참고용, 처리량과 p99만 회귀로 판정
+                if worse > args.threshold and metric != "p50_us":
+                    mark = " ⚠"
+                    regressions += 1
+                print("| %s | %s | %.1f | %.1f | %+.1f%%%s |" %
+                      (name, metric, a, b, change, mark))
+    print()
+    print("회귀 %d건 (기준 %.1f%%)" % (regressions, args.threshold))
+    return 1 if regressions else 0
+
+
+def main():
+    ap = argparse.ArgumentParser(
+        description=__doc__.splitlines()[0],
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    s = sub.add_parser("summarize")
+    s.add_argument("--label", default="")
+    s.add_argument("--meta")
+    s.add_argument("fio", nargs="*")
+    s.set_defaults(func=summarize)
+
+    c = sub.add_parser("compare")
+    c.add_argument("--threshold", type=float, default=5.0)
+    c.add_argument("baseline")
+    c.add_argument("current")
+    c.set_defaults(func=compare)
+
+    args = ap.parse_args()
+    return args.func(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
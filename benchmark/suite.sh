@@ -0,0 +1,130 @@
+#!/bin/bash
+# SFUSE 자동 벤치마크 스위트
+#
+# 1) 이미지 파일을 만들어 포맷하고 SFUSE를 마운트
+# 2) fio 매트릭스 실행 (순차/랜덤 × 읽기/쓰기 × 블록 크기 × 큐 깊이 × 작업 수)
+# 3) mdtest 방식 메타데이터 워크로드 (create/stat/readdir/unlink)
+# 4) 언마운트 후 결과를 summary.json으로 요약하고, 기준선이 있으면 비교
+#
+# 사용법: ./benchmark/suite.sh [-q] [-b baseline.json] [-o outdir] [build_dir]
+#   -q : 빠른 실행 (작은 매트릭스, 파일 1만 개)
+#   -b : 비교할 기준선 summary.json (회귀가 있으면 종료 코드 1)
+#   -o : 결과 디렉터리 (기본값 bench-<커밋>-<시각>)
+#
+# 매트릭스는 환경 변수로 바꿀 수 있다.
+#   RWS="read write randread randwrite" BSS="4k 128k 1M" QDS="1 16 64"
+#   JOBS="1 4" SIZE=256M RUNTIME=10 MD_FILES=100000 IMG_SIZE=4G
+#
+# root가 아니어도 되지만 fusermount3와 fio, python3가 필요하다.
+
+set -e
+
+QUICK=0
+BASELINE=""
+OUT=""
+while getopts "qb:o:" opt; do
+  case $opt in
+  q) QUICK=1 ;;
+  b) BASELINE="$(realpath "$OPTARG")" ;;
+  o) OUT="$OPTARG" ;;
+  *)
+    echo "사용법: $0 [-q] [-b baseline.json] [-o outdir] [build_dir]"
+    exit 1
+    ;;
+  esac
+done
+shift $((OPTIND - 1))
+
+SRC_DIR="$(dirname "$(realpath "$0")")/.."
+BUILD_DIR="$(realpath -m "${1:-$SRC_DIR/build}")"
+LABEL="$(git -C "$SRC_DIR" rev-parse --short HEAD 2>/dev/null || echo unknown)"
+OUT="$(realpath -m "${OUT:-bench-$LABEL-$(date +%Y%m%d-%H%M%S)}")"
+
+if [ "$QUICK" = 1 ]; then
+  : "${RWS:=write read randwrite randread}" "${BSS:=4k 1M}" "${QDS:=1 16}"
+  : "${JOBS:=1}" "${SIZE:=64M}" "${RUNTIME:=3}" "${MD_FILES:=10000}"
+fi
+: "${RWS:=write read randwrite randread}" "${BSS:=4k 128k 1M}"
+: "${QDS:=1 16 64}" "${JOBS:=1 4}" "${SIZE:=256M}" "${RUNTIME:=10}"
+: "${MD_FILES:=100000}" "${IMG_SIZE:=4G}"
+
+# 1) 빌드, 이미지 포맷, 마운트
+if [ ! -x "$BUILD_DIR/sfuse" ]; then
+  cmake -S "$SRC_DIR" -B "$BUILD_DIR" -DCMAKE_BUILD_TYPE=Release
+  cmake --build "$BUILD_DIR" -j"$(nproc)"
+fi
+
+mkdir -p "$OUT/fio"
+IMG="$OUT/sfuse.img"
+MNT="$OUT/mnt"
+truncate -s "$IMG_SIZE" "$IMG"
+"$BUILD_DIR/mkfs.sfuse" "$IMG" >"$OUT/mkfs.log"
+mkdir -p "$MNT"
+"$BUILD_DIR/sfuse" "$IMG" "$MNT" -f >"$OUT/sfuse.log" 2>&1 &
+SFUSE_PID=$!
+
+cleanup() {
+  if mountpoint -q "$MNT"; then
+    fusermount3 -u "$MNT" || true
+  fi
+  wait "$SFUSE_PID" 2>/dev/null || true
+  rm -f "$IMG"
+  rmdir "$MNT" 2>/dev/null || true
+}
+trap cleanup EXIT
+
+for _ in $(seq 50); do
+  mountpoint -q "$MNT" && break
+  sleep 0.1
+done
+mountpoint -q "$MNT" || { echo "마운트 실패 ($OUT/sfuse.log 참고)"; exit 1; }
+
+# 캐시 비우기: SFUSE 자체 캐시는 /.sfuse/control, 커널 캐시는 root일 때만
+drop_caches() {
+  echo drop_caches >"$MNT/.sfuse/control"
+  if [ "$(id -u)" = 0 ]; then
+    echo 3 >/proc/sys/vm/drop_caches
+  fi
+}
+
+# 2) fio 매트릭스: 같은 패턴의 쓰기가 읽기보다 먼저 실행되도록 RWS 순서를 둔다.
+for rw in $RWS; do
+  for bs in $BSS; do
+    for qd in $QDS; do
+      for nj in $JOBS; do
+        name="$rw-$bs-qd$qd-j$nj"
+        engine=libaio
+        [ "$qd" = 1 ] && engine=sync
+        echo "fio: $name"
+        drop_caches
+        fio --name="$name" --directory="$MNT" --filename_format='fio.$jobnum' \
+          --size="$SIZE" --bs="$bs" --rw="$rw" --direct=1 \
+          --ioengine="$engine" --iodepth="$qd" --numjobs="$nj" \
+          --runtime="$RUNTIME" --time_based --ramp_time=1 \
+          --group_reporting --output-format=json \
+          --output="$OUT/fio/$name.json"
+      done
+    done
+  done
+done
+rm -f "$MNT"/fio.*
+
+# 3) 메타데이터 워크로드
+echo "mdtest: $MD_FILES files"
+python3 "$SRC_DIR/benchmark/mdtest.py" --files "$MD_FILES" "$MNT" \
+  >"$OUT/mdtest.json"
+cat "$MNT/.sfuse/stats" >"$OUT/sfuse-stats.txt"
+
+# 4) 언마운트 후 요약 및 기준선 비교
+cleanup
+trap - EXIT
+
+python3 "$SRC_DIR/benchmark/report.py" summarize --label "$LABEL" \
+  --meta "$OUT/mdtest.json" "$OUT"/fio/*.json >"$OUT/summary.json"
+echo "결과: $OUT/summary.json"
+
+if [ -n "$BASELINE" ]; then
+  python3 "$SRC_DIR/benchmark/report.py" compare "$BASELINE" \
+    "$OUT/summary.json" | tee "$OUT/compare.md"
+  exit "${PIPESTATUS[0]}"
+fi
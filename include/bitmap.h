@@ -5,6 +5,13 @@
  * bitmap.h에서는 데이터 블록과 아이노드를 관리하기 위한 비트맵 관련 함수들의
  * 인터페이스를 정의한다. 비트맵 로딩, 디스크 동기화 및 블록과 아이노드
  * 할당/해제 기능을 제공한다.
+ *
+ * 마운트된 파일 시스템의 블록 비트맵은 bitmap_groups_init()으로 등록하여 할당
+ * 그룹 단위로 지연 로드한다. 마운트 시에는 그룹 요약 테이블(그룹별 빈 블록
+ * 수)만 읽고, 각 그룹의 비트맵 블록은 그 그룹에서 처음 할당·해제할 때 읽는다.
+ * 빈 블록이 없는 그룹은 비트맵을 읽지 않고 건너뛰며, bitmap_sync()는 바뀐
+ * 비트맵 블록과 요약 테이블 블록만 기록한다. 따라서 마운트·언마운트 비용이
+ * 장치 크기가 아니라 실제로 사용한 그룹 수에 비례한다.
  */
 
 #ifndef SFUSE_BITMAP_H
@@ -14,6 +21,23 @@
 #include <stddef.h>
 #include <stdint.h>
 
+/** @brief 그룹 요약 테이블 블록 하나에 담기는 그룹 수 (그룹당 8바이트) */
+#define SFUSE_SUMMARY_PER_BLOCK (SFUSE_BLOCK_SIZE / sizeof(uint64_t))
+
+/** @brief 빈 구간 길이 분포의 구간 수 (1블록 ~ 2^20블록 이상) */
+#define SFUSE_FREE_EXTENT_ORDERS 21
+
+/**
+ * @struct sfuse_free_extents
+ * @brief 블록 비트맵의 빈 구간(연속된 빈 블록) 통계
+ */
+struct sfuse_free_extents {
+  uint64_t count;   /**< 빈 구간 수 */
+  uint64_t blocks;  /**< 빈 블록 수 */
+  uint64_t largest; /**< 가장 긴 빈 구간의 블록 수 */
+  uint64_t order[SFUSE_FREE_EXTENT_ORDERS]; /**< 길이 [2^k, 2^(k+1)) 구간 수 */
+};
+
 /**
  * @brief 비트맵 데이터를 디스크에서 로드
  *
@@ -25,12 +49,14 @@
  * @param map_size 버퍼의 크기 (바이트 단위)
  * @return 성공 시 0, 실패 시 음수 오류 코드 반환
  */
-int bitmap_load(int fd, uint32_t block_no, uint8_t *map, size_t map_size);
+int bitmap_load(int fd, uint64_t block_no, uint8_t *map, size_t map_size);
 
 /**
  * @brief 비트맵 데이터를 디스크에 기록
  *
  * 메모리에 있는 비트맵 데이터를 지정된 디스크 블록에 저장한다.
+ * bitmap_groups_init()으로 등록한 블록 비트맵이면 바뀐 비트맵 블록과 그룹
+ * 요약 테이블 블록만 기록한다.
  *
  * @param fd 디바이스 파일 디스크립터
  * @param block_no 비트맵을 기록할 블록 번호
@@ -38,7 +64,36 @@ int bitmap_load(int fd, uint32_t block_no, uint8_t *map, size_t map_size);
  * @param map_size 버퍼의 크기 (바이트 단위)
  * @return 성공 시 0, 실패 시 음수 오류 코드 반환
  */
-int bitmap_sync(int fd, uint32_t block_no, uint8_t *map, size_t map_size);
+int bitmap_sync(int fd, uint64_t block_no, uint8_t *map, size_t map_size);
+
+/**
+ * @brief 블록 비트맵을 등록하고 그룹 요약 테이블을 읽는다.
+ *
+ * GROUP_SUMMARY 기능이 있으면 요약 테이블만 읽고 비트맵은 그룹별로 처음 쓸 때
+ * 읽는다. 기능이 없는 장치이거나 요약 테이블이 손상되었으면 비트맵 전체를
+ * 읽어 그룹별 빈 블록 수를 계산한다. (요약 테이블은 다음 동기화 때 다시 기록)
+ *
+ * @param fd        장치 파일 디스크립터
+ * @param sb        마운트된 파일 시스템의 슈퍼블록 (빈 블록 수 보정에 사용)
+ * @param block_map 블록 비트맵 버퍼 (blocks_count / 8 바이트, 0으로 초기화)
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ *         -ENOMEM : 그룹 상태 메모리 할당 실패
+ *         -EIO    : 비트맵 전체 읽기 실패
+ *         -EBADMSG: 비트맵 체크섬 불일치
+ */
+int bitmap_groups_init(int fd, struct sfuse_super *sb, uint8_t *block_map);
+
+/**
+ * @brief 등록한 블록 비트맵의 그룹 상태를 해제한다.
+ *
+ * 바뀐 내용은 먼저 bitmap_sync()로 기록해야 한다.
+ */
+void bitmap_groups_destroy(void);
+
+/**
+ * @brief 비트맵을 메모리에 읽어 둔 그룹 수 (통계용)
+ */
+uint32_t bitmap_groups_loaded(void);
 
 /**
  * @brief 데이터 블록 할당
@@ -49,7 +104,23 @@ int bitmap_sync(int fd, uint32_t block_no, uint8_t *map, size_t map_size);
  * @param block_map 블록 비트맵 버퍼
  * @return 할당된 블록의 오프셋(0부터 시작), 실패 시 -ENOSPC
  */
-int alloc_block(struct sfuse_super *sb, uint8_t *block_map);
+int64_t alloc_block(struct sfuse_super *sb, uint8_t *block_map);
+
+/**
+ * @brief 연속된 데이터 블록 묶음 할당
+ *
+ * want개의 연속된 빈 블록을 찾아 한꺼번에 할당한다. 그만큼 긴 빈 구간이 없으면
+ * 찾은 구간 중 가장 긴 구간을 할당하고, 실제 할당한 개수를 got으로 돌려준다.
+ * 동시에 alloc_block()이 구간 안의 블록을 가져가면 그 앞에서 끊겨 더 짧아진다.
+ *
+ * @param sb 슈퍼블록 구조체 포인터
+ * @param block_map 블록 비트맵 버퍼
+ * @param want 원하는 연속 블록 수 (1 이상)
+ * @param got 실제로 할당된 블록 수를 저장할 포인터
+ * @return 할당된 첫 블록의 오프셋(0부터 시작), 실패 시 -ENOSPC
+ */
+int64_t alloc_block_run(struct sfuse_super *sb, uint8_t *block_map,
+                        uint64_t want, uint64_t *got);
 
 /**
  * @brief 데이터 블록 해제
@@ -60,7 +131,34 @@ int alloc_block(struct sfuse_super *sb, uint8_t *block_map);
  * @param block_map 블록 비트맵 버퍼
  * @param offset 해제할 블록의 오프셋(0부터 시작)
  */
-void free_block(struct sfuse_super *sb, uint8_t *block_map, uint32_t offset);
+void free_block(struct sfuse_super *sb, uint8_t *block_map, uint64_t offset);
+
+/**
+ * @brief 지정한 데이터 블록을 할당된 것으로 표시
+ *
+ * 장애로 비트맵에 기록되지 못한 할당을 마운트할 때 다시 표시하는 데 쓴다.
+ * 이미 할당되어 있으면 아무 일도 하지 않는다.
+ *
+ * @param sb 슈퍼블록 구조체 포인터
+ * @param block_map 블록 비트맵 버퍼
+ * @param offset 표시할 블록의 오프셋(0부터 시작)
+ * @return 새로 표시했으면 1, 이미 할당되어 있었으면 0, 실패 시 음수 오류 코드
+ *         (그룹 비트맵을 읽지 못함)
+ */
+int claim_block(struct sfuse_super *sb, uint8_t *block_map, uint64_t offset);
+
+/**
+ * @brief 빈 공간 단편화 통계
+ *
+ * 블록 비트맵을 한 번 훑어 빈 구간의 수와 길이 분포를 구한다. 빈 블록이
+ * 충분해도 긴 구간이 없으면 지연 할당의 연속 배치가 어려워진다.
+ *
+ * @param sb 슈퍼블록 구조체 포인터
+ * @param block_map 블록 비트맵 버퍼
+ * @param out 결과를 저장할 구조체
+ */
+void bitmap_free_extents(const struct sfuse_super *sb, const uint8_t *block_map,
+                         struct sfuse_free_extents *out);
 
 /**
  * @brief 아이노드 할당
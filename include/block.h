@@ -18,7 +18,7 @@
  * @param buf       SFUSE_BLOCK_SIZE 바이트 버퍼
  * @return 0 성공, 음수 오류코드
  */
-int read_block(int fd, uint32_t block_no, void *buf);
+int read_block(int fd, uint64_t block_no, void *buf);
 
 /**
  * @brief 디바이스에 블록 단위(4KB)로 쓰기
@@ -27,6 +27,6 @@ int read_block(int fd, uint32_t block_no, void *buf);
  * @param buf       SFUSE_BLOCK_SIZE 바이트 데이터 버퍼
  * @return 0 성공, 음수 오류코드
  */
-int write_block(int fd, uint32_t block_no, const void *buf);
+int write_block(int fd, uint64_t block_no, const void *buf);
 
 #endif // SFUSE_BLOCK_H
@@ -0,0 +1,89 @@
+/**
+ * @file include/compress.h
+ * @brief 클러스터 단위 데이터 압축(LZ4 블록 형식) 함수 선언
+ *
+ * 압축을 켠 파일(SFUSE_INODE_FLAG_COMPRESS)의 데이터는 지연 할당 기록 시점에
+ * SFUSE_COMPRESS_CLUSTER_BLOCKS개 논리 블록(클러스터) 단위로 압축된다. 압축해도
+ * 블록이 하나 이상 줄지 않는 클러스터는 그대로 기록한다.
+ *
+ * 압축된 클러스터는 연속된 m개의 물리 블록(압축 구간)에 헤더와 함께 저장되고,
+ * 클러스터의 논리 블록 k개는 모두 SFUSE_BLOCK_COMPRESSED 비트가 있는 포인터를
+ * 갖는다. 앞의 m개는 구간의 블록을 하나씩(첫 포인터가 구간의 시작), 나머지는
+ * 물리 번호 0을 가리키므로 블록을 포인터마다 해제하는 기존 경로가 그대로 구간
+ * 전체를 해제한다.
+ *
+ * 읽기는 클러스터 첫 포인터의 구간을 통째로 읽어 풀고, 푼 클러스터는 작은
+ * 캐시에 보관해 같은 클러스터의 다음 블록 읽기가 다시 풀지 않게 한다.
+ */
+
+#ifndef SFUSE_COMPRESS_H
+#define SFUSE_COMPRESS_H
+
+#include "super.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief 압축 단위인 클러스터의 논리 블록 수 (64KiB) */
+#define SFUSE_COMPRESS_CLUSTER_BLOCKS 16
+
+/** @brief 푼 클러스터를 보관하는 캐시 칸 수 (칸마다 64KiB) */
+#define SFUSE_COMPRESS_CACHE_SLOTS 64
+
+/** @brief 압축 구간 헤더의 압축 방식: LZ4 블록 형식 */
+#define SFUSE_COMPRESS_LZ4 1
+
+/**
+ * @brief 클러스터 하나를 압축한다.
+ *
+ * 결과는 헤더와 압축 데이터이며, 블록 단위로 올림한 크기가 원래보다 한 블록
+ * 이상 작을 때만 돌려준다.
+ *
+ * @param src     클러스터 데이터 (nblocks개 블록)
+ * @param nblocks 클러스터의 논리 블록 수 (2 이상 SFUSE_COMPRESS_CLUSTER_BLOCKS
+ *                이하)
+ * @param dst     결과를 받을 버퍼 ((nblocks - 1)개 블록 크기 이상)
+ * @return 결과를 담은 블록 수, 압축할 가치가 없으면 0
+ */
+uint32_t compress_cluster(const void *src, uint32_t nblocks, void *dst);
+
+/**
+ * @brief 압축 구간에서 논리 블록 하나의 일부를 풀어 읽는다.
+ *
+ * @param fd  디바이스 파일 디스크립터
+ * @param pbn 압축 구간의 첫 물리 블록 번호 (클러스터 첫 포인터)
+ * @param idx 클러스터 안에서의 논리 블록 순번
+ * @param off 블록 내 시작 오프셋
+ * @param dst 데이터를 받을 버퍼
+ * @param len 읽을 바이트 수 (off + len은 블록 크기 이하)
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ *         -EIO: 읽기 실패, 체크섬 불일치 또는 손상된 압축 구간
+ *         -ENOMEM: 캐시 메모리 할당 실패
+ */
+int compress_read(int fd, uint64_t pbn, uint64_t idx, size_t off, void *dst,
+                  size_t len);
+
+/**
+ * @brief 해제한 압축 구간을 캐시에서 뺀다.
+ *
+ * @param pbn 해제한 물리 블록 번호 (구간의 시작이 아니면 아무 일도 없음)
+ */
+void compress_forget(uint64_t pbn);
+
+/**
+ * @brief 캐시에 보관한 클러스터를 모두 버린다.
+ */
+void compress_cache_drop(void);
+
+/**
+ * @brief 슈퍼블록에 압축 기능 표시를 남긴다.
+ *
+ * 압축 포인터를 처음 기록하기 전에 호출해, 압축을 모르는 드라이버가 장치를
+ * 마운트하지 않게 한다. 이미 표시되어 있으면 아무 일도 하지 않는다.
+ *
+ * @param fd 디바이스 파일 디스크립터
+ * @param sb 슈퍼블록 정보 포인터
+ * @return 성공 시 0, 실패 시 음수 오류 코드 (sb_sync()의 오류)
+ */
+int compress_feature_set(int fd, struct sfuse_super *sb);
+
+#endif // SFUSE_COMPRESS_H
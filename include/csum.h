@@ -0,0 +1,120 @@
+/**
+ * @file include/csum.h
+ * @brief CRC32C 계산과 블록 체크섬 테이블 관리 함수 선언
+ *
+ * METADATA_CSUM 기능으로 포맷된 장치는 저널 영역 뒤에 블록마다 4바이트
+ * CRC32C를 담는 체크섬 테이블을 둔다. 테이블은 메모리에 두되(장치 1GB당
+ * 1MB) 테이블 블록마다 처음 쓸 때 장치에서 읽으며, read_block()/write_block()과
+ * 비트맵 로드·동기화가 블록이 장치와 오갈 때 갱신하고 검증한다. 값이 0인 항목은 아직 체크섬이 기록되지
+ * 않은 블록으로 보고 검증하지 않는다.
+ *
+ * 아이노드 레코드는 블록의 일부만 읽고 쓰므로 테이블 대신 레코드 안의 reserved
+ * 필드에 자체 체크섬을 저장한다. (inode_load()/inode_sync())
+ *
+ * DATA_CSUM 기능이 함께 켜져 있으면 지연 할당 기록과 순차 읽기의 여러 블록
+ * 입출력에서도 데이터 블록 체크섬을 기록·검증한다. 꺼져 있으면 해당 블록의
+ * 항목을 0으로 지워 검증에서 제외한다.
+ */
+
+#ifndef SFUSE_CSUM_H
+#define SFUSE_CSUM_H
+
+#include "super.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief 체크섬 테이블 블록 하나에 담기는 항목 수 (1024개) */
+#define SFUSE_CSUM_PER_BLOCK (SFUSE_BLOCK_SIZE / sizeof(uint32_t))
+
+/**
+ * @brief CRC32C(Castagnoli) 값을 계산한다.
+ *
+ * SSE4.2를 지원하는 x86-64 CPU에서는 crc32 명령어를, 그 밖에는 slicing-by-8
+ * 테이블을 사용한다. crc에 이전 결과를 넘기면 이어서 계산한다.
+ * (crc32c(0, "123456789", 9) == 0xE3069283)
+ *
+ * @param crc 이전 CRC 값 (처음이면 0)
+ * @param buf 데이터
+ * @param len 데이터 크기 (바이트)
+ * @return CRC32C 값
+ */
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+
+/**
+ * @brief 사용 중인 CRC32C 구현 이름 ("sse4.2" 또는 "soft")
+ */
+const char *crc32c_impl(void);
+
+/**
+ * @brief 블록 체크섬을 켠다.
+ *
+ * METADATA_CSUM 기능이 없는 장치면 아무 일도 하지 않는다. 테이블 블록은 여기서
+ * 읽지 않고 그 블록의 항목을 처음 쓸 때 읽는다.
+ *
+ * @param fd 장치 파일 디스크립터
+ * @param sb 슈퍼블록 (테이블 위치와 기능 플래그)
+ * @param load 거짓이면 읽지 않고 빈 테이블로 시작 (mkfs)
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ *         -ENOMEM: 테이블 메모리 할당 실패
+ */
+int csum_init(int fd, const struct sfuse_super *sb, bool load);
+
+/**
+ * @brief 바뀐 체크섬 테이블 블록을 장치에 기록한다.
+ *
+ * @param fd 장치 파일 디스크립터
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ */
+int csum_sync(int fd);
+
+/**
+ * @brief 체크섬 테이블 메모리를 해제하고 블록 체크섬을 끈다.
+ */
+void csum_destroy(void);
+
+/**
+ * @brief 장치에 기록한 블록들의 체크섬을 갱신한다.
+ *
+ * size가 블록 크기의 배수가 아니면 마지막 블록의 나머지는 0으로 보고
+ * 계산한다. (비트맵 영역의 마지막 블록)
+ *
+ * @param block_no 첫 블록 번호
+ * @param buf      기록한 데이터
+ * @param size     데이터 크기 (바이트)
+ */
+void csum_update(uint64_t block_no, const void *buf, size_t size);
+
+/**
+ * @brief 장치에서 읽은 블록들의 체크섬을 검증한다.
+ *
+ * @param block_no 첫 블록 번호
+ * @param buf      읽은 데이터
+ * @param size     데이터 크기 (바이트, csum_update()와 같은 규칙)
+ * @return 일치하거나 체크섬이 없으면 0, 불일치하면 -EBADMSG
+ */
+int csum_verify(uint64_t block_no, const void *buf, size_t size);
+
+/**
+ * @brief 여러 블록 단위로 기록한 데이터 블록의 체크섬을 갱신한다.
+ *
+ * DATA_CSUM이 꺼져 있으면 계산하지 않고 항목을 지운다.
+ *
+ * @param block_no 첫 블록 번호
+ * @param buf      기록한 데이터
+ * @param nblocks  블록 수
+ */
+void csum_data_update(uint64_t block_no, const void *buf, uint64_t nblocks);
+
+/**
+ * @brief 여러 블록 단위로 읽은 데이터 블록의 체크섬을 검증한다.
+ *
+ * DATA_CSUM이 꺼져 있으면 항상 0을 돌려준다.
+ *
+ * @param block_no 첫 블록 번호
+ * @param buf      읽은 데이터
+ * @param nblocks  블록 수
+ * @return 일치하거나 체크섬이 없으면 0, 불일치하면 -EBADMSG
+ */
+int csum_data_verify(uint64_t block_no, const void *buf, uint64_t nblocks);
+
+#endif // SFUSE_CSUM_H
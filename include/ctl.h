@@ -0,0 +1,126 @@
+/**
+ * @file include/ctl.h
+ * @brief 실행 중인 마운트의 통계 조회와 제어를 위한 가상 파일 선언
+ *
+ * 마운트 루트 아래에 장치에 저장되지 않는 숨은 디렉터리 /.sfuse를 둔다.
+ *   - /.sfuse/stats  : 읽으면 "키 값" 형식의 한 줄 한 항목 통계를 돌려준다.
+ *   - /.sfuse/control: 명령을 쓰면 실행한다. (drop_caches, checkpoint, reset,
+ *                      snapshot, snapshot_delete, defrag, defrag_stop)
+ *
+ * 루트 디렉터리 목록에는 나타나지 않으며, 같은 이름의 파일을 만들 수 없다.
+ */
+
+#ifndef SFUSE_CTL_H
+#define SFUSE_CTL_H
+
+#include <fuse.h>
+#include <stddef.h>
+#include <sys/stat.h>
+
+/** @brief 가상 디렉터리 경로 */
+#define SFUSE_CTL_DIR "/.sfuse"
+
+struct sfuse_fs;
+
+/**
+ * @enum sfuse_ctl_node
+ * @brief 경로가 가리키는 가상 노드 종류
+ */
+enum sfuse_ctl_node {
+  SFUSE_CTL_NONE,    /**< 일반 경로 (가상 노드 아님) */
+  SFUSE_CTL_ROOT,    /**< /.sfuse 디렉터리 */
+  SFUSE_CTL_STATS,   /**< /.sfuse/stats */
+  SFUSE_CTL_CONTROL, /**< /.sfuse/control */
+  SFUSE_CTL_UNKNOWN  /**< /.sfuse 아래의 없는 경로 */
+};
+
+/**
+ * @brief 마운트 시각을 기록하고 통계 기준점을 초기화한다.
+ */
+void ctl_init(void);
+
+/**
+ * @brief 경로가 가상 노드인지 판별한다.
+ *
+ * 첫 구성요소가 ".sfuse"가 아니면 바로 SFUSE_CTL_NONE을 돌려준다.
+ *
+ * @param path FUSE 경로 (NULL이면 SFUSE_CTL_NONE)
+ * @return 가상 노드 종류
+ */
+enum sfuse_ctl_node ctl_node(const char *path);
+
+/**
+ * @brief 가상 노드의 속성을 채운다.
+ *
+ * @param node  가상 노드 종류
+ * @param stbuf 속성을 저장할 구조체
+ * @return 성공 시 0, 없는 노드면 -ENOENT
+ */
+int ctl_getattr(enum sfuse_ctl_node node, struct stat *stbuf);
+
+/**
+ * @brief /.sfuse 디렉터리의 항목을 나열한다.
+ *
+ * @param buf    readdir 버퍼
+ * @param filler 항목 추가 함수
+ * @return 성공 시 0
+ */
+int ctl_readdir(void *buf, fuse_fill_dir_t filler);
+
+/**
+ * @brief 가상 파일을 연다.
+ *
+ * stats는 여는 시점의 통계를 텍스트로 만들어 fi->fh에 보관하므로, 여러 번의
+ * read로 나누어 읽어도 한 시점의 일관된 값을 보게 된다.
+ *
+ * @param fs   파일 시스템 컨텍스트
+ * @param node 가상 노드 종류
+ * @param fi   FUSE 파일 정보
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ *         -EACCES: 접근 모드가 맞지 않거나 control을 열 권한이 없음
+ *         -EISDIR: 디렉터리를 파일로 열려고 함
+ *         -ENOMEM: 통계 텍스트를 만들 메모리 부족
+ */
+int ctl_open(struct sfuse_fs *fs, enum sfuse_ctl_node node,
+             struct fuse_file_info *fi);
+
+/**
+ * @brief 열 때 만든 통계 텍스트를 읽는다.
+ *
+ * @param fi     FUSE 파일 정보
+ * @param buf    데이터를 저장할 버퍼
+ * @param size   읽을 최대 바이트 수
+ * @param offset 읽기 시작 오프셋
+ * @return 읽은 바이트 수
+ */
+int ctl_read(struct fuse_file_info *fi, char *buf, size_t size, off_t offset);
+
+/**
+ * @brief control에 쓴 명령을 실행한다.
+ *
+ * 공백이나 줄바꿈으로 구분된 명령을 순서대로 실행한다.
+ *   - drop_caches: 더티 데이터를 기록한 뒤 장치의 페이지 캐시와 푼 클러스터
+ *     캐시를 버린다.
+ *   - checkpoint : 더티 데이터, 비트맵, 슈퍼블록을 기록하고 장치를 fsync한다.
+ *   - reset      : 연산 통계를 0부터 다시 센다.
+ *   - snapshot   : 파일 시스템 전체의 스냅숏을 만든다. (snap_create())
+ *   - snapshot_delete: 스냅숏을 지운다. (snap_delete())
+ *   - defrag     : 조각난 파일을 연속 구간으로 옮긴다. (defrag_start())
+ *   - defrag_stop: 진행 중인 조각 모음을 중단한다.
+ *
+ * @param fs   파일 시스템 컨텍스트
+ * @param buf  쓴 데이터
+ * @param size 데이터 크기
+ * @return 성공 시 size, 실패 시 음수 오류 코드
+ *         -EINVAL: 알 수 없는 명령
+ */
+int ctl_write(struct sfuse_fs *fs, const char *buf, size_t size);
+
+/**
+ * @brief 가상 파일을 닫고 열 때 만든 텍스트를 해제한다.
+ *
+ * @param fi FUSE 파일 정보
+ */
+void ctl_release(struct fuse_file_info *fi);
+
+#endif // SFUSE_CTL_H
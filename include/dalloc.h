@@ -0,0 +1,254 @@
+/**
+ * @file include/dalloc.h
+ * @brief 지연 할당(delayed allocation) 쓰기 버퍼 구조체 및 함수 선언
+ *
+ * 아직 물리 블록이 없는 논리 블록에 대한 쓰기를 곧바로 할당하지 않고 아이노드별
+ * 더티 버퍼에 모아 둔다. 물리 블록은 write-back(일정 시간 경과), fsync, 메모리
+ * 압박 시점에 파일 단위로 한꺼번에 연속 할당된다. 기록 전에 삭제된 임시 파일은
+ * 블록을 전혀 할당하지 않는다.
+ *
+ * 만료된 더티 데이터는 백그라운드 기록 스레드가 기록하므로 요청이 없는
+ * 마운트에서도 메모리에 남지 않는다. 메모리 한도는 쓰기 요청이 직접 지킨다.
+ * 한도를 넘으면 쓰기 전에 가장 큰 아이노드부터 기록하며, 그 아이노드를 처리
+ * 중인 요청이 있으면 끝나기를 기다린다.
+ */
+
+#ifndef SFUSE_DALLOC_H
+#define SFUSE_DALLOC_H
+
+#include "inode.h"
+#include "super.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+/** @brief 더티 블록 해시 테이블의 버킷 수 (2의 거듭제곱) */
+#define SFUSE_DALLOC_HASH_SIZE 4096
+
+/** @brief 메모리에 보관할 수 있는 최대 더티 블록 수 (64MiB)
+ *
+ * 이 값을 넘으면 더티 블록이 가장 많은 아이노드부터 기록하여 메모리를
+ * 확보한다.
+ */
+#define SFUSE_DALLOC_MAX_BLOCKS 16384
+
+/** @brief 더티 데이터를 메모리에 보관하는 최대 시간 (초)
+ *
+ * 처음 더티가 된 뒤 이 시간이 지난 아이노드는 기록 스레드가 기록한다.
+ */
+#define SFUSE_DALLOC_EXPIRE_SEC 5
+
+/** @brief 기록 스레드가 만료된 더티 데이터를 확인하는 주기 (초) */
+#define SFUSE_DALLOC_FLUSH_INTERVAL_SEC 1
+
+/** @brief 블록 기록 시 한 번의 disk_write()로 모아 쓰는 최대 블록 수 (1MiB) */
+#define SFUSE_DALLOC_IO_BLOCKS 256
+
+/** @brief 인다이렉트 블록 할당을 위해 예약 계산에서 남겨 두는 여유 블록 수 */
+#define SFUSE_DALLOC_META_SLACK 8
+
+struct sfuse_fs;
+struct dalloc_block;
+struct dalloc_inode;
+
+/**
+ * @struct sfuse_dalloc
+ * @brief 파일 시스템 전체의 지연 할당 버퍼 상태
+ *
+ * 더티 블록은 (아이노드 번호, 논리 블록 번호)로 해시 테이블에서 찾고, 아이노드별
+ * 목록으로도 연결되어 파일 단위 기록과 삭제에 사용된다. 기록 스레드 상태도
+ * lock으로 보호한다.
+ */
+struct sfuse_dalloc {
+  pthread_mutex_t lock; /**< 버퍼 구조 보호용 잠금 */
+  struct dalloc_block *hash[SFUSE_DALLOC_HASH_SIZE]; /**< 더티 블록 해시 */
+  struct dalloc_inode *inodes; /**< 더티 블록을 가진 아이노드 목록 */
+  uint64_t nblocks;            /**< 전체 더티 블록 수 (= 예약된 블록 수) */
+  pthread_cond_t wake;         /**< 기록 스레드에 종료 요청을 알림 */
+  pthread_t thread;            /**< 만료된 더티 데이터 기록 스레드 */
+  bool started;                /**< 기록 스레드가 실행 중인지 */
+  bool stop;                   /**< 기록 스레드 종료 요청 */
+};
+
+/**
+ * @struct sfuse_dalloc_usage
+ * @brief 지연 할당 버퍼의 현재 사용량 (dalloc_usage()가 채움)
+ */
+struct sfuse_dalloc_usage {
+  uint64_t dirty_blocks; /**< 더티 블록 수 */
+  uint32_t dirty_inodes; /**< 더티 블록을 가진 아이노드 수 */
+  time_t oldest;         /**< 가장 오래된 더티 데이터의 시각 (없으면 0) */
+};
+
+/**
+ * @brief 지연 할당 버퍼를 초기화한다.
+ *
+ * @param da 초기화할 버퍼 상태 포인터
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ */
+int dalloc_init(struct sfuse_dalloc *da);
+
+/**
+ * @brief 만료된 더티 데이터를 기록하는 스레드를 시작한다.
+ *
+ * 스냅숏 마운트는 읽기 전용이므로 시작하지 않는다. 스레드를 만들 수 없으면
+ * 더티 데이터는 fsync, 메모리 압박, 언마운트 때에만 기록된다.
+ *
+ * @param fs 파일 시스템 컨텍스트
+ */
+void dalloc_start(struct sfuse_fs *fs);
+
+/**
+ * @brief 기록 스레드를 멈추고 모든 더티 데이터를 기록한 뒤 버퍼를 정리한다.
+ *
+ * @param fs 파일 시스템 컨텍스트
+ */
+void dalloc_destroy(struct sfuse_fs *fs);
+
+/**
+ * @brief 버퍼에 있는 더티 블록에서 데이터를 읽는다.
+ *
+ * @param fs   파일 시스템 컨텍스트
+ * @param ino  아이노드 번호
+ * @param lbn  논리 블록 번호
+ * @param off  블록 내 시작 오프셋
+ * @param dst  데이터를 복사할 버퍼
+ * @param len  읽을 바이트 수
+ * @return 버퍼에 있으면 0, 없으면 -ENOENT
+ */
+int dalloc_read(struct sfuse_fs *fs, uint32_t ino, uint64_t lbn, size_t off,
+                void *dst, size_t len);
+
+/**
+ * @brief 더티 블록에 데이터를 기록한다.
+ *
+ * create가 참이면 버퍼에 없는 블록을 0으로 채워 새로 만들고 기록 시점까지
+ * 사용할 데이터 블록 하나를 예약한다.
+ *
+ * @param fs     파일 시스템 컨텍스트
+ * @param ino    아이노드 번호
+ * @param lbn    논리 블록 번호
+ * @param off    블록 내 시작 오프셋
+ * @param src    기록할 데이터
+ * @param len    기록할 바이트 수
+ * @param create 버퍼에 없을 때 새로 만들지 여부
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ *         -ENOENT : 버퍼에 없고 create가 거짓
+ *         -ENOSPC : 예약할 데이터 블록이 없음
+ *         -ENOMEM : 버퍼 메모리 할당 실패
+ */
+int dalloc_write(struct sfuse_fs *fs, uint32_t ino, uint64_t lbn, size_t off,
+                 const void *src, size_t len, bool create);
+
+/**
+ * @brief 논리 블록이 속한 압축 클러스터를 풀어 더티 버퍼로 옮긴다.
+ *
+ * 압축 클러스터의 블록을 제자리에서 고치기 전(쓰기, 자르기, 구멍 뚫기)에
+ * 호출한다. 아이노드를 장치에 기록하므로 호출자는 가지고 있던 아이노드를 다시
+ * 읽어야 한다.
+ *
+ * @param fs  파일 시스템 컨텍스트
+ * @param ino 아이노드 번호
+ * @param lbn 논리 블록 번호
+ * @return 풀었으면 1, 압축 클러스터가 아니면 0, 실패 시 음수 오류 코드
+ */
+int dalloc_expand(struct sfuse_fs *fs, uint32_t ino, uint64_t lbn);
+
+/**
+ * @brief 논리 블록이 더티 버퍼에 있는지 확인한다.
+ *
+ * @param fs  파일 시스템 컨텍스트
+ * @param ino 아이노드 번호
+ * @param lbn 논리 블록 번호
+ * @return 버퍼에 있으면 1, 없으면 0
+ */
+int dalloc_contains(struct sfuse_fs *fs, uint32_t ino, uint64_t lbn);
+
+/**
+ * @brief 아이노드의 더티 블록을 연속된 물리 블록에 할당하여 기록한다.
+ *
+ * 아이노드를 디스크에서 다시 읽어 블록 맵을 갱신하고 기록하므로, 호출자는
+ * 메모리에 들고 있는 같은 아이노드의 변경 사항을 먼저 inode_sync()해야 한다.
+ * 아이노드를 처리 중인 요청(defrag_io_begin())이 끝나기를 기다리므로, 어떤
+ * 아이노드의 요청 잠금도 잡지 않은 채로 호출해야 한다.
+ *
+ * @param fs  파일 시스템 컨텍스트
+ * @param ino 아이노드 번호
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ */
+int dalloc_flush_inode(struct sfuse_fs *fs, uint32_t ino);
+
+/**
+ * @brief 모든 아이노드의 더티 블록을 기록한다.
+ *
+ * 호출 시점에 더티 블록을 가진 아이노드마다 dalloc_flush_inode()를 호출한다.
+ *
+ * @param fs 파일 시스템 컨텍스트
+ * @return 성공 시 0, 실패 시 마지막으로 발생한 음수 오류 코드
+ */
+int dalloc_flush_all(struct sfuse_fs *fs);
+
+/**
+ * @brief defrag_io_freeze()로 요청을 막은 상태에서 모든 더티 블록을 기록한다.
+ *
+ * 재배치 잠금을 이미 잡았으므로 아이노드마다 잠금을 잡지 않고 기록한다.
+ *
+ * @param fs 파일 시스템 컨텍스트
+ * @return 성공 시 0, 실패 시 음수 오류 코드 (남은 블록은 버퍼에 남음)
+ */
+int dalloc_flush_frozen(struct sfuse_fs *fs);
+
+/**
+ * @brief 더티 데이터가 메모리 한도 아래로 내려갈 때까지 기록한다.
+ *
+ * 더티 블록을 만드는 요청이 아이노드를 읽기 전에 호출한다. 한도를 넘었으면
+ * 가장 큰 아이노드부터 dalloc_flush_inode()로 기록하므로, 어떤 아이노드의 요청
+ * 잠금도 잡지 않은 채로 호출해야 한다. 기록에 실패하면 더 기다리지 않는다.
+ *
+ * @param fs 파일 시스템 컨텍스트
+ */
+void dalloc_writeback(struct sfuse_fs *fs);
+
+/**
+ * @brief 새 파일 크기 이후의 더티 데이터를 버린다.
+ *
+ * 크기 이후 블록은 할당 없이 버려지고, 마지막 블록의 크기 이후 부분은 0으로
+ * 채워진다. size가 0이면 아이노드의 더티 데이터를 모두 버린다(파일 삭제).
+ *
+ * @param fs   파일 시스템 컨텍스트
+ * @param ino  아이노드 번호
+ * @param size 새 파일 크기 (바이트)
+ */
+void dalloc_truncate(struct sfuse_fs *fs, uint32_t ino, uint64_t size);
+
+/**
+ * @brief 바이트 범위 [start, end)의 더티 데이터를 버린다.
+ *
+ * fallocate의 PUNCH_HOLE에서 사용한다. 범위에 완전히 포함된 블록은 버리고,
+ * 일부만 걸친 블록은 겹치는 부분을 0으로 채운다.
+ *
+ * @param fs    파일 시스템 컨텍스트
+ * @param ino   아이노드 번호
+ * @param start 시작 바이트 오프셋
+ * @param end   끝 바이트 오프셋 (이 오프셋은 제외)
+ */
+void dalloc_punch(struct sfuse_fs *fs, uint32_t ino, uint64_t start,
+                  uint64_t end);
+
+/**
+ * @brief 더티 데이터용으로 예약된 블록 수를 반환한다.
+ *
+ * @param fs 파일 시스템 컨텍스트
+ * @return 예약된 블록 수
+ */
+uint64_t dalloc_reserved(struct sfuse_fs *fs);
+
+/**
+ * @brief 지연 할당 버퍼의 현재 사용량을 구한다.
+ *
+ * @param fs  파일 시스템 컨텍스트
+ * @param out 결과를 저장할 구조체
+ */
+void dalloc_usage(struct sfuse_fs *fs, struct sfuse_dalloc_usage *out);
+
+#endif // SFUSE_DALLOC_H
@@ -0,0 +1,176 @@
+/**
+ * @file include/dedup.h
+ * @brief 데이터 블록 중복 제거(참조 수 테이블과 지문 색인) 함수 선언
+ *
+ * -o dedup으로 마운트하면 지연 할당 기록 시점에 일반 파일의 블록마다 지문
+ * (XXH64)을 계산해 지문 색인에서 같은 내용의 블록을 찾는다. 찾은 블록의 내용을
+ * 직접 비교해 같으면 새 블록을 할당하지 않고 그 블록을 함께 가리킨다.
+ *
+ * 처음 -o dedup으로 마운트할 때 데이터 영역에서 연속 구간을 할당해 다음 두
+ * 표를 둔다. 구간의 위치는 슈퍼블록(refcount_start 등)에 기록되고, 이후에는
+ * -o dedup 없이 마운트해도 참조 수를 지킨다. (RO_COMPAT_REFCOUNT 기능)
+ *
+ * - 참조 수 테이블: 데이터 블록마다 16비트. 하위 15비트는 비트맵의 할당 표시
+ *   외에 더 있는 참조 수(공유한 횟수)이고, 최상위 비트는 지문 색인에 오른 일반
+ *   파일 데이터 블록이라는 표시다. 표시가 없는 블록(디렉터리, 인다이렉트,
+ *   압축 구간 등)은 공유 대상이 되지 않는다.
+ * - 지문 색인: {지문, 물리 블록 번호} 항목의 집합 연관(SFUSE_DEDUP_WAYS) 표.
+ *   집합이 차면 항목을 덮어쓰는 손실 색인이며, 찾은 블록은 항상 내용을 비교해
+ *   확인한다.
+ *
+ * 참조를 늘릴 때는 테이블을 곧바로 기록한 뒤 포인터를 연결하고, 줄일 때는
+ * 메모리에만 반영했다가 슈퍼블록을 기록할 때(포인터를 지운 아이노드가 기록된
+ * 뒤) 함께 기록한다. 장애가 나도 블록이 누수될 수는 있지만 아직 가리키는
+ * 파일이 있는 블록이 해제되지는 않는다.
+ */
+
+#ifndef SFUSE_DEDUP_H
+#define SFUSE_DEDUP_H
+
+#include "super.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/** @brief 블록 하나에 담기는 참조 수 항목 수 (항목당 2바이트) */
+#define SFUSE_REFCOUNT_PER_BLOCK (SFUSE_BLOCK_SIZE / 2)
+
+/** @brief 블록 하나에 담기는 지문 색인 항목 수 (항목당 16바이트) */
+#define SFUSE_DEDUP_ENTRIES_PER_BLOCK (SFUSE_BLOCK_SIZE / 16)
+
+/** @brief 지문 색인의 집합 하나에 든 항목 수 */
+#define SFUSE_DEDUP_WAYS 4
+
+/** @brief 지문 색인 항목 하나가 맡는 데이터 블록 수 (색인 크기 계산용) */
+#define SFUSE_DEDUP_BLOCKS_PER_ENTRY 4
+
+/** @brief 지문 색인의 최대 블록 수 (32MiB) */
+#define SFUSE_DEDUP_MAX_INDEX_BLOCKS 8192
+
+/** @brief 참조 수 항목에서 지문 색인에 오른 블록의 표시 비트 */
+#define SFUSE_REFCOUNT_INDEXED 0x8000
+
+/** @brief 참조 수 항목에서 더 있는 참조 수를 담는 비트 */
+#define SFUSE_REFCOUNT_MASK 0x7fff
+
+/** @brief 제자리 쓰기와 공유 확인을 직렬화하는 잠금 수 */
+#define SFUSE_DEDUP_LOCKS 64
+
+/**
+ * @brief 참조 수 테이블과 지문 색인을 준비한다.
+ *
+ * 슈퍼블록에 REFCOUNT 기능이 있으면 구간을 사용하고, 없는데 enable이면 구간을
+ * 할당해 0으로 채운 뒤 기능을 표시한다. 테이블은 블록마다 처음 쓸 때 읽는다.
+ *
+ * @param fd        디바이스 파일 디스크립터
+ * @param sb        슈퍼블록 정보 포인터
+ * @param block_map 블록 비트맵 버퍼
+ * @param enable    1이면 새로 기록하는 블록의 중복을 제거한다 (-o dedup)
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ *         -ENOSPC: 구간으로 쓸 연속된 빈 블록이 없음
+ *         -ENOMEM: 테이블 메모리 할당 실패
+ *         -EIO: 구간 초기화 실패
+ */
+int dedup_init(int fd, struct sfuse_super *sb, uint8_t *block_map,
+               bool enable);
+
+/**
+ * @brief 바뀐 테이블을 기록하고 메모리를 정리한다.
+ *
+ * @param fd 디바이스 파일 디스크립터
+ */
+void dedup_destroy(int fd);
+
+/**
+ * @brief 새로 기록하는 블록의 중복을 제거하는지 확인한다.
+ */
+bool dedup_enabled(void);
+
+/**
+ * @brief 바뀐 참조 수 테이블과 지문 색인 블록을 기록한다.
+ *
+ * sb_sync()가 슈퍼블록보다 먼저 호출한다. 참조 수 테이블을 쓰지 않으면 아무
+ * 일도 하지 않는다.
+ *
+ * @param fd 디바이스 파일 디스크립터
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ */
+int dedup_sync(int fd);
+
+/**
+ * @brief 블록 내용의 지문(XXH64)을 계산한다.
+ *
+ * @param block 블록 데이터 (SFUSE_BLOCK_SIZE 바이트)
+ * @return 64비트 지문
+ */
+uint64_t dedup_fingerprint(const void *block);
+
+/**
+ * @brief 내용이 같은 기존 블록을 찾아 참조를 하나 늘린다.
+ *
+ * 지문 색인이 가리키는 블록의 내용을 비교해 같으면 참조 수를 기록한 뒤 번호를
+ * 돌려준다. 호출자는 돌려받은 블록을 블록 맵에 연결하고, 연결하지 못하면
+ * dedup_release()로 참조를 되돌린다.
+ *
+ * @param fd    디바이스 파일 디스크립터
+ * @param fp    block의 지문
+ * @param block 기록하려는 블록 데이터
+ * @param pbn   찾은 물리 블록 번호를 받을 포인터
+ * @return 찾았으면 1, 없으면 0
+ */
+int dedup_lookup(int fd, uint64_t fp, const void *block, uint64_t *pbn);
+
+/**
+ * @brief 다른 파일에 연결할 기존 데이터 블록의 참조를 하나 늘린다.
+ *
+ * copy_file_range가 원본 블록을 복사하지 않고 대상 파일과 공유할 때 쓴다.
+ * 참조 수를 기록한 뒤 1을 돌려주며, 호출자는 블록을 블록 맵에 연결하고
+ * 연결하지 못하면 dedup_release()로 참조를 되돌린다.
+ *
+ * @param fd  디바이스 파일 디스크립터
+ * @param pbn 물리 블록 번호
+ * @return 참조를 늘렸으면 1, 참조 수 테이블이 없거나 참조 수가 한도에 닿았으면
+ *         0 (복사해야 함), 실패 시 음수 오류 코드
+ */
+int dedup_share(int fd, uint64_t pbn);
+
+/**
+ * @brief 새로 기록해 블록 맵에 연결한 일반 파일 데이터 블록을 색인에 올린다.
+ *
+ * @param fp  블록 내용의 지문
+ * @param pbn 물리 블록 번호
+ */
+void dedup_insert(uint64_t fp, uint64_t pbn);
+
+/**
+ * @brief 블록 맵에서 뺀 블록의 참조를 하나 놓는다.
+ *
+ * 더 있는 참조가 있으면 하나 줄이고, 없으면 색인 표시를 지운다. 참조 수를
+ * 읽을 수 없으면 블록을 해제하지 않도록 true를 돌려준다. (누수가 공유 블록
+ * 해제보다 안전함)
+ *
+ * @param pbn 물리 블록 번호 (데이터 영역 안)
+ * @return 블록을 다른 파일이 아직 가리키면 true (비트맵에서 해제하지 않음),
+ *         마지막 참조였으면 false
+ */
+bool dedup_release(uint64_t pbn);
+
+/**
+ * @brief 데이터 블록을 제자리에서 고치기 전에 공유 여부를 확인한다.
+ *
+ * 참조 수 테이블을 쓰면 블록의 잠금을 잡고, dedup_write_end()를 호출할 때까지
+ * 같은 블록을 새로 공유하지 못하게 한다. 반환값과 관계없이 dedup_write_end()를
+ * 호출해야 한다.
+ *
+ * @param pbn 물리 블록 번호
+ * @return 다른 파일과 공유 중이면 true (제자리에서 고치면 안 됨)
+ */
+bool dedup_write_begin(uint64_t pbn);
+
+/**
+ * @brief dedup_write_begin()이 잡은 잠금을 놓는다.
+ *
+ * @param pbn 물리 블록 번호
+ */
+void dedup_write_end(uint64_t pbn);
+
+#endif // SFUSE_DEDUP_H
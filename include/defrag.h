@@ -0,0 +1,189 @@
+/**
+ * @file include/defrag.h
+ * @brief 온라인 조각 모음(파일 재배치) 함수 선언
+ *
+ * alloc_block()은 항상 가장 낮은 빈 블록을 가져가므로, 동시에 기록한 파일은
+ * 블록 단위로 섞여 놓이고 오래 쓴 볼륨에서 순차 읽기가 느려진다.
+ * /.sfuse/control에 defrag를 쓰면 백그라운드 스레드가 아이노드 테이블을 한 번
+ * 훑으며 블록 맵을 따라가 조각난 일반 파일을 찾고, alloc_block_run()으로 얻은
+ * 연속 구간에 옮긴다.
+ *
+ * 파일 하나는 블록 맵 leaf 안에서 SFUSE_DEFRAG_BATCH_BLOCKS개씩 묶어 옮긴다.
+ * 묶음마다 원래 블록을 읽어 새 구간에 disk_write()로 기록하고(스냅숏이 있으면
+ * 복사 경로를 거침), 블록 맵을 바꿔 아이노드를 기록한 뒤에야 원래 블록을
+ * 해제한다. 한 묶음의 포인터는 아이노드 레코드나 인다이렉트 블록 하나에
+ * 있으므로 장애가 나면 묶음의 각 블록은 옮겨졌거나 옮겨지지 않았을 뿐 둘 다
+ * 온전하다. (해제했지만 비트맵에 반영되지 않은 블록이 남을 수는 있음)
+ *
+ * 압축 구간, 예약(unwritten) 블록, 중복 제거로 공유된 블록은 옮기지 않는다.
+ *
+ * 파일 데이터와 블록 맵을 다루는 요청은 defrag_io_begin()/defrag_io_end()로
+ * 아이노드의 재배치 잠금을 공유로 잡는다. 재배치 스레드는 묶음마다 이 잠금을
+ * 배타로 시도하고, 요청이 처리 중이면 기다리지 않고 물러났다가 다시 시도한다.
+ * 묶음 사이에는 쉬며, 그동안 읽기/쓰기 요청이 있었으면 더 오래 쉰다.
+ * 지연 할당 기록도 블록 맵을 바꾸므로 같은 잠금을 배타로 잡는다.
+ */
+
+#ifndef SFUSE_DEFRAG_H
+#define SFUSE_DEFRAG_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/** @brief 재배치 한 묶음에서 옮기는 최대 블록 수 (1MiB) */
+#define SFUSE_DEFRAG_BATCH_BLOCKS 256
+
+/** @brief 조각난 파일로 보는 평균 구간 길이 (이보다 짧으면 옮김, 1MiB)
+ *
+ * 이보다 짧은 빈 구간밖에 없으면 옮겨도 나아지지 않으므로 파일을 건너뛴다.
+ */
+#define SFUSE_DEFRAG_MIN_EXTENT 256
+
+/** @brief 묶음 사이에 쉬는 시간 (밀리초) */
+#define SFUSE_DEFRAG_BATCH_DELAY_MS 2
+
+/** @brief 직전 묶음 이후 읽기/쓰기 요청이 있었을 때 쉬는 시간 (밀리초) */
+#define SFUSE_DEFRAG_BUSY_DELAY_MS 50
+
+/** @brief 요청이 처리 중인 파일의 잠금을 다시 시도하는 횟수 */
+#define SFUSE_DEFRAG_BUSY_RETRIES 20
+
+/** @brief 이만큼의 아이노드를 훑을 때마다 쉼 */
+#define SFUSE_DEFRAG_SCAN_INODES 1024
+
+/** @brief 아이노드별 재배치 잠금 수 */
+#define SFUSE_DEFRAG_LOCKS 64
+
+struct sfuse_fs;
+
+/**
+ * @struct sfuse_defrag
+ * @brief 재배치 스레드 상태
+ *
+ * 아래 필드는 lock으로 보호한다.
+ */
+struct sfuse_defrag {
+  pthread_mutex_t lock; /**< 상태 보호용 잠금 */
+  pthread_cond_t wake;  /**< 시작/중단/종료 요청을 알림 */
+  pthread_t thread;     /**< 재배치 스레드 */
+  bool started;         /**< 재배치 스레드가 실행 중인지 */
+  bool stop;            /**< 재배치 스레드 종료 요청 */
+  bool pending;         /**< 새 훑기 요청 */
+  bool cancel;          /**< 진행 중인 훑기 중단 요청 */
+  bool running;         /**< 훑는 중 */
+  uint32_t cursor;      /**< 다음에 볼 아이노드 번호 (진행률) */
+};
+
+/**
+ * @brief 재배치 스레드를 시작한다.
+ *
+ * 스레드는 defrag_start()로 요청할 때까지 잠들어 있다. 스냅숏 마운트는 읽기
+ * 전용이므로 시작하지 않는다.
+ *
+ * @param fs 파일 시스템 컨텍스트
+ */
+void defrag_init(struct sfuse_fs *fs);
+
+/**
+ * @brief 진행 중인 묶음을 마치고 재배치 스레드를 멈춘다.
+ *
+ * @param fs 파일 시스템 컨텍스트
+ */
+void defrag_destroy(struct sfuse_fs *fs);
+
+/**
+ * @brief 조각난 파일을 찾아 옮기는 훑기를 한 번 시작한다.
+ *
+ * @param fs 파일 시스템 컨텍스트
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ *         -EROFS: 스냅숏 마운트
+ *         -EBUSY: 이미 훑는 중
+ *         -EAGAIN: 재배치 스레드를 만들지 못함
+ */
+int defrag_start(struct sfuse_fs *fs);
+
+/**
+ * @brief 진행 중인 훑기를 중단한다. (옮기던 묶음은 마침)
+ *
+ * @param fs 파일 시스템 컨텍스트
+ */
+void defrag_stop(struct sfuse_fs *fs);
+
+/**
+ * @brief 훑는 중인지 확인하고 진행률을 돌려준다.
+ *
+ * @param fs     파일 시스템 컨텍스트
+ * @param cursor 다음에 볼 아이노드 번호를 받을 포인터 (NULL 가능)
+ * @return 훑는 중이면 참
+ */
+bool defrag_running(struct sfuse_fs *fs, uint32_t *cursor);
+
+/**
+ * @brief 아이노드의 데이터나 블록 맵을 다루기 전에 재배치 잠금을 공유로 잡는다.
+ *
+ * 반드시 defrag_io_end()로 놓는다. 두 아이노드를 함께 다룰 때는 같은 잠금을
+ * 두 번 잡거나 순서가 엇갈리지 않도록 defrag_io_lock_pair()를 쓴다.
+ *
+ * @param ino 아이노드 번호
+ */
+void defrag_io_begin(uint32_t ino);
+
+/**
+ * @brief 아이노드의 재배치 잠금을 배타로 잡는다.
+ *
+ * 요청이 들고 있는 아이노드 사본과 블록 맵을 바꾸는 쪽(재배치, 지연 할당
+ * 기록)이 사용한다. 기다리지 않으면 다른 잠금을 잡은 채로 호출해도 된다.
+ * defrag_io_end()로 놓는다.
+ *
+ * @param ino  아이노드 번호
+ * @param wait 참이면 요청이 끝날 때까지 기다림
+ * @return 잡았으면 참
+ */
+bool defrag_io_lock(uint32_t ino, bool wait);
+
+/**
+ * @brief 원본 아이노드의 재배치 잠금을 배타로, 대상 아이노드의 잠금을 공유로
+ *        잡는다.
+ *
+ * copy_file_range가 원본 블록을 대상 파일과 공유하는 동안 원본의 블록 맵이
+ * 바뀌지 않게 한다. 서로 다른 잠금만 번호 순서대로 한 번씩 잡으며, 두
+ * 아이노드가 같은 잠금을 쓰면 배타로 한 번 잡는다. defrag_io_end_pair()로
+ * 놓는다.
+ *
+ * @param src 원본 아이노드 번호
+ * @param dst 대상 아이노드 번호
+ */
+void defrag_io_lock_pair(uint32_t src, uint32_t dst);
+
+/**
+ * @brief defrag_io_lock_pair()가 잡은 잠금을 놓는다.
+ *
+ * @param src 원본 아이노드 번호
+ * @param dst 대상 아이노드 번호
+ */
+void defrag_io_end_pair(uint32_t src, uint32_t dst);
+
+/**
+ * @brief 모든 아이노드의 재배치 잠금을 번호 순서대로 배타로 잡는다.
+ *
+ * 진행 중인 요청과 재배치, 지연 할당 기록, 고아 회수가 끝나기를 기다리고 새로
+ * 시작하지 못하게 한다. 스냅숏을 만드는 동안 장치를 한 시점의 상태로 묶는 데
+ * 쓴다. 다른 재배치 잠금을 잡은 채로 호출하면 안 되며, defrag_io_thaw()로
+ * 놓는다.
+ */
+void defrag_io_freeze(void);
+
+/**
+ * @brief defrag_io_freeze()가 잡은 잠금을 모두 놓는다.
+ */
+void defrag_io_thaw(void);
+
+/**
+ * @brief defrag_io_begin()이나 defrag_io_lock()이 잡은 잠금을 놓는다.
+ *
+ * @param ino 아이노드 번호
+ */
+void defrag_io_end(uint32_t ino);
+
+#endif // SFUSE_DEFRAG_H
@@ -0,0 +1,92 @@
+/**
+ * @file include/discard.h
+ * @brief 해제한 데이터 블록의 discard(TRIM) 묶음 처리 함수 선언
+ *
+ * free_block()이 해제한 블록은 곧바로 장치에 알리지 않고 대기 목록에 모은다.
+ * 해제를 포함한 기록이 커밋(fs_sync_device())되면 목록을 정렬해 인접한 구간을
+ * 합친 뒤, 백그라운드 스레드가 구간마다 한 번씩 장치에 알린다. 블록 장치는
+ * BLKDISCARD, 이미지 파일은 fallocate(FALLOC_FL_PUNCH_HOLE)를 사용한다.
+ *
+ * 커밋 전에 해제된 블록은 장애 뒤에도 메타데이터가 여전히 가리킬 수 있으므로
+ * 커밋이 끝난 블록만 discard한다. 대기 중인 블록이 다시 할당되면
+ * discard_claim()이 그 구간을 목록에서 빼고, 이미 장치에 요청 중이면 끝날
+ * 때까지 기다려 새로 기록한 데이터가 지워지지 않게 한다.
+ */
+
+#ifndef SFUSE_DISCARD_H
+#define SFUSE_DISCARD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** @brief 목록마다 보관하는 최대 구간 수 (넘치는 구간은 discard하지 않음) */
+#define SFUSE_DISCARD_MAX_EXTENTS 65536
+
+/**
+ * @brief discard 처리를 시작한다.
+ *
+ * 장치 종류에 따라 discard 방법을 정하고 백그라운드 스레드를 만든다. 블록
+ * 장치나 일반 파일이 아니면 discard를 쓰지 않고 성공을 돌려준다.
+ *
+ * @param fd 장치 파일 디스크립터
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ *         -errno: fstat() 또는 스레드 생성 실패
+ */
+int discard_init(int fd);
+
+/**
+ * @brief 커밋된 구간을 모두 장치에 알린 뒤 스레드를 멈추고 목록을 정리한다.
+ *
+ * 아직 커밋되지 않은 구간은 버린다. (discard_init() 전에도 호출할 수 있음)
+ */
+void discard_destroy(void);
+
+/**
+ * @brief discard를 사용 중인지 확인한다.
+ */
+bool discard_enabled(void);
+
+/**
+ * @brief 해제한 블록 구간을 대기 목록에 더한다.
+ *
+ * @param blk 구간의 첫 블록 번호 (장치 기준)
+ * @param len 블록 수
+ */
+void discard_note(uint64_t blk, uint64_t len);
+
+/**
+ * @brief 지금까지 대기 목록에 모은 구간을 이번 커밋 대상으로 묶는다.
+ *
+ * 장치 플러시 직전에 호출한다. 이후 해제된 블록은 다음 커밋 대상이다.
+ */
+void discard_seal(void);
+
+/**
+ * @brief 묶어 둔 구간을 합쳐 백그라운드 스레드에 넘긴다.
+ *
+ * 장치 플러시가 성공한 뒤에 호출한다. 플러시가 실패하면 호출하지 않으며, 묶은
+ * 구간은 다음 커밋 때 함께 처리된다.
+ */
+void discard_commit(void);
+
+/**
+ * @brief 다시 할당한 블록 구간을 discard 대상에서 뺀다.
+ *
+ * 구간이 장치에 요청 중이면 요청이 끝날 때까지 기다린다.
+ *
+ * @param blk 구간의 첫 블록 번호 (장치 기준)
+ * @param len 블록 수
+ */
+void discard_claim(uint64_t blk, uint64_t len);
+
+/**
+ * @brief 해제한 블록을 대기 목록에 더할지 정한다.
+ *
+ * 스냅숏이 있는 동안에는 원본에서 해제한 블록도 스냅숏이 가리킬 수 있으므로
+ * discard하지 않는다. 이미 목록에 있는 구간은 그대로 처리한다.
+ *
+ * @param hold 참이면 이후 discard_note()를 무시한다
+ */
+void discard_hold(bool hold);
+
+#endif // SFUSE_DISCARD_H
@@ -24,8 +24,8 @@
  * 이 함수는 주어진 파일 디스크립터(fd)를 사용하여 지정된 offset 위치에서부터
  * size 바이트만큼 데이터를 읽어 buf가 가리키는 메모리 영역에 저장한다.
  *
- * 내부적으로는 디바이스 내 offset 위치로 lseek를 수행한 뒤 read 시스템 호출을
- * 통해 읽기를 수행한다.
+ * 내부적으로는 pread 시스템 호출로 읽기를 수행하므로 파일 포인터를 공유하는
+ * 여러 스레드에서 동시에 호출해도 된다.
  *
  * @param fd     원시 디바이스 파일 디스크립터 (open으로 열림)
  * @param buf    데이터를 저장할 메모리 버퍼의 포인터
@@ -45,8 +45,8 @@ ssize_t disk_read(int fd, void *buf, size_t size, off_t offset);
  * 이 함수는 주어진 파일 디스크립터(fd)를 사용하여 지정된 offset 위치에서부터
  * buf가 가리키는 데이터를 size 바이트만큼 디스크에 기록한다.
  *
- * 내부적으로는 디바이스 내 offset 위치로 lseek를 수행한 뒤 write 시스템 호출을
- * 통해 기록을 수행한다.
+ * 내부적으로는 pwrite 시스템 호출로 기록을 수행한다. (disk_read()와 같이
+ * 여러 스레드에서 동시에 호출해도 됨)
  *
  * @param fd     원시 디바이스 파일 디스크립터 (open으로 열림)
  * @param buf    기록할 데이터를 담고 있는 메모리 버퍼의 포인터
@@ -61,6 +61,29 @@ ssize_t disk_read(int fd, void *buf, size_t size, off_t offset);
  */
 ssize_t disk_write(int fd, const void *buf, size_t size, off_t offset);
 
+/**
+ * @struct disk_hooks
+ * @brief disk_read()/disk_write()가 장치에 접근할 때 거치는 함수
+ *
+ * 스냅숏 모듈(snap.c)이 마운트할 때 등록한다. 등록하지 않으면(mkfs 등)
+ * pread/pwrite로 바로 접근한다.
+ */
+struct disk_hooks {
+  /** pread 대신 호출한다. 실패 시 음수(-errno)를 돌려준다. (NULL이면 pread) */
+  ssize_t (*read)(int fd, void *buf, size_t size, off_t offset);
+  /** 기록하기 전에 호출한다. 음수를 돌려주면 기록하지 않고 그 값을 돌려준다. */
+  int (*write)(int fd, off_t offset, size_t size);
+};
+
+/**
+ * @brief 장치 접근 함수를 등록한다.
+ *
+ * 요청을 처리하는 스레드가 없을 때(마운트 초기화와 정리 단계) 호출한다.
+ *
+ * @param hooks 등록할 함수 (NULL이면 등록 해제)
+ */
+void disk_set_hooks(const struct disk_hooks *hooks);
+
 #endif // SFUSE_DISK_H
 
 // NOTE: read_block()과 write_block() 함수는 중복 코드를 방지하기 위해
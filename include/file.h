@@ -0,0 +1,127 @@
+/**
+ * @file include/file.h
+ * @brief 열린 파일 핸들(fi->fh) 구조체 및 함수 선언
+ *
+ * open/create 시점에 만들어 fi->fh에 저장하고 release에서 해제한다. 핸들은
+ * 아이노드와 블록 맵 일부를 캐시하므로, 열린 파일에 대한 read/write는 경로
+ * 탐색과 아이노드 읽기 없이 처리된다. 다른 경로에서 아이노드가 기록되면
+ * inode_generation()이 바뀌어 다음 접근 시 다시 읽는다.
+ *
+ * FUSE는 같은 핸들의 요청을 여러 스레드에서 동시에 보낼 수 있으므로, 캐시를
+ * 사용하는 동안(file_revalidate()부터 file_readahead()까지) lock을 잡는다.
+ */
+
+#ifndef SFUSE_FILE_H
+#define SFUSE_FILE_H
+
+#include "inode.h"
+#include <pthread.h>
+#include <stdint.h>
+
+/** @brief 순차 읽기가 감지되었을 때 처음 미리 읽는 크기 (128KiB) */
+#define SFUSE_RA_MIN (128 * 1024)
+
+/** @brief 미리 읽기 창의 최대 크기 (1MiB) */
+#define SFUSE_RA_MAX (1024 * 1024)
+
+struct sfuse_fs;
+
+/**
+ * @struct sfuse_file
+ * @brief open/create로 만들어지는 열린 파일 객체
+ */
+struct sfuse_file {
+  pthread_mutex_t lock;     /**< 아래 캐시 보호용 잠금 */
+  uint32_t ino;             /**< 아이노드 번호 */
+  int accmode;              /**< 접근 모드 (O_RDONLY, O_WRONLY, O_RDWR) */
+  uint32_t gen;             /**< 캐시 시점의 아이노드 세대 번호 */
+  struct sfuse_inode inode; /**< 캐시된 아이노드 */
+
+  bool map_valid;     /**< 블록 맵 캐시 유효 여부 */
+  uint32_t map_count; /**< 캐시된 포인터 수 */
+  uint64_t map_base;  /**< 캐시된 첫 항목의 논리 블록 번호 */
+  uint64_t map[SFUSE_ADDR_PER_BLOCK]; /**< 캐시된 블록 맵 leaf */
+
+  uint64_t ra_next;   /**< 순차 읽기라면 다음에 올 오프셋 */
+  uint64_t ra_end;    /**< 미리 읽기를 요청한 끝 오프셋 */
+  uint64_t ra_window; /**< 현재 미리 읽기 창 크기 (0이면 비순차) */
+};
+
+/**
+ * @brief 열린 파일 객체를 만들고 아이노드를 캐시한다.
+ *
+ * @param fs    파일 시스템 컨텍스트
+ * @param ino   아이노드 번호
+ * @param flags open 플래그 (fi->flags)
+ * @param out   만들어진 객체를 돌려받을 포인터
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ *         -ENOMEM : 메모리 할당 실패
+ *         -EIO    : 아이노드 읽기 실패
+ */
+int file_open(struct sfuse_fs *fs, uint32_t ino, int flags,
+              struct sfuse_file **out);
+
+/**
+ * @brief 열린 파일 객체를 해제한다.
+ *
+ * @param f 해제할 객체 (NULL 가능)
+ */
+void file_close(struct sfuse_file *f);
+
+/**
+ * @brief 캐시된 아이노드가 최신인지 확인하고, 아니면 다시 읽는다.
+ *
+ * 이 함수와 file_bmap(), file_readahead()는 f->lock을 잡은 채 호출한다.
+ *
+ * @param fs 파일 시스템 컨텍스트
+ * @param f  열린 파일 객체
+ * @return 성공 시 0, 아이노드 읽기 실패 시 -EIO
+ */
+int file_revalidate(struct sfuse_fs *fs, struct sfuse_file *f);
+
+/**
+ * @brief 핸들이 캐시된 아이노드를 직접 기록한 뒤 세대 번호를 갱신한다.
+ *
+ * @param f 열린 파일 객체
+ */
+void file_synced(struct sfuse_file *f);
+
+/**
+ * @brief 블록 맵 캐시를 버린다. 블록 맵을 바꾼 뒤 호출한다.
+ *
+ * @param f 열린 파일 객체
+ */
+void file_map_invalidate(struct sfuse_file *f);
+
+/**
+ * @brief 캐시된 블록 맵으로 논리 블록을 물리 블록으로 변환한다.
+ *
+ * 반환 값은 logical_to_physical()과 같다. 캐시에 없는 leaf는 inode_map_leaf()로
+ * 읽어 캐시한다.
+ *
+ * @param fs      파일 시스템 컨텍스트
+ * @param f       열린 파일 객체
+ * @param lbn     논리 블록 번호
+ * @param pbn_out 물리 블록 번호를 돌려받을 포인터
+ * @return 성공 시 0, 예약만 된(unwritten) 블록이면 1, 압축 클러스터의 블록이면
+ *         2, 할당되지 않은 블록이면 -ENOENT, 그 외 음수의 오류 코드
+ */
+int file_bmap(struct sfuse_fs *fs, struct sfuse_file *f, uint64_t lbn,
+              uint64_t *pbn_out);
+
+/**
+ * @brief 순차 읽기를 감지하여 다음 구간의 데이터 블록을 미리 읽도록 요청한다.
+ *
+ * 직전 읽기의 끝에서 이어지는 읽기가 오면 창 크기를 SFUSE_RA_MIN부터
+ * SFUSE_RA_MAX까지 두 배씩 늘리며, 다음 구간의 물리 블록 범위에
+ * posix_fadvise(POSIX_FADV_WILLNEED)를 호출한다.
+ *
+ * @param fs     파일 시스템 컨텍스트
+ * @param f      열린 파일 객체
+ * @param offset 방금 읽은 시작 오프셋
+ * @param size   방금 읽은 바이트 수
+ */
+void file_readahead(struct sfuse_fs *fs, struct sfuse_file *f, uint64_t offset,
+                    size_t size);
+
+#endif // SFUSE_FILE_H
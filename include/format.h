@@ -0,0 +1,34 @@
+/**
+ * @file include/format.h
+ * @brief SFUSE 파일 시스템 포맷(mkfs) 함수 선언
+ *
+ * 장치에 슈퍼블록, 비트맵, 아이노드 테이블과 루트 디렉터리를 기록하여 새로운
+ * SFUSE 파일 시스템을 생성한다. FUSE에 의존하지 않으므로 mkfs.sfuse와 같은
+ * 독립 실행 도구에서도 사용할 수 있다.
+ */
+
+#ifndef SFUSE_FORMAT_H
+#define SFUSE_FORMAT_H
+
+#include "super.h"
+#include <stdint.h>
+#include <sys/types.h>
+
+/** @brief 포맷 시 메타데이터 영역을 0으로 채울 때 사용하는 한 번의 쓰기 크기 */
+#define SFUSE_FORMAT_IO_SIZE (1024 * 1024)
+
+/**
+ * @brief 장치를 SFUSE 파일 시스템으로 포맷한다.
+ *
+ * @param fd        포맷할 장치(또는 이미지 파일)의 파일 디스크립터
+ * @param dev_bytes 장치 전체 크기 (바이트)
+ * @param geo       mkfs 구성 값 (NULL이면 기본값)
+ * @param uid       루트 디렉터리 소유자 사용자 ID
+ * @param gid       루트 디렉터리 소유자 그룹 ID
+ * @param sb_out    기록된 슈퍼블록을 돌려받을 포인터 (NULL 가능)
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ */
+int fs_format(int fd, uint64_t dev_bytes, const struct sfuse_geometry *geo,
+              uid_t uid, gid_t gid, struct sfuse_super *sb_out);
+
+#endif // SFUSE_FORMAT_H
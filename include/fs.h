@@ -6,6 +6,9 @@
 #ifndef SFUSE_FS_H
 #define SFUSE_FS_H
 
+#include "dalloc.h"
+#include "defrag.h"
+#include "orphan.h"
 #include "super.h"
 #include <stdint.h>
 
@@ -26,6 +29,61 @@
  */
 #define SFUSE_ROOT_INO 1
 
+/**
+ * @defgroup sfuse_cache_defaults 커널 캐시 기본값
+ *
+ * 장치의 모든 변경은 SFUSE를 거치므로 커널의 항목/속성 캐시를 길게 유지해도
+ * 일관성이 깨지지 않는다. 마운트 옵션(-o entry_timeout= 등)으로 바꿀 수 있다.
+ * @{
+ */
+#define SFUSE_DEFAULT_ENTRY_TIMEOUT 60.0    /**< 디렉터리 항목 캐시 시간 (초) */
+#define SFUSE_DEFAULT_ATTR_TIMEOUT 60.0     /**< 속성 캐시 시간 (초) */
+#define SFUSE_DEFAULT_NEGATIVE_TIMEOUT 10.0 /**< 없는 항목 캐시 시간 (초) */
+#define SFUSE_MAX_WRITE (1024 * 1024)       /**< 쓰기 요청 최대 크기 */
+#define SFUSE_MAX_READAHEAD (1024 * 1024)   /**< 커널 readahead 최대 크기 */
+#define SFUSE_MAX_BACKGROUND 64             /**< 최대 비동기 요청 수 */
+/** @} */
+
+/**
+ * @struct sfuse_mount_opts
+ * @brief 마운트 옵션(-o)으로 지정하는 커널 캐시 설정
+ *
+ * main()이 fuse_opt_parse()로 채우고, sfuse_init_cb()가 fuse_config 및
+ * fuse_conn_info에 반영한다.
+ */
+struct sfuse_mount_opts {
+  double entry_timeout;    /**< 디렉터리 항목 캐시 시간 (초) */
+  double attr_timeout;     /**< 속성 캐시 시간 (초) */
+  double negative_timeout; /**< 없는 항목(ENOENT) 캐시 시간 (초) */
+  int no_writeback_cache;  /**< 1이면 커널 writeback 캐시를 쓰지 않는다 */
+  int no_keep_cache;       /**< 1이면 open마다 페이지 캐시를 버린다 */
+  int mmap_meta;           /**< 1이면 메타데이터 영역을 mmap으로 접근한다 */
+  int no_discard;          /**< 1이면 해제한 블록을 장치에 discard하지 않는다 */
+  int compress;            /**< 1이면 새 파일의 데이터를 압축해 기록한다 */
+  int dedup;               /**< 1이면 새로 기록하는 블록의 중복을 제거한다 */
+  int snapshot;            /**< 1이면 스냅숏을 읽기 전용으로 마운트한다 */
+};
+
+struct fuse;
+
+/**
+ * @struct sfuse_sync
+ * @brief 장치 플러시 묶음 처리(fsync coalescing) 상태
+ *
+ * 동시에 들어온 fsync 요청마다 장치를 플러시하지 않고, 한 스레드가 대표로
+ * 플러시하는 동안 도착한 요청은 기다렸다가 다음 플러시 한 번으로 함께 처리한다.
+ * 요청 번호가 완료 번호 이하이면 그 요청 이전의 기록은 모두 장치에 반영된 것이다.
+ */
+struct sfuse_sync {
+  pthread_mutex_t lock;  /**< 상태 보호용 잠금 */
+  pthread_cond_t done;   /**< 플러시 완료 알림 */
+  uint64_t requested;    /**< 마지막으로 발급한 요청 번호 */
+  uint64_t completed;    /**< 완료된 플러시가 포함하는 마지막 요청 번호 */
+  bool running;          /**< 플러시 진행 중 여부 */
+  bool full;             /**< 대기 요청 중 fsync(메타데이터 포함)가 있음 */
+  int result;            /**< 마지막 플러시 결과 (0 또는 음수 오류 코드) */
+};
+
 /**
  * @struct sfuse_fs
  * @brief SFUSE 파일 시스템의 전역 컨텍스트를 나타내는 구조체
@@ -44,6 +102,12 @@ struct sfuse_fs {
   struct sfuse_super sb; /**< 슈퍼블록 구조체 */
   uint8_t *block_map;    /**< 블록 비트맵 버퍼 포인터 */
   uint8_t *inode_map;    /**< 아이노드 비트맵 버퍼 포인터 */
+  struct sfuse_dalloc dalloc; /**< 지연 할당 쓰기 버퍼 */
+  struct sfuse_mount_opts opts; /**< 커널 캐시 관련 마운트 옵션 */
+  struct fuse *fuse;            /**< 캐시 무효화 요청에 사용할 FUSE 핸들 */
+  struct sfuse_sync sync;       /**< 장치 플러시 묶음 처리 상태 */
+  struct sfuse_orphan orphan;   /**< 고아 목록과 회수 스레드 상태 */
+  struct sfuse_defrag defrag;   /**< 조각 모음 스레드 상태 */
 };
 
 /**
@@ -70,6 +134,81 @@ int fs_initialize(int backing_fd);
  */
 void fs_destroy(void *private_data);
 
+/**
+ * @brief 비트맵 메모리를 해제한다. (메타데이터 매핑이면 매핑을 해제)
+ *
+ * @param fs 파일 시스템 컨텍스트
+ */
+void fs_free_maps(struct sfuse_fs *fs);
+
+/**
+ * @brief 그동안 기록한 내용을 장치에 영구 반영한다. (fsync 묶음 처리)
+ *
+ * 이 함수를 호출하기 전에 끝난 disk_write()와 메타데이터 매핑의 변경은 반환
+ * 시점에 모두 장치에 반영되어 있다. 여러 스레드가 동시에 호출하면 장치 플러시는 한 번만 실행되고, 플러시가
+ * 이미 진행 중이면 끝나기를 기다렸다가 그동안 모인 요청을 한 번에 처리한다.
+ *
+ * @param fs       파일 시스템 컨텍스트
+ * @param datasync 참이면 fdatasync로 충분함 (모인 요청이 모두 datasync일 때만)
+ * @return 성공 시 0, 실패 시 음수 오류 코드 (fsync/fdatasync의 errno)
+ */
+int fs_sync_device(struct sfuse_fs *fs, bool datasync);
+
+/**
+ * @brief 더티 데이터, 비트맵, 슈퍼블록을 기록하고 장치를 fsync한다.
+ *
+ * 반환 시점의 장치 내용만으로 파일 시스템을 마운트할 수 있다.
+ *
+ * @param fs 파일 시스템 컨텍스트
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ */
+int fs_checkpoint(struct sfuse_fs *fs);
+
+/**
+ * @brief 데이터 요청을 막고 장치를 한 시점의 상태로 기록한다.
+ *
+ * fs_checkpoint()로 먼저 기록한 뒤 defrag_io_freeze()로 데이터 요청, 재배치,
+ * 지연 할당 기록, 고아 회수를 멈추고 그사이 생긴 더티 데이터와 메타데이터를
+ * 기록한다. 성공하면 fs_thaw()를 호출할 때까지 막힌 상태로 남고, 실패하면
+ * 막지 않은 상태로 돌아간다. 이름 공간 요청(생성, 삭제, 이름 변경)은 막지
+ * 않는다.
+ *
+ * @param fs 파일 시스템 컨텍스트
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ */
+int fs_freeze(struct sfuse_fs *fs);
+
+/**
+ * @brief fs_freeze()로 막은 요청을 다시 받는다.
+ *
+ * @param fs 파일 시스템 컨텍스트
+ */
+void fs_thaw(struct sfuse_fs *fs);
+
+/**
+ * @brief 커널이 캐시한 경로의 속성과 페이지 캐시를 무효화한다.
+ *
+ * 커널 요청과 무관하게 SFUSE가 파일 내용이나 메타데이터를 바꾼 경우 호출한다.
+ * 마운트 전이거나 캐시에 없는 경로이면 아무 일도 하지 않는다.
+ *
+ * @param fs   파일 시스템의 전역 컨텍스트
+ * @param path 무효화할 경로
+ */
+void fs_invalidate_path(struct sfuse_fs *fs, const char *path);
+
+/**
+ * @brief 아이노드를 가리키는 모든 경로의 커널 캐시를 무효화한다.
+ *
+ * 경로를 모르는 백그라운드 작업(재배치 등)이 쓴다. 디렉터리 트리를 훑어 ino를
+ * 가리키는 엔트리마다 fs_invalidate_path()를 호출하므로, 재배치 잠금이나 다른
+ * 요청이 기다릴 수 있는 잠금을 잡은 채로 호출하면 안 된다. (커널이 무효화하며
+ * 보내는 기록 요청과 교착됨)
+ *
+ * @param fs  파일 시스템의 전역 컨텍스트
+ * @param ino 아이노드 번호 (0이면 모든 경로)
+ */
+void fs_invalidate_ino(struct sfuse_fs *fs, uint32_t ino);
+
 /**
  * @brief 주어진 경로를 아이노드 번호로 변환한다.
  *
@@ -0,0 +1,110 @@
+/**
+ * @file include/fsck.h
+ * @brief 파일 시스템 검사와 복구(fsck.sfuse) 함수 선언
+ *
+ * 장애가 나면 장치의 블록/아이노드 비트맵과 빈 블록 수가 아이노드 테이블과
+ * 어긋날 수 있다. (아이노드를 먼저 기록한 뒤 비트맵을 기록하므로 대개
+ * 해제했지만 비트맵에 남은 블록이다) 검사는 아이노드 테이블과 디렉터리 트리에서 실제로
+ * 쓰이는 블록과 아이노드를 다시 구해 장치의 값과 비교한다.
+ *
+ *   1. 아이노드 테이블을 큰 순차 읽기 단위로 나눠 여러 스레드가 읽고, 쓰이는
+ *      아이노드마다 블록 트리를 따라가며 블록을 공유 비트맵에 원자적으로
+ *      표시한다. 이미 표시된 블록은 이중 참조로 모은다.
+ *   2. 디렉터리마다(역시 여러 스레드) 엔트리를 검사하고 아이노드별 참조 수와
+ *      하위 디렉터리의 부모를 구한다.
+ *   3. 한 스레드에서 이중 참조(참조 수 테이블로 공유된 블록인지), 고아 목록,
+ *      스냅숏 예외 테이블, 루트에서 닿지 않는 아이노드, 링크 수를 확인하고
+ *      비트맵, 그룹 요약, 빈 블록/아이노드 수를 장치의 값과 비교한다.
+ *
+ * 검사 단계는 장치에 기록하지 않고 고칠 내용만 모은다. 복구를 요청하면 모든
+ * 블록의 사용 여부가 정해진 뒤 고칠 내용을 차례로 기록하고, 마지막으로 다시
+ * 만든 비트맵과 슈퍼블록을 기록한다. 스냅숏이 있으면 복구 기록도 원본 마운트와
+ * 같이 disk_write()의 복사 경로를 거치므로 스냅숏이 보존된다.
+ *
+ * 마운트되지 않은 장치에서 실행해야 한다.
+ */
+
+#ifndef SFUSE_FSCK_H
+#define SFUSE_FSCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** @brief 아이노드 테이블을 한 번에 읽는 크기 (바이트) */
+#define SFUSE_FSCK_CHUNK_BYTES (4 * 1024 * 1024)
+
+/** @brief 검사 스레드 수의 상한 */
+#define SFUSE_FSCK_MAX_THREADS 64
+
+/** @brief 연결되지 않은 아이노드를 옮겨 두는 디렉터리 이름 (루트 아래) */
+#define SFUSE_FSCK_LOST_FOUND "lost+found"
+
+/**
+ * @enum sfuse_fsck_problem
+ * @brief 검사가 찾는 문제 종류
+ */
+enum sfuse_fsck_problem {
+  SFUSE_FSCK_BAD_INODE,    /**< 체크섬이나 형식이 잘못된 아이노드 */
+  SFUSE_FSCK_BAD_BLOCK,    /**< 데이터 영역 밖을 가리키는 블록 포인터 */
+  SFUSE_FSCK_DUP_BLOCK,    /**< 공유가 허용되지 않는 이중 참조 */
+  SFUSE_FSCK_BAD_DIRENT,   /**< 잘못된 디렉터리 엔트리 */
+  SFUSE_FSCK_UNATTACHED,   /**< 루트에서 닿지 않는 아이노드 */
+  SFUSE_FSCK_LINK_COUNT,   /**< 링크 수 불일치 */
+  SFUSE_FSCK_ORPHAN,       /**< 고아 목록 손상 */
+  SFUSE_FSCK_REFCOUNT,     /**< 참조 수 테이블 불일치 */
+  SFUSE_FSCK_SNAPSHOT,     /**< 스냅숏 예외 테이블 손상 */
+  SFUSE_FSCK_BLOCK_BITMAP, /**< 블록 비트맵 차이 (누수 또는 누락) */
+  SFUSE_FSCK_INODE_BITMAP, /**< 아이노드 비트맵 차이 */
+  SFUSE_FSCK_COUNTS,       /**< 빈 블록/아이노드 수와 그룹 요약 불일치 */
+  SFUSE_FSCK_NR_PROBLEMS
+};
+
+/**
+ * @struct sfuse_fsck_opts
+ * @brief 검사 옵션
+ */
+struct sfuse_fsck_opts {
+  bool repair;      /**< 찾은 문제를 장치에 고친다 */
+  bool verbose;     /**< 문제를 하나씩 출력한다 */
+  uint32_t threads; /**< 검사 스레드 수 (0이면 CPU 수) */
+};
+
+/**
+ * @struct sfuse_fsck_result
+ * @brief 검사 결과
+ */
+struct sfuse_fsck_result {
+  uint64_t problems[SFUSE_FSCK_NR_PROBLEMS]; /**< 종류별 문제 수 */
+  uint64_t unfixed;      /**< 고치지 못한 문제 수 (검사만 했으면 전체) */
+  uint64_t inodes;       /**< 쓰이는 아이노드 수 */
+  uint64_t dirs;         /**< 디렉터리 수 */
+  uint64_t blocks;       /**< 쓰이는 데이터 블록 수 */
+  uint64_t shared;       /**< 참조 수 테이블로 공유된 추가 참조 수 */
+  uint64_t leaked;       /**< 비트맵에만 할당된 블록 수 */
+  uint64_t missing;      /**< 쓰이지만 비트맵에서 빈 블록 수 */
+  uint64_t free_blocks;  /**< 다시 계산한 빈 블록 수 */
+  uint32_t free_inodes;  /**< 다시 계산한 빈 아이노드 수 */
+  uint32_t threads;      /**< 사용한 스레드 수 */
+};
+
+/**
+ * @brief 파일 시스템을 검사하고, 요청하면 복구한다.
+ *
+ * @param fd   장치 파일 디스크립터 (복구하면 읽기/쓰기로 열어야 함)
+ * @param opts 검사 옵션
+ * @param out  검사 결과
+ * @return 검사를 마치면 0 (찾은 문제는 out에 담김), 실패 시 음수 오류 코드
+ *         -EINVAL: 유효한 슈퍼블록이 없음
+ *         -EUCLEAN: 루트 디렉터리가 손상되어 복구할 수 없음
+ *         -ENOMEM: 메모리 할당 실패
+ *         -EIO: 장치 읽기/쓰기 실패
+ */
+int fsck_run(int fd, const struct sfuse_fsck_opts *opts,
+             struct sfuse_fsck_result *out);
+
+/**
+ * @brief 문제 종류의 이름 (출력용)
+ */
+const char *fsck_problem_name(enum sfuse_fsck_problem p);
+
+#endif // SFUSE_FSCK_H
@@ -11,33 +11,130 @@
 #define SFUSE_INODE_H
 
 #include "super.h" ///< struct sfuse_super, SFUSE_BLOCK_SIZE 정의
+#include <stddef.h>
 #include <stdint.h>
 #include <sys/types.h> ///< mode_t, uid_t, gid_t 정의
 
 /// Direct 블록 포인터 수 (12개)
 #define SFUSE_NDIR_BLOCKS 12
 
+/// 인다이렉트 블록 하나에 저장되는 64비트 블록 주소의 개수 (512개)
+#define SFUSE_ADDR_PER_BLOCK (SFUSE_BLOCK_SIZE / sizeof(uint64_t))
+
+/// 온디스크 아이노드 레코드의 기본 크기 (바이트)
+#define SFUSE_DEFAULT_INODE_SIZE 256
+
+/// 온디스크 아이노드 레코드의 최대 크기 (바이트, mkfs -I 상한)
+#define SFUSE_MAX_INODE_SIZE 1024
+
+/// 고정 필드(헤더 + 블록 포인터)가 차지하는 아이노드 레코드의 크기 (바이트)
+#define SFUSE_INODE_CORE_SIZE 176
+
+/// 인라인 데이터가 시작되는 레코드 내 오프셋 (블록 포인터 영역의 시작)
+#define SFUSE_INODE_INLINE_OFFSET 56
+
+/// 인라인 데이터 영역의 최대 크기 (SFUSE_MAX_INODE_SIZE 레코드 기준)
+#define SFUSE_INODE_INLINE_MAX                                                 \
+  (SFUSE_MAX_INODE_SIZE - SFUSE_INODE_INLINE_OFFSET)
+
+/// 아이노드 플래그: 파일 내용이 블록 대신 아이노드 레코드 안에 저장됨
+#define SFUSE_INODE_FLAG_INLINE 0x0001
+
+/// 아이노드 플래그: 이름이 지워져 고아 목록에서 블록 회수를 기다림.
+/// 이 플래그가 있는 동안 atime 필드는 목록의 다음 아이노드 번호를 담는다.
+#define SFUSE_INODE_FLAG_ORPHAN 0x0002
+
+/// 아이노드 플래그: 데이터를 클러스터 단위로 압축해 기록함 (chattr +c).
+/// 디렉터리에 있으면 그 안에 새로 만드는 파일과 디렉터리가 물려받는다.
+#define SFUSE_INODE_FLAG_COMPRESS 0x0004
+
+/**
+ * @brief 데이터 블록 포인터의 예약(unwritten) 표시 비트
+ *
+ * fallocate로 할당만 하고 아직 기록하지 않은 블록은 블록 맵의 마지막 단계
+ * 포인터에 이 비트를 함께 저장한다. 이런 블록은 디스크 내용과 무관하게 0으로
+ * 읽히며, 처음 기록될 때 비트가 지워진다. 인다이렉트 블록 포인터에는 쓰이지
+ * 않는다.
+ */
+#define SFUSE_BLOCK_UNWRITTEN (1ULL << 63)
+
+/**
+ * @brief 데이터 블록 포인터의 압축 클러스터 표시 비트
+ *
+ * 압축된 클러스터에 속한 논리 블록의 포인터에 저장한다. 비트를 뗀 번호는 압축
+ * 구간의 블록 하나이거나 0이며, 데이터는 클러스터 첫 포인터의 구간을 풀어서
+ * 읽는다. (compress.h 참고) 인다이렉트 블록 포인터에는 쓰이지 않는다.
+ */
+#define SFUSE_BLOCK_COMPRESSED (1ULL << 62)
+
 /**
  * @struct sfuse_inode
  * @brief 파일의 메타데이터를 관리하는 아이노드 구조체
  *
  * 아이노드는 파일의 권한, 소유자, 크기, 타임스탬프, 블록 포인터 등의
  * 메타데이터를 저장한다.
+ *
+ * 디스크에는 플랫폼의 mode_t/uid_t 크기와 무관하도록 고정 크기 필드만 사용한
+ * 패딩 없는 리틀 엔디언 형식으로 저장되며, inode_load()/inode_sync()가
+ * 호스트 바이트 순서와의 변환을 담당한다. 각 아이노드 레코드는 슈퍼블록의
+ * inode_size(기본 256바이트) 크기를 차지한다.
+ *
+ * SFUSE_INODE_FLAG_INLINE이 설정된 아이노드는 블록 포인터 영역부터 레코드
+ * 끝까지(inode_size - 56바이트, 기본 200바이트)를 파일 내용으로 사용한다.
+ * 이 경우 데이터 블록이 없으므로 inode_load() 한 번으로 내용까지 읽힌다.
  */
 struct sfuse_inode {
-  mode_t mode;                        ///< 파일 타입 및 접근 권한
-  uid_t uid;                          ///< 파일 소유자의 사용자 ID
-  gid_t gid;                          ///< 파일 소유자의 그룹 ID
-  uint32_t size;                      ///< 파일 크기 (바이트 단위)
-  uint32_t atime;                     ///< 마지막 접근 시간 (Access Time)
-  uint32_t mtime;                     ///< 마지막 수정 시간 (Modification Time)
-  uint32_t ctime;                     ///< 상태 변경 시간 (Change Time)
-  uint32_t direct[SFUSE_NDIR_BLOCKS]; ///< 직접 참조 블록 포인터 배열
-  uint32_t indirect;                  ///< Single Indirect 블록 포인터
-  uint32_t double_indirect;           ///< Double Indirect 블록 포인터
+  uint32_t mode;                      ///< 파일 타입 및 접근 권한
+  uint32_t uid;                       ///< 파일 소유자의 사용자 ID
+  uint32_t gid;                       ///< 파일 소유자의 그룹 ID
   uint32_t links;                     ///< 파일에 연결된 링크 수
+  uint32_t flags;                     ///< 아이노드 플래그 (예약)
+  uint32_t reserved;                  ///< 레코드 체크섬 (METADATA_CSUM)
+  uint64_t size;                      ///< 파일 크기 (바이트 단위)
+  int64_t atime;                      ///< 마지막 접근 시간 (Access Time)
+  int64_t mtime;                      ///< 마지막 수정 시간 (Modification Time)
+  int64_t ctime;                      ///< 상태 변경 시간 (Change Time)
+  union {
+    struct {
+      uint64_t direct[SFUSE_NDIR_BLOCKS]; ///< 직접 참조 블록 포인터 배열
+      uint64_t indirect;                  ///< Single Indirect 블록 포인터
+      uint64_t double_indirect;           ///< Double Indirect 블록 포인터
+      uint64_t triple_indirect;           ///< Triple Indirect 블록 포인터
+    };
+    /// 인라인 데이터 (SFUSE_INODE_FLAG_INLINE일 때만 유효)
+    uint8_t inline_data[SFUSE_INODE_INLINE_MAX];
+  };
 };
 
+// 모든 필드가 자연 정렬되어 패딩 없이 고정 크기로 저장됨을 보장한다.
+_Static_assert(offsetof(struct sfuse_inode, direct) ==
+                   SFUSE_INODE_INLINE_OFFSET,
+               "struct sfuse_inode의 블록 포인터 위치가 변경됨");
+_Static_assert(offsetof(struct sfuse_inode, triple_indirect) +
+                       sizeof(uint64_t) ==
+                   SFUSE_INODE_CORE_SIZE,
+               "struct sfuse_inode의 온디스크 크기가 변경됨");
+
+/**
+ * @brief 아이노드가 인라인 데이터를 사용하는지 확인한다.
+ *
+ * @param inode 대상 아이노드
+ * @return 인라인 데이터를 사용하면 1, 아니면 0
+ */
+static inline int inode_is_inline(const struct sfuse_inode *inode) {
+  return (inode->flags & SFUSE_INODE_FLAG_INLINE) != 0;
+}
+
+/**
+ * @brief 아이노드 레코드 안에 저장할 수 있는 인라인 데이터의 최대 크기
+ *
+ * @param sb 슈퍼블록 정보 포인터
+ * @return 인라인 데이터 용량 (바이트)
+ */
+static inline uint32_t inode_inline_capacity(const struct sfuse_super *sb) {
+  return sb->inode_size - SFUSE_INODE_INLINE_OFFSET;
+}
+
 /**
  * @brief 새로운 아이노드를 기본 값으로 초기화한다.
  *
@@ -66,6 +163,21 @@ void fs_init_inode(const struct sfuse_super *sb, uint32_t ino, mode_t mode,
 int inode_load(int fd, const struct sfuse_super *sb, uint32_t ino,
                struct sfuse_inode *inode);
 
+/**
+ * @brief 디스크에서 읽은 아이노드 레코드의 체크섬을 검증하고 변환한다.
+ *
+ * inode_load()의 뒷부분으로, 아이노드 테이블을 큰 단위로 읽어 레코드를 직접
+ * 해석하는 도구(fsck.sfuse)가 사용한다.
+ *
+ * @param sb    슈퍼블록 정보 포인터
+ * @param ino   레코드의 아이노드 번호 (체크섬 계산에 섞임)
+ * @param rec   리틀 엔디언 레코드 (sb->inode_size 바이트)
+ * @param inode 변환한 아이노드를 저장할 버퍼 포인터
+ * @return 성공 시 0, 체크섬이 맞지 않으면 -EBADMSG (inode는 채워짐)
+ */
+int inode_decode(const struct sfuse_super *sb, uint32_t ino, const void *rec,
+                 struct sfuse_inode *inode);
+
 /**
  * @brief 메모리에 저장된 아이노드 정보를 디스크에 기록한다.
  *
@@ -78,6 +190,19 @@ int inode_load(int fd, const struct sfuse_super *sb, uint32_t ino,
 int inode_sync(int fd, const struct sfuse_super *sb, uint32_t ino,
                const struct sfuse_inode *inode);
 
+/**
+ * @brief 아이노드가 마지막으로 기록된 세대 번호를 반환한다.
+ *
+ * inode_sync()가 성공할 때마다 증가한다. 아이노드를 메모리에 캐시한 쪽(열린
+ * 파일 핸들)은 캐시 시점의 값과 비교하여 다른 경로에서의 변경을 감지한다.
+ * 아이노드 번호를 해시 버킷으로 나눠 관리하므로, 다른 아이노드의 기록으로도
+ * 값이 바뀔 수 있다(불필요한 재적재만 일어날 뿐 변경을 놓치지는 않는다).
+ *
+ * @param ino 아이노드 번호
+ * @return 현재 세대 번호
+ */
+uint32_t inode_generation(uint32_t ino);
+
 /**
  * @brief 논리 블록 번호(Logical Block Number)를 물리 블록 번호(Physical Block
  * Number)로 변환한다.
@@ -91,10 +216,120 @@ int inode_sync(int fd, const struct sfuse_super *sb, uint32_t ino,
  * @param lbn      변환할 논리 블록 번호
  * @param buf      임시로 사용할 블록 크기의 버퍼 (크기는 SFUSE_BLOCK_SIZE)
  * @param pbn_out  결과로 변환된 물리 블록 번호를 저장할 포인터
- * @return 성공 시 0, 실패 시 음수의 오류 코드 반환
+ * @return 성공 시 0, 예약만 된(unwritten) 블록이면 1, 압축 클러스터의 블록이면
+ *         2, 할당되지 않은 블록이면 -ENOENT, 그 외 음수의 오류 코드
  */
 int logical_to_physical(int fd, const struct sfuse_super *sb,
-                        const struct sfuse_inode *inode, uint32_t lbn,
-                        void *buf, uint32_t *pbn_out);
+                        const struct sfuse_inode *inode, uint64_t lbn,
+                        void *buf, uint64_t *pbn_out);
+
+/**
+ * @brief 논리 블록 번호에 물리 블록을 연결한다.
+ *
+ * 필요한 경우 인다이렉트 블록을 새로 할당하여 블록 맵을 확장한다.
+ * 아이노드 자체의 변경 사항(direct/indirect 포인터)은 호출자가 inode_sync()로
+ * 기록해야 한다.
+ *
+ * @param fd        디바이스 파일 디스크립터
+ * @param sb        슈퍼블록 정보 포인터 (인다이렉트 블록 할당 시 갱신)
+ * @param block_map 블록 비트맵 버퍼
+ * @param inode     대상 아이노드 포인터
+ * @param lbn       연결할 논리 블록 번호
+ * @param pbn       연결할 물리 블록 번호 (0이면 연결 해제, 예약 블록은
+ *                  SFUSE_BLOCK_UNWRITTEN, 압축 클러스터의 블록은
+ *                  SFUSE_BLOCK_COMPRESSED 비트 포함)
+ * @return 성공 시 0, 실패 시 음수의 오류 코드 반환
+ */
+int inode_set_block(int fd, struct sfuse_super *sb, uint8_t *block_map,
+                    struct sfuse_inode *inode, uint64_t lbn, uint64_t pbn);
+
+/**
+ * @brief 지정된 논리 블록 이후의 모든 데이터 블록과 인다이렉트 블록을 해제한다.
+ *
+ * 파일 삭제(from_lbn = 0) 또는 파일 크기 축소 시 사용한다.
+ * 아이노드의 블록 포인터는 갱신되지만 inode_sync()는 호출자가 수행해야 한다.
+ *
+ * @param fd        디바이스 파일 디스크립터
+ * @param sb        슈퍼블록 정보 포인터 (free_blocks 갱신)
+ * @param block_map 블록 비트맵 버퍼
+ * @param inode     대상 아이노드 포인터
+ * @param from_lbn  해제를 시작할 논리 블록 번호
+ * @return 성공 시 0, 실패 시 음수의 오류 코드 반환
+ */
+int inode_free_blocks(int fd, struct sfuse_super *sb, uint8_t *block_map,
+                      struct sfuse_inode *inode, uint64_t from_lbn);
+
+/**
+ * @brief 논리 블록 범위 [from_lbn, to_lbn)의 데이터 블록을 해제한다.
+ *
+ * fallocate의 PUNCH_HOLE처럼 파일 중간에 구멍(hole)을 만들 때 사용한다.
+ * 아이노드의 블록 포인터는 갱신되지만 inode_sync()는 호출자가 수행해야 한다.
+ *
+ * @param fd        디바이스 파일 디스크립터
+ * @param sb        슈퍼블록 정보 포인터 (free_blocks 갱신)
+ * @param block_map 블록 비트맵 버퍼
+ * @param inode     대상 아이노드 포인터
+ * @param from_lbn  해제를 시작할 논리 블록 번호
+ * @param to_lbn    해제를 끝낼 논리 블록 번호 (이 번호는 제외)
+ * @return 성공 시 0, 실패 시 음수의 오류 코드 반환
+ */
+int inode_punch_blocks(int fd, struct sfuse_super *sb, uint8_t *block_map,
+                       struct sfuse_inode *inode, uint64_t from_lbn,
+                       uint64_t to_lbn);
+
+/**
+ * @brief 인라인 데이터를 새 데이터 블록으로 옮기고 블록 맵 형식으로 전환한다.
+ *
+ * 인라인 데이터가 용량을 넘어설 때 sfuse_write_cb()/truncate에서 호출한다.
+ * 아이노드 변경 사항은 호출자가 inode_sync()로 기록해야 한다.
+ *
+ * @param fd        디바이스 파일 디스크립터
+ * @param sb        슈퍼블록 정보 포인터 (블록 할당 시 갱신)
+ * @param block_map 블록 비트맵 버퍼
+ * @param inode     인라인 데이터를 가진 아이노드 포인터
+ * @return 성공 시 0, 실패 시 음수의 오류 코드 반환
+ *         -ENOSPC : 데이터 블록 부족
+ *         -EIO    : 디스크 쓰기 실패
+ */
+int inode_inline_migrate(int fd, struct sfuse_super *sb, uint8_t *block_map,
+                         struct sfuse_inode *inode);
+
+/**
+ * @brief 논리 블록 lbn을 담고 있는 블록 맵 단위(leaf)를 통째로 읽는다.
+ *
+ * Direct 블록(12개) 또는 lbn을 가리키는 마지막 단계 인다이렉트 블록(512개)의
+ * 포인터를 호스트 바이트 순서로 돌려준다. 경로 중간이 비어 있으면 모든 항목이
+ * 0(구멍)이다. 순차 입출력에서 블록마다 인다이렉트 블록을 다시 읽지 않도록
+ * 열린 파일 핸들이 결과를 캐시한다.
+ *
+ * @param fd       디바이스 파일 디스크립터
+ * @param inode    대상 아이노드 포인터 (인라인 아이노드가 아니어야 함)
+ * @param lbn      논리 블록 번호
+ * @param ptrs     포인터를 받을 배열 (SFUSE_ADDR_PER_BLOCK개)
+ * @param base_out 첫 항목의 논리 블록 번호
+ * @return 성공 시 항목 수, 실패 시 음수의 오류 코드 반환
+ *         -EFBIG : 최대 파일 크기를 넘는 논리 블록 번호
+ *         -EIO   : 인다이렉트 블록 읽기 실패
+ */
+int inode_map_leaf(int fd, const struct sfuse_inode *inode, uint64_t lbn,
+                   uint64_t *ptrs, uint64_t *base_out);
+
+/**
+ * @brief start_lbn 이후 첫 데이터 블록 또는 구멍의 논리 블록 번호를 찾는다.
+ *
+ * lseek의 SEEK_DATA/SEEK_HOLE에서 사용한다. 할당되지 않은 인다이렉트 하위
+ * 트리는 읽지 않고 건너뛰며, 예약(unwritten) 블록은 구멍으로 본다.
+ *
+ * @param fd        디바이스 파일 디스크립터
+ * @param inode     대상 아이노드 포인터 (인라인 아이노드가 아니어야 함)
+ * @param start_lbn 검색을 시작할 논리 블록 번호
+ * @param data      참이면 데이터 블록을, 거짓이면 구멍을 찾는다
+ * @param lbn_out   찾은 논리 블록 번호
+ * @return 성공 시 0, 실패 시 음수의 오류 코드 반환
+ *         -ENXIO : start_lbn 이후에 데이터 블록이 없음
+ *         -EIO   : 인다이렉트 블록 읽기 실패
+ */
+int inode_seek_block(int fd, const struct sfuse_inode *inode,
+                     uint64_t start_lbn, bool data, uint64_t *lbn_out);
 
 #endif // SFUSE_INODE_H
@@ -0,0 +1,69 @@
+/**
+ * @file include/meta.h
+ * @brief 메타데이터 영역 메모리 매핑(-o mmap_meta) 함수 선언
+ *
+ * 마운트 옵션 mmap_meta를 주면 장치의 블록 0부터 아이노드 테이블 끝(저널 시작)
+ * 까지를 MAP_SHARED로 매핑한다. 블록/아이노드 비트맵은 별도 버퍼 없이 매핑을
+ * 직접 가리키고, inode_load()/inode_sync()는 disk_read()/disk_write() 대신
+ * 매핑과 레코드를 복사한다. 변경된 페이지는 표시만 해 두었다가 커밋
+ * 시점(fs_sync_device())에 더티 페이지 구간별 msync()로 장치에 반영한다.
+ *
+ * 매핑은 장치의 페이지 캐시를 그대로 공유하므로 같은 영역을 disk_read()/
+ * disk_write()로 접근하는 경로(슈퍼블록 등)와 내용이 일치한다.
+ */
+
+#ifndef SFUSE_META_H
+#define SFUSE_META_H
+
+#include "super.h"
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * @brief 메타데이터 영역(블록 0 ~ 저널 시작 전)을 매핑한다.
+ *
+ * @param fd 장치 파일 디스크립터
+ * @param sb 슈퍼블록 (영역 크기 계산용)
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ *         -ENOMEM: 더티 표시 메모리 할당 실패
+ *         mmap()의 -errno
+ */
+int meta_map(int fd, const struct sfuse_super *sb);
+
+/**
+ * @brief 매핑을 해제한다. (매핑되어 있지 않으면 아무 일도 하지 않음)
+ *
+ * 남은 더티 페이지는 먼저 meta_flush()로 반영해야 한다.
+ */
+void meta_unmap(void);
+
+/**
+ * @brief 장치 오프셋 구간에 해당하는 매핑 주소를 돌려준다.
+ *
+ * @param off 장치 내 바이트 오프셋
+ * @param len 구간 길이 (바이트)
+ * @return 구간 전체가 매핑 안에 있으면 그 주소, 아니면 NULL
+ */
+void *meta_ptr(off_t off, size_t len);
+
+/**
+ * @brief 포인터가 매핑 안을 가리키는지 확인한다.
+ */
+bool meta_owns(const void *p);
+
+/**
+ * @brief 매핑을 통해 바꾼 구간의 페이지를 더티로 표시한다.
+ *
+ * @param p   바꾼 구간의 시작 주소 (meta_ptr()로 얻은 주소)
+ * @param len 구간 길이 (바이트)
+ */
+void meta_dirty(const void *p, size_t len);
+
+/**
+ * @brief 더티로 표시된 페이지를 연속 구간별로 msync()하여 장치에 기록한다.
+ *
+ * @return 성공 시 0, 실패 시 음수 오류 코드 (msync()의 -errno)
+ */
+int meta_flush(void);
+
+#endif // SFUSE_META_H
@@ -0,0 +1,108 @@
+/**
+ * @file include/orphan.h
+ * @brief 고아 아이노드 목록과 백그라운드 블록 회수 함수 선언
+ *
+ * 큰 파일을 지우면 unlink는 이름만 지우고 아이노드를 고아 목록에 넣는다.
+ * 크기를 0으로 줄일 때는 블록 맵을 새 아이노드로 옮겨 고아 목록에 넣는다.
+ * 목록은 슈퍼블록의 last_orphan에서 시작해 각 아이노드의 atime 필드로 이어지는
+ * 연결 리스트로 장치에 기록되므로, 회수 도중 장애가 나도 다음 마운트에서
+ * 이어서 회수한다.
+ *
+ * 회수 스레드는 파일 끝에서부터 SFUSE_ORPHAN_BATCH_BLOCKS개의 논리 블록씩
+ * 해제하고, 묶음마다 줄어든 크기를 아이노드에 기록한 뒤 잠시 쉰다.
+ */
+
+#ifndef SFUSE_ORPHAN_H
+#define SFUSE_ORPHAN_H
+
+#include "inode.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/** @brief 회수 한 묶음에서 해제하는 논리 블록 수 (8MiB)
+ *
+ * 블록 수가 이 값 이하인 파일은 고아 목록을 거치지 않고 요청 안에서 바로
+ * 해제한다.
+ */
+#define SFUSE_ORPHAN_BATCH_BLOCKS 2048
+
+/** @brief 회수 묶음 사이에 쉬는 시간 (밀리초) */
+#define SFUSE_ORPHAN_BATCH_DELAY_MS 5
+
+struct sfuse_fs;
+
+/**
+ * @struct sfuse_orphan
+ * @brief 고아 목록과 회수 스레드 상태
+ *
+ * 슈퍼블록의 last_orphan과 목록 아이노드의 연결 필드는 lock으로 보호한다.
+ */
+struct sfuse_orphan {
+  pthread_mutex_t lock; /**< 목록 보호용 잠금 */
+  pthread_cond_t wake;  /**< 새 고아나 종료 요청을 알림 */
+  pthread_t thread;     /**< 회수 스레드 */
+  bool started;         /**< 회수 스레드가 실행 중인지 */
+  bool stop;            /**< 회수 스레드 종료 요청 */
+  uint32_t count;       /**< 목록의 아이노드 수 */
+};
+
+/**
+ * @brief 장치의 고아 목록을 확인하고 회수 스레드를 시작한다.
+ *
+ * 이전 마운트에서 회수하지 못한 고아가 있으면 이어서 회수한다. 스레드를 만들 수
+ * 없으면 고아는 다음 마운트까지 남는다.
+ *
+ * @param fs 파일 시스템 컨텍스트
+ */
+void orphan_init(struct sfuse_fs *fs);
+
+/**
+ * @brief 진행 중인 묶음을 마치고 회수 스레드를 멈춘다.
+ *
+ * 남은 고아는 장치에 기록되어 있으므로 다음 마운트에서 이어서 회수한다.
+ *
+ * @param fs 파일 시스템 컨텍스트
+ */
+void orphan_destroy(struct sfuse_fs *fs);
+
+/**
+ * @brief 아이노드의 블록을 고아 목록으로 회수할 만큼 큰지 확인한다.
+ *
+ * @param inode 대상 아이노드
+ * @return 블록 수가 SFUSE_ORPHAN_BATCH_BLOCKS를 넘으면 참
+ */
+bool orphan_wanted(const struct sfuse_inode *inode);
+
+/**
+ * @brief 이름이 지워진 아이노드를 고아 목록에 넣는다.
+ *
+ * @param fs    파일 시스템 컨텍스트
+ * @param ino   아이노드 번호
+ * @param inode 아이노드 (고아 표시와 연결 필드가 채워짐)
+ * @return 성공 시 0, 실패 시 음수 오류 코드 (inode_sync()/sb_sync()의 오류)
+ */
+int orphan_add(struct sfuse_fs *fs, uint32_t ino, struct sfuse_inode *inode);
+
+/**
+ * @brief 아이노드의 블록 맵을 새 고아 아이노드로 옮겨 크기를 0으로 만든다.
+ *
+ * 원래 아이노드를 먼저 비워 기록하므로, 장애가 나도 두 아이노드가 같은 블록을
+ * 가리키지 않는다. (블록이 회수되지 않고 남을 수는 있음)
+ *
+ * @param fs    파일 시스템 컨텍스트
+ * @param ino   아이노드 번호
+ * @param inode 아이노드 (성공하면 블록 포인터와 크기가 0이 됨)
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ *         -ENOSPC: 빈 아이노드 없음
+ *         inode_sync()/sb_sync()의 오류
+ */
+int orphan_detach(struct sfuse_fs *fs, uint32_t ino,
+                  struct sfuse_inode *inode);
+
+/**
+ * @brief 회수를 기다리는 고아 아이노드 수를 돌려준다.
+ */
+uint32_t orphan_pending(struct sfuse_fs *fs);
+
+#endif // SFUSE_ORPHAN_H
@@ -0,0 +1,119 @@
+/**
+ * @file include/snap.h
+ * @brief 파일 시스템 전체의 읽기 전용 스냅숏 함수 선언
+ *
+ * 스냅숏은 만든 시점의 장치 이미지 전체다. 만들 때는 더티 데이터와 메타데이터를
+ * 기록한 뒤 예외 테이블 블록 하나만 할당하므로 데이터를 복사하지 않는다.
+ * 이후 스냅숏이 가리키는 블록(메타데이터 영역 전체와, 스냅숏 시점의 블록
+ * 비트맵에서 할당된 데이터 블록)을 처음 고칠 때 disk_write()가 기록하기 전에
+ * 원래 내용을 새 블록에 복사하고 {원래 블록, 복사본} 항목을 예외 테이블에
+ * 더한다. (copy-on-first-write) 아이노드 테이블과 디렉터리 블록도 제자리에서
+ * 고치므로 스냅숏의 루트 아이노드를 비롯한 모든 메타데이터가 이렇게 보존된다.
+ *
+ * -o snapshot으로 마운트하면 장치의 블록 대신 복사본을 읽어 스냅숏 시점의
+ * 파일 시스템을 읽기 전용으로 보여 준다. 원본 파일 시스템이 마운트된 채로도
+ * 마운트할 수 있어 백업 중에도 원본을 계속 쓸 수 있다.
+ *
+ * 예외 테이블 블록 형식 (리틀 엔디언):
+ *   [0]  매직 (SFUSE_SNAP_MAGIC, 4바이트)
+ *   [4]  플래그 (SFUSE_SNAP_F_*, 4바이트)
+ *   [8]  다음 테이블 블록 번호 (0이면 마지막)
+ *   [16] {원래 블록, 복사본 블록} 항목 SFUSE_SNAP_ENTRIES개
+ * 복사본 번호가 0인 항목은 아직 쓰지 않은 자리다. 복사할 공간이 없으면 마지막
+ * 테이블 블록에 SFUSE_SNAP_F_INVALID를 켜 스냅숏을 무효로 표시한다. (새 블록을
+ * 할당하지 않고 표시할 수 있도록 항목 대신 헤더에 둔다)
+ *
+ * 한 번에 스냅숏 하나만 둘 수 있다. (RO_COMPAT_SNAPSHOT 기능)
+ */
+
+#ifndef SFUSE_SNAP_H
+#define SFUSE_SNAP_H
+
+#include "super.h" // SFUSE_BLOCK_SIZE
+#include <stdbool.h>
+#include <stdint.h>
+
+struct sfuse_fs;
+
+/** @brief 예외 테이블 블록의 매직 넘버 ("SNAP") */
+#define SFUSE_SNAP_MAGIC 0x50414e53
+
+/** @brief 예외 테이블 블록 하나에 담기는 항목 수 (항목당 16바이트) */
+#define SFUSE_SNAP_ENTRIES ((SFUSE_BLOCK_SIZE - 16) / 16)
+
+/** @brief 테이블 블록 플래그: 복사하지 못한 블록이 있어 스냅숏이 무효 */
+#define SFUSE_SNAP_F_INVALID 0x1
+
+/**
+ * @brief 원본 마운트에서 스냅숏 보호를 준비한다.
+ *
+ * disk_write()가 기록 전에 원래 내용을 복사하도록 연결하고, 스냅숏이 있으면
+ * 예외 테이블을 읽어 보호를 다시 시작한다. 장애로 비트맵에 기록되지 못한
+ * 복사본과 테이블 블록은 할당된 것으로 다시 표시한다. 블록 비트맵을 준비한 뒤,
+ * 장치에 기록할 수 있는 다른 모듈보다 먼저 호출한다.
+ *
+ * @param fs 파일 시스템 컨텍스트
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ *         -EIO: 예외 테이블이 손상됨
+ *         -ENOMEM: 메모리 할당 실패
+ */
+int snap_init(struct sfuse_fs *fs);
+
+/**
+ * @brief 스냅숏 마운트(-o snapshot)를 준비한다.
+ *
+ * 슈퍼블록을 읽기 전에 호출한다. 원본의 예외 테이블을 읽고 disk_read()가
+ * 복사된 블록은 복사본에서 읽도록 연결하며, disk_write()는 -EROFS로 거부한다.
+ *
+ * @param fd 디바이스 파일 디스크립터
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ *         -ENOENT: 스냅숏이 없음
+ *         -ESTALE: 공간이 부족해 무효가 된 스냅숏
+ *         -EIO: 예외 테이블이 손상됨
+ *         -ENOMEM: 메모리 할당 실패
+ */
+int snap_open_view(int fd);
+
+/**
+ * @brief 연결한 입출력 함수를 떼고 메모리를 정리한다.
+ */
+void snap_destroy(void);
+
+/**
+ * @brief 스냅숏을 만든다.
+ *
+ * 더티 데이터, 비트맵, 슈퍼블록을 기록해 장치를 한 시점의 상태로 맞춘 뒤
+ * 보호를 시작한다. 동시에 진행 중인 연산은 장애가 난 것처럼 반영될 수 있다.
+ *
+ * @param fs 파일 시스템 컨텍스트
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ *         -EEXIST: 이미 스냅숏이 있음
+ *         -EOPNOTSUPP: 메타데이터 매핑(-o mmap_meta)이나 스냅숏 마운트
+ *         -ENOSPC: 예외 테이블 블록을 할당할 공간이 없음
+ *         -EIO: 기록 실패
+ */
+int snap_create(struct sfuse_fs *fs);
+
+/**
+ * @brief 스냅숏을 지우고 복사본과 테이블 블록을 해제한다.
+ *
+ * 스냅숏 마운트를 먼저 해제해야 한다.
+ *
+ * @param fs 파일 시스템 컨텍스트
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ *         -ENOENT: 스냅숏이 없음
+ *         -EIO: 슈퍼블록 기록 실패
+ */
+int snap_delete(struct sfuse_fs *fs);
+
+/**
+ * @brief 스냅숏 보호 중인지 확인한다. (무효가 된 스냅숏은 거짓)
+ */
+bool snap_active(void);
+
+/**
+ * @brief 스냅숏을 위해 쓰는 블록 수 (복사본과 예외 테이블)
+ */
+uint64_t snap_blocks(void);
+
+#endif // SFUSE_SNAP_H
@@ -0,0 +1,191 @@
+/**
+ * @file include/stats.h
+ * @brief 연산별 카운터와 지연 시간 히스토그램 선언
+ *
+ * 모든 FUSE 콜백과 disk_read()/disk_write()의 호출 수, 오류 수, 처리 바이트 수,
+ * 지연 시간 분포를 항상 수집한다. 각 스레드는 자기 전용 영역에만 잠금 없이
+ * 기록하고, 읽는 쪽(stats_snapshot)이 모든 스레드의 값을 합친다. 지연 시간은
+ * 2의 거듭제곱 구간을 4개로 나눈 로그 구간(HDR 방식, 상대 오차 25% 이하)에
+ * 기록된다.
+ */
+
+#ifndef SFUSE_STATS_H
+#define SFUSE_STATS_H
+
+#include <stdint.h>
+
+/** @brief 지연 시간 히스토그램의 구간 수 (약 2^40ns = 18분까지 표현) */
+#define SFUSE_STATS_BUCKETS 160
+
+/**
+ * @enum sfuse_stat_op
+ * @brief 통계를 수집하는 연산 종류
+ */
+enum sfuse_stat_op {
+  SFUSE_OP_GETATTR,
+  SFUSE_OP_ACCESS,
+  SFUSE_OP_READDIR,
+  SFUSE_OP_OPEN,
+  SFUSE_OP_RELEASE,
+  SFUSE_OP_READ,
+  SFUSE_OP_WRITE,
+  SFUSE_OP_CREATE,
+  SFUSE_OP_MKDIR,
+  SFUSE_OP_SYMLINK,
+  SFUSE_OP_READLINK,
+  SFUSE_OP_UNLINK,
+  SFUSE_OP_RMDIR,
+  SFUSE_OP_RENAME,
+  SFUSE_OP_TRUNCATE,
+  SFUSE_OP_FALLOCATE,
+  SFUSE_OP_LSEEK,
+  SFUSE_OP_COPY_FILE_RANGE,
+  SFUSE_OP_UTIMENS,
+  SFUSE_OP_FLUSH,
+  SFUSE_OP_FSYNC,
+  SFUSE_OP_STATFS,
+  SFUSE_OP_GETXATTR,
+  SFUSE_OP_LISTXATTR,
+  SFUSE_OP_IOCTL,
+  SFUSE_OP_DISK_READ,  /**< 장치 읽기 (disk_read) */
+  SFUSE_OP_DISK_WRITE, /**< 장치 쓰기 (disk_write) */
+  SFUSE_OP_COUNT
+};
+
+/**
+ * @enum sfuse_stat_event
+ * @brief 지연 시간 없이 횟수만 세는 내부 이벤트
+ */
+enum sfuse_stat_event {
+  SFUSE_EV_BMAP_HIT,       /**< 열린 파일의 블록 맵 캐시 적중 */
+  SFUSE_EV_BMAP_MISS,      /**< 블록 맵 leaf를 장치에서 읽음 */
+  SFUSE_EV_DALLOC_HIT,     /**< 읽기가 지연 할당 버퍼에서 처리됨 */
+  SFUSE_EV_DALLOC_MISS,    /**< 읽기가 지연 할당 버퍼에 없음 */
+  SFUSE_EV_READAHEAD_BLKS, /**< 미리 읽기를 요청한 블록 수 */
+  SFUSE_EV_CSUM_ERROR,     /**< 체크섬 불일치로 거부한 블록/아이노드 */
+  SFUSE_EV_DEV_FLUSH,      /**< 장치 플러시(fsync/fdatasync) 실행 */
+  SFUSE_EV_FSYNC_MERGED,   /**< 다른 요청의 플러시로 처리된 fsync */
+  SFUSE_EV_DISCARD,        /**< 장치에 보낸 discard 요청 */
+  SFUSE_EV_DISCARD_BLKS,   /**< discard한 블록 수 */
+  SFUSE_EV_ORPHAN_BATCH,   /**< 고아 아이노드 회수 묶음 */
+  SFUSE_EV_COMPRESS,       /**< 압축해 기록한 클러스터 */
+  SFUSE_EV_COMPRESS_SAVED, /**< 압축으로 아낀 데이터 블록 수 */
+  SFUSE_EV_COMPRESS_RAW,   /**< 압축이 듣지 않아 그대로 기록한 클러스터 */
+  SFUSE_EV_CLUSTER_HIT,    /**< 푼 클러스터 캐시 적중 */
+  SFUSE_EV_CLUSTER_MISS,   /**< 압축 구간을 장치에서 읽어 풂 */
+  SFUSE_EV_DEDUP_HIT,      /**< 이미 있는 블록을 공유해 할당하지 않은 블록 */
+  SFUSE_EV_DEDUP_MISS,     /**< 같은 내용의 블록을 찾지 못한 블록 */
+  SFUSE_EV_DEDUP_COW,      /**< 공유 블록을 고치려고 새 블록에 복사 */
+  SFUSE_EV_SNAP_COPY,      /**< 스냅숏이 가리키는 블록을 고치기 전에 복사 */
+  SFUSE_EV_DEFRAG_FILES,   /**< 조각 모음으로 옮긴 파일 */
+  SFUSE_EV_DEFRAG_BLOCKS,  /**< 조각 모음으로 옮긴 블록 수 */
+  SFUSE_EV_COUNT
+};
+
+/**
+ * @struct sfuse_op_stats
+ * @brief 연산 하나의 누적 통계 (모든 스레드 합계)
+ */
+struct sfuse_op_stats {
+  uint64_t count;                     /**< 호출 수 */
+  uint64_t errors;                    /**< 음수 오류를 돌려준 호출 수 */
+  uint64_t bytes;                     /**< 처리한 바이트 수 (입출력 연산) */
+  uint64_t total_ns;                  /**< 지연 시간 합계 (ns) */
+  uint64_t max_ns;                    /**< 최대 지연 시간 (ns) */
+  uint64_t inflight;                  /**< 현재 처리 중인 호출 수 */
+  uint64_t hist[SFUSE_STATS_BUCKETS]; /**< 로그 구간별 호출 수 */
+};
+
+/**
+ * @struct sfuse_stats_snapshot
+ * @brief stats_snapshot()이 돌려주는 전체 통계
+ */
+struct sfuse_stats_snapshot {
+  struct sfuse_op_stats op[SFUSE_OP_COUNT]; /**< 연산별 통계 */
+  uint64_t events[SFUSE_EV_COUNT];          /**< 이벤트별 횟수 */
+};
+
+/**
+ * @brief 현재 시각을 나노초 단위로 반환한다. (CLOCK_MONOTONIC)
+ *
+ * @return 단조 증가 시각 (ns)
+ */
+uint64_t stats_now(void);
+
+/**
+ * @brief 연산 시작을 기록하고 시작 시각을 반환한다.
+ *
+ * 반환 값을 같은 연산의 stats_record()에 넘기면, 그 사이 동안 연산이 처리
+ * 중(inflight)으로 집계된다.
+ *
+ * @param op 연산 종류
+ * @return 연산 시작 시각 (ns)
+ */
+uint64_t stats_begin(enum sfuse_stat_op op);
+
+/**
+ * @brief 연산 하나의 결과를 현재 스레드의 통계에 기록한다.
+ *
+ * 잠금이나 원자적 read-modify-write 없이 현재 스레드 전용 영역만 갱신한다.
+ *
+ * @param op       연산 종류
+ * @param start_ns 연산 시작 시각 (stats_now())
+ * @param res      연산 결과. 음수면 오류로, 입출력 연산의 양수는 바이트 수로
+ *                 집계한다.
+ */
+void stats_record(enum sfuse_stat_op op, uint64_t start_ns, int64_t res);
+
+/**
+ * @brief 이벤트 횟수를 현재 스레드의 통계에 더한다.
+ *
+ * @param ev 이벤트 종류
+ * @param n  더할 횟수
+ */
+void stats_event(enum sfuse_stat_event ev, uint64_t n);
+
+/**
+ * @brief 모든 스레드의 통계를 합쳐 돌려준다.
+ *
+ * @param out 결과를 저장할 구조체
+ */
+void stats_snapshot(struct sfuse_stats_snapshot *out);
+
+/**
+ * @brief 스냅숏에서 기준 스냅숏의 값을 빼 구간 통계로 만든다.
+ *
+ * 카운터를 0으로 되돌리는 대신 기준 시점의 스냅숏을 빼서 초기화를 구현한다.
+ * 기준 이후 최대 지연 시간이 갱신되지 않았으면 max_ns는 남은 히스토그램의
+ * 가장 높은 구간 상한으로 추정한다. inflight는 현재 값을 그대로 둔다.
+ *
+ * @param cur  현재 스냅숏 (결과로 덮어씀)
+ * @param base 기준 스냅숏
+ */
+void stats_subtract(struct sfuse_stats_snapshot *cur,
+                    const struct sfuse_stats_snapshot *base);
+
+/**
+ * @brief 히스토그램에서 백분위 지연 시간을 구한다.
+ *
+ * @param st 연산 통계
+ * @param p  백분위 (0.0 ~ 100.0)
+ * @return 해당 백분위가 속한 구간의 상한 (ns), 호출이 없으면 0
+ */
+uint64_t stats_percentile(const struct sfuse_op_stats *st, double p);
+
+/**
+ * @brief 연산 이름을 반환한다.
+ *
+ * @param op 연산 종류
+ * @return 연산 이름 문자열 (예: "read", "disk_write")
+ */
+const char *stats_op_name(enum sfuse_stat_op op);
+
+/**
+ * @brief 이벤트 이름을 반환한다.
+ *
+ * @param ev 이벤트 종류
+ * @return 이벤트 이름 문자열 (예: "bmap_hit")
+ */
+const char *stats_event_name(enum sfuse_stat_event ev);
+
+#endif // SFUSE_STATS_H
@@ -7,37 +7,42 @@
  */
 
 /*
-SFUSE 파일시스템 구조
+SFUSE 파일시스템 구조 (mkfs.sfuse가 장치 크기와 옵션으로부터 계산)
 
 +------------------------------------------------------------------------------+
 | 블록 번호  |                  블록 용도 및 설명                              |
 +------------------------------------------------------------------------------+
-|    0      | 예약 블록 (일반적으로 미사용, 부트 섹터 등 예약 용도)            |
+|    0      | 예약 블록 + 슈퍼블록 (바이트 오프셋 1024)                        |
+|           | ├─ 매직 넘버 (Magic number): 0xEF53, 포맷 버전, 기능 플래그      |
+|           | ├─ 블록 크기, 총 블록 수, 아이노드 수                            |
+|           | ├─ 각 메타데이터 영역의 시작 블록 번호                           |
+|           | └─ 저널 크기 및 할당 그룹(allocation group) 정보                 |
 +------------------------------------------------------------------------------+
-|    1      | 슈퍼블록 (Superblock)                                            |
-|           | ├─ 매직 넘버 (Magic number): 0xEF53                              |
-|           | ├─ 총 블록 수: 1,048,576개                                       |
-|           | ├─ 아이노드 수: 4096개                                           |
-|           | ├─ 아이노드 비트맵 시작 블록: 2번                                |
-|           | ├─ 블록 비트맵 시작 블록: 3번                                    |
-|           | ├─ 아이노드 테이블 시작 블록: 35번                               |
-|           | └─ 데이터 블록 시작 번호: 123번                                  |
+|    1      | 예비 블록                                                        |
 +------------------------------------------------------------------------------+
-|    2      | 아이노드 비트맵 (Inode Bitmap)                                   |
-|           | └─ 총 4096개 아이노드 사용 여부 기록 (512바이트, 1블록 내 저장)  |
+|  2 ~      | 블록 비트맵 (Block Bitmap)                                       |
+|           | └─ 블록 하나당 1비트, (총 블록 수 ÷ 8) 바이트                    |
 +------------------------------------------------------------------------------+
-|  3 ~ 34   | 블록 비트맵 (Block Bitmap)                                       |
-|           | └─ 총 1,048,576개 블록 사용 여부 기록                            |
-|           | └─ 총 131,072바이트(128KB), 32개 블록 필요                       |
+|   ~       | 그룹 요약 테이블 (GROUP_SUMMARY 기능)                            |
+|           | └─ 할당 그룹 하나당 빈 블록 수 8바이트                           |
 +------------------------------------------------------------------------------+
-| 35 ~ 122  | 아이노드 테이블 (Inode Table)                                    |
-|           | ├─ 각 아이노드 ≈ 88바이트                                        |
-|           | ├─ 4096개 아이노드 × 88바이트 = 360,448바이트 (총 88개 블록)     |
-|           | └─ 파일 및 디렉토리의 메타데이터 저장                            |
+|   ~       | 아이노드 비트맵 (Inode Bitmap)                                   |
+|           | └─ 아이노드 하나당 1비트, (아이노드 수 ÷ 8) 바이트               |
 +------------------------------------------------------------------------------+
-|   123     | 실제 데이터 블록 (Data Blocks) 시작                              |
-|     ~     | ├─ 사용자가 저장한 파일 및 디렉토리 실제 데이터 영역             |
-| 1,048,575 | └─ 사용자 데이터 공간 (총 약 4GB)                                |
+|   ~       | 아이노드 테이블 (Inode Table)                                    |
+|           | ├─ 아이노드 수 = 장치 크기 ÷ inode ratio (mkfs -i 옵션)          |
+|           | └─ 레코드 크기 = inode_size (mkfs -I 옵션, 기본 256바이트)       |
++------------------------------------------------------------------------------+
+|   ~       | 저널 영역 (Journal, mkfs -J 옵션, 기본 0블록)                    |
++------------------------------------------------------------------------------+
+|   ~       | 체크섬 테이블 (METADATA_CSUM 기능, mkfs -C로 끔)                 |
+|           | └─ 블록 하나당 CRC32C 4바이트, (총 블록 수 × 4) 바이트           |
++------------------------------------------------------------------------------+
+| data_block| 실제 데이터 블록 (Data Blocks)                                   |
+|  _start ~ | ├─ groups_count개의 할당 그룹으로 나뉘어 관리됨                  |
+|           | └─ 참조 수 테이블 + 지문 색인 (REFCOUNT 기능, -o dedup 첫 마운트 |
+|           |    때 데이터 영역에서 할당, 위치는 refcount_start)               |
+|           | └─ 스냅숏 예외 테이블과 복사본 (SNAPSHOT 기능, snap_table)       |
 +------------------------------------------------------------------------------+
 */
 
@@ -49,78 +54,135 @@ SFUSE 파일시스템 구조
 /** @brief 슈퍼블록의 매직 넘버 (파일 시스템 식별용 상수) */
 #define SFUSE_MAGIC 0xEF53
 
-/** @brief 블록 크기 (4KB로 고정) */
+/** @brief 블록 크기 (4KB로 고정)
+ *
+ * mkfs.sfuse의 -b 옵션으로 슈퍼블록에 기록되지만, 현재 입출력 경로는 이 값으로
+ * 컴파일되므로 다른 크기로 포맷된 장치는 마운트 시 거부된다.
+ */
 #define SFUSE_BLOCK_SIZE 4096
 
 /** @brief 슈퍼블록이 저장되는 오프셋 (1024 바이트 고정) */
 #define SFUSE_SUPERBLOCK_OFFSET 1024
 
-/** @brief 파일 시스템의 총 아이노드 개수 */
-#define SFUSE_INODES_COUNT 4096
-
-/** @brief 파일 시스템의 총 블록 개수
+/** @brief 블록 비트맵이 시작되는 블록 번호
  *
- * 총 파일시스템 용량(4096MB)을 블록 크기(4KB)로 나눈 값.
- * (4096MB × 1024KB) ÷ 4KB = 1,048,576 블록
+ * 블록 0(예약 블록 + 슈퍼블록)과 블록 1(예비 블록) 바로 뒤에 위치한다.
+ * 이후의 메타데이터 영역(아이노드 비트맵, 아이노드 테이블, 저널)은 장치 크기에
+ * 따라 mkfs 시점에 계산되어 슈퍼블록에 기록된다.
  */
-#define SFUSE_BLOCKS_COUNT 1048576
+#define SFUSE_BLOCK_BITMAP_BLOCK 2
 
-/** @brief 아이노드 비트맵이 시작되는 블록 번호
+/** @brief 기본 inode ratio (아이노드 하나당 할당되는 장치 바이트 수)
  *
- * 아이노드 4096개는 512바이트의 비트맵(4096 ÷ 8)을 요구하며,
- * 단일 블록(4096바이트) 내에 충분히 저장 가능.
- * 가장 앞부분인 블록 2번으로 할당.
+ * mkfs.sfuse의 -i 옵션을 지정하지 않으면 장치 16KB마다 아이노드 하나를
+ * 만든다. 작은 파일이 많은 워크로드는 이 값을 줄여 더 많은 아이노드를 확보할 수
+ * 있다.
  */
-#define SFUSE_INODE_BITMAP_BLOCK 2
+#define SFUSE_DEFAULT_INODE_RATIO 16384
 
-/** @brief 블록 비트맵이 시작되는 블록 번호
+/** @brief 최소 아이노드 개수 (루트 디렉터리와 예약 아이노드 0번 포함) */
+#define SFUSE_MIN_INODES 16
+
+/** @brief 기본 할당 그룹 하나의 블록 수
  *
- * 블록 개수(1,048,576개)마다 1비트로 관리되므로 총 131,072바이트(128KB) 필요.
- * 블록 크기(4096바이트)로 나누면 32개의 블록이 필요 (131,072 ÷ 4096).
- * 아이노드 비트맵(블록 2)의 바로 뒤인 블록 3번부터 할당.
- * 따라서 블록 3번~34번이 비트맵 영역임.
+ * 비트맵 블록 하나(4096바이트 × 8비트)가 관리하는 블록 수와 같다.
+ * mkfs.sfuse의 -G 옵션을 지정하지 않으면 이 크기를 기준으로 그룹 수를 정한다.
  */
-#define SFUSE_BLOCK_BITMAP_BLOCK 3
+#define SFUSE_DEFAULT_BLOCKS_PER_GROUP (SFUSE_BLOCK_SIZE * 8)
 
-/** @brief 아이노드 테이블이 시작되는 블록 번호
+/** @brief 온디스크 포맷 버전
  *
- * 아이노드 구조체 크기 ≈ 88바이트(가정), 총 4096개 아이노드이므로:
- * 4096 × 88 = 360,448바이트 필요.
- * 블록 크기(4096바이트)로 나누면 88개 블록 필요 (360,448 ÷ 4096).
- * 블록 비트맵이 끝난 직후 블록 35번부터 할당.
- * 즉, 블록 35번~122번까지가 아이노드 테이블 영역임.
+ * 1: 64비트 블록 주소/파일 크기, 고정 크기 리틀 엔디언 아이노드
  */
-#define SFUSE_INODE_TABLE_BLOCK 35
+#define SFUSE_REV_LEVEL 1
 
-/** @brief 실제 데이터 블록이 시작되는 블록 번호
- *
- * 데이터 블록은 모든 메타데이터 영역(비트맵, 아이노드 테이블 등) 이후부터 시작.
- * 위에서 계산된 메타데이터 블록:
- * - 아이노드 비트맵: 블록 2번 (총 1개 블록)
- * - 블록 비트맵: 블록 3~34번 (총 32개 블록)
- * - 아이노드 테이블: 블록 35~122번 (총 88개 블록)
+/**
+ * @defgroup sfuse_features 슈퍼블록 기능 플래그
  *
- * 총 메타데이터 블록 수 =
- *        1(아이노드 비트맵) + 32(블록 비트맵) + 88(아이노드 테이블) = 121개
- * 블록 블록 2번부터 시작했으므로, 마지막 메타데이터 블록 번호 = 122번 따라서
- * 실제 데이터 블록은 다음 블록인 123번부터 시작됨.
+ * - compat   : 모르는 기능이어도 마운트 가능
+ * - incompat : 모르는 기능이 있으면 마운트 불가
+ * - ro_compat: 모르는 기능이 있으면 쓰기 마운트 불가 (SFUSE는 마운트 거부)
+ * @{
  */
-#define SFUSE_DATA_BLOCK_START 123
+#define SFUSE_FEATURE_INCOMPAT_64BIT 0x0001       /**< 64비트 블록 주소 */
+#define SFUSE_FEATURE_INCOMPAT_INLINE_DATA 0x0002 /**< 아이노드 인라인 데이터 */
+#define SFUSE_FEATURE_INCOMPAT_UNWRITTEN 0x0004   /**< 예약(unwritten) 블록 */
+#define SFUSE_FEATURE_INCOMPAT_COMPRESS 0x0008    /**< 압축 클러스터 */
+
+#define SFUSE_FEATURE_RO_COMPAT_METADATA_CSUM 0x0001 /**< 메타데이터 체크섬 */
+#define SFUSE_FEATURE_RO_COMPAT_DATA_CSUM 0x0002 /**< 데이터 블록 체크섬 */
+#define SFUSE_FEATURE_RO_COMPAT_GROUP_SUMMARY 0x0004 /**< 그룹별 빈 블록 수 */
+#define SFUSE_FEATURE_RO_COMPAT_REFCOUNT 0x0008 /**< 공유 블록 참조 수 */
+#define SFUSE_FEATURE_RO_COMPAT_SNAPSHOT 0x0010 /**< 스냅숏 예외 테이블 */
+
+#define SFUSE_FEATURE_COMPAT_SUPP 0
+#define SFUSE_FEATURE_INCOMPAT_SUPP                                            \
+  (SFUSE_FEATURE_INCOMPAT_64BIT | SFUSE_FEATURE_INCOMPAT_INLINE_DATA |        \
+   SFUSE_FEATURE_INCOMPAT_UNWRITTEN | SFUSE_FEATURE_INCOMPAT_COMPRESS)
+#define SFUSE_FEATURE_RO_COMPAT_SUPP                                           \
+  (SFUSE_FEATURE_RO_COMPAT_METADATA_CSUM |                                    \
+   SFUSE_FEATURE_RO_COMPAT_DATA_CSUM | SFUSE_FEATURE_RO_COMPAT_GROUP_SUMMARY | \
+   SFUSE_FEATURE_RO_COMPAT_REFCOUNT | SFUSE_FEATURE_RO_COMPAT_SNAPSHOT)
+/** @} */
 
 /**
  * @struct sfuse_super
  * @brief 파일 시스템 메타데이터를 저장하는 슈퍼블록 구조체
+ *
+ * 디스크에는 패딩 없는 160바이트 리틀 엔디언 형식으로 기록되며,
+ * sb_load()/sb_sync()가 호스트 바이트 순서와의 변환을 담당한다.
  */
 struct sfuse_super {
   uint32_t magic;              /**< 슈퍼블록 유효성 확인을 위한 매직 넘버 */
+  uint32_t rev_level;          /**< 온디스크 포맷 버전 (SFUSE_REV_LEVEL) */
+  uint32_t feature_compat;     /**< 호환 기능 플래그 */
+  uint32_t feature_incompat;   /**< 비호환 기능 플래그 */
+  uint32_t feature_ro_compat;  /**< 읽기 전용 호환 기능 플래그 */
+  uint32_t block_size;         /**< 포맷 시 지정된 블록 크기 (바이트) */
+  uint32_t inode_size;         /**< 온디스크 아이노드 레코드 크기 (바이트) */
+  uint32_t inode_ratio;        /**< 아이노드 하나당 장치 바이트 수 */
   uint32_t inodes_count;       /**< 전체 아이노드 수 */
-  uint32_t blocks_count;       /**< 전체 데이터 블록 수 */
   uint32_t free_inodes;        /**< 사용 가능한 아이노드 수 */
-  uint32_t free_blocks;        /**< 사용 가능한 데이터 블록 수 */
-  uint32_t inode_bitmap_start; /**< 아이노드 비트맵 시작 블록 번호 */
-  uint32_t block_bitmap_start; /**< 블록 비트맵 시작 블록 번호 */
-  uint32_t inode_table_start;  /**< 아이노드 테이블 시작 블록 번호 */
-  uint32_t data_block_start;   /**< 데이터 블록 시작 블록 번호 */
+  uint64_t blocks_count;       /**< 전체 블록 수 */
+  uint64_t free_blocks;        /**< 사용 가능한 데이터 블록 수 */
+  uint64_t inode_bitmap_start; /**< 아이노드 비트맵 시작 블록 번호 */
+  uint64_t block_bitmap_start; /**< 블록 비트맵 시작 블록 번호 */
+  uint64_t inode_table_start;  /**< 아이노드 테이블 시작 블록 번호 */
+  uint64_t journal_start;      /**< 저널 영역 시작 블록 번호 */
+  uint64_t journal_blocks;     /**< 저널 영역 블록 수 (0이면 저널 없음) */
+  uint64_t data_block_start;   /**< 데이터 블록 시작 블록 번호 */
+  uint64_t blocks_per_group;   /**< 할당 그룹 하나의 블록 수 */
+  uint32_t groups_count;       /**< 데이터 영역의 할당 그룹 수 */
+  uint32_t csum_blocks;        /**< 체크섬 테이블 블록 수 (데이터 영역 직전) */
+  uint32_t summary_blocks;     /**< 그룹 요약 테이블 블록 수 (아이노드 비트맵 직전) */
+  uint32_t last_orphan;        /**< 고아 아이노드 목록의 첫 아이노드 (0이면 없음) */
+  uint64_t refcount_start;     /**< 참조 수 테이블 시작 블록 번호 (REFCOUNT 기능) */
+  uint32_t refcount_blocks;    /**< 참조 수 테이블 블록 수 */
+  uint32_t dedup_index_blocks; /**< 지문 색인 블록 수 (참조 수 테이블 바로 뒤) */
+  uint64_t snap_table;         /**< 스냅숏 예외 테이블 첫 블록 (SNAPSHOT 기능) */
+  int64_t snap_time;           /**< 스냅숏을 만든 시각 (Unix 시간) */
+};
+
+// 모든 필드가 자연 정렬되어 패딩 없이 고정 크기로 저장됨을 보장한다.
+_Static_assert(sizeof(struct sfuse_super) == 160,
+               "struct sfuse_super의 온디스크 크기가 변경됨");
+
+/**
+ * @struct sfuse_geometry
+ * @brief mkfs 시점에 지정하는 파일 시스템 구성 값
+ *
+ * 0으로 남겨 둔 필드는 sb_format()이 기본값으로 채운다.
+ */
+struct sfuse_geometry {
+  uint32_t block_size;     /**< 블록 크기 (0이면 SFUSE_BLOCK_SIZE) */
+  uint32_t inode_ratio;    /**< 아이노드 하나당 장치 바이트 수 */
+  uint32_t inodes_count;   /**< 아이노드 수 직접 지정 (0이면 ratio로 계산) */
+  uint32_t inode_size;     /**< 아이노드 레코드 크기 (0이면 기본 256) */
+  uint64_t journal_blocks; /**< 저널 영역 블록 수 */
+  uint32_t groups_count;   /**< 할당 그룹 수 (0이면 장치 크기로 계산) */
+  uint32_t no_inline;      /**< 1이면 인라인 데이터 기능을 끈다 */
+  uint32_t no_csum;        /**< 1이면 메타데이터 체크섬 기능을 끈다 */
+  uint32_t data_csum;      /**< 1이면 데이터 블록 체크섬도 사용한다 */
 };
 
 /**
@@ -138,6 +200,8 @@ int sb_load(int fd, struct sfuse_super *sb);
  * @brief 슈퍼블록을 디스크에 동기화(쓰기)하는 함수
  *
  *  * 이 함수는 메모리에 있는 슈퍼블록의 내용을 디스크에 기록한다.
+ * 참조 수 테이블이나 체크섬 테이블에 바뀐 블록이 있으면 슈퍼블록보다 먼저
+ * 기록한다.
  *
  * @param fd 디바이스 파일 디스크립터
  * @param sb 디스크에 기록할 슈퍼블록 구조체의 포인터
@@ -146,12 +210,16 @@ int sb_load(int fd, struct sfuse_super *sb);
 int sb_sync(int fd, const struct sfuse_super *sb);
 
 /**
- * @brief 슈퍼블록 구조체를 기본 값으로 초기화하는 함수
+ * @brief 장치 크기와 구성 값으로 슈퍼블록의 레이아웃을 계산하는 함수
  *
- * 이 함수는 새로운 파일 시스템을 만들 때 사용된다.
+ * 이 함수는 새로운 파일 시스템을 만들 때(mkfs.sfuse) 사용된다.
  *
- * @param sb 초기화할 슈퍼블록 구조체의 포인터
+ * @param sb           초기화할 슈퍼블록 구조체의 포인터
+ * @param total_blocks 장치 전체 블록 수
+ * @param geo          mkfs 구성 값 (NULL이면 모두 기본값)
+ * @return 성공 시 0, 장치가 너무 작거나 값이 잘못된 경우 -EINVAL
  */
-void sb_format(struct sfuse_super *sb);
+int sb_format(struct sfuse_super *sb, uint64_t total_blocks,
+              const struct sfuse_geometry *geo);
 
 #endif // SFUSE_SUPER_H
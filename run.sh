@@ -60,7 +60,8 @@ COMPILE() {
   # cmake 실행
   echo -e "\n"
   echo "cmake 실행 중..."
-  cmake -DCMAKE_BUILD_TYPE=Debug -S . -B build
+  # BUILD_TYPE=Debug|Profile|Release (기본값 Release)
+  cmake -DCMAKE_BUILD_TYPE="${BUILD_TYPE:-Release}" -S . -B build
 
   # make 실행
   echo -e "\n"
@@ -119,11 +120,23 @@ MOUNT() {
   # sudo mount /dev/nvme0n1p6 /mnt/partition_06_4GB
 }
 
+# 4) mkfs 함수
+MKFS() {
+  # 마운트 전에 장치를 SFUSE 파일 시스템으로 포맷한다.
+  # (mount 시점에는 더 이상 포맷하지 않으므로 최초 1회 실행이 필요하다.)
+  echo -e "\n"
+  echo -e "포맷 명령어:"
+  echo -e "sudo ./build/mkfs.sfuse /dev/nvme0n1p6"
+  echo -e "\n"
+  sudo ./build/mkfs.sfuse /dev/nvme0n1p6
+}
+
 # 옵션 출력
 echo -e "┌───────────────옵션───────────────┐"
 echo -e "│ 1) compile_commands.json 생성    │"
 echo -e "│ 2) 컴파일                        │"
 echo -e "│ 3) 파일 기반 블록 디바이스 마운트│"
+echo -e "│ 4) 블록 디바이스 포맷 (mkfs)     │"
 echo -e "│ q) 종료                          │"
 echo -e "└──────────────────────────────────┘"
 
@@ -144,6 +157,10 @@ case $choice in
   # MOUNT 함수 실행
   MOUNT
   ;;
+4)
+  # MKFS 함수 실행
+  MKFS
+  ;;
 q)
   echo "종료합니다."
   exit 0
@@ -9,10 +9,20 @@
  */
 
 #include "bitmap.h"
+#include "block.h"
+#include "csum.h"
+#include "discard.h"
 #include "disk.h"
+#include "meta.h"
 #include "super.h"
+#include <endian.h>
 #include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -23,6 +33,8 @@
  * 디스크의 특정 블록에서 읽어들여 메모리의 버퍼에 저장한다.
  *
  * 이 함수는 파일 시스템 초기화 및 비트맵 동기화 시 주로 사용된다.
+ * map이 메타데이터 매핑(-o mmap_meta)의 해당 위치를 가리키면 이미 장치 내용이
+ * 보이므로 읽지 않고 체크섬만 검증한다.
  *
  * @param fd 디바이스 파일 디스크립터 (읽을 대상 디스크 장치)
  * @param block_no 비트맵이 저장된 디스크 내의 블록 번호
@@ -30,11 +42,16 @@
  * @param map_size 비트맵 데이터의 크기(바이트 단위)
  *
  * @return 성공 시 0을 반환하며, 오류 발생 시 음수 값으로 오류 코드 반환:
- *         -EIO (I/O 오류), 기타 disk_read가 반환하는 음수 값
+ *         -EIO (I/O 오류), -EBADMSG (체크섬 불일치),
+ *         기타 disk_read가 반환하는 음수 값
  */
-int bitmap_load(int fd, uint32_t block_no, uint8_t *map, size_t map_size) {
+int bitmap_load(int fd, uint64_t block_no, uint8_t *map, size_t map_size) {
   ssize_t ret;
 
+  // 매핑된 비트맵이면 읽기 없이 검증만 한다.
+  if (meta_ptr((off_t)block_no * SFUSE_BLOCK_SIZE, map_size) == map)
+    return csum_verify(block_no, map, map_size);
+
   // 디스크에서 비트맵 데이터를 읽어 메모리(map)로 로드한다.
   ret = disk_read(fd, map, map_size, (off_t)block_no * SFUSE_BLOCK_SIZE);
   if (ret < 0)
@@ -44,9 +61,329 @@ int bitmap_load(int fd, uint32_t block_no, uint8_t *map, size_t map_size) {
   if ((size_t)ret != map_size)
     return -EIO; // 읽은 데이터 크기가 예상 크기와 불일치
 
-  return 0; // 정상 종료
+  // 체크섬이 기록된 비트맵 블록이면 손상되지 않았는지 확인한다.
+  return csum_verify(block_no, map, map_size);
+}
+
+/**
+ * @brief 비트맵 데이터를 그대로 장치에 기록한다. (bitmap_sync()의 실제 기록)
+ */
+static int bitmap_write(int fd, uint64_t block_no, uint8_t *map,
+                        size_t map_size) {
+  ssize_t ret;
+
+  // 매핑된 비트맵은 이미 장치 페이지 캐시에 반영되어 있음
+  if (meta_ptr((off_t)block_no * SFUSE_BLOCK_SIZE, map_size) == map) {
+    meta_dirty(map, map_size);
+    csum_update(block_no, map, map_size);
+    return 0;
+  }
+
+  // 메모리(map)의 비트맵 데이터를 디스크의 지정된 위치에 기록한다.
+  ret = disk_write(fd, map, map_size, (off_t)block_no * SFUSE_BLOCK_SIZE);
+  if (ret < 0)
+    return (int)ret; // disk_write 실패: 기록 자체가 실패함
+
+  // 기록한 데이터 크기가 요청한 크기와 일치하는지 검증한다.
+  if ((size_t)ret != map_size)
+    return -EIO; // 기록한 데이터 크기가 예상 크기와 불일치 (부분적 기록 발생)
+
+  // 기록한 비트맵 블록들의 체크섬을 갱신한다.
+  csum_update(block_no, map, map_size);
+
+  return 0; // 정상적으로 비트맵 데이터를 디스크에 기록 완료
+}
+
+/** @brief 비트맵 블록 하나가 다루는 데이터 블록 수 */
+#define BITS_PER_CHUNK ((uint64_t)SFUSE_BLOCK_SIZE * 8)
+
+/**
+ * @struct bitmap_groups
+ * @brief 등록된 블록 비트맵의 그룹별 지연 로드 상태
+ *
+ * 비트맵은 비트맵 블록(청크) 단위로 읽고 기록한다. 그룹 경계가 청크 경계와
+ * 어긋나면 한 청크가 두 그룹에 걸치므로, 로드 여부는 청크마다, 빈 블록 수 확인
+ * 여부(ready)는 그룹마다 따로 둔다.
+ */
+static struct bitmap_groups {
+  uint8_t *map;                 /**< 등록된 블록 비트맵 (NULL이면 없음) */
+  int fd;                       /**< 장치 파일 디스크립터 */
+  struct sfuse_super *sb;       /**< 마운트된 슈퍼블록 */
+  size_t size;                  /**< 비트맵 크기 (바이트) */
+  uint64_t nchunks;             /**< 비트맵 블록 수 */
+  uint64_t ngroups;             /**< 할당 그룹 수 */
+  uint64_t per_group;           /**< 그룹 하나의 블록 수 */
+  bool summary;                 /**< 요약 테이블을 장치에 기록하는지 */
+  _Atomic uint8_t *loaded;      /**< 청크별 로드 여부 */
+  _Atomic uint8_t *dirty;       /**< 청크별 변경 여부 */
+  _Atomic uint8_t *ready;       /**< 그룹별 로드 및 빈 블록 수 확인 여부 */
+  _Atomic uint64_t *free;       /**< 그룹별 빈 블록 수 */
+  _Atomic uint8_t *sum_dirty;   /**< 요약 테이블 블록별 변경 여부 */
+  _Atomic uint32_t nready;      /**< 로드된 그룹 수 */
+} groups;
+
+/** @brief 청크 로드를 한 스레드만 하도록 보호하는 잠금 */
+static pthread_mutex_t groups_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief 청크 c의 바이트 수 (마지막 청크는 비트맵 끝까지)
+ */
+static size_t chunk_len(uint64_t c) {
+  size_t off = (size_t)c * SFUSE_BLOCK_SIZE;
+  return groups.size - off < SFUSE_BLOCK_SIZE ? groups.size - off
+                                              : SFUSE_BLOCK_SIZE;
+}
+
+/**
+ * @brief 그룹 g가 다루는 비트 구간 [*first, *end)를 구한다.
+ */
+static void group_range(uint64_t g, uint64_t *first, uint64_t *end) {
+  uint64_t total = groups.sb->blocks_count - groups.sb->data_block_start;
+  *first = g * groups.per_group;
+  *end = *first + groups.per_group < total ? *first + groups.per_group : total;
+}
+
+/**
+ * @brief 비트 구간 [first, end)의 빈 블록 수를 센다.
+ */
+static uint64_t count_free(const uint8_t *map, uint64_t first, uint64_t end) {
+  uint64_t used = 0, i = first;
+  for (; i < end && i % 8; i++)
+    used += (map[i / 8] >> (i % 8)) & 1;
+  for (; i + 8 <= end; i += 8)
+    used += (uint64_t)__builtin_popcount(map[i / 8]);
+  for (; i < end; i++)
+    used += (map[i / 8] >> (i % 8)) & 1;
+  return (end - first) - used;
+}
+
+/**
+ * @brief 그룹 g의 요약 항목이 담긴 테이블 블록을 변경으로 표시한다.
+ */
+static void summary_mark(uint64_t g) {
+  atomic_store_explicit(&groups.sum_dirty[g / SFUSE_SUMMARY_PER_BLOCK], 1,
+                        memory_order_relaxed);
+}
+
+/**
+ * @brief 그룹 g의 비트맵 청크를 읽고 빈 블록 수를 확인한다.
+ *
+ * 처음 한 번만 실제로 읽으며, 이후에는 원자 변수 확인만으로 돌아간다. 요약
+ * 테이블의 값이 비트맵과 다르면(비정상 종료 등) 비트맵을 기준으로 요약과
+ * 슈퍼블록의 빈 블록 수를 고친다.
+ *
+ * @return 성공 시 0, 실패 시 음수 오류 코드 (bitmap_load()의 오류)
+ */
+static int group_load(uint64_t g) {
+  if (atomic_load_explicit(&groups.ready[g], memory_order_acquire))
+    return 0;
+
+  int res = 0;
+  pthread_mutex_lock(&groups_lock);
+  if (!atomic_load_explicit(&groups.ready[g], memory_order_relaxed)) {
+    uint64_t first, end;
+    group_range(g, &first, &end);
+    for (uint64_t c = first / BITS_PER_CHUNK;
+         c <= (end - 1) / BITS_PER_CHUNK && res == 0; c++) {
+      if (atomic_load_explicit(&groups.loaded[c], memory_order_relaxed))
+        continue;
+      res = bitmap_load(groups.fd, groups.sb->block_bitmap_start + c,
+                        groups.map + c * SFUSE_BLOCK_SIZE, chunk_len(c));
+      if (res == 0)
+        atomic_store_explicit(&groups.loaded[c], 1, memory_order_release);
+    }
+    if (res == 0) {
+      uint64_t actual = count_free(groups.map, first, end);
+      uint64_t recorded = atomic_load(&groups.free[g]);
+      if (actual != recorded) {
+        atomic_store(&groups.free[g], actual);
+        __atomic_add_fetch(&groups.sb->free_blocks, actual - recorded,
+                           __ATOMIC_RELAXED);
+        summary_mark(g);
+      }
+      atomic_store_explicit(&groups.ready[g], 1, memory_order_release);
+      atomic_fetch_add(&groups.nready, 1);
+    }
+  }
+  pthread_mutex_unlock(&groups_lock);
+  if (res < 0)
+    fprintf(stderr, "[SFUSE] 할당 그룹 %" PRIu64 " 비트맵 로드 실패 (%d)\n", g,
+            res);
+  return res;
+}
+
+/**
+ * @brief 할당 탐색에서 그룹을 건너뛸지 판단한다.
+ *
+ * 등록된 블록 비트맵이 아니면 항상 거짓이다. 빈 블록이 없거나 비트맵을 읽을 수
+ * 없는 그룹은 건너뛰고, 그 밖에는 그룹 비트맵을 로드한다.
+ */
+static bool group_skip(const uint8_t *map, uint64_t g) {
+  if (!groups.map || map != groups.map || g >= groups.ngroups)
+    return false;
+  if (atomic_load_explicit(&groups.free[g], memory_order_relaxed) == 0)
+    return true;
+  return group_load(g) < 0;
+}
+
+/**
+ * @brief 비트 i를 원자적으로 1로 만든다.
+ *
+ * @return 이미 1이었으면 참 (다른 스레드가 먼저 할당)
+ */
+static bool bitmap_set(uint8_t *map, uint64_t i) {
+  uint8_t bit = (uint8_t)(1 << (i % 8));
+  return __atomic_fetch_or(&map[i / 8], bit, __ATOMIC_RELAXED) & bit;
+}
+
+/**
+ * @brief 비트 i의 할당 상태 변경을 그룹 상태와 discard 목록에 반영한다.
+ *
+ * 해제한 블록은 discard 대기 목록에 더하고, 다시 할당한 블록은 목록에서 뺀다.
+ *
+ * @param delta 빈 블록 수 변화 (할당 -1, 해제 +1)
+ */
+static void group_note(const uint8_t *map, uint64_t i, int delta) {
+  if (!groups.map || map != groups.map)
+    return;
+  uint64_t blk = groups.sb->data_block_start + i;
+  if (delta > 0)
+    discard_note(blk, 1);
+  else
+    discard_claim(blk, 1);
+  uint64_t g = i / groups.per_group;
+  atomic_fetch_add_explicit(&groups.free[g], (uint64_t)(int64_t)delta,
+                            memory_order_relaxed);
+  atomic_store_explicit(&groups.dirty[i / BITS_PER_CHUNK], 1,
+                        memory_order_relaxed);
+  summary_mark(g);
+}
+
+/**
+ * @brief 바뀐 비트맵 청크와 요약 테이블 블록만 기록한다.
+ */
+static int groups_sync(void) {
+  int res = 0;
+  for (uint64_t c = 0; c < groups.nchunks; c++) {
+    if (!atomic_exchange_explicit(&groups.dirty[c], 0, memory_order_acquire))
+      continue;
+    int r = bitmap_write(groups.fd, groups.sb->block_bitmap_start + c,
+                         groups.map + c * SFUSE_BLOCK_SIZE, chunk_len(c));
+    if (r < 0) {
+      atomic_store(&groups.dirty[c], 1); // 다음 동기화 때 다시 시도
+      res = r;
+    }
+  }
+  if (!groups.summary)
+    return res;
+
+  uint64_t sum_start = groups.sb->inode_bitmap_start -
+                       groups.sb->summary_blocks;
+  uint64_t raw[SFUSE_SUMMARY_PER_BLOCK];
+  for (uint64_t t = 0; t * SFUSE_SUMMARY_PER_BLOCK < groups.ngroups; t++) {
+    if (!atomic_exchange_explicit(&groups.sum_dirty[t], 0,
+                                  memory_order_acquire))
+      continue;
+    memset(raw, 0, sizeof(raw));
+    for (uint64_t k = 0; k < SFUSE_SUMMARY_PER_BLOCK; k++) {
+      uint64_t g = t * SFUSE_SUMMARY_PER_BLOCK + k;
+      if (g < groups.ngroups)
+        raw[k] = htole64(atomic_load_explicit(&groups.free[g],
+                                              memory_order_relaxed));
+    }
+    int r = write_block(groups.fd, sum_start + t, raw);
+    if (r < 0) {
+      atomic_store(&groups.sum_dirty[t], 1);
+      res = r;
+    }
+  }
+  return res;
+}
+
+/**
+ * @brief 요약 테이블을 읽어 그룹별 빈 블록 수를 채운다.
+ */
+static int summary_load(void) {
+  uint64_t sum_start = groups.sb->inode_bitmap_start -
+                       groups.sb->summary_blocks;
+  uint64_t raw[SFUSE_SUMMARY_PER_BLOCK];
+  for (uint64_t t = 0; t * SFUSE_SUMMARY_PER_BLOCK < groups.ngroups; t++) {
+    int res = read_block(groups.fd, sum_start + t, raw);
+    if (res < 0)
+      return res;
+    for (uint64_t k = 0; k < SFUSE_SUMMARY_PER_BLOCK; k++) {
+      uint64_t g = t * SFUSE_SUMMARY_PER_BLOCK + k;
+      if (g < groups.ngroups)
+        atomic_init(&groups.free[g], le64toh(raw[k]));
+    }
+  }
+  return 0;
+}
+
+int bitmap_groups_init(int fd, struct sfuse_super *sb, uint8_t *block_map) {
+  uint64_t total = sb->blocks_count - sb->data_block_start;
+  uint64_t per_group = sb->blocks_per_group ? sb->blocks_per_group : total;
+
+  groups.fd = fd;
+  groups.sb = sb;
+  groups.size = sb->blocks_count / 8;
+  groups.nchunks = (groups.size + SFUSE_BLOCK_SIZE - 1) / SFUSE_BLOCK_SIZE;
+  groups.per_group = per_group;
+  groups.ngroups = (total + per_group - 1) / per_group;
+  groups.summary =
+      (sb->feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_GROUP_SUMMARY) != 0;
+  groups.loaded = calloc(groups.nchunks, sizeof(*groups.loaded));
+  groups.dirty = calloc(groups.nchunks, sizeof(*groups.dirty));
+  groups.ready = calloc(groups.ngroups, sizeof(*groups.ready));
+  groups.free = calloc(groups.ngroups, sizeof(*groups.free));
+  groups.sum_dirty = calloc(
+      (groups.ngroups + SFUSE_SUMMARY_PER_BLOCK - 1) / SFUSE_SUMMARY_PER_BLOCK,
+      sizeof(*groups.sum_dirty));
+  atomic_init(&groups.nready, 0);
+  if (!groups.loaded || !groups.dirty || !groups.ready || !groups.free ||
+      !groups.sum_dirty) {
+    bitmap_groups_destroy();
+    return -ENOMEM;
+  }
+
+  /* [1단계] 요약 테이블이 있으면 그것만 읽고 비트맵은 그룹별로 나중에 로드 */
+  if (groups.summary && summary_load() == 0) {
+    groups.map = block_map;
+    return 0;
+  }
+
+  /* [2단계] 요약이 없거나 손상됨: 비트맵 전체를 읽어 그룹별 빈 블록 수 계산 */
+  int res = bitmap_load(fd, sb->block_bitmap_start, block_map, groups.size);
+  if (res < 0) {
+    bitmap_groups_destroy();
+    return res;
+  }
+  for (uint64_t c = 0; c < groups.nchunks; c++)
+    atomic_init(&groups.loaded[c], 1);
+  for (uint64_t g = 0; g < groups.ngroups; g++) {
+    uint64_t first, end;
+    group_range(g, &first, &end);
+    atomic_init(&groups.free[g], count_free(block_map, first, end));
+    atomic_init(&groups.ready[g], 1);
+    if (groups.summary)
+      summary_mark(g); // 손상된 요약 테이블은 다음 동기화 때 다시 기록
+  }
+  atomic_init(&groups.nready, (uint32_t)groups.ngroups);
+  groups.map = block_map;
+  return 0;
+}
+
+void bitmap_groups_destroy(void) {
+  free(groups.loaded);
+  free(groups.dirty);
+  free(groups.ready);
+  free(groups.free);
+  free(groups.sum_dirty);
+  memset(&groups, 0, sizeof(groups));
 }
 
+uint32_t bitmap_groups_loaded(void) { return atomic_load(&groups.nready); }
+
 /**
  * @brief 메모리의 비트맵 데이터를 디스크에 기록
  *
@@ -55,7 +392,11 @@ int bitmap_load(int fd, uint32_t block_no, uint8_t *map, size_t map_size) {
  *
  * 비트맵의 변경 사항(블록 또는 아이노드 할당 상태 등)을 디스크에 반영하여,
  * 시스템이 재부팅되거나 파일 시스템이 다시 마운트될 때 정확한 상태를 유지하도록
- * 한다.
+ * 한다. map이 메타데이터 매핑을 가리키면 기록 대신 페이지를 더티로 표시하고,
+ * 실제 기록은 커밋 시점의 meta_flush()에 맡긴다. bitmap_groups_init()으로
+ * 등록한 블록 비트맵이면 바뀐 청크와 그룹 요약 테이블 블록만 기록한다.
+ * 요청 처리 스레드와 고아 회수 스레드가 같은 블록의 내용과 체크섬을 엇갈려
+ * 기록하지 않도록 기록은 하나씩 수행한다.
  *
  * @param fd 디바이스 파일 디스크립터 (기록할 대상 디스크 장치)
  * @param block_no 비트맵을 기록할 디스크 내의 블록 번호
@@ -65,19 +406,15 @@ int bitmap_load(int fd, uint32_t block_no, uint8_t *map, size_t map_size) {
  * @return 성공 시 0을 반환하며, 오류 발생 시 음수 값으로 오류 코드 반환:
  *         -EIO (I/O 오류), 또는 disk_write가 반환하는 기타 음수 값
  */
-int bitmap_sync(int fd, uint32_t block_no, uint8_t *map, size_t map_size) {
-  ssize_t ret;
-
-  // 메모리(map)의 비트맵 데이터를 디스크의 지정된 위치에 기록한다.
-  ret = disk_write(fd, map, map_size, (off_t)block_no * SFUSE_BLOCK_SIZE);
-  if (ret < 0)
-    return (int)ret; // disk_write 실패: 기록 자체가 실패함
-
-  // 기록한 데이터 크기가 요청한 크기와 일치하는지 검증한다.
-  if ((size_t)ret != map_size)
-    return -EIO; // 기록한 데이터 크기가 예상 크기와 불일치 (부분적 기록 발생)
-
-  return 0; // 정상적으로 비트맵 데이터를 디스크에 기록 완료
+int bitmap_sync(int fd, uint64_t block_no, uint8_t *map, size_t map_size) {
+  static pthread_mutex_t sync_lock = PTHREAD_MUTEX_INITIALIZER;
+  pthread_mutex_lock(&sync_lock);
+  // 등록된 블록 비트맵은 바뀐 청크와 요약 테이블만 기록
+  int res = groups.map && map == groups.map
+                ? groups_sync()
+                : bitmap_write(fd, block_no, map, map_size);
+  pthread_mutex_unlock(&sync_lock);
+  return res;
 }
 
 /**
@@ -85,7 +422,8 @@ int bitmap_sync(int fd, uint32_t block_no, uint8_t *map, size_t map_size) {
  *
  * 이 함수는 파일 시스템에서 데이터 저장을 위해 사용되지 않은 블록을 찾아
  * 할당한다. 블록의 사용 여부는 비트맵(block_map)에 비트 단위로 저장되어 있으며,
- * 이 비트맵을 순차적으로 탐색해 첫 번째 빈 블록을 찾아 할당한다.
+ * 이 비트맵을 순차적으로 탐색해 첫 번째 빈 블록을 찾아 할당한다. 등록된 블록
+ * 비트맵이면 빈 블록이 없는 그룹은 읽지 않고 건너뛴다.
  *
  * 블록을 할당하면 해당 블록의 비트를 '사용 중(1)'으로 설정하고,
  * 슈퍼블록의 'free_blocks' 필드 값을 감소시켜 남은 가용 블록 수를 갱신한다.
@@ -96,25 +434,36 @@ int bitmap_sync(int fd, uint32_t block_no, uint8_t *map, size_t map_size) {
  * @return 성공 시 할당된 블록의 오프셋(0부터 시작)을 반환하며,
  *         가용 블록이 없으면 공간 부족을 의미하는 -ENOSPC 반환
  */
-int alloc_block(struct sfuse_super *sb, uint8_t *block_map) {
+int64_t alloc_block(struct sfuse_super *sb, uint8_t *block_map) {
   // 데이터 블록 영역에서 사용 가능한 총 블록 개수를 계산
-  uint32_t total = sb->blocks_count - sb->data_block_start;
+  uint64_t total = sb->blocks_count - sb->data_block_start;
+
+  uint64_t per_group = sb->blocks_per_group ? sb->blocks_per_group : total;
 
   // 비트맵을 처음부터 끝까지 탐색하며 빈 블록을 찾음
-  for (uint32_t i = 0; i < total; i++) {
-    uint32_t byte_idx = i / 8; // 비트맵의 바이트 단위 인덱스
+  for (uint64_t i = 0; i < total; i++) {
+    // 그룹 시작에서 빈 블록이 없는 그룹은 비트맵을 읽지 않고 건너뜀
+    if (i % per_group == 0 && group_skip(block_map, i / per_group)) {
+      i += per_group - 1;
+      continue;
+    }
+    uint64_t byte_idx = i / 8; // 비트맵의 바이트 단위 인덱스
     uint32_t bit_idx = i % 8;  // 바이트 내의 비트 위치 (0~7)
 
     // 현재 블록(i)이 사용 가능한 상태인지 확인 (비트 값이 0이면 사용 가능)
     if (!(block_map[byte_idx] & (1 << bit_idx))) {
       // 사용 가능한 블록 발견 시 해당 비트를 '1'로 설정하여 사용 중으로 표시
-      block_map[byte_idx] |= (1 << bit_idx);
+      // (고아 회수 스레드가 같은 바이트의 다른 비트를 지울 수 있으므로 원자적
+      // 연산을 사용하고, 그 사이 다른 스레드가 가져갔으면 계속 탐색)
+      if (bitmap_set(block_map, i))
+        continue;
 
       // 슈퍼블록에서 사용 가능한 블록 개수 1 감소
-      sb->free_blocks--;
+      __atomic_sub_fetch(&sb->free_blocks, 1, __ATOMIC_RELAXED);
+      group_note(block_map, i, -1);
 
       // 할당된 블록의 오프셋 반환 (0부터 시작)
-      return (int)i;
+      return (int64_t)i;
     }
   }
 
@@ -122,6 +471,97 @@ int alloc_block(struct sfuse_super *sb, uint8_t *block_map) {
   return -ENOSPC;
 }
 
+/**
+ * @brief 비트맵에서 빈 구간을 찾는다. (비트는 바꾸지 않음)
+ *
+ * want 이상인 구간을 처음 만나면 그 앞부분 want개를, 끝까지 찾지 못하면
+ * 지금까지 본 가장 긴 구간을 돌려준다.
+ *
+ * @param len 찾은 구간의 길이를 저장할 포인터 (없으면 0)
+ * @return 찾은 구간의 첫 블록 오프셋
+ */
+static uint64_t find_free_run(struct sfuse_super *sb, uint8_t *block_map,
+                              uint64_t want, uint64_t *len) {
+  uint64_t total = sb->blocks_count - sb->data_block_start;
+  uint64_t best_start = 0, best_len = 0; // 지금까지 찾은 가장 긴 빈 구간
+  uint64_t run_start = 0, run_len = 0;   // 현재 탐색 중인 빈 구간
+
+  uint64_t per_group = sb->blocks_per_group ? sb->blocks_per_group : total;
+
+  for (uint64_t i = 0; i < total; i++) {
+    // 빈 블록이 없는 그룹은 건너뜀 (구간도 거기서 끊김)
+    if (i % per_group == 0 && group_skip(block_map, i / per_group)) {
+      i += per_group - 1;
+      run_len = 0;
+      continue;
+    }
+    if (block_map[i / 8] & (1 << (i % 8))) {
+      run_len = 0; // 사용 중인 블록을 만나면 구간 종료
+      continue;
+    }
+    if (run_len == 0)
+      run_start = i;
+    run_len++;
+    if (run_len > best_len) {
+      best_start = run_start;
+      best_len = run_len;
+    }
+    if (run_len == want)
+      break; // 원하는 길이의 구간 발견
+  }
+
+  *len = best_len;
+  return best_start;
+}
+
+/**
+ * @brief 연속된 데이터 블록 묶음을 할당하고 비트맵과 슈퍼블록 상태를 갱신
+ *
+ * 지연 할당(delayed allocation)으로 모아 둔 블록을 기록할 때, 파일 하나의
+ * 블록들이 디스크에서 연속으로 배치되도록 하기 위해 사용한다.
+ *
+ * 비트맵을 처음부터 탐색하면서 빈 구간(연속된 0 비트)의 길이를 센다.
+ *   - want 이상인 구간을 처음 만나면 그 구간의 앞부분 want개를 할당한다.
+ *   - 끝까지 찾지 못하면 지금까지 본 가장 긴 구간을 할당한다.
+ *
+ * 탐색과 비트 설정 사이에 alloc_block()이 구간 안의 블록을 가져가면 구간을
+ * 그 블록 앞에서 끊는다. 첫 블록부터 가져갔으면 다시 탐색한다.
+ *
+ * @param sb 슈퍼블록 구조체 포인터
+ * @param block_map 블록 비트맵 버퍼
+ * @param want 원하는 연속 블록 수 (1 이상)
+ * @param got 실제로 할당된 블록 수를 저장할 포인터
+ *
+ * @return 성공 시 할당된 첫 블록의 오프셋(0부터 시작),
+ *         빈 블록이 하나도 없으면 -ENOSPC 반환
+ */
+int64_t alloc_block_run(struct sfuse_super *sb, uint8_t *block_map,
+                        uint64_t want, uint64_t *got) {
+  if (want == 0)
+    want = 1;
+
+  for (;;) {
+    uint64_t len;
+    uint64_t start = find_free_run(sb, block_map, want, &len);
+    if (len == 0)
+      return -ENOSPC;
+
+    // 선택한 구간의 비트를 앞에서부터 '1'로 설정하고, 다른 스레드가 먼저
+    // 가져간 비트를 만나면 거기서 구간을 끊음 (그 비트는 세지 않음)
+    uint64_t n = 0;
+    while (n < len && !bitmap_set(block_map, start + n)) {
+      group_note(block_map, start + n, -1);
+      n++;
+    }
+    if (n == 0)
+      continue; // 첫 블록을 빼앗김: 바뀐 비트맵으로 다시 탐색
+
+    __atomic_sub_fetch(&sb->free_blocks, n, __ATOMIC_RELAXED);
+    *got = n;
+    return (int64_t)start;
+  }
+}
+
 /**
  * @brief 이전에 할당된 데이터 블록을 해제하고 비트맵과 슈퍼블록 상태를 갱신
  *
@@ -139,15 +579,98 @@ int alloc_block(struct sfuse_super *sb, uint8_t *block_map) {
  * @param block_map 블록 할당 여부를 나타내는 비트맵 버퍼 포인터
  * @param offset 해제할 블록의 오프셋(0부터 시작)
  */
-void free_block(struct sfuse_super *sb, uint8_t *block_map, uint32_t offset) {
-  uint32_t byte_idx = offset / 8; // 비트맵 내의 바이트 단위 인덱스 계산
+void free_block(struct sfuse_super *sb, uint8_t *block_map, uint64_t offset) {
+  uint64_t byte_idx = offset / 8; // 비트맵 내의 바이트 단위 인덱스 계산
   uint32_t bit_idx = offset % 8;  // 바이트 내에서의 비트 위치 계산 (0~7)
 
+  // 등록된 블록 비트맵이면 해당 그룹을 먼저 로드 (읽을 수 없으면 해제 포기)
+  if (groups.map && block_map == groups.map &&
+      group_load(offset / groups.per_group) < 0)
+    return;
+
+  // 그룹 상태와 discard 목록에 먼저 반영한다. 비트를 지운 뒤에 반영하면 그
+  // 사이에 다른 스레드가 다시 할당한 블록이 discard 목록에 남을 수 있다.
+  group_note(block_map, offset, 1);
+
   // 비트맵에서 해당 블록의 비트를 '0'으로 설정 (빈 상태로 표시)
-  block_map[byte_idx] &= ~(1 << bit_idx);
+  __atomic_fetch_and(&block_map[byte_idx], (uint8_t)~(1 << bit_idx),
+                     __ATOMIC_RELEASE);
 
   // 슈퍼블록 내 빈 블록 개수를 1 증가 (가용 블록 수 갱신)
-  sb->free_blocks++;
+  __atomic_add_fetch(&sb->free_blocks, 1, __ATOMIC_RELAXED);
+}
+
+int claim_block(struct sfuse_super *sb, uint8_t *block_map, uint64_t offset) {
+  if (groups.map && block_map == groups.map) {
+    int res = group_load(offset / groups.per_group);
+    if (res < 0)
+      return res;
+  }
+  if (bitmap_set(block_map, offset))
+    return 0;
+  __atomic_sub_fetch(&sb->free_blocks, 1, __ATOMIC_RELAXED);
+  group_note(block_map, offset, -1);
+  return 1;
+}
+
+/**
+ * @brief 빈 구간 하나를 통계에 더한다.
+ */
+static void free_extent_add(struct sfuse_free_extents *out, uint64_t len) {
+  if (len == 0)
+    return;
+  unsigned order = 63 - (unsigned)__builtin_clzll(len);
+  if (order >= SFUSE_FREE_EXTENT_ORDERS)
+    order = SFUSE_FREE_EXTENT_ORDERS - 1;
+  out->count++;
+  out->blocks += len;
+  out->order[order]++;
+  if (len > out->largest)
+    out->largest = len;
+}
+
+/**
+ * @brief 블록 비트맵의 빈 구간 통계를 구한다.
+ *
+ * 모두 비었거나(0x00) 모두 사용 중인(0xFF) 바이트는 비트 단위로 보지 않고
+ * 한 번에 처리한다. 등록된 블록 비트맵이면 아직 읽지 않은 그룹도 모두 읽는다.
+ *
+ * @param sb 슈퍼블록 구조체 포인터
+ * @param block_map 블록 비트맵 버퍼
+ * @param out 결과를 저장할 구조체
+ */
+void bitmap_free_extents(const struct sfuse_super *sb, const uint8_t *block_map,
+                         struct sfuse_free_extents *out) {
+  uint64_t total = sb->blocks_count - sb->data_block_start;
+  uint64_t run = 0; // 현재 빈 구간의 길이
+
+  // 등록된 블록 비트맵이면 아직 읽지 않은 그룹도 모두 로드
+  if (groups.map && block_map == groups.map)
+    for (uint64_t g = 0; g < groups.ngroups; g++)
+      group_load(g);
+
+  memset(out, 0, sizeof(*out));
+  for (uint64_t i = 0; i < total;) {
+    uint8_t byte = block_map[i / 8];
+    if (i % 8 == 0 && i + 8 <= total && (byte == 0x00 || byte == 0xFF)) {
+      if (byte == 0x00) {
+        run += 8;
+      } else {
+        free_extent_add(out, run);
+        run = 0;
+      }
+      i += 8;
+      continue;
+    }
+    if (byte & (1 << (i % 8))) {
+      free_extent_add(out, run);
+      run = 0;
+    } else {
+      run++;
+    }
+    i++;
+  }
+  free_extent_add(out, run);
 }
 
 /**
@@ -178,10 +701,11 @@ int alloc_inode(struct sfuse_super *sb, uint8_t *inode_map) {
     // 현재 아이노드(i)가 빈 상태인지 검사 (0이면 빈 상태)
     if (!(inode_map[byte_idx] & (1 << bit_idx))) {
       // 사용 가능한 아이노드를 발견하면, 비트맵에 사용 중으로 표시 (비트=1)
-      inode_map[byte_idx] |= (1 << bit_idx);
+      if (bitmap_set(inode_map, i))
+        continue; // 다른 스레드가 먼저 가져감
 
       // 슈퍼블록의 남은 빈 아이노드 수를 1 감소시킴
-      sb->free_inodes--;
+      __atomic_sub_fetch(&sb->free_inodes, 1, __ATOMIC_RELAXED);
 
       // 할당된 아이노드 번호를 반환 (번호는 1부터 시작)
       return (int)i;
@@ -219,8 +743,9 @@ void free_inode(struct sfuse_super *sb, uint8_t *inode_map, uint32_t ino) {
   uint32_t bit_idx = ino % 8;  // 해당 바이트 내의 비트 위치 계산 (0~7)
 
   // 비트맵에서 해당 아이노드의 비트를 0으로 설정하여 빈 상태로 변경
-  inode_map[byte_idx] &= ~(1 << bit_idx);
+  __atomic_fetch_and(&inode_map[byte_idx], (uint8_t)~(1 << bit_idx),
+                     __ATOMIC_RELAXED);
 
   // 슈퍼블록의 빈 아이노드 개수를 1 증가시킴
-  sb->free_inodes++;
+  __atomic_add_fetch(&sb->free_inodes, 1, __ATOMIC_RELAXED);
 }
@@ -7,6 +7,7 @@
  */
 
 #include "block.h"
+#include "csum.h"
 #include "disk.h"
 #include "super.h" // SFUSE_BLOCK_SIZE
 #include <errno.h>
@@ -20,14 +21,18 @@
  * disk_read()를 호출하여 해당 위치에서 블록 단위의 데이터를 읽는다.
  * 읽기 작업은 SFUSE_BLOCK_SIZE 단위로 이루어진다.
  *
+ * 체크섬이 기록된 블록이면 읽은 내용을 검증한다. 불일치는 다른 스레드가 같은
+ * 블록을 기록하는 도중에 읽었을 때도 생길 수 있으므로 한 번 다시 읽어 확인한다.
+ *
  * @param fd 디바이스 파일 디스크립터
  * @param block_no 읽을 블록 번호 (0부터 시작)
  * @param buf 읽은 데이터를 저장할 SFUSE_BLOCK_SIZE 크기의 버퍼
  * @return 0 성공, 음수 오류 코드
  *         -EIO: 읽은 데이터 크기가 SFUSE_BLOCK_SIZE와 다를 경우
+ *         -EBADMSG: 체크섬 불일치
  *         disk_read()에서 반환된 음수의 오류 코드
  */
-int read_block(int fd, uint32_t block_no, void *buf) {
+int read_block(int fd, uint64_t block_no, void *buf) {
   // 블록 번호를 실제 파일의 바이트 오프셋으로 변환
   off_t offset = (off_t)block_no * SFUSE_BLOCK_SIZE;
 
@@ -42,7 +47,13 @@ int read_block(int fd, uint32_t block_no, void *buf) {
   if ((size_t)ret != SFUSE_BLOCK_SIZE)
     return -EIO;
 
-  return 0;
+  // 체크섬 검증 (불일치하면 한 번 다시 읽음)
+  if (csum_verify(block_no, buf, SFUSE_BLOCK_SIZE) == 0)
+    return 0;
+  ret = disk_read(fd, buf, SFUSE_BLOCK_SIZE, offset);
+  if (ret != SFUSE_BLOCK_SIZE)
+    return ret < 0 ? (int)ret : -EIO;
+  return csum_verify(block_no, buf, SFUSE_BLOCK_SIZE);
 }
 
 /**
@@ -50,7 +61,8 @@ int read_block(int fd, uint32_t block_no, void *buf) {
  *
  * 블록 번호를 기반으로 디바이스 파일 내의 정확한 위치(offset)를 계산한 후,
  * disk_write()를 호출하여 해당 위치에 블록 크기의 데이터를 기록한다.
- * 쓰기 작업은 SFUSE_BLOCK_SIZE 단위로 이루어진다.
+ * 쓰기 작업은 SFUSE_BLOCK_SIZE 단위로 이루어진다. 기록에 성공하면 블록
+ * 체크섬을 갱신한다.
  *
  * @param fd 디바이스 파일 디스크립터
  * @param block_no 기록할 블록 번호 (0부터 시작)
@@ -59,7 +71,7 @@ int read_block(int fd, uint32_t block_no, void *buf) {
  *         -EIO: 기록한 데이터 크기가 SFUSE_BLOCK_SIZE와 다를 경우
  *         disk_write()에서 반환된 음수의 오류 코드
  */
-int write_block(int fd, uint32_t block_no, const void *buf) {
+int write_block(int fd, uint64_t block_no, const void *buf) {
   // 블록 번호를 실제 파일의 바이트 오프셋으로 변환
   off_t offset = (off_t)block_no * SFUSE_BLOCK_SIZE;
 
@@ -74,5 +86,7 @@ int write_block(int fd, uint32_t block_no, const void *buf) {
   if ((size_t)ret != SFUSE_BLOCK_SIZE)
     return -EIO;
 
+  // 기록한 내용의 체크섬을 테이블에 반영
+  csum_update(block_no, buf, SFUSE_BLOCK_SIZE);
   return 0;
 }
@@ -0,0 +1,352 @@
+/**
+ * @file src/compress.c
+ * @brief 클러스터 단위 데이터 압축(LZ4 블록 형식) 구현
+ *
+ * 압축 구간은 헤더(struct cluster_header)와 LZ4 블록 형식의 압축 데이터로
+ * 이루어지며, 마지막 블록의 남는 부분은 0으로 채운다. 외부 라이브러리 없이
+ * 동작하도록 LZ4 블록 형식의 압축기(탐욕적 해시 매칭)와 해제기를 직접
+ * 구현한다. 해제기는 입력을 신뢰하지 않고 모든 길이와 거리를 검사한다.
+ */
+
+#include "compress.h"
+#include "csum.h"
+#include "disk.h"
+#include "stats.h"
+#include <endian.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** @brief 압축 구간 헤더의 식별 값 ("SFZ1") */
+#define CLUSTER_MAGIC 0x315A4653u
+
+/** @brief 클러스터 최대 크기 (바이트) */
+#define CLUSTER_BYTES (SFUSE_COMPRESS_CLUSTER_BLOCKS * SFUSE_BLOCK_SIZE)
+
+/** @brief LZ4 최소 일치 길이 */
+#define LZ4_MIN_MATCH 4
+/** @brief 마지막 일치가 시작할 수 있는 입력 끝으로부터의 최소 거리 */
+#define LZ4_MFLIMIT 12
+/** @brief 항상 리터럴로 남기는 입력 끝 바이트 수 */
+#define LZ4_LAST_LITERALS 5
+/** @brief 압축기 해시 테이블 크기 (2의 거듭제곱) */
+#define LZ4_HASH_LOG 12
+
+/**
+ * @struct cluster_header
+ * @brief 압축 구간 첫 블록 앞에 놓이는 헤더 (리틀 엔디언)
+ */
+struct cluster_header {
+  uint32_t magic;   /**< CLUSTER_MAGIC */
+  uint32_t csize;   /**< 헤더 뒤 압축 데이터 크기 (바이트) */
+  uint16_t nblocks; /**< 클러스터의 논리 블록 수 */
+  uint8_t algo;     /**< 압축 방식 (SFUSE_COMPRESS_LZ4) */
+  uint8_t pad;      /**< 0 */
+};
+
+/**
+ * @struct cluster_cache
+ * @brief 푼 클러스터 캐시 (압축 구간 시작 블록 번호로 직접 사상)
+ */
+static struct cluster_cache {
+  pthread_mutex_t lock; /**< 캐시 보호용 잠금 */
+  struct cluster_slot {
+    uint64_t pbn;     /**< 압축 구간 시작 블록 번호 (0이면 빈 칸) */
+    uint32_t nblocks; /**< 클러스터의 논리 블록 수 */
+    uint8_t *data;    /**< 푼 데이터 (CLUSTER_BYTES, 처음 쓸 때 할당) */
+  } slot[SFUSE_COMPRESS_CACHE_SLOTS];
+} cache = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static uint32_t read32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint32_t lz4_hash(uint32_t seq) {
+  return (seq * 2654435761u) >> (32 - LZ4_HASH_LOG);
+}
+
+/**
+ * @brief 255 단위로 이어지는 길이 바이트를 기록한다.
+ */
+static uint8_t *lz4_put_len(uint8_t *op, size_t len) {
+  for (; len >= 255; len -= 255)
+    *op++ = 255;
+  *op++ = (uint8_t)len;
+  return op;
+}
+
+/**
+ * @brief 시퀀스 하나(리터럴 + 일치)를 기록한다.
+ *
+ * @param mlen 일치 길이 (LZ4_MIN_MATCH를 뺀 값, 마지막 시퀀스면 무시)
+ * @param last 참이면 일치 없이 리터럴만 기록
+ * @return 다음 출력 위치, 용량이 모자라면 NULL
+ */
+static uint8_t *lz4_put_seq(uint8_t *op, const uint8_t *oend,
+                            const uint8_t *lit, size_t nlit, uint16_t offset,
+                            size_t mlen, bool last) {
+  // 길이 바이트까지 포함한 최대 크기로 미리 검사
+  size_t need = 1 + nlit / 255 + 1 + nlit + (last ? 0 : 2 + mlen / 255 + 1);
+  if (need > (size_t)(oend - op))
+    return NULL;
+
+  uint8_t *token = op++;
+  *token = (uint8_t)((nlit >= 15 ? 15 : nlit) << 4);
+  if (nlit >= 15)
+    op = lz4_put_len(op, nlit - 15);
+  memcpy(op, lit, nlit);
+  op += nlit;
+  if (last)
+    return op;
+
+  *op++ = (uint8_t)(offset & 0xff);
+  *op++ = (uint8_t)(offset >> 8);
+  *token |= (uint8_t)(mlen >= 15 ? 15 : mlen);
+  if (mlen >= 15)
+    op = lz4_put_len(op, mlen - 15);
+  return op;
+}
+
+/**
+ * @brief LZ4 블록 형식으로 압축한다.
+ *
+ * 일치를 찾지 못하는 동안 탐색 간격을 넓혀, 압축되지 않는 데이터에 쓰는
+ * 시간을 줄인다.
+ *
+ * @return 압축 데이터 크기, cap 안에 담을 수 없으면 0
+ */
+static size_t lz4_compress(const uint8_t *src, size_t n, uint8_t *dst,
+                           size_t cap) {
+  uint32_t table[1u << LZ4_HASH_LOG] = {0};
+  const uint8_t *ip = src, *anchor = src, *end = src + n;
+  uint8_t *op = dst, *oend = dst + cap;
+
+  if (n > LZ4_MFLIMIT) {
+    const uint8_t *mflimit = end - LZ4_MFLIMIT;
+    const uint8_t *matchlimit = end - LZ4_LAST_LITERALS;
+    uint32_t misses = 0;
+    ip++;
+    while (ip < mflimit) {
+      uint32_t seq = read32(ip);
+      uint32_t h = lz4_hash(seq);
+      const uint8_t *ref = src + table[h];
+      table[h] = (uint32_t)(ip - src);
+      if (ref >= ip || ip - ref > 0xffff || read32(ref) != seq) {
+        ip += 1 + (misses++ >> 6);
+        continue;
+      }
+      misses = 0;
+
+      // 일치를 앞뒤로 늘림
+      while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+        ip--;
+        ref--;
+      }
+      const uint8_t *mp = ip + LZ4_MIN_MATCH, *rp = ref + LZ4_MIN_MATCH;
+      while (mp < matchlimit && *mp == *rp) {
+        mp++;
+        rp++;
+      }
+
+      op = lz4_put_seq(op, oend, anchor, (size_t)(ip - anchor),
+                       (uint16_t)(ip - ref), (size_t)(mp - ip) - LZ4_MIN_MATCH,
+                       false);
+      if (!op)
+        return 0;
+      ip = anchor = mp;
+      table[lz4_hash(read32(ip - 2))] = (uint32_t)(ip - 2 - src);
+    }
+  }
+
+  op = lz4_put_seq(op, oend, anchor, (size_t)(end - anchor), 0, 0, true);
+  return op ? (size_t)(op - dst) : 0;
+}
+
+/**
+ * @brief 255 단위로 이어지는 길이 바이트를 읽는다.
+ *
+ * @return 성공 시 0, 입력이 끝나면 -1
+ */
+static int lz4_get_len(const uint8_t **ip, const uint8_t *iend, size_t *len) {
+  uint8_t b;
+  do {
+    if (*ip >= iend)
+      return -1;
+    b = *(*ip)++;
+    *len += b;
+  } while (b == 255);
+  return 0;
+}
+
+/**
+ * @brief LZ4 블록 형식을 푼다.
+ *
+ * @return 푼 데이터 크기, 형식이 잘못되었거나 cap을 넘으면 -1
+ */
+static ssize_t lz4_decompress(const uint8_t *src, size_t n, uint8_t *dst,
+                              size_t cap) {
+  const uint8_t *ip = src, *iend = src + n;
+  uint8_t *op = dst, *oend = dst + cap;
+
+  while (ip < iend) {
+    uint8_t token = *ip++;
+    size_t nlit = token >> 4;
+    if (nlit == 15 && lz4_get_len(&ip, iend, &nlit) < 0)
+      return -1;
+    if (nlit > (size_t)(iend - ip) || nlit > (size_t)(oend - op))
+      return -1;
+    memcpy(op, ip, nlit);
+    op += nlit;
+    ip += nlit;
+    if (ip == iend)
+      break; // 마지막 시퀀스는 리터럴만 가짐
+
+    if (iend - ip < 2)
+      return -1;
+    size_t offset = ip[0] | (size_t)ip[1] << 8;
+    ip += 2;
+    size_t mlen = token & 15;
+    if (mlen == 15 && lz4_get_len(&ip, iend, &mlen) < 0)
+      return -1;
+    mlen += LZ4_MIN_MATCH;
+    if (offset == 0 || offset > (size_t)(op - dst) ||
+        mlen > (size_t)(oend - op))
+      return -1;
+
+    const uint8_t *ref = op - offset;
+    if (offset >= mlen) {
+      memcpy(op, ref, mlen);
+      op += mlen;
+    } else {
+      while (mlen--) // 겹치는 일치는 바이트 단위로 복사
+        *op++ = *ref++;
+    }
+  }
+  return op - dst;
+}
+
+uint32_t compress_cluster(const void *src, uint32_t nblocks, void *dst) {
+  const size_t hdr = sizeof(struct cluster_header);
+  size_t cap = (size_t)(nblocks - 1) * SFUSE_BLOCK_SIZE;
+  size_t csize = lz4_compress(src, (size_t)nblocks * SFUSE_BLOCK_SIZE,
+                              (uint8_t *)dst + hdr, cap - hdr);
+  if (csize == 0)
+    return 0; // 한 블록도 줄지 않음
+
+  struct cluster_header h = {.magic = htole32(CLUSTER_MAGIC),
+                             .csize = htole32((uint32_t)csize),
+                             .nblocks = htole16((uint16_t)nblocks),
+                             .algo = SFUSE_COMPRESS_LZ4};
+  memcpy(dst, &h, hdr);
+  size_t used = hdr + csize;
+  uint32_t m = (uint32_t)((used + SFUSE_BLOCK_SIZE - 1) / SFUSE_BLOCK_SIZE);
+  memset((uint8_t *)dst + used, 0, (size_t)m * SFUSE_BLOCK_SIZE - used);
+  return m;
+}
+
+/**
+ * @brief 압축 구간을 읽어 풀어서 캐시 칸에 채운다. (cache.lock 보유 상태)
+ */
+static int cluster_load(int fd, uint64_t pbn, struct cluster_slot *s) {
+  uint8_t *raw = malloc(CLUSTER_BYTES);
+  if (!raw)
+    return -ENOMEM;
+
+  /* [1단계] 첫 블록에서 헤더를 읽고 구간 길이를 구함 */
+  int res = -EIO;
+  struct cluster_header h;
+  if (disk_read(fd, raw, SFUSE_BLOCK_SIZE, (off_t)pbn * SFUSE_BLOCK_SIZE) !=
+      SFUSE_BLOCK_SIZE)
+    goto out;
+  memcpy(&h, raw, sizeof(h));
+  uint32_t csize = le32toh(h.csize);
+  uint16_t nblocks = le16toh(h.nblocks);
+  size_t used = sizeof(h) + (size_t)csize;
+  if (le32toh(h.magic) != CLUSTER_MAGIC || h.algo != SFUSE_COMPRESS_LZ4 ||
+      nblocks < 2 || nblocks > SFUSE_COMPRESS_CLUSTER_BLOCKS ||
+      used > (size_t)(nblocks - 1) * SFUSE_BLOCK_SIZE)
+    goto out;
+  uint64_t m = (used + SFUSE_BLOCK_SIZE - 1) / SFUSE_BLOCK_SIZE;
+
+  /* [2단계] 나머지 블록을 읽어 체크섬 검증 (DATA_CSUM) */
+  size_t rest = (size_t)(m - 1) * SFUSE_BLOCK_SIZE;
+  if (rest && disk_read(fd, raw + SFUSE_BLOCK_SIZE, rest,
+                        (off_t)(pbn + 1) * SFUSE_BLOCK_SIZE) != (ssize_t)rest)
+    goto out;
+  if (csum_data_verify(pbn, raw, m) < 0)
+    goto out;
+
+  /* [3단계] 캐시 칸에 풂 */
+  if (!s->data && !(s->data = malloc(CLUSTER_BYTES))) {
+    res = -ENOMEM;
+    goto out;
+  }
+  size_t want = (size_t)nblocks * SFUSE_BLOCK_SIZE;
+  if (lz4_decompress(raw + sizeof(h), csize, s->data, want) != (ssize_t)want) {
+    s->pbn = 0;
+    goto out;
+  }
+  s->pbn = pbn;
+  s->nblocks = nblocks;
+  res = 0;
+out:
+  if (res == -EIO)
+    fprintf(stderr, "[SFUSE] 압축 구간 %" PRIu64 "을 읽을 수 없습니다\n", pbn);
+  free(raw);
+  return res;
+}
+
+int compress_read(int fd, uint64_t pbn, uint64_t idx, size_t off, void *dst,
+                  size_t len) {
+  struct cluster_slot *s = &cache.slot[pbn % SFUSE_COMPRESS_CACHE_SLOTS];
+  int res = 0;
+
+  pthread_mutex_lock(&cache.lock);
+  if (s->pbn == pbn) {
+    stats_event(SFUSE_EV_CLUSTER_HIT, 1);
+  } else {
+    stats_event(SFUSE_EV_CLUSTER_MISS, 1);
+    res = cluster_load(fd, pbn, s);
+  }
+  if (res == 0) {
+    // 헤더의 블록 수를 넘는 블록은 구멍과 같이 0으로 읽힘
+    if (idx < s->nblocks)
+      memcpy(dst, s->data + idx * SFUSE_BLOCK_SIZE + off, len);
+    else
+      memset(dst, 0, len);
+  }
+  pthread_mutex_unlock(&cache.lock);
+  return res;
+}
+
+void compress_forget(uint64_t pbn) {
+  struct cluster_slot *s = &cache.slot[pbn % SFUSE_COMPRESS_CACHE_SLOTS];
+  pthread_mutex_lock(&cache.lock);
+  if (s->pbn == pbn)
+    s->pbn = 0;
+  pthread_mutex_unlock(&cache.lock);
+}
+
+void compress_cache_drop(void) {
+  pthread_mutex_lock(&cache.lock);
+  for (size_t i = 0; i < SFUSE_COMPRESS_CACHE_SLOTS; i++) {
+    free(cache.slot[i].data);
+    cache.slot[i].data = NULL;
+    cache.slot[i].pbn = 0;
+  }
+  pthread_mutex_unlock(&cache.lock);
+}
+
+int compress_feature_set(int fd, struct sfuse_super *sb) {
+  if (__atomic_load_n(&sb->feature_incompat, __ATOMIC_ACQUIRE) &
+      SFUSE_FEATURE_INCOMPAT_COMPRESS)
+    return 0;
+  __atomic_fetch_or(&sb->feature_incompat, SFUSE_FEATURE_INCOMPAT_COMPRESS,
+                    __ATOMIC_RELEASE);
+  return sb_sync(fd, sb);
+}
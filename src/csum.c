@@ -0,0 +1,308 @@
+/**
+ * @file src/csum.c
+ * @brief CRC32C 계산과 블록 체크섬 테이블 관리 구현
+ *
+ * 체크섬 테이블은 블록 번호로 바로 찾는 uint32_t 배열이다. 서로 다른 블록의
+ * 항목은 서로 다른 스레드가 갱신하므로 잠금 없이 relaxed 원자 연산으로 읽고
+ * 쓰며, 바뀐 테이블 블록은 dirty 표시를 남겨 csum_sync()가 모아 기록한다.
+ *
+ * 테이블 블록은 마운트 시 한꺼번에 읽지 않고 그 블록의 항목을 처음 쓸 때 읽는다.
+ * (마운트 비용이 장치 크기에 비례하지 않도록)
+ */
+
+#include "csum.h"
+#include "disk.h"
+#include "stats.h"
+#include <endian.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+/** @brief CRC32C 다항식 (비트 반전 표현) */
+#define CRC32C_POLY 0x82F63B78u
+
+/** @brief slicing-by-8 조회 테이블 */
+static uint32_t crc32c_table[8][256];
+
+/** @brief 선택된 구현 (crc, buf, len; 시작/끝 반전은 호출자가 처리) */
+static uint32_t (*crc32c_fn)(uint32_t, const uint8_t *, size_t);
+
+/** @brief 선택된 구현 이름 */
+static const char *crc32c_name = "soft";
+
+/**
+ * @struct csum_state
+ * @brief 마운트된 장치의 체크섬 테이블
+ */
+static struct csum_state {
+  _Atomic uint32_t *sums;   /**< 블록별 체크섬 (NULL이면 꺼짐) */
+  _Atomic uint8_t *dirty;   /**< 테이블 블록별 변경 표시 */
+  _Atomic uint8_t *loaded;  /**< 테이블 블록별 로드 여부 */
+  int fd;                   /**< 장치 파일 디스크립터 */
+  uint64_t nblocks;         /**< 테이블이 다루는 블록 수 (장치 전체) */
+  uint64_t start;           /**< 테이블 영역의 시작 블록 번호 */
+  uint64_t table_blocks;    /**< 테이블 영역의 블록 수 */
+  bool data;                /**< 데이터 블록도 검증하는지 (DATA_CSUM) */
+} csum;
+
+/** @brief 테이블 블록 로드를 한 스레드만 하도록 보호하는 잠금 */
+static pthread_mutex_t csum_load_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief slicing-by-8 방식으로 CRC32C를 계산한다.
+ */
+static uint32_t crc32c_soft(uint32_t crc, const uint8_t *p, size_t len) {
+  while (len && ((uintptr_t)p & 7)) {
+    crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    len--;
+  }
+  while (len >= 8) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    v = le64toh(v) ^ crc;
+    crc = crc32c_table[7][v & 0xff] ^ crc32c_table[6][(v >> 8) & 0xff] ^
+          crc32c_table[5][(v >> 16) & 0xff] ^
+          crc32c_table[4][(v >> 24) & 0xff] ^
+          crc32c_table[3][(v >> 32) & 0xff] ^
+          crc32c_table[2][(v >> 40) & 0xff] ^
+          crc32c_table[1][(v >> 48) & 0xff] ^ crc32c_table[0][v >> 56];
+    p += 8;
+    len -= 8;
+  }
+  while (len--)
+    crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+  return crc;
+}
+
+#if defined(__x86_64__)
+/**
+ * @brief SSE4.2 crc32 명령어로 CRC32C를 계산한다. (8바이트씩)
+ */
+__attribute__((target("sse4.2"))) static uint32_t
+crc32c_sse42(uint32_t crc, const uint8_t *p, size_t len) {
+  uint64_t c = crc;
+  while (len && ((uintptr_t)p & 7)) {
+    c = _mm_crc32_u8((uint32_t)c, *p++);
+    len--;
+  }
+  while (len >= 8) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    c = _mm_crc32_u64(c, v);
+    p += 8;
+    len -= 8;
+  }
+  while (len--)
+    c = _mm_crc32_u8((uint32_t)c, *p++);
+  return (uint32_t)c;
+}
+#endif
+
+/**
+ * @brief 조회 테이블을 만들고 CPU에 맞는 구현을 고른다. (프로그램 시작 시)
+ */
+__attribute__((constructor)) static void crc32c_init(void) {
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; k++)
+      c = (c >> 1) ^ (CRC32C_POLY & (0u - (c & 1)));
+    crc32c_table[0][i] = c;
+  }
+  for (uint32_t i = 0; i < 256; i++)
+    for (int t = 1; t < 8; t++)
+      crc32c_table[t][i] = (crc32c_table[t - 1][i] >> 8) ^
+                           crc32c_table[0][crc32c_table[t - 1][i] & 0xff];
+
+  crc32c_fn = crc32c_soft;
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.2")) {
+    crc32c_fn = crc32c_sse42;
+    crc32c_name = "sse4.2";
+  }
+#endif
+}
+
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len) {
+  return ~crc32c_fn(~crc, buf, len);
+}
+
+const char *crc32c_impl(void) { return crc32c_name; }
+
+/**
+ * @brief 블록 체크섬 값을 계산한다.
+ *
+ * size가 블록 크기보다 작으면 나머지를 0으로 채운 블록의 값을 돌려준다.
+ * 0은 "체크섬 없음"을 뜻하므로 계산 결과가 0이면 1로 바꾼다.
+ */
+static uint32_t csum_block(const void *buf, size_t size) {
+  static const uint8_t zero[SFUSE_BLOCK_SIZE];
+  uint32_t c = crc32c(0, buf, size);
+  if (size < SFUSE_BLOCK_SIZE)
+    c = crc32c(c, zero, SFUSE_BLOCK_SIZE - size);
+  return c ? c : 1;
+}
+
+/**
+ * @brief 테이블 블록 t를 처음 쓸 때 장치에서 읽는다.
+ *
+ * 읽을 수 없으면 그 블록의 항목을 모두 0(체크섬 없음)으로 두고 변경 표시를
+ * 남겨, 검증이 잘못된 값으로 실패하지 않고 다음 동기화 때 테이블이 다시
+ * 기록되게 한다.
+ */
+static void csum_table_load(uint64_t t) {
+  if (atomic_load_explicit(&csum.loaded[t], memory_order_acquire))
+    return;
+  pthread_mutex_lock(&csum_load_lock);
+  if (!atomic_load_explicit(&csum.loaded[t], memory_order_relaxed)) {
+    uint32_t raw[SFUSE_CSUM_PER_BLOCK];
+    ssize_t ret = disk_read(csum.fd, raw, sizeof(raw),
+                            (off_t)(csum.start + t) * SFUSE_BLOCK_SIZE);
+    if (ret != (ssize_t)sizeof(raw)) {
+      fprintf(stderr, "[SFUSE] 체크섬 테이블 블록 %" PRIu64 " 읽기 실패\n",
+              csum.start + t);
+      memset(raw, 0, sizeof(raw));
+      atomic_store(&csum.dirty[t], 1);
+    }
+    for (size_t i = 0; i < SFUSE_CSUM_PER_BLOCK; i++)
+      atomic_store_explicit(&csum.sums[t * SFUSE_CSUM_PER_BLOCK + i],
+                            le32toh(raw[i]), memory_order_relaxed);
+    atomic_store_explicit(&csum.loaded[t], 1, memory_order_release);
+  }
+  pthread_mutex_unlock(&csum_load_lock);
+}
+
+/**
+ * @brief 블록의 테이블 항목을 바꾸고 테이블 블록에 변경 표시를 남긴다.
+ */
+static void csum_set(uint64_t blk, uint32_t value) {
+  if (blk >= csum.nblocks || (blk >= csum.start &&
+                              blk < csum.start + csum.table_blocks))
+    return; // 테이블 영역 자신은 다루지 않음
+  csum_table_load(blk / SFUSE_CSUM_PER_BLOCK);
+  if (atomic_load_explicit(&csum.sums[blk], memory_order_relaxed) == value)
+    return;
+  atomic_store_explicit(&csum.sums[blk], value, memory_order_relaxed);
+  atomic_store_explicit(&csum.dirty[blk / SFUSE_CSUM_PER_BLOCK], 1,
+                        memory_order_release);
+}
+
+/**
+ * @brief 블록 하나를 검증한다.
+ */
+static int csum_check(uint64_t blk, const void *buf, size_t size) {
+  if (blk >= csum.nblocks)
+    return 0;
+  csum_table_load(blk / SFUSE_CSUM_PER_BLOCK);
+  uint32_t want = atomic_load_explicit(&csum.sums[blk], memory_order_relaxed);
+  if (want == 0 || want == csum_block(buf, size))
+    return 0;
+  stats_event(SFUSE_EV_CSUM_ERROR, 1);
+  fprintf(stderr, "[SFUSE] 블록 %" PRIu64 " 체크섬 불일치 (기록 %08x)\n",
+          blk, want);
+  return -EBADMSG;
+}
+
+int csum_init(int fd, const struct sfuse_super *sb, bool load) {
+  if (!(sb->feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_METADATA_CSUM))
+    return 0;
+
+  csum.nblocks = sb->blocks_count;
+  csum.table_blocks = sb->csum_blocks;
+  csum.start = sb->data_block_start - sb->csum_blocks;
+  csum.data = (sb->feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_DATA_CSUM) != 0;
+  csum.sums = calloc(csum.table_blocks * SFUSE_CSUM_PER_BLOCK,
+                     sizeof(*csum.sums));
+  csum.dirty = calloc(csum.table_blocks, sizeof(*csum.dirty));
+  csum.loaded = calloc(csum.table_blocks, sizeof(*csum.loaded));
+  if (!csum.sums || !csum.dirty || !csum.loaded) {
+    csum_destroy();
+    return -ENOMEM;
+  }
+  csum.fd = fd;
+
+  // 테이블 블록은 처음 필요할 때 읽는다. 포맷 중이면 빈 테이블로 시작
+  if (!load)
+    for (uint64_t t = 0; t < csum.table_blocks; t++)
+      atomic_init(&csum.loaded[t], 1);
+  return 0;
+}
+
+int csum_sync(int fd) {
+  if (!csum.sums)
+    return 0;
+
+  uint32_t raw[SFUSE_CSUM_PER_BLOCK];
+  for (uint64_t t = 0; t < csum.table_blocks; t++) {
+    if (!atomic_exchange_explicit(&csum.dirty[t], 0, memory_order_acquire))
+      continue;
+    for (size_t i = 0; i < SFUSE_CSUM_PER_BLOCK; i++)
+      raw[i] = htole32(atomic_load_explicit(
+          &csum.sums[t * SFUSE_CSUM_PER_BLOCK + i], memory_order_relaxed));
+    ssize_t ret = disk_write(fd, raw, sizeof(raw),
+                             (off_t)(csum.start + t) * SFUSE_BLOCK_SIZE);
+    if (ret != (ssize_t)sizeof(raw)) {
+      atomic_store(&csum.dirty[t], 1); // 다음 동기화 때 다시 시도
+      return ret < 0 ? (int)ret : -EIO;
+    }
+  }
+  return 0;
+}
+
+void csum_destroy(void) {
+  free(csum.sums);
+  free(csum.dirty);
+  free(csum.loaded);
+  memset(&csum, 0, sizeof(csum));
+}
+
+void csum_update(uint64_t block_no, const void *buf, size_t size) {
+  if (!csum.sums)
+    return;
+  const uint8_t *p = buf;
+  for (; size > 0; block_no++) {
+    size_t n = size < SFUSE_BLOCK_SIZE ? size : SFUSE_BLOCK_SIZE;
+    csum_set(block_no, csum_block(p, n));
+    p += n;
+    size -= n;
+  }
+}
+
+int csum_verify(uint64_t block_no, const void *buf, size_t size) {
+  if (!csum.sums)
+    return 0;
+  const uint8_t *p = buf;
+  for (; size > 0; block_no++) {
+    size_t n = size < SFUSE_BLOCK_SIZE ? size : SFUSE_BLOCK_SIZE;
+    if (csum_check(block_no, p, n) < 0)
+      return -EBADMSG;
+    p += n;
+    size -= n;
+  }
+  return 0;
+}
+
+void csum_data_update(uint64_t block_no, const void *buf, uint64_t nblocks) {
+  if (!csum.sums)
+    return;
+  if (csum.data) {
+    csum_update(block_no, buf, nblocks * SFUSE_BLOCK_SIZE);
+    return;
+  }
+  // 데이터 체크섬을 쓰지 않으면 이전 내용의 체크섬이 남지 않도록 지움
+  for (uint64_t i = 0; i < nblocks; i++)
+    csum_set(block_no + i, 0);
+}
+
+int csum_data_verify(uint64_t block_no, const void *buf, uint64_t nblocks) {
+  if (!csum.data)
+    return 0;
+  return csum_verify(block_no, buf, nblocks * SFUSE_BLOCK_SIZE);
+}
@@ -0,0 +1,423 @@
+/**
+ * @file src/ctl.c
+ * @brief 통계 조회와 제어를 위한 가상 파일(/.sfuse) 구현
+ *
+ * stats는 한 줄에 "키 값" 하나씩 출력하므로 grep/awk나 수집기로 바로 읽을 수
+ * 있다. 연산 통계 초기화(reset)는 카운터를 지우지 않고 그 시점의 스냅숏을
+ * 기준점으로 저장해 두었다가 다음 출력에서 빼는 방식으로 구현한다. 기록하는
+ * 스레드의 카운터는 단일 기록자 전용이라 다른 스레드가 0으로 쓸 수 없기
+ * 때문이다.
+ */
+
+#include "ctl.h"
+#include "bitmap.h"
+#include "compress.h"
+#include "dedup.h"
+#include "csum.h"
+#include "dalloc.h"
+#include "defrag.h"
+#include "discard.h"
+#include "fs.h"
+#include "orphan.h"
+#include "snap.h"
+#include "stats.h"
+#include "super.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @struct ctl_text
+ * @brief 열 때 만든 stats 텍스트 (fi->fh에 보관)
+ */
+struct ctl_text {
+  size_t len;  /**< 텍스트 길이 */
+  char data[]; /**< 텍스트 */
+};
+
+/** @brief 통계 기준점 보호용 잠금 */
+static pthread_mutex_t ctl_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** @brief 마지막 reset 시점의 스냅숏 */
+static struct sfuse_stats_snapshot ctl_base;
+
+/** @brief 마지막 reset 시각 (ns) */
+static uint64_t ctl_base_ns;
+
+/** @brief 마운트 시각 */
+static time_t ctl_mount_time;
+
+/** @brief 마운트 시각 (ns, stats_now() 기준) */
+static uint64_t ctl_mount_ns;
+
+/**
+ * @brief 마운트 시각을 기록하고 통계 기준점을 초기화한다.
+ */
+void ctl_init(void) {
+  pthread_mutex_lock(&ctl_lock);
+  memset(&ctl_base, 0, sizeof(ctl_base));
+  ctl_mount_time = time(NULL);
+  ctl_mount_ns = stats_now();
+  ctl_base_ns = ctl_mount_ns;
+  pthread_mutex_unlock(&ctl_lock);
+}
+
+/**
+ * @brief 경로가 가상 노드인지 판별한다.
+ */
+enum sfuse_ctl_node ctl_node(const char *path) {
+  size_t n = sizeof(SFUSE_CTL_DIR) - 1;
+  if (!path || path[0] != '/' || path[1] != '.' ||
+      strncmp(path, SFUSE_CTL_DIR, n))
+    return SFUSE_CTL_NONE;
+  if (path[n] == '\0')
+    return SFUSE_CTL_ROOT;
+  if (path[n] != '/')
+    return SFUSE_CTL_NONE; // "/.sfusefoo" 같은 일반 이름
+  if (!strcmp(path + n + 1, "stats"))
+    return SFUSE_CTL_STATS;
+  if (!strcmp(path + n + 1, "control"))
+    return SFUSE_CTL_CONTROL;
+  return SFUSE_CTL_UNKNOWN;
+}
+
+/**
+ * @brief 가상 노드의 속성을 채운다.
+ */
+int ctl_getattr(enum sfuse_ctl_node node, struct stat *stbuf) {
+  memset(stbuf, 0, sizeof(*stbuf));
+  switch (node) {
+  case SFUSE_CTL_ROOT:
+    stbuf->st_mode = S_IFDIR | 0555;
+    stbuf->st_nlink = 2;
+    break;
+  case SFUSE_CTL_STATS:
+    // 크기를 미리 알 수 없으므로 0으로 두고 direct_io로 읽게 함
+    stbuf->st_mode = S_IFREG | 0444;
+    stbuf->st_nlink = 1;
+    break;
+  case SFUSE_CTL_CONTROL:
+    stbuf->st_mode = S_IFREG | 0200;
+    stbuf->st_nlink = 1;
+    break;
+  default:
+    return -ENOENT;
+  }
+  stbuf->st_uid = getuid();
+  stbuf->st_gid = getgid();
+  stbuf->st_atime = stbuf->st_mtime = stbuf->st_ctime = ctl_mount_time;
+  return 0;
+}
+
+/**
+ * @brief /.sfuse 디렉터리의 항목을 나열한다.
+ */
+int ctl_readdir(void *buf, fuse_fill_dir_t filler) {
+  static const char *const names[] = {".", "..", "stats", "control"};
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    if (filler(buf, names[i], NULL, 0, 0))
+      break;
+  return 0;
+}
+
+/**
+ * @brief 적중/실패 카운터 쌍과 적중률(%)을 출력한다.
+ */
+static void ctl_print_ratio(FILE *out, const char *name, uint64_t hit,
+                            uint64_t miss) {
+  uint64_t total = hit + miss;
+  fprintf(out, "cache.%s_hit %" PRIu64 "\n", name, hit);
+  fprintf(out, "cache.%s_miss %" PRIu64 "\n", name, miss);
+  fprintf(out, "cache.%s_hit_pct %.1f\n", name,
+          total ? 100.0 * (double)hit / (double)total : 0.0);
+}
+
+/**
+ * @brief 연산 하나의 통계를 출력한다. 호출이 없었던 연산은 생략한다.
+ */
+static void ctl_print_op(FILE *out, const char *name,
+                         const struct sfuse_op_stats *o) {
+  static const struct {
+    const char *key;
+    double p;
+  } pcts[] = {{"p50", 50.0}, {"p90", 90.0}, {"p99", 99.0}, {"p999", 99.9}};
+
+  if (o->count == 0 && o->inflight == 0)
+    return;
+  fprintf(out, "op.%s.count %" PRIu64 "\n", name, o->count);
+  fprintf(out, "op.%s.errors %" PRIu64 "\n", name, o->errors);
+  fprintf(out, "op.%s.bytes %" PRIu64 "\n", name, o->bytes);
+  fprintf(out, "op.%s.inflight %" PRIu64 "\n", name, o->inflight);
+  fprintf(out, "op.%s.avg_ns %" PRIu64 "\n", name,
+          o->count ? o->total_ns / o->count : 0);
+  for (size_t i = 0; i < sizeof(pcts) / sizeof(pcts[0]); i++)
+    fprintf(out, "op.%s.%s_ns %" PRIu64 "\n", name, pcts[i].key,
+            stats_percentile(o, pcts[i].p));
+  fprintf(out, "op.%s.max_ns %" PRIu64 "\n", name, o->max_ns);
+}
+
+/**
+ * @brief 현재 상태를 "키 값" 형식의 텍스트로 출력한다.
+ */
+static void ctl_render_stats(struct sfuse_fs *fs, FILE *out) {
+  static struct sfuse_stats_snapshot snap;
+  static pthread_mutex_t snap_lock = PTHREAD_MUTEX_INITIALIZER;
+  struct sfuse_super *sb = &fs->sb;
+  uint64_t now = stats_now();
+
+  /* [1단계] 기준점을 뺀 연산 통계 (스냅숏이 커서 정적 버퍼를 잠가 사용) */
+  pthread_mutex_lock(&snap_lock);
+  stats_snapshot(&snap);
+  pthread_mutex_lock(&ctl_lock);
+  stats_subtract(&snap, &ctl_base);
+  uint64_t interval_ns = now - ctl_base_ns;
+  pthread_mutex_unlock(&ctl_lock);
+
+  fprintf(out, "uptime_sec %" PRIu64 "\n", (now - ctl_mount_ns) / 1000000000);
+  fprintf(out, "interval_sec %.3f\n", (double)interval_ns / 1e9);
+
+  /* [2단계] 공간과 할당기 상태 */
+  uint64_t reserved = dalloc_reserved(fs);
+  fprintf(out, "space.block_size %d\n", SFUSE_BLOCK_SIZE);
+  fprintf(out, "space.data_blocks %" PRIu64 "\n",
+          sb->blocks_count - sb->data_block_start);
+  uint64_t free_blocks = sb->free_blocks;
+  fprintf(out, "space.free_blocks %" PRIu64 "\n",
+          free_blocks > reserved ? free_blocks - reserved : 0);
+  fprintf(out, "space.inodes %u\n", sb->inodes_count);
+  fprintf(out, "space.free_inodes %u\n", sb->free_inodes);
+  fprintf(out, "alloc.groups %u\n", sb->groups_count);
+  fprintf(out, "alloc.blocks_per_group %" PRIu64 "\n", sb->blocks_per_group);
+  fprintf(out, "alloc.groups_loaded %u\n", bitmap_groups_loaded());
+  fprintf(out, "alloc.reserved_blocks %" PRIu64 "\n", reserved);
+
+  /* [3단계] 빈 공간 단편화 */
+  struct sfuse_free_extents fe;
+  bitmap_free_extents(sb, fs->block_map, &fe);
+  fprintf(out, "frag.free_extents %" PRIu64 "\n", fe.count);
+  fprintf(out, "frag.largest_extent_blocks %" PRIu64 "\n", fe.largest);
+  fprintf(out, "frag.avg_extent_blocks %" PRIu64 "\n",
+          fe.count ? fe.blocks / fe.count : 0);
+  for (int k = 0; k < SFUSE_FREE_EXTENT_ORDERS; k++)
+    if (fe.order[k])
+      fprintf(out, "frag.extents_order_%d %" PRIu64 "\n", k, fe.order[k]);
+
+  /* [4단계] 지연 할당 더티 데이터와 저널 */
+  struct sfuse_dalloc_usage du;
+  dalloc_usage(fs, &du);
+  fprintf(out, "dirty.blocks %" PRIu64 "\n", du.dirty_blocks);
+  fprintf(out, "dirty.bytes %" PRIu64 "\n",
+          du.dirty_blocks * SFUSE_BLOCK_SIZE);
+  fprintf(out, "dirty.inodes %u\n", du.dirty_inodes);
+  fprintf(out, "dirty.oldest_age_sec %lld\n",
+          du.oldest ? (long long)(time(NULL) - du.oldest) : 0LL);
+  fprintf(out, "dirty.limit_blocks %d\n", SFUSE_DALLOC_MAX_BLOCKS);
+  // 저널 영역은 예약만 되어 있고 아직 기록하지 않는다.
+  fprintf(out, "journal.blocks %" PRIu64 "\n", sb->journal_blocks);
+  fprintf(out, "journal.used_blocks 0\n");
+  fprintf(out, "csum.metadata %d\n",
+          !!(sb->feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_METADATA_CSUM));
+  fprintf(out, "csum.data %d\n",
+          !!(sb->feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_DATA_CSUM));
+  fprintf(out, "csum.impl %s\n", crc32c_impl());
+  fprintf(out, "meta.mmap %d\n", fs->opts.mmap_meta);
+
+  /* [5단계] 캐시 적중률과 요청 큐 깊이 */
+  const uint64_t *ev = snap.events;
+  ctl_print_ratio(out, "bmap", ev[SFUSE_EV_BMAP_HIT], ev[SFUSE_EV_BMAP_MISS]);
+  ctl_print_ratio(out, "dalloc", ev[SFUSE_EV_DALLOC_HIT],
+                  ev[SFUSE_EV_DALLOC_MISS]);
+  ctl_print_ratio(out, "cluster", ev[SFUSE_EV_CLUSTER_HIT],
+                  ev[SFUSE_EV_CLUSTER_MISS]);
+  fprintf(out, "cache.readahead_blocks %" PRIu64 "\n",
+          ev[SFUSE_EV_READAHEAD_BLKS]);
+  fprintf(out, "csum.errors %" PRIu64 "\n", ev[SFUSE_EV_CSUM_ERROR]);
+  fprintf(out, "sync.dev_flushes %" PRIu64 "\n", ev[SFUSE_EV_DEV_FLUSH]);
+  fprintf(out, "sync.fsync_merged %" PRIu64 "\n", ev[SFUSE_EV_FSYNC_MERGED]);
+  fprintf(out, "discard.enabled %d\n", discard_enabled());
+  fprintf(out, "discard.requests %" PRIu64 "\n", ev[SFUSE_EV_DISCARD]);
+  fprintf(out, "discard.blocks %" PRIu64 "\n", ev[SFUSE_EV_DISCARD_BLKS]);
+  fprintf(out, "orphan.inodes %u\n", orphan_pending(fs));
+  fprintf(out, "orphan.batches %" PRIu64 "\n", ev[SFUSE_EV_ORPHAN_BATCH]);
+  fprintf(out, "compress.enabled %d\n",
+          !!(sb->feature_incompat & SFUSE_FEATURE_INCOMPAT_COMPRESS));
+  fprintf(out, "compress.clusters %" PRIu64 "\n", ev[SFUSE_EV_COMPRESS]);
+  fprintf(out, "compress.raw_clusters %" PRIu64 "\n",
+          ev[SFUSE_EV_COMPRESS_RAW]);
+  fprintf(out, "compress.saved_blocks %" PRIu64 "\n",
+          ev[SFUSE_EV_COMPRESS_SAVED]);
+  fprintf(out, "dedup.enabled %d\n", dedup_enabled());
+  fprintf(out, "dedup.refcount %d\n",
+          !!(sb->feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_REFCOUNT));
+  fprintf(out, "dedup.hits %" PRIu64 "\n", ev[SFUSE_EV_DEDUP_HIT]);
+  fprintf(out, "dedup.misses %" PRIu64 "\n", ev[SFUSE_EV_DEDUP_MISS]);
+  fprintf(out, "dedup.cow %" PRIu64 "\n", ev[SFUSE_EV_DEDUP_COW]);
+  fprintf(out, "snapshot.exists %d\n",
+          !!(sb->feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_SNAPSHOT));
+  fprintf(out, "snapshot.active %d\n", snap_active());
+  fprintf(out, "snapshot.time %lld\n", (long long)sb->snap_time);
+  fprintf(out, "snapshot.blocks %" PRIu64 "\n", snap_blocks());
+  fprintf(out, "snapshot.copies %" PRIu64 "\n", ev[SFUSE_EV_SNAP_COPY]);
+  uint32_t cursor;
+  fprintf(out, "defrag.running %d\n", defrag_running(fs, &cursor));
+  fprintf(out, "defrag.cursor_ino %u\n", cursor);
+  fprintf(out, "defrag.files %" PRIu64 "\n", ev[SFUSE_EV_DEFRAG_FILES]);
+  fprintf(out, "defrag.blocks %" PRIu64 "\n", ev[SFUSE_EV_DEFRAG_BLOCKS]);
+
+  uint64_t fuse_inflight = 0;
+  for (int op = 0; op < SFUSE_OP_DISK_READ; op++)
+    fuse_inflight += snap.op[op].inflight;
+  fprintf(out, "queue.fuse_inflight %" PRIu64 "\n", fuse_inflight);
+  fprintf(out, "queue.disk_inflight %" PRIu64 "\n",
+          snap.op[SFUSE_OP_DISK_READ].inflight +
+              snap.op[SFUSE_OP_DISK_WRITE].inflight);
+  fprintf(out, "queue.max_background %d\n", SFUSE_MAX_BACKGROUND);
+
+  /* [6단계] 연산별 지연 시간 */
+  for (int op = 0; op < SFUSE_OP_COUNT; op++)
+    ctl_print_op(out, stats_op_name(op), &snap.op[op]);
+  pthread_mutex_unlock(&snap_lock);
+}
+
+/**
+ * @brief 가상 파일을 연다.
+ */
+int ctl_open(struct sfuse_fs *fs, enum sfuse_ctl_node node,
+             struct fuse_file_info *fi) {
+  int accmode = fi->flags & O_ACCMODE;
+
+  switch (node) {
+  case SFUSE_CTL_ROOT:
+    return -EISDIR;
+  case SFUSE_CTL_CONTROL: {
+    // 마운트한 사용자와 root만 제어 명령을 보낼 수 있음
+    uid_t uid = fuse_get_context()->uid;
+    if (accmode == O_RDONLY || (uid != 0 && uid != getuid()))
+      return -EACCES;
+    fi->fh = 0;
+    fi->direct_io = 1;
+    return 0;
+  }
+  case SFUSE_CTL_STATS:
+    break;
+  default:
+    return -ENOENT;
+  }
+
+  if (accmode != O_RDONLY)
+    return -EACCES;
+
+  char *text = NULL;
+  size_t len = 0;
+  FILE *out = open_memstream(&text, &len);
+  if (!out)
+    return -ENOMEM;
+  ctl_render_stats(fs, out);
+  if (fclose(out) != 0) {
+    free(text);
+    return -ENOMEM;
+  }
+
+  struct ctl_text *t = malloc(sizeof(*t) + len);
+  if (!t) {
+    free(text);
+    return -ENOMEM;
+  }
+  t->len = len;
+  memcpy(t->data, text, len);
+  free(text);
+
+  fi->fh = (uint64_t)(uintptr_t)t;
+  // 크기가 0으로 보이는 파일을 끝까지 읽고, 열 때마다 새 값을 보도록 함
+  fi->direct_io = 1;
+  return 0;
+}
+
+/**
+ * @brief 열 때 만든 통계 텍스트를 읽는다.
+ */
+int ctl_read(struct fuse_file_info *fi, char *buf, size_t size, off_t offset) {
+  const struct ctl_text *t = (const struct ctl_text *)(uintptr_t)fi->fh;
+  if (!t || offset < 0 || (size_t)offset >= t->len)
+    return 0;
+  size_t n = t->len - (size_t)offset;
+  if (n > size)
+    n = size;
+  memcpy(buf, t->data + offset, n);
+  return (int)n;
+}
+
+/**
+ * @brief 명령 하나를 실행한다.
+ */
+static int ctl_command(struct sfuse_fs *fs, const char *cmd) {
+  if (!strcmp(cmd, "checkpoint"))
+    return fs_checkpoint(fs);
+
+  if (!strcmp(cmd, "drop_caches")) {
+    // 깨끗한 페이지만 버려지므로 먼저 모두 기록
+    int res = fs_checkpoint(fs);
+    if (res < 0)
+      return res;
+    compress_cache_drop();
+    fs_invalidate_ino(fs, 0); // 커널의 항목/속성/페이지 캐시도 버림
+    return -posix_fadvise(fs->backing_fd, 0, 0, POSIX_FADV_DONTNEED);
+  }
+
+  if (!strcmp(cmd, "snapshot"))
+    return snap_create(fs);
+
+  if (!strcmp(cmd, "snapshot_delete"))
+    return snap_delete(fs);
+
+  if (!strcmp(cmd, "defrag"))
+    return defrag_start(fs);
+
+  if (!strcmp(cmd, "defrag_stop")) {
+    defrag_stop(fs);
+    return 0;
+  }
+
+  if (!strcmp(cmd, "reset")) {
+    pthread_mutex_lock(&ctl_lock);
+    stats_snapshot(&ctl_base);
+    ctl_base_ns = stats_now();
+    pthread_mutex_unlock(&ctl_lock);
+    // 새 측정이 커널에 남은 캐시의 영향을 받지 않도록 함
+    fs_invalidate_ino(fs, 0);
+    return 0;
+  }
+
+  return -EINVAL;
+}
+
+/**
+ * @brief control에 쓴 명령을 실행한다.
+ */
+int ctl_write(struct sfuse_fs *fs, const char *buf, size_t size) {
+  char *text = strndup(buf, size);
+  if (!text)
+    return -ENOMEM;
+
+  int res = 0;
+  char *save = NULL;
+  for (char *cmd = strtok_r(text, " \t\r\n", &save); cmd && res == 0;
+       cmd = strtok_r(NULL, " \t\r\n", &save))
+    res = ctl_command(fs, cmd);
+  free(text);
+  return res < 0 ? res : (int)size;
+}
+
+/**
+ * @brief 가상 파일을 닫고 열 때 만든 텍스트를 해제한다.
+ */
+void ctl_release(struct fuse_file_info *fi) {
+  free((void *)(uintptr_t)fi->fh);
+  fi->fh = 0;
+}
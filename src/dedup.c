@@ -0,0 +1,497 @@
+/**
+ * @file src/dedup.c
+ * @brief 데이터 블록 중복 제거(참조 수 테이블과 지문 색인) 구현
+ *
+ * 참조 수 테이블과 지문 색인은 블록 단위로 처음 쓸 때 읽어 메모리에 둔다.
+ * 참조 수 블록은 장치에 기록된 내용(disk)과 현재 값(mem)을 따로 보관한다.
+ * 참조를 늘리면 두 값을 함께 바꿔 곧바로 기록하고, 줄이거나 색인 표시를 바꾸면
+ * mem만 바꿔 두었다가 dedup_sync()에서 disk로 옮겨 기록한다. 덕분에 장치의
+ * 참조 수는 언제나 메모리의 값 이상이다.
+ *
+ * 지문은 외부 라이브러리 없이 동작하도록 직접 구현한 XXH64이다.
+ */
+
+#include "dedup.h"
+#include "bitmap.h"
+#include "block.h"
+#include "stats.h"
+#include <endian.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** @brief XXH64 상수 */
+#define XXH_PRIME1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME3 0x165667B19E3779F9ULL
+#define XXH_PRIME4 0x85EBCA77C2B2AE63ULL
+
+/**
+ * @struct dedup_page
+ * @brief 메모리에 올린 테이블 블록 하나
+ */
+struct dedup_page {
+  uint8_t *mem;  /**< 현재 내용 (NULL이면 아직 읽지 않음) */
+  uint8_t *disk; /**< 장치에 기록된 내용 (참조 수 테이블만 사용) */
+  bool dirty;    /**< mem이 장치와 다름 */
+};
+
+/**
+ * @struct dedup_state
+ * @brief 중복 제거 모듈의 전역 상태
+ */
+static struct dedup_state {
+  pthread_mutex_t lock;    /**< 테이블 보호용 잠금 */
+  pthread_mutex_t wlock[SFUSE_DEDUP_LOCKS]; /**< 블록별 제자리 쓰기 잠금 */
+  bool active;             /**< 참조 수 테이블 사용 중 (REFCOUNT 기능) */
+  bool enabled;            /**< 새 블록의 중복 제거 (-o dedup) */
+  int fd;                  /**< 디바이스 파일 디스크립터 */
+  uint64_t data_start;     /**< 데이터 영역 시작 블록 번호 */
+  uint64_t data_blocks;    /**< 데이터 블록 수 */
+  uint64_t rc_start;       /**< 참조 수 테이블 시작 블록 번호 */
+  uint32_t rc_blocks;      /**< 참조 수 테이블 블록 수 */
+  uint32_t idx_blocks;     /**< 지문 색인 블록 수 (참조 수 테이블 바로 뒤) */
+  struct dedup_page *rc;   /**< 참조 수 테이블 블록 */
+  struct dedup_page *idx;  /**< 지문 색인 블록 */
+} dd = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static uint64_t xxh_read64(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return le64toh(v);
+}
+
+static uint64_t xxh_rotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t xxh_round(uint64_t acc, uint64_t input) {
+  acc += input * XXH_PRIME2;
+  acc = xxh_rotl(acc, 31);
+  return acc * XXH_PRIME1;
+}
+
+static uint64_t xxh_merge(uint64_t acc, uint64_t val) {
+  acc ^= xxh_round(0, val);
+  return acc * XXH_PRIME1 + XXH_PRIME4;
+}
+
+uint64_t dedup_fingerprint(const void *block) {
+  // 블록 크기는 32의 배수이므로 남는 꼬리 입력이 없다.
+  const uint8_t *p = block;
+  const uint8_t *end = p + SFUSE_BLOCK_SIZE;
+  uint64_t v1 = XXH_PRIME1 + XXH_PRIME2, v2 = XXH_PRIME2, v3 = 0,
+           v4 = -XXH_PRIME1;
+  for (; p < end; p += 32) {
+    v1 = xxh_round(v1, xxh_read64(p));
+    v2 = xxh_round(v2, xxh_read64(p + 8));
+    v3 = xxh_round(v3, xxh_read64(p + 16));
+    v4 = xxh_round(v4, xxh_read64(p + 24));
+  }
+  uint64_t h = xxh_rotl(v1, 1) + xxh_rotl(v2, 7) + xxh_rotl(v3, 12) +
+               xxh_rotl(v4, 18);
+  h = xxh_merge(h, v1);
+  h = xxh_merge(h, v2);
+  h = xxh_merge(h, v3);
+  h = xxh_merge(h, v4);
+  h += SFUSE_BLOCK_SIZE;
+
+  h ^= h >> 33;
+  h *= XXH_PRIME2;
+  h ^= h >> 29;
+  h *= XXH_PRIME3;
+  h ^= h >> 32;
+  return h;
+}
+
+/**
+ * @brief 테이블 블록을 메모리에 올린다. (dd.lock 보유 상태)
+ *
+ * @param blk  장치 블록 번호
+ * @param twin 1이면 장치 내용 사본(disk)도 보관
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ */
+static int page_load(struct dedup_page *pg, uint64_t blk, bool twin) {
+  if (pg->mem)
+    return 0;
+  uint8_t *buf = malloc(twin ? 2 * SFUSE_BLOCK_SIZE : SFUSE_BLOCK_SIZE);
+  if (!buf)
+    return -ENOMEM;
+  int res = read_block(dd.fd, blk, buf);
+  if (res < 0) {
+    free(buf);
+    fprintf(stderr,
+            "[SFUSE] 중복 제거 테이블 블록 %" PRIu64 " 읽기 실패 (%d)\n", blk,
+            res);
+    return res;
+  }
+  if (twin) {
+    pg->disk = buf + SFUSE_BLOCK_SIZE;
+    memcpy(pg->disk, buf, SFUSE_BLOCK_SIZE);
+  }
+  pg->mem = buf;
+  return 0;
+}
+
+/**
+ * @brief 데이터 블록의 참조 수 항목을 찾는다. (dd.lock 보유 상태)
+ *
+ * @param pg  항목이 든 테이블 블록을 받을 포인터
+ * @param off 블록 안의 바이트 오프셋을 받을 포인터
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ *         -ERANGE: 데이터 영역 밖의 블록 번호
+ */
+static int rc_locate(uint64_t pbn, struct dedup_page **pg, size_t *off) {
+  if (pbn < dd.data_start || pbn - dd.data_start >= dd.data_blocks)
+    return -ERANGE;
+  uint64_t i = pbn - dd.data_start;
+  *pg = &dd.rc[i / SFUSE_REFCOUNT_PER_BLOCK];
+  *off = (size_t)(i % SFUSE_REFCOUNT_PER_BLOCK) * 2;
+  return page_load(*pg, dd.rc_start + i / SFUSE_REFCOUNT_PER_BLOCK, true);
+}
+
+static uint16_t rc_get(const uint8_t *p) {
+  uint16_t v;
+  memcpy(&v, p, sizeof(v));
+  return le16toh(v);
+}
+
+static void rc_put(uint8_t *p, uint16_t v) {
+  v = htole16(v);
+  memcpy(p, &v, sizeof(v));
+}
+
+/**
+ * @brief 지문이 놓이는 색인 집합을 찾는다. (dd.lock 보유 상태)
+ *
+ * @return 집합 첫 항목의 주소 (SFUSE_DEDUP_WAYS개 항목), 색인 블록을 읽지
+ *         못하면 NULL
+ */
+static uint8_t *idx_set(uint64_t fp, struct dedup_page **pg) {
+  const uint64_t per_block = SFUSE_DEDUP_ENTRIES_PER_BLOCK / SFUSE_DEDUP_WAYS;
+  uint64_t set = fp % ((uint64_t)dd.idx_blocks * per_block);
+  uint64_t b = set / per_block;
+  *pg = &dd.idx[b];
+  if (page_load(*pg, dd.rc_start + dd.rc_blocks + b, false) < 0)
+    return NULL;
+  return (*pg)->mem + (set % per_block) * SFUSE_DEDUP_WAYS * 16;
+}
+
+/**
+ * @brief 블록이 색인에 오른 일반 파일 데이터 블록인지 확인한다.
+ *        (dd.lock 보유 상태)
+ */
+static bool rc_indexed(uint64_t pbn) {
+  struct dedup_page *pg;
+  size_t off;
+  return rc_locate(pbn, &pg, &off) == 0 &&
+         (rc_get(pg->mem + off) & SFUSE_REFCOUNT_INDEXED);
+}
+
+static pthread_mutex_t *wlock_of(uint64_t pbn) {
+  return &dd.wlock[pbn % SFUSE_DEDUP_LOCKS];
+}
+
+/**
+ * @brief 참조 수 테이블과 지문 색인 구간을 할당하고 슈퍼블록에 기록한다.
+ */
+static int dedup_format(int fd, struct sfuse_super *sb, uint8_t *block_map) {
+  uint64_t data_blocks = sb->blocks_count - sb->data_block_start;
+  uint64_t rc_blocks = (data_blocks + SFUSE_REFCOUNT_PER_BLOCK - 1) /
+                       SFUSE_REFCOUNT_PER_BLOCK;
+  const uint64_t per_idx =
+      (uint64_t)SFUSE_DEDUP_ENTRIES_PER_BLOCK * SFUSE_DEDUP_BLOCKS_PER_ENTRY;
+  uint64_t idx_blocks = (data_blocks + per_idx - 1) / per_idx;
+  if (idx_blocks > SFUSE_DEDUP_MAX_INDEX_BLOCKS)
+    idx_blocks = SFUSE_DEDUP_MAX_INDEX_BLOCKS;
+  uint64_t total = rc_blocks + idx_blocks;
+
+  /* [1단계] 연속 구간 할당 */
+  uint64_t got;
+  int64_t start = alloc_block_run(sb, block_map, total, &got);
+  if (start < 0)
+    return -ENOSPC;
+  if (got < total) {
+    for (uint64_t i = 0; i < got; i++)
+      free_block(sb, block_map, (uint64_t)start + i);
+    return -ENOSPC;
+  }
+
+  /* [2단계] 구간을 0으로 채움 */
+  uint8_t zero[SFUSE_BLOCK_SIZE] = {0};
+  uint64_t first = sb->data_block_start + (uint64_t)start;
+  for (uint64_t i = 0; i < total; i++) {
+    if (write_block(fd, first + i, zero) < 0) {
+      for (uint64_t j = 0; j < total; j++)
+        free_block(sb, block_map, (uint64_t)start + j);
+      return -EIO;
+    }
+  }
+
+  /* [3단계] 비트맵을 먼저 기록한 뒤 슈퍼블록에 구간과 기능을 표시 */
+  int res = bitmap_sync(fd, sb->block_bitmap_start, block_map,
+                        sb->blocks_count / 8);
+  if (res < 0)
+    return res;
+  sb->refcount_start = first;
+  sb->refcount_blocks = (uint32_t)rc_blocks;
+  sb->dedup_index_blocks = (uint32_t)idx_blocks;
+  sb->feature_ro_compat |= SFUSE_FEATURE_RO_COMPAT_REFCOUNT;
+  return sb_sync(fd, sb);
+}
+
+int dedup_init(int fd, struct sfuse_super *sb, uint8_t *block_map,
+               bool enable) {
+  if (!(sb->feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_REFCOUNT)) {
+    if (!enable)
+      return 0;
+    int res = dedup_format(fd, sb, block_map);
+    if (res < 0) {
+      fprintf(stderr, "[SFUSE] 중복 제거 테이블을 만들 수 없습니다 (%d)\n",
+              res);
+      return res;
+    }
+  }
+
+  dd.rc = calloc(sb->refcount_blocks, sizeof(*dd.rc));
+  dd.idx = calloc(sb->dedup_index_blocks, sizeof(*dd.idx));
+  if (!dd.rc || !dd.idx) {
+    free(dd.rc);
+    free(dd.idx);
+    dd.rc = dd.idx = NULL;
+    return -ENOMEM;
+  }
+  for (int i = 0; i < SFUSE_DEDUP_LOCKS; i++)
+    pthread_mutex_init(&dd.wlock[i], NULL);
+  dd.fd = fd;
+  dd.data_start = sb->data_block_start;
+  dd.data_blocks = sb->blocks_count - sb->data_block_start;
+  dd.rc_start = sb->refcount_start;
+  dd.rc_blocks = sb->refcount_blocks;
+  dd.idx_blocks = sb->dedup_index_blocks;
+  dd.enabled = enable;
+  dd.active = true;
+  return 0;
+}
+
+/**
+ * @brief 바뀐 테이블 블록을 기록한다. (dd.lock 보유 상태)
+ */
+static int dedup_sync_locked(int fd) {
+  int res = 0;
+  for (uint32_t i = 0; i < dd.rc_blocks; i++) {
+    struct dedup_page *pg = &dd.rc[i];
+    if (!pg->dirty)
+      continue;
+    memcpy(pg->disk, pg->mem, SFUSE_BLOCK_SIZE);
+    if (write_block(fd, dd.rc_start + i, pg->disk) < 0)
+      res = -EIO;
+    else
+      pg->dirty = false;
+  }
+  for (uint32_t i = 0; i < dd.idx_blocks; i++) {
+    struct dedup_page *pg = &dd.idx[i];
+    if (!pg->dirty)
+      continue;
+    if (write_block(fd, dd.rc_start + dd.rc_blocks + i, pg->mem) < 0)
+      res = -EIO;
+    else
+      pg->dirty = false;
+  }
+  return res;
+}
+
+int dedup_sync(int fd) {
+  if (!dd.active)
+    return 0;
+  pthread_mutex_lock(&dd.lock);
+  int res = dedup_sync_locked(fd);
+  pthread_mutex_unlock(&dd.lock);
+  return res;
+}
+
+void dedup_destroy(int fd) {
+  if (!dd.active)
+    return;
+  pthread_mutex_lock(&dd.lock);
+  if (dedup_sync_locked(fd) < 0)
+    fprintf(stderr, "[SFUSE] 중복 제거 테이블 기록 실패\n");
+  for (uint32_t i = 0; i < dd.rc_blocks; i++)
+    free(dd.rc[i].mem);
+  for (uint32_t i = 0; i < dd.idx_blocks; i++)
+    free(dd.idx[i].mem);
+  free(dd.rc);
+  free(dd.idx);
+  dd.rc = dd.idx = NULL;
+  dd.active = dd.enabled = false;
+  pthread_mutex_unlock(&dd.lock);
+  for (int i = 0; i < SFUSE_DEDUP_LOCKS; i++)
+    pthread_mutex_destroy(&dd.wlock[i]);
+}
+
+bool dedup_enabled(void) { return dd.enabled; }
+
+int dedup_lookup(int fd, uint64_t fp, const void *block, uint64_t *pbn) {
+  if (!dd.enabled)
+    return 0;
+
+  /* [1단계] 색인에서 후보 블록을 찾음 (색인에 오른 블록만) */
+  pthread_mutex_lock(&dd.lock);
+  struct dedup_page *pg;
+  uint8_t *e = idx_set(fp, &pg);
+  uint64_t cand = 0;
+  for (int w = 0; e && w < SFUSE_DEDUP_WAYS && cand == 0; w++, e += 16)
+    if (xxh_read64(e) == fp && rc_indexed(xxh_read64(e + 8)))
+      cand = xxh_read64(e + 8);
+  pthread_mutex_unlock(&dd.lock);
+  if (cand == 0) {
+    stats_event(SFUSE_EV_DEDUP_MISS, 1);
+    return 0;
+  }
+
+  /* [2단계] 제자리 쓰기를 막은 채 내용을 비교하고 참조를 늘려 기록 */
+  uint8_t buf[SFUSE_BLOCK_SIZE];
+  int found = 0;
+  size_t off;
+  pthread_mutex_lock(wlock_of(cand));
+  if (read_block(fd, cand, buf) == 0 &&
+      memcmp(buf, block, SFUSE_BLOCK_SIZE) == 0) {
+    pthread_mutex_lock(&dd.lock);
+    uint16_t v;
+    if (rc_locate(cand, &pg, &off) == 0 &&
+        ((v = rc_get(pg->mem + off)) & SFUSE_REFCOUNT_INDEXED) &&
+        (v & SFUSE_REFCOUNT_MASK) < SFUSE_REFCOUNT_MASK) {
+      uint16_t d = rc_get(pg->disk + off);
+      rc_put(pg->disk + off, d + 1);
+      if (write_block(fd, dd.rc_start + (cand - dd.data_start) /
+                                            SFUSE_REFCOUNT_PER_BLOCK,
+                      pg->disk) == 0) {
+        rc_put(pg->mem + off, v + 1);
+        found = 1;
+      } else {
+        rc_put(pg->disk + off, d);
+      }
+    }
+    pthread_mutex_unlock(&dd.lock);
+  }
+  pthread_mutex_unlock(wlock_of(cand));
+
+  stats_event(found ? SFUSE_EV_DEDUP_HIT : SFUSE_EV_DEDUP_MISS, 1);
+  if (found)
+    *pbn = cand;
+  return found;
+}
+
+int dedup_share(int fd, uint64_t pbn) {
+  if (!dd.active)
+    return 0;
+
+  // 제자리 쓰기를 막은 채 참조를 늘려 기록 (장치에 먼저 기록해야 충돌 후에도
+  // 참조 수가 실제보다 작아지지 않음)
+  int res = 0;
+  pthread_mutex_lock(wlock_of(pbn));
+  pthread_mutex_lock(&dd.lock);
+  struct dedup_page *pg;
+  size_t off;
+  uint16_t v;
+  int loc = rc_locate(pbn, &pg, &off);
+  if (loc < 0 && loc != -ERANGE) {
+    res = loc;
+  } else if (loc == 0 &&
+             ((v = rc_get(pg->mem + off)) & SFUSE_REFCOUNT_MASK) <
+                 SFUSE_REFCOUNT_MASK) {
+    uint16_t d = rc_get(pg->disk + off);
+    rc_put(pg->disk + off, d + 1);
+    if (write_block(fd, dd.rc_start + (pbn - dd.data_start) /
+                                          SFUSE_REFCOUNT_PER_BLOCK,
+                    pg->disk) == 0) {
+      rc_put(pg->mem + off, v + 1);
+      res = 1;
+    } else {
+      rc_put(pg->disk + off, d);
+      res = -EIO;
+    }
+  }
+  pthread_mutex_unlock(&dd.lock);
+  pthread_mutex_unlock(wlock_of(pbn));
+  return res;
+}
+
+void dedup_insert(uint64_t fp, uint64_t pbn) {
+  if (!dd.enabled)
+    return;
+  pthread_mutex_lock(&dd.lock);
+  struct dedup_page *ipg, *rpg;
+  size_t off;
+  uint8_t *set = idx_set(fp, &ipg);
+  if (set && rc_locate(pbn, &rpg, &off) == 0) {
+    uint16_t v = rc_get(rpg->mem + off);
+    rc_put(rpg->mem + off, v | SFUSE_REFCOUNT_INDEXED);
+    rpg->dirty = true;
+
+    // 같은 지문, 빈 항목, 해제된 블록의 항목 순으로 자리를 고르고, 모두
+    // 쓰이고 있으면 지문으로 정한 항목을 덮어씀
+    int victim = -1;
+    for (int w = 0; w < SFUSE_DEDUP_WAYS && victim < 0; w++)
+      if (xxh_read64(set + w * 16) == fp)
+        victim = w;
+    for (int w = 0; w < SFUSE_DEDUP_WAYS && victim < 0; w++) {
+      uint64_t old = xxh_read64(set + w * 16 + 8);
+      if (old == 0 || !rc_indexed(old))
+        victim = w;
+    }
+    if (victim < 0)
+      victim = (int)((fp >> 32) % SFUSE_DEDUP_WAYS);
+
+    uint64_t ent[2] = {htole64(fp), htole64(pbn)};
+    memcpy(set + victim * 16, ent, sizeof(ent));
+    ipg->dirty = true;
+  }
+  pthread_mutex_unlock(&dd.lock);
+}
+
+bool dedup_release(uint64_t pbn) {
+  if (!dd.active)
+    return false;
+  pthread_mutex_lock(&dd.lock);
+  struct dedup_page *pg;
+  size_t off;
+  int res = rc_locate(pbn, &pg, &off);
+  bool shared = res < 0 && res != -ERANGE; // 읽지 못하면 해제하지 않음
+  if (res == 0) {
+    uint16_t v = rc_get(pg->mem + off);
+    if (v & SFUSE_REFCOUNT_MASK) {
+      rc_put(pg->mem + off, v - 1);
+      shared = true;
+    } else {
+      // 마지막 참조: 해제되는 블록이 다시 공유되지 않도록 색인 표시를 지움
+      rc_put(pg->mem + off, 0);
+    }
+    pg->dirty |= v != 0;
+  }
+  pthread_mutex_unlock(&dd.lock);
+  return shared;
+}
+
+bool dedup_write_begin(uint64_t pbn) {
+  if (!dd.active)
+    return false;
+  pthread_mutex_lock(wlock_of(pbn));
+  pthread_mutex_lock(&dd.lock);
+  struct dedup_page *pg;
+  size_t off;
+  int res = rc_locate(pbn, &pg, &off);
+  // 참조 수를 읽지 못하면 공유 중으로 보고 복사해 기록
+  bool shared = res == 0 ? (rc_get(pg->mem + off) & SFUSE_REFCOUNT_MASK) != 0
+                         : res != -ERANGE;
+  pthread_mutex_unlock(&dd.lock);
+  return shared;
+}
+
+void dedup_write_end(uint64_t pbn) {
+  if (dd.active)
+    pthread_mutex_unlock(wlock_of(pbn));
+}
@@ -0,0 +1,596 @@
+/**
+ * @file src/defrag.c
+ * @brief 온라인 조각 모음(파일 재배치) 구현
+ *
+ * 재배치 스레드는 아이노드 번호 순으로 일반 파일의 블록 맵을 따라가며 옮길 수
+ * 있는 블록 수와 물리적으로 이어진 구간 수를 센다. 평균 구간이
+ * SFUSE_DEFRAG_MIN_EXTENT보다 짧은 파일은 남은 블록 수만큼의 연속 구간을 먼저
+ * 잡아 비트맵에 기록해 두고, 묶음 단위로 채워 나간다.
+ *
+ * 한 묶음은 아이노드의 재배치 잠금을 배타로 잡은 채로 처리하므로 그동안 같은
+ * 파일의 요청은 데이터와 블록 맵을 바꾸지 못한다. 지연 할당 기록과 공유 블록
+ * 찾기는 잠금과 관계없이 dalloc 잠금 아래에서 일어나므로, 블록 맵을 바꾸기
+ * 직전에 dalloc 잠금을 잡고 포인터가 복사한 그대로인지, 그사이 공유되지
+ * 않았는지 다시 확인한다.
+ */
+
+#include "defrag.h"
+#include "bitmap.h"
+#include "csum.h"
+#include "dedup.h"
+#include "disk.h"
+#include "fs.h"
+#include "inode.h"
+#include "stats.h"
+#include "super.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+/** @brief 아이노드별 재배치 잠금 (요청은 공유, 재배치와 지연 할당 기록은
+ *         배타). 언마운트의 마지막 기록도 사용하므로 한 번만 만들고 해제하지
+ *         않는다. */
+static pthread_rwlock_t defrag_locks[SFUSE_DEFRAG_LOCKS];
+static pthread_once_t defrag_locks_once = PTHREAD_ONCE_INIT;
+
+static void init_locks(void) {
+  for (int i = 0; i < SFUSE_DEFRAG_LOCKS; i++)
+    pthread_rwlock_init(&defrag_locks[i], NULL);
+}
+
+static pthread_rwlock_t *lock_of(uint32_t ino) {
+  pthread_once(&defrag_locks_once, init_locks);
+  return &defrag_locks[ino % SFUSE_DEFRAG_LOCKS];
+}
+
+void defrag_io_begin(uint32_t ino) { pthread_rwlock_rdlock(lock_of(ino)); }
+
+void defrag_io_end(uint32_t ino) { pthread_rwlock_unlock(lock_of(ino)); }
+
+bool defrag_io_lock(uint32_t ino, bool wait) {
+  if (wait)
+    return pthread_rwlock_wrlock(lock_of(ino)) == 0;
+  return pthread_rwlock_trywrlock(lock_of(ino)) == 0;
+}
+
+void defrag_io_lock_pair(uint32_t src, uint32_t dst) {
+  pthread_rwlock_t *s = lock_of(src), *d = lock_of(dst);
+  if (s == d) {
+    pthread_rwlock_wrlock(s);
+  } else if (s < d) {
+    pthread_rwlock_wrlock(s);
+    pthread_rwlock_rdlock(d);
+  } else {
+    pthread_rwlock_rdlock(d);
+    pthread_rwlock_wrlock(s);
+  }
+}
+
+void defrag_io_end_pair(uint32_t src, uint32_t dst) {
+  pthread_rwlock_t *s = lock_of(src), *d = lock_of(dst);
+  if (s != d)
+    pthread_rwlock_unlock(d);
+  pthread_rwlock_unlock(s);
+}
+
+void defrag_io_freeze(void) {
+  pthread_once(&defrag_locks_once, init_locks);
+  for (int i = 0; i < SFUSE_DEFRAG_LOCKS; i++)
+    pthread_rwlock_wrlock(&defrag_locks[i]);
+}
+
+void defrag_io_thaw(void) {
+  for (int i = SFUSE_DEFRAG_LOCKS; i-- > 0;)
+    pthread_rwlock_unlock(&defrag_locks[i]);
+}
+
+/**
+ * @struct defrag_ctx
+ * @brief 재배치 스레드의 작업 버퍼
+ */
+struct defrag_ctx {
+  uint8_t *buf;                            /**< 묶음의 데이터 */
+  uint64_t ptrs[SFUSE_ADDR_PER_BLOCK];     /**< 블록 맵 leaf */
+  uint64_t lbn[SFUSE_DEFRAG_BATCH_BLOCKS]; /**< 묶음의 논리 블록 번호 */
+  uint64_t old[SFUSE_DEFRAG_BATCH_BLOCKS]; /**< 묶음의 원래 물리 블록 번호 */
+  struct sfuse_stats_snapshot *st;         /**< 요청 수 확인용 통계 */
+  uint64_t io_seen; /**< 직전에 본 읽기/쓰기 요청 수 */
+  uint32_t files;   /**< 이번 훑기에서 옮긴 파일 수 */
+  uint64_t blocks;  /**< 이번 훑기에서 옮긴 블록 수 */
+};
+
+/**
+ * @brief ms만큼 쉰다.
+ *
+ * @return 종료나 중단 요청이 있으면 참
+ */
+static bool defrag_wait(struct sfuse_fs *fs, long ms) {
+  struct sfuse_defrag *d = &fs->defrag;
+  struct timespec until;
+  clock_gettime(CLOCK_REALTIME, &until);
+  until.tv_sec += ms / 1000;
+  until.tv_nsec += (ms % 1000) * 1000000L;
+  if (until.tv_nsec >= 1000000000L) {
+    until.tv_sec++;
+    until.tv_nsec -= 1000000000L;
+  }
+  pthread_mutex_lock(&d->lock);
+  if (!d->stop && !d->cancel)
+    pthread_cond_timedwait(&d->wake, &d->lock, &until);
+  bool quit = d->stop || d->cancel;
+  pthread_mutex_unlock(&d->lock);
+  return quit;
+}
+
+/**
+ * @brief 묶음 사이에 쉰다. 직전 묶음 이후 읽기/쓰기 요청이 있었으면 더 오래
+ *        쉰다.
+ *
+ * @return 종료나 중단 요청이 있으면 참
+ */
+static bool defrag_pause(struct sfuse_fs *fs, struct defrag_ctx *c) {
+  stats_snapshot(c->st);
+  const struct sfuse_op_stats *r = &c->st->op[SFUSE_OP_READ];
+  const struct sfuse_op_stats *w = &c->st->op[SFUSE_OP_WRITE];
+  uint64_t seen = r->count + w->count;
+  bool busy = seen != c->io_seen || r->inflight || w->inflight;
+  c->io_seen = seen;
+  return defrag_wait(fs, busy ? SFUSE_DEFRAG_BUSY_DELAY_MS
+                              : SFUSE_DEFRAG_BATCH_DELAY_MS);
+}
+
+/**
+ * @brief 아이노드의 재배치 잠금을 배타로 잡는다. 요청이 처리 중이면 기다리지
+ *        않고 쉬었다가 다시 시도한다.
+ *
+ * @return 잡았으면 0, SFUSE_DEFRAG_BUSY_RETRIES번 실패하면 -EBUSY, 종료나
+ *         중단 요청이 있으면 1
+ */
+static int defrag_lock(struct sfuse_fs *fs, uint32_t ino) {
+  for (int tries = 0;; tries++) {
+    if (defrag_io_lock(ino, false))
+      return 0;
+    if (tries == SFUSE_DEFRAG_BUSY_RETRIES)
+      return -EBUSY;
+    if (defrag_wait(fs, SFUSE_DEFRAG_BUSY_DELAY_MS))
+      return 1;
+  }
+}
+
+/**
+ * @brief 옮길 수 있는 파일인지 확인한다.
+ *
+ * 해제된 아이노드의 레코드는 비트맵으로, 고아와 만드는 중인 아이노드는 플래그와
+ * 링크 수로 거른다.
+ */
+static bool defrag_usable(struct sfuse_fs *fs, uint32_t ino,
+                          const struct sfuse_inode *inode) {
+  return (fs->inode_map[ino / 8] & (1 << (ino % 8))) &&
+         S_ISREG(inode->mode) && !inode_is_inline(inode) &&
+         !(inode->flags & SFUSE_INODE_FLAG_ORPHAN) && inode->links > 0;
+}
+
+/**
+ * @brief 제자리에서 옮길 수 있는 블록 포인터인지 확인한다.
+ *
+ * 구멍, 예약(unwritten) 블록, 압축 구간과 데이터 영역 밖을 가리키는 손상된
+ * 포인터는 옮기지 않는다.
+ */
+static bool defrag_movable(const struct sfuse_super *sb, uint64_t ptr) {
+  return ptr >= sb->data_block_start && ptr < sb->blocks_count;
+}
+
+/**
+ * @brief 중복 제거로 다른 파일과 공유하는 블록인지 확인한다.
+ */
+static bool defrag_shared(uint64_t pbn) {
+  bool shared = dedup_write_begin(pbn);
+  dedup_write_end(pbn);
+  return shared;
+}
+
+/**
+ * @brief 옮길 수 있는 블록 수와 물리적으로 이어진 구간 수를 센다.
+ *
+ * @param movable 옮길 수 있는 블록 수를 받을 포인터
+ * @param extents 구간 수를 받을 포인터
+ * @return 성공 시 0, 블록 맵을 읽지 못하면 음수 오류 코드
+ */
+static int defrag_measure(struct sfuse_fs *fs, struct defrag_ctx *c,
+                          const struct sfuse_inode *inode, uint64_t *movable,
+                          uint64_t *extents) {
+  uint64_t nblocks = (inode->size + SFUSE_BLOCK_SIZE - 1) / SFUSE_BLOCK_SIZE;
+  uint64_t prev = 0, lbn = 0;
+  *movable = *extents = 0;
+
+  while (lbn < nblocks) {
+    // 할당되지 않은 인다이렉트 하위 트리는 읽지 않고 건너뜀
+    int res = inode_seek_block(fs->backing_fd, inode, lbn, true, &lbn);
+    if (res == -ENXIO || (res == 0 && lbn >= nblocks))
+      break;
+    if (res < 0)
+      return res;
+    uint64_t base;
+    int n = inode_map_leaf(fs->backing_fd, inode, lbn, c->ptrs, &base);
+    if (n < 0)
+      return n;
+    for (uint64_t i = lbn - base; i < (uint64_t)n && base + i < nblocks; i++) {
+      uint64_t ptr = c->ptrs[i];
+      if (!defrag_movable(&fs->sb, ptr))
+        continue;
+      if (ptr != prev + 1)
+        (*extents)++;
+      (*movable)++;
+      prev = ptr;
+    }
+    lbn = base + (uint64_t)n;
+  }
+  return 0;
+}
+
+/**
+ * @brief 재배치할 연속 구간을 잡아 비트맵에 기록한다.
+ *
+ * 지연 할당 버퍼가 예약한 블록은 건드리지 않는다. want개를 잡지 못하면 찾은
+ * 가장 긴 구간을 잡되, SFUSE_DEFRAG_MIN_EXTENT보다 짧으면 옮겨도 나아지지
+ * 않으므로 반환한다.
+ *
+ * @param start 잡은 구간의 첫 블록 오프셋을 받을 포인터
+ * @param len   잡은 블록 수를 받을 포인터
+ * @return 성공 시 0, 충분한 구간이 없으면 -ENOSPC
+ */
+static int defrag_reserve(struct sfuse_fs *fs, uint64_t want, uint64_t *start,
+                          uint64_t *len) {
+  struct sfuse_dalloc *da = &fs->dalloc;
+  pthread_mutex_lock(&da->lock);
+  uint64_t keep = da->nblocks + SFUSE_DALLOC_META_SLACK;
+  uint64_t avail = fs->sb.free_blocks > keep ? fs->sb.free_blocks - keep : 0;
+  if (want > avail)
+    want = avail;
+  int64_t off = want ? alloc_block_run(&fs->sb, fs->block_map, want, len)
+                     : -ENOSPC;
+  pthread_mutex_unlock(&da->lock);
+  if (off < 0)
+    return -ENOSPC;
+
+  if (*len < want && *len < SFUSE_DEFRAG_MIN_EXTENT) {
+    for (uint64_t i = 0; i < *len; i++)
+      free_block(&fs->sb, fs->block_map, (uint64_t)off + i);
+    return -ENOSPC;
+  }
+  // 구간을 가리키는 포인터가 기록되기 전에 할당을 장치에 남김
+  int res = bitmap_sync(fs->backing_fd, fs->sb.block_bitmap_start,
+                        fs->block_map, fs->sb.blocks_count / 8);
+  if (res < 0) {
+    for (uint64_t i = 0; i < *len; i++)
+      free_block(&fs->sb, fs->block_map, (uint64_t)off + i);
+    return res;
+  }
+  *start = (uint64_t)off;
+  return 0;
+}
+
+/**
+ * @brief 한 묶음을 옮긴다. (아이노드의 재배치 잠금을 배타로 잡은 상태)
+ *
+ * *lbn 이후 첫 leaf에서 옮길 수 있는 블록을 최대 max개 모아, 잡아 둔 구간의
+ * dst부터 차례로 기록하고 블록 맵을 바꾼다.
+ *
+ * @param lbn    다음에 볼 논리 블록 번호 (본 만큼 앞으로 옮겨짐)
+ * @param dst    기록할 구간 위치 (데이터 영역 오프셋)
+ * @param max    구간에 남은 블록 수 (SFUSE_DEFRAG_BATCH_BLOCKS 이하)
+ * @param used   구간에서 쓴(옮겼거나 반환한) 블록 수를 받을 포인터
+ * @return 계속할 수 있으면 0, 파일 끝까지 봤으면 1, 실패 시 음수 오류 코드
+ *         (-ESTALE: 그사이 지워졌거나 옮길 수 없게 된 파일)
+ */
+static int defrag_batch(struct sfuse_fs *fs, struct defrag_ctx *c, uint32_t ino,
+                        uint64_t *lbn, uint64_t dst, uint64_t max,
+                        uint64_t *used) {
+  struct sfuse_super *sb = &fs->sb;
+  int fd = fs->backing_fd;
+  *used = 0;
+
+  /* [1단계] 아이노드를 다시 읽고 옮길 블록 모으기 */
+  struct sfuse_inode inode;
+  if (inode_load(fd, sb, ino, &inode) < 0 || !defrag_usable(fs, ino, &inode))
+    return -ESTALE;
+  uint64_t nblocks = (inode.size + SFUSE_BLOCK_SIZE - 1) / SFUSE_BLOCK_SIZE;
+  uint64_t next;
+  int res = *lbn < nblocks
+                ? inode_seek_block(fd, &inode, *lbn, true, &next)
+                : -ENXIO;
+  if (res == -ENXIO || (res == 0 && next >= nblocks))
+    return 1;
+  if (res < 0)
+    return res;
+  uint64_t base;
+  int n = inode_map_leaf(fd, &inode, next, c->ptrs, &base);
+  if (n < 0)
+    return n;
+  uint64_t k = 0, i = next - base;
+  for (; i < (uint64_t)n && base + i < nblocks && k < max; i++) {
+    uint64_t ptr = c->ptrs[i];
+    if (!defrag_movable(sb, ptr) || defrag_shared(ptr))
+      continue;
+    c->lbn[k] = base + i;
+    c->old[k] = ptr;
+    k++;
+  }
+  *lbn = base + i;
+  if (k == 0)
+    return 0;
+
+  /* [2단계] 원래 블록을 읽어 새 구간에 기록 (이어진 블록은 모아 읽음) */
+  for (uint64_t j = 0; j < k;) {
+    uint64_t run = 1;
+    while (j + run < k && c->old[j + run] == c->old[j] + run)
+      run++;
+    uint8_t *p = c->buf + j * SFUSE_BLOCK_SIZE;
+    size_t bytes = (size_t)run * SFUSE_BLOCK_SIZE;
+    if (disk_read(fd, p, bytes, (off_t)c->old[j] * SFUSE_BLOCK_SIZE) !=
+        (ssize_t)bytes)
+      return -EIO;
+    // 손상된 블록을 새 체크섬과 함께 옮기지 않음
+    if (csum_data_verify(c->old[j], p, run) < 0)
+      return -EIO;
+    j += run;
+  }
+  uint64_t pbn0 = sb->data_block_start + dst;
+  size_t bytes = (size_t)k * SFUSE_BLOCK_SIZE;
+  if (disk_write(fd, c->buf, bytes, (off_t)pbn0 * SFUSE_BLOCK_SIZE) !=
+      (ssize_t)bytes)
+    return -EIO;
+  csum_data_update(pbn0, c->buf, k);
+
+  /* [3단계] 지연 할당 기록과 공유를 막고 포인터가 그대로인 블록만 연결 */
+  struct sfuse_dalloc *da = &fs->dalloc;
+  pthread_mutex_lock(&da->lock);
+  bool linked[SFUSE_DEFRAG_BATCH_BLOCKS] = {false};
+  uint64_t moved = 0;
+  res = inode_load(fd, sb, ino, &inode);
+  if (res == 0)
+    res = inode_map_leaf(fd, &inode, c->lbn[0], c->ptrs, &base);
+  for (uint64_t j = 0; res >= 0 && j < k; j++) {
+    if (c->ptrs[c->lbn[j] - base] != c->old[j] || defrag_shared(c->old[j]))
+      continue;
+    res = inode_set_block(fd, sb, fs->block_map, &inode, c->lbn[j], pbn0 + j);
+    if (res == 0) {
+      linked[j] = true;
+      moved++;
+    }
+  }
+  if (moved > 0 && inode_sync(fd, sb, ino, &inode) < 0) {
+    // 새 포인터가 장치에 남았는지 알 수 없으므로 두 블록 모두 해제하지 않음
+    // (누수는 fsck.sfuse가 회수)
+    pthread_mutex_unlock(&da->lock);
+    *used = k;
+    return -EIO;
+  }
+
+  /* [4단계] 옮긴 블록의 원래 블록과 연결하지 못한 새 블록을 반환 */
+  bool index = dedup_enabled();
+  for (uint64_t j = 0; j < k; j++) {
+    if (!linked[j]) {
+      free_block(sb, fs->block_map, dst + j);
+      continue;
+    }
+    if (!dedup_release(c->old[j]))
+      free_block(sb, fs->block_map, c->old[j] - sb->data_block_start);
+    if (index)
+      dedup_insert(dedup_fingerprint(c->buf + j * SFUSE_BLOCK_SIZE), pbn0 + j);
+  }
+  pthread_mutex_unlock(&da->lock);
+
+  *used = k;
+  c->blocks += moved;
+  stats_event(SFUSE_EV_DEFRAG_BLOCKS, moved);
+  return res < 0 ? res : 0;
+}
+
+/**
+ * @brief 조각난 파일이면 연속 구간으로 옮긴다.
+ *
+ * @return 성공(옮길 필요가 없거나 건너뜀 포함) 시 0, 종료나 중단 요청이 있으면
+ *         1, 실패 시 음수 오류 코드
+ */
+static int defrag_file(struct sfuse_fs *fs, struct defrag_ctx *c,
+                       uint32_t ino) {
+  /* [1단계] 잠금 없이 블록 맵을 따라가 조각난 정도를 잼 */
+  struct sfuse_inode inode;
+  if (inode_load(fs->backing_fd, &fs->sb, ino, &inode) < 0 ||
+      !defrag_usable(fs, ino, &inode))
+    return 0;
+  uint64_t left, extents;
+  int res = defrag_measure(fs, c, &inode, &left, &extents);
+  if (res < 0 || extents < 2 || left / extents >= SFUSE_DEFRAG_MIN_EXTENT)
+    return res;
+
+  /* [2단계] 구간을 잡고 묶음 단위로 채움 */
+  uint64_t lbn = 0, start = 0, len = 0, used = 0, moved = c->blocks;
+  while (left > 0) {
+    if (used == len) {
+      res = defrag_reserve(fs, left, &start, &len);
+      used = 0;
+      if (res < 0) {
+        len = 0;
+        break;
+      }
+    }
+    res = defrag_lock(fs, ino);
+    if (res != 0)
+      break;
+    uint64_t max = len - used, got;
+    if (max > SFUSE_DEFRAG_BATCH_BLOCKS)
+      max = SFUSE_DEFRAG_BATCH_BLOCKS;
+    res = defrag_batch(fs, c, ino, &lbn, start + used, max, &got);
+    pthread_rwlock_unlock(lock_of(ino));
+    used += got;
+    left = got < left ? left - got : 0;
+    if (res == 1)
+      res = 0; // 파일 끝까지 봄
+    if (res != 0 || left == 0)
+      break;
+    if (defrag_pause(fs, c)) {
+      res = 1;
+      break;
+    }
+  }
+
+  /* [3단계] 남은 구간을 반환하고 해제한 블록을 장치에 반영 */
+  for (uint64_t i = used; i < len; i++)
+    free_block(&fs->sb, fs->block_map, start + i);
+  if (c->blocks > moved) {
+    c->files++;
+    stats_event(SFUSE_EV_DEFRAG_FILES, 1);
+  }
+  bitmap_sync(fs->backing_fd, fs->sb.block_bitmap_start, fs->block_map,
+              fs->sb.blocks_count / 8);
+  sb_sync(fs->backing_fd, &fs->sb);
+  // 블록 맵이 바뀌었으므로 커널이 캐시한 속성과 페이지를 버리게 함 (커널이
+  // 더티 페이지를 기록하러 올 수 있으므로 재배치 잠금을 놓은 뒤 호출)
+  if (c->blocks > moved)
+    fs_invalidate_ino(fs, ino);
+
+  // 그사이 지워졌거나, 요청이 계속 몰리거나, 공간이 모자란 파일은 건너뜀
+  if (res == -ESTALE || res == -EBUSY || res == -ENOSPC)
+    res = 0;
+  return res;
+}
+
+/**
+ * @brief 재배치 스레드: 요청이 오면 아이노드 테이블을 한 번 훑는다.
+ */
+static void *defrag_worker(void *arg) {
+  struct sfuse_fs *fs = arg;
+  struct sfuse_defrag *d = &fs->defrag;
+  struct defrag_ctx *c = calloc(1, sizeof(*c));
+  if (c) {
+    c->buf = malloc((size_t)SFUSE_DEFRAG_BATCH_BLOCKS * SFUSE_BLOCK_SIZE);
+    c->st = malloc(sizeof(*c->st));
+  }
+
+  pthread_mutex_lock(&d->lock);
+  while (!d->stop) {
+    if (!d->pending) {
+      pthread_cond_wait(&d->wake, &d->lock);
+      continue;
+    }
+    d->pending = d->cancel = false;
+    if (!c || !c->buf || !c->st) {
+      fprintf(stderr, "[SFUSE] 조각 모음 버퍼를 할당할 수 없습니다\n");
+      continue;
+    }
+    d->running = true;
+    pthread_mutex_unlock(&d->lock);
+
+    c->files = 0;
+    c->blocks = 0;
+    stats_snapshot(c->st);
+    c->io_seen =
+        c->st->op[SFUSE_OP_READ].count + c->st->op[SFUSE_OP_WRITE].count;
+    int res = 0;
+    for (uint32_t ino = 1; ino < fs->sb.inodes_count && res != 1; ino++) {
+      pthread_mutex_lock(&d->lock);
+      d->cursor = ino;
+      bool quit = d->stop || d->cancel;
+      pthread_mutex_unlock(&d->lock);
+      if (quit)
+        break;
+      if (!(fs->inode_map[ino / 8] & (1 << (ino % 8))))
+        continue;
+      res = defrag_file(fs, c, ino);
+      if (res < 0)
+        fprintf(stderr, "[SFUSE] 아이노드 %u 조각 모음 실패 (%d)\n", ino, res);
+      // 아이노드 테이블을 읽는 것도 요청과 겹치지 않도록 가끔 쉼
+      if (res == 0 && ino % SFUSE_DEFRAG_SCAN_INODES == 0 &&
+          defrag_pause(fs, c))
+        res = 1;
+    }
+    fprintf(stderr,
+            "[SFUSE] 조각 모음: 파일 %u개의 블록 %" PRIu64 "개를 옮겼습니다\n",
+            c->files, c->blocks);
+
+    pthread_mutex_lock(&d->lock);
+    d->running = false;
+  }
+  pthread_mutex_unlock(&d->lock);
+
+  if (c) {
+    free(c->buf);
+    free(c->st);
+    free(c);
+  }
+  return NULL;
+}
+
+void defrag_init(struct sfuse_fs *fs) {
+  struct sfuse_defrag *d = &fs->defrag;
+  pthread_mutex_init(&d->lock, NULL);
+  pthread_cond_init(&d->wake, NULL);
+  d->started = d->stop = d->pending = d->cancel = d->running = false;
+  d->cursor = 0;
+
+  // 스냅숏 마운트는 읽기 전용이므로 옮기지 않는다.
+  if (fs->opts.snapshot)
+    return;
+
+  int err = pthread_create(&d->thread, NULL, defrag_worker, fs);
+  if (err) {
+    fprintf(stderr, "[SFUSE] 조각 모음 스레드를 만들 수 없습니다 (%d)\n", err);
+    return;
+  }
+  d->started = true;
+}
+
+void defrag_destroy(struct sfuse_fs *fs) {
+  struct sfuse_defrag *d = &fs->defrag;
+  if (d->started) {
+    pthread_mutex_lock(&d->lock);
+    d->stop = true;
+    pthread_cond_signal(&d->wake);
+    pthread_mutex_unlock(&d->lock);
+    pthread_join(d->thread, NULL);
+    d->started = false;
+  }
+  pthread_cond_destroy(&d->wake);
+  pthread_mutex_destroy(&d->lock);
+}
+
+int defrag_start(struct sfuse_fs *fs) {
+  struct sfuse_defrag *d = &fs->defrag;
+  if (fs->opts.snapshot)
+    return -EROFS;
+  if (!d->started)
+    return -EAGAIN;
+  pthread_mutex_lock(&d->lock);
+  int res = d->running || d->pending ? -EBUSY : 0;
+  if (res == 0) {
+    d->pending = true;
+    pthread_cond_signal(&d->wake);
+  }
+  pthread_mutex_unlock(&d->lock);
+  return res;
+}
+
+void defrag_stop(struct sfuse_fs *fs) {
+  struct sfuse_defrag *d = &fs->defrag;
+  pthread_mutex_lock(&d->lock);
+  d->pending = false;
+  d->cancel = true;
+  pthread_cond_signal(&d->wake);
+  pthread_mutex_unlock(&d->lock);
+}
+
+bool defrag_running(struct sfuse_fs *fs, uint32_t *cursor) {
+  struct sfuse_defrag *d = &fs->defrag;
+  pthread_mutex_lock(&d->lock);
+  bool running = d->running || d->pending;
+  if (cursor)
+    *cursor = d->cursor;
+  pthread_mutex_unlock(&d->lock);
+  return running;
+}
@@ -0,0 +1,325 @@
+/**
+ * @file src/discard.c
+ * @brief 해제한 데이터 블록의 discard(TRIM) 묶음 처리 구현
+ *
+ * 구간은 세 목록을 차례로 거친다.
+ *   - pending: 해제되었지만 아직 커밋 대상으로 묶이지 않은 구간
+ *   - sealed : 진행 중인 장치 플러시에 포함된 구간
+ *   - queue  : 커밋이 끝나 장치에 알릴 구간 (정렬·병합됨)
+ * 백그라운드 스레드는 queue에서 구간을 하나씩 꺼내(busy) 잠금 없이 장치에
+ * 요청한다. 장치가 discard를 지원하지 않으면 이후로는 구간을 모으지 않는다.
+ */
+
+#define _GNU_SOURCE
+#include "discard.h"
+#include "stats.h"
+#include "super.h" // SFUSE_BLOCK_SIZE
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <linux/fs.h> // BLKDISCARD
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+/**
+ * @struct discard_extent
+ * @brief 연속된 블록 구간
+ */
+struct discard_extent {
+  uint64_t start; /**< 첫 블록 번호 (장치 기준) */
+  uint64_t len;   /**< 블록 수 */
+};
+
+/**
+ * @struct discard_list
+ * @brief 구간 배열
+ */
+struct discard_list {
+  struct discard_extent *v; /**< 구간 배열 */
+  size_t n;                 /**< 구간 수 */
+  size_t cap;               /**< 배열 용량 */
+};
+
+/**
+ * @struct discard_state
+ * @brief discard 처리 상태 (discard_lock으로 보호)
+ */
+static struct discard_state {
+  int fd;                      /**< 장치 파일 디스크립터 */
+  bool blkdev;                 /**< 블록 장치면 참 (BLKDISCARD 사용) */
+  bool started;                /**< 스레드가 실행 중인지 */
+  bool stop;                   /**< 스레드 종료 요청 */
+  _Atomic bool enabled;        /**< discard를 사용하는지 */
+  _Atomic bool held;           /**< 해제한 블록을 모으지 않음 (스냅숏) */
+  _Atomic size_t nextents;     /**< 모든 목록과 busy의 구간 수 */
+  pthread_t thread;            /**< 백그라운드 스레드 */
+  struct discard_list pending; /**< 커밋 대상으로 묶이지 않은 구간 */
+  struct discard_list sealed;  /**< 진행 중인 플러시에 포함된 구간 */
+  struct discard_list queue;   /**< 장치에 알릴 구간 */
+  struct discard_extent busy;  /**< 장치에 요청 중인 구간 (len 0이면 없음) */
+} dc;
+
+static pthread_mutex_t discard_lock = PTHREAD_MUTEX_INITIALIZER;
+/** @brief queue에 구간이 들어오거나 종료를 요청할 때 알림 */
+static pthread_cond_t discard_wake = PTHREAD_COND_INITIALIZER;
+/** @brief busy 구간의 요청이 끝날 때 알림 */
+static pthread_cond_t discard_idle = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief 구간 수를 다시 센다. (discard_lock을 잡은 상태에서 호출)
+ */
+static void discard_recount(void) {
+  atomic_store(&dc.nextents, dc.pending.n + dc.sealed.n + dc.queue.n +
+                                 (dc.busy.len ? 1 : 0));
+}
+
+/**
+ * @brief 목록 끝에 구간을 더한다. 마지막 구간과 이어지면 합친다.
+ *
+ * @return 성공 시 0, 목록이 가득 찼거나 메모리가 부족하면 -ENOMEM
+ */
+static int list_add(struct discard_list *l, uint64_t start, uint64_t len) {
+  if (l->n > 0 && l->v[l->n - 1].start + l->v[l->n - 1].len == start) {
+    l->v[l->n - 1].len += len;
+    return 0;
+  }
+  if (l->n == l->cap) {
+    if (l->cap >= SFUSE_DISCARD_MAX_EXTENTS)
+      return -ENOMEM;
+    size_t cap = l->cap ? l->cap * 2 : 64;
+    struct discard_extent *v = realloc(l->v, cap * sizeof(*v));
+    if (!v)
+      return -ENOMEM;
+    l->v = v;
+    l->cap = cap;
+  }
+  l->v[l->n++] = (struct discard_extent){start, len};
+  return 0;
+}
+
+/**
+ * @brief 목록에서 [start, start + len)과 겹치는 부분을 뺀다.
+ *
+ * 구간 가운데가 빠지면 뒷부분을 목록 끝에 새 구간으로 더한다.
+ */
+static void list_remove(struct discard_list *l, uint64_t start, uint64_t len) {
+  uint64_t end = start + len;
+  size_t n = l->n; // 이번에 새로 더한 뒷부분은 다시 보지 않음
+  for (size_t i = 0; i < n; i++) {
+    struct discard_extent *e = &l->v[i];
+    uint64_t e_end = e->start + e->len;
+    if (e->len == 0 || e_end <= start || e->start >= end)
+      continue;
+    if (e_end > end && e->start < start) {
+      // 가운데가 빠짐: 뒷부분을 따로 더함 (실패하면 뒷부분은 버림)
+      uint64_t tail = e_end - end;
+      e->len = start - e->start;
+      list_add(l, end, tail);
+      e = &l->v[i]; // list_add()가 배열을 옮겼을 수 있음
+    } else if (e->start < start) {
+      e->len = start - e->start;
+    } else if (e_end > end) {
+      e->len = e_end - end;
+      e->start = end;
+    } else {
+      e->len = 0;
+    }
+  }
+
+  // 빈 구간 제거
+  size_t k = 0;
+  for (size_t i = 0; i < l->n; i++)
+    if (l->v[i].len)
+      l->v[k++] = l->v[i];
+  l->n = k;
+}
+
+/**
+ * @brief qsort() 비교 함수: 시작 블록 순
+ */
+static int extent_cmp(const void *a, const void *b) {
+  const struct discard_extent *x = a, *y = b;
+  return (x->start > y->start) - (x->start < y->start);
+}
+
+/**
+ * @brief 목록을 정렬하고 겹치거나 이어지는 구간을 합친다.
+ */
+static void list_merge(struct discard_list *l) {
+  if (l->n < 2)
+    return;
+  qsort(l->v, l->n, sizeof(*l->v), extent_cmp);
+  size_t k = 0;
+  for (size_t i = 1; i < l->n; i++) {
+    struct discard_extent *last = &l->v[k];
+    if (l->v[i].start <= last->start + last->len) {
+      uint64_t end = l->v[i].start + l->v[i].len;
+      if (end > last->start + last->len)
+        last->len = end - last->start;
+    } else {
+      l->v[++k] = l->v[i];
+    }
+  }
+  l->n = k + 1;
+}
+
+/**
+ * @brief 목록 src의 구간을 모두 dst로 옮긴다.
+ */
+static void list_move(struct discard_list *dst, struct discard_list *src) {
+  for (size_t i = 0; i < src->n; i++)
+    if (list_add(dst, src->v[i].start, src->v[i].len) < 0)
+      break; // 넘치는 구간은 discard하지 않음
+  src->n = 0;
+}
+
+/**
+ * @brief 구간 하나를 장치에 알린다.
+ *
+ * @return 성공 시 0, 실패 시 음수 오류 코드 (ioctl()/fallocate()의 -errno)
+ */
+static int discard_issue(const struct discard_extent *e) {
+  uint64_t off = e->start * SFUSE_BLOCK_SIZE;
+  uint64_t len = e->len * SFUSE_BLOCK_SIZE;
+  int res;
+  if (dc.blkdev) {
+    uint64_t range[2] = {off, len};
+    res = ioctl(dc.fd, BLKDISCARD, range);
+  } else {
+    // 이미지 파일: 구멍을 뚫어 호스트 파일 시스템의 공간을 돌려줌
+    res = fallocate(dc.fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                    (off_t)off, (off_t)len);
+  }
+  if (res < 0)
+    return -errno;
+  stats_event(SFUSE_EV_DISCARD, 1);
+  stats_event(SFUSE_EV_DISCARD_BLKS, e->len);
+  return 0;
+}
+
+/**
+ * @brief 백그라운드 스레드: queue의 구간을 하나씩 장치에 알린다.
+ *
+ * 종료 요청을 받아도 queue가 빌 때까지는 계속 처리한다.
+ */
+static void *discard_worker(void *arg) {
+  (void)arg;
+  pthread_mutex_lock(&discard_lock);
+  for (;;) {
+    while (dc.queue.n == 0 && !dc.stop)
+      pthread_cond_wait(&discard_wake, &discard_lock);
+    if (dc.queue.n == 0)
+      break;
+
+    // 요청하는 동안 잠금을 풀어 할당이 막히지 않게 함
+    dc.busy = dc.queue.v[--dc.queue.n];
+    pthread_mutex_unlock(&discard_lock);
+    int res = discard_issue(&dc.busy);
+    pthread_mutex_lock(&discard_lock);
+
+    if (res == -EOPNOTSUPP || res == -ENOTTY || res == -EINVAL) {
+      // 장치가 discard를 지원하지 않음: 이후로는 모으지 않음
+      fprintf(stderr, "[SFUSE] 장치가 discard를 지원하지 않습니다 (%d)\n",
+              res);
+      atomic_store(&dc.enabled, false);
+      dc.pending.n = dc.sealed.n = dc.queue.n = 0;
+    } else if (res < 0) {
+      fprintf(stderr, "[SFUSE] 블록 %" PRIu64 "부터 %" PRIu64
+                      "개 discard 실패 (%d)\n",
+              dc.busy.start, dc.busy.len, res);
+    }
+    dc.busy.len = 0;
+    discard_recount();
+    pthread_cond_broadcast(&discard_idle);
+  }
+  pthread_mutex_unlock(&discard_lock);
+  return NULL;
+}
+
+int discard_init(int fd) {
+  struct stat st;
+  if (fstat(fd, &st) < 0)
+    return -errno;
+  if (!S_ISBLK(st.st_mode) && !S_ISREG(st.st_mode))
+    return 0; // discard 방법이 없음
+
+  memset(&dc, 0, sizeof(dc));
+  dc.fd = fd;
+  dc.blkdev = S_ISBLK(st.st_mode);
+  int err = pthread_create(&dc.thread, NULL, discard_worker, NULL);
+  if (err)
+    return -err;
+  dc.started = true;
+  atomic_store(&dc.enabled, true);
+  return 0;
+}
+
+void discard_destroy(void) {
+  if (dc.started) {
+    pthread_mutex_lock(&discard_lock);
+    dc.stop = true;
+    pthread_cond_broadcast(&discard_wake);
+    pthread_mutex_unlock(&discard_lock);
+    pthread_join(dc.thread, NULL);
+  }
+  free(dc.pending.v);
+  free(dc.sealed.v);
+  free(dc.queue.v);
+  memset(&dc, 0, sizeof(dc));
+}
+
+bool discard_enabled(void) { return atomic_load(&dc.enabled); }
+
+void discard_note(uint64_t blk, uint64_t len) {
+  if (!atomic_load_explicit(&dc.enabled, memory_order_relaxed) ||
+      atomic_load(&dc.held) || len == 0)
+    return;
+  pthread_mutex_lock(&discard_lock);
+  list_add(&dc.pending, blk, len); // 넘치면 discard를 생략
+  discard_recount();
+  pthread_mutex_unlock(&discard_lock);
+}
+
+void discard_hold(bool hold) { atomic_store(&dc.held, hold); }
+
+void discard_seal(void) {
+  if (!atomic_load_explicit(&dc.nextents, memory_order_relaxed))
+    return;
+  pthread_mutex_lock(&discard_lock);
+  list_move(&dc.sealed, &dc.pending);
+  discard_recount();
+  pthread_mutex_unlock(&discard_lock);
+}
+
+void discard_commit(void) {
+  if (!atomic_load_explicit(&dc.nextents, memory_order_relaxed))
+    return;
+  pthread_mutex_lock(&discard_lock);
+  if (dc.sealed.n > 0) {
+    list_move(&dc.queue, &dc.sealed);
+    list_merge(&dc.queue);
+    pthread_cond_signal(&discard_wake);
+  }
+  discard_recount();
+  pthread_mutex_unlock(&discard_lock);
+}
+
+void discard_claim(uint64_t blk, uint64_t len) {
+  // 대기 중인 구간이 없으면 잠금 없이 끝냄 (대부분의 할당)
+  if (!atomic_load_explicit(&dc.nextents, memory_order_acquire))
+    return;
+  pthread_mutex_lock(&discard_lock);
+  list_remove(&dc.pending, blk, len);
+  list_remove(&dc.sealed, blk, len);
+  list_remove(&dc.queue, blk, len);
+  while (dc.busy.len && dc.busy.start < blk + len &&
+         blk < dc.busy.start + dc.busy.len)
+    pthread_cond_wait(&discard_idle, &discard_lock);
+  discard_recount();
+  pthread_mutex_unlock(&discard_lock);
+}
@@ -10,15 +10,20 @@
  */
 
 #include "disk.h"
+#include "stats.h"
 #include <errno.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+/** @brief 등록된 장치 접근 함수 (NULL이면 pread/pwrite로 바로 접근) */
+static const struct disk_hooks *hooks;
+
 /**
  * @brief 원시 디바이스의 지정된 offset에서 데이터를 읽는다.
  *
- * 본 함수는 lseek를 통해 디스크 내 원하는 위치(offset)로 이동한 뒤, read를 통해
- * 데이터를 읽는다. offset은 파일의 시작 위치로부터 바이트 단위로 계산된다.
+ * 본 함수는 pread로 디스크 내 원하는 위치(offset)에서 데이터를 읽는다. offset은
+ * 파일의 시작 위치로부터 바이트 단위로 계산된다. 파일 포인터를 옮기지 않으므로
+ * 여러 스레드가 같은 디스크립터로 동시에 읽고 써도 된다.
  *
  * @param fd     디바이스 파일 디스크립터
  * @param buf    읽은 데이터를 저장할 버퍼 포인터
@@ -30,23 +35,25 @@
  * @note 반환된 바이트 수는 요청한 count 값보다 작을 수 있다.
  */
 ssize_t disk_read(int fd, void *buf, size_t count, off_t off) {
-  // 지정된 위치로 디스크 포인터 이동
-  if (lseek(fd, off, SEEK_SET) < 0)
-    return -errno; // lseek 실패 시 errno 반환
+  uint64_t t0 = stats_begin(SFUSE_OP_DISK_READ);
+  ssize_t ret;
 
-  // 데이터를 실제로 읽음
-  ssize_t ret = read(fd, buf, count);
-  if (ret < 0)
-    return -errno; // 읽기 실패 시 errno 반환
+  // 지정된 위치에서 데이터를 실제로 읽음 (스냅숏 마운트면 복사본에서)
+  if (hooks && hooks->read)
+    ret = hooks->read(fd, buf, count, off);
+  else if ((ret = pread(fd, buf, count, off)) < 0)
+    ret = -errno; // 읽기 실패 시 errno 반환
 
+  stats_record(SFUSE_OP_DISK_READ, t0, ret);
   return ret; // 읽기 성공 시 읽은 바이트 수 반환
 }
 
 /**
  * @brief 원시 디바이스의 지정된 offset에 데이터를 기록한다.
  *
- * 본 함수는 lseek를 통해 디스크 내 원하는 위치(offset)로 이동한 뒤, write를
- * 통해 데이터를 쓴다. offset은 파일의 시작 위치로부터 바이트 단위로 계산된다.
+ * 본 함수는 pwrite로 디스크 내 원하는 위치(offset)에 데이터를 쓴다. offset은
+ * 파일의 시작 위치로부터 바이트 단위로 계산된다. (disk_read()와 같이 파일
+ * 포인터를 옮기지 않음)
  *
  * @param fd     디바이스 파일 디스크립터
  * @param buf    기록할 데이터가 저장된 버퍼 포인터
@@ -59,17 +66,19 @@ ssize_t disk_read(int fd, void *buf, size_t count, off_t off) {
  * 등의 상황에서는 ENOSPC 오류가 발생할 수 있다.
  */
 ssize_t disk_write(int fd, const void *buf, size_t count, off_t off) {
-  // 지정된 위치로 디스크 포인터 이동
-  if (lseek(fd, off, SEEK_SET) < 0)
-    return -errno; // lseek 실패 시 errno 반환
+  uint64_t t0 = stats_begin(SFUSE_OP_DISK_WRITE);
+  ssize_t ret;
 
-  // 데이터를 실제로 기록함
-  ssize_t ret = write(fd, buf, count);
-  if (ret < 0)
-    return -errno; // 기록 실패 시 errno 반환
+  // 스냅숏이 가리키는 블록이면 원래 내용을 먼저 복사한 뒤 실제로 기록함
+  ret = hooks && hooks->write ? hooks->write(fd, off, count) : 0;
+  if (ret == 0 && (ret = pwrite(fd, buf, count, off)) < 0)
+    ret = -errno; // 기록 실패 시 errno 반환
 
+  stats_record(SFUSE_OP_DISK_WRITE, t0, ret);
   return ret; // 기록 성공 시 기록한 바이트 수 반환
 }
 
+void disk_set_hooks(const struct disk_hooks *h) { hooks = h; }
+
 // NOTE: read_block()과 write_block() 함수는 중복 코드를 방지하기 위해
 // block.c에구현되어 있다.
@@ -0,0 +1,187 @@
+/**
+ * @file src/file.c
+ * @brief 열린 파일 핸들(fi->fh) 구현
+ *
+ * 열린 파일마다 아이노드와 최근에 사용한 블록 맵 leaf를 캐시하여, read/write
+ * 콜백이 경로 탐색, 아이노드 읽기, 인다이렉트 블록 읽기를 반복하지 않도록
+ * 한다. 캐시의 유효성은 inode_sync()가 증가시키는 세대 번호로 확인한다.
+ * 순차 읽기가 감지되면 다음 구간의 물리 블록을 장치 페이지 캐시로 미리 읽는다.
+ */
+
+#include "file.h"
+#include "fs.h"
+#include "inode.h"
+#include "stats.h"
+#include "super.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+
+/**
+ * @brief 열린 파일 객체를 만들고 아이노드를 캐시한다.
+ *
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ */
+int file_open(struct sfuse_fs *fs, uint32_t ino, int flags,
+              struct sfuse_file **out) {
+  struct sfuse_file *f = calloc(1, sizeof(*f));
+  if (!f)
+    return -ENOMEM;
+
+  pthread_mutex_init(&f->lock, NULL);
+  f->ino = ino;
+  f->accmode = flags & O_ACCMODE;
+  // 세대 번호를 먼저 읽어 두어, 읽는 도중의 변경은 다음 접근에서 감지
+  f->gen = inode_generation(ino);
+  if (inode_load(fs->backing_fd, &fs->sb, ino, &f->inode) < 0) {
+    file_close(f);
+    return -EIO;
+  }
+
+  *out = f;
+  return 0;
+}
+
+/**
+ * @brief 열린 파일 객체를 해제한다.
+ */
+void file_close(struct sfuse_file *f) {
+  if (!f)
+    return;
+  pthread_mutex_destroy(&f->lock);
+  free(f);
+}
+
+/**
+ * @brief 캐시된 아이노드가 최신인지 확인하고, 아니면 다시 읽는다.
+ *
+ * @return 성공 시 0, 아이노드 읽기 실패 시 -EIO
+ */
+int file_revalidate(struct sfuse_fs *fs, struct sfuse_file *f) {
+  uint32_t gen = inode_generation(f->ino);
+  if (gen == f->gen)
+    return 0;
+
+  // 다른 경로(truncate, 지연 할당 기록 등)에서 아이노드가 바뀜
+  if (inode_load(fs->backing_fd, &fs->sb, f->ino, &f->inode) < 0)
+    return -EIO;
+  f->gen = gen;
+  f->map_valid = false;
+  return 0;
+}
+
+/**
+ * @brief 핸들이 캐시된 아이노드를 직접 기록한 뒤 세대 번호를 갱신한다.
+ */
+void file_synced(struct sfuse_file *f) { f->gen = inode_generation(f->ino); }
+
+/**
+ * @brief 블록 맵 캐시를 버린다.
+ */
+void file_map_invalidate(struct sfuse_file *f) { f->map_valid = false; }
+
+/**
+ * @brief 캐시된 블록 맵으로 논리 블록을 물리 블록으로 변환한다.
+ *
+ * @return 성공 시 0, 예약(unwritten) 블록이면 1, 압축 클러스터의 블록이면 2,
+ *         구멍이면 -ENOENT, 그 외 음수의 오류 코드
+ */
+int file_bmap(struct sfuse_fs *fs, struct sfuse_file *f, uint64_t lbn,
+              uint64_t *pbn_out) {
+  if (inode_is_inline(&f->inode))
+    return -ENOENT;
+
+  /* [1단계] lbn을 담은 leaf가 캐시에 없으면 읽어 옴 */
+  if (!f->map_valid || lbn < f->map_base ||
+      lbn - f->map_base >= f->map_count) {
+    stats_event(SFUSE_EV_BMAP_MISS, 1);
+    int n = inode_map_leaf(fs->backing_fd, &f->inode, lbn, f->map,
+                           &f->map_base);
+    if (n < 0) {
+      f->map_valid = false;
+      return n;
+    }
+    f->map_count = (uint32_t)n;
+    f->map_valid = true;
+  } else {
+    stats_event(SFUSE_EV_BMAP_HIT, 1);
+  }
+
+  /* [2단계] 캐시된 포인터 해석 */
+  uint64_t blk = f->map[lbn - f->map_base];
+  if (blk == 0)
+    return -ENOENT;
+  if (blk & SFUSE_BLOCK_UNWRITTEN) {
+    *pbn_out = blk & ~SFUSE_BLOCK_UNWRITTEN;
+    return 1;
+  }
+  if (blk & SFUSE_BLOCK_COMPRESSED) {
+    *pbn_out = blk & ~SFUSE_BLOCK_COMPRESSED;
+    return 2;
+  }
+  *pbn_out = blk;
+  return 0;
+}
+
+/**
+ * @brief 물리 블록 구간 [pbn, pbn + count)를 미리 읽도록 커널에 알린다.
+ */
+static void readahead_run(struct sfuse_fs *fs, uint64_t pbn, uint64_t count) {
+  if (count == 0)
+    return;
+  stats_event(SFUSE_EV_READAHEAD_BLKS, count);
+  posix_fadvise(fs->backing_fd, (off_t)(pbn * SFUSE_BLOCK_SIZE),
+                (off_t)(count * SFUSE_BLOCK_SIZE), POSIX_FADV_WILLNEED);
+}
+
+/**
+ * @brief 순차 읽기를 감지하여 다음 구간의 데이터 블록을 미리 읽도록 요청한다.
+ */
+void file_readahead(struct sfuse_fs *fs, struct sfuse_file *f, uint64_t offset,
+                    size_t size) {
+  uint64_t end = offset + size;
+
+  /* [1단계] 순차 여부 판단과 창 크기 조정 */
+  if (offset != f->ra_next || size == 0) {
+    // 비순차 읽기: 창을 닫고 다음 읽기부터 다시 판단
+    f->ra_next = end;
+    f->ra_end = end;
+    f->ra_window = 0;
+    return;
+  }
+  f->ra_next = end;
+  if (f->ra_window == 0)
+    f->ra_window = SFUSE_RA_MIN;
+  else if (f->ra_window < SFUSE_RA_MAX)
+    f->ra_window *= 2;
+
+  /* [2단계] 아직 요청하지 않은 구간 계산 */
+  uint64_t target = end + f->ra_window;
+  if (target > f->inode.size)
+    target = f->inode.size;
+  uint64_t from = f->ra_end > end ? f->ra_end : end;
+  if (from >= target || inode_is_inline(&f->inode))
+    return;
+  f->ra_end = target;
+
+  /* [3단계] 물리적으로 이어진 블록끼리 모아 미리 읽기 요청 */
+  uint64_t run_pbn = 0, run_len = 0;
+  uint64_t last = (target - 1) / SFUSE_BLOCK_SIZE;
+  for (uint64_t lbn = from / SFUSE_BLOCK_SIZE; lbn <= last; lbn++) {
+    uint64_t pbn;
+    if (file_bmap(fs, f, lbn, &pbn) != 0) {
+      // 구멍, 예약 블록, 지연 할당 블록은 읽을 필요 없음
+      readahead_run(fs, run_pbn, run_len);
+      run_len = 0;
+      continue;
+    }
+    if (run_len && pbn == run_pbn + run_len) {
+      run_len++;
+      continue;
+    }
+    readahead_run(fs, run_pbn, run_len);
+    run_pbn = pbn;
+    run_len = 1;
+  }
+  readahead_run(fs, run_pbn, run_len);
+}
@@ -12,14 +12,23 @@
 #include "fs.h"
 #include "bitmap.h"
 #include "block.h"
+#include "compress.h"
+#include "csum.h"
+#include "dedup.h"
 #include "dir.h"
+#include "discard.h"
 #include "inode.h"
+#include "meta.h"
+#include "snap.h"
+#include "stats.h"
 #include "super.h"
 #include <errno.h>
 #include <fuse.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 /**
@@ -55,22 +64,17 @@ struct sfuse_fs *get_fs_context(void) {
 /**
  * @brief SFUSE 파일 시스템을 초기화하고 슈퍼블록 및 메타데이터를 준비한다.
  *
- * 이 함수는 주어진 블록 장치 파일 디스크립터를 이용하여 SFUSE 파일 시스템을
- * 초기화한다. 먼저 장치의 크기를 계산하고, 슈퍼블록이 존재하지 않으면 파일
- * 시스템을 포맷하여 새로 생성하며, 슈퍼블록 및 루트 디렉터리를 초기화한다. 만약
- * 슈퍼블록이 이미 존재한다면 이를 로드하고 기존 비트맵 데이터를 불러온다.
- *
- * @param backing_fd 파일 시스템을 저장하는 장치의 파일 디스크립터.
- * @return 성공 시 0, 실패 시 음수의 에러 코드.
- */
-/**
- * @brief SFUSE 파일 시스템을 초기화하고 슈퍼블록 및 메타데이터를 준비한다.
- *
- * 파일 시스템의 슈퍼블록, inode 테이블, 비트맵 등을 초기화하거나 기존 데이터를
+ * 장치의 슈퍼블록을 읽어 유효성을 확인하고, 블록 및 아이노드 비트맵을 메모리로
  * 로드하여 파일 시스템 사용 준비를 완료한다.
  *
+ * 포맷은 더 이상 마운트 시점에 수행하지 않는다. 유효한 슈퍼블록이 없는 장치는
+ * mkfs.sfuse로 먼저 포맷해야 하며, 덕분에 마운트는 포맷 비용을 지불하지 않고
+ * 아이노드 수 등의 구성도 mkfs 옵션으로 자유롭게 정할 수 있다.
+ *
  * @param backing_fd 파일 시스템을 저장하는 블록 장치 파일 디스크립터.
  * @return 성공 시 0, 실패 시 음수의 에러 코드.
+ *         -EINVAL: 유효한 SFUSE 슈퍼블록이 없음 (mkfs.sfuse 필요)
+ *         -ENOMEM: 비트맵 메모리 할당 실패
  */
 int fs_initialize(int backing_fd) {
   // 현재 사용 중인 파일 시스템 컨텍스트 획득
@@ -79,289 +83,132 @@ int fs_initialize(int backing_fd) {
   // 얻은 블록 장치 파일 디스크립터 저장
   fs->backing_fd = backing_fd;
 
-  /*
-  블록 장치(backing_fd)의 크기를 바이트 단위로 얻는다.
-  파일의 크기를 얻으려면 파일의 가장 끝으로 파일 오프셋(offset)을 이동시킨다.
-  이때 사용되는 함수가 바로 `lseek`이다.
-
-  lseek 함수 원형:
-  off_t lseek(int fd, off_t offset, int whence);
-
-  인자 설명:
-  - fd: 오프셋을 이동시킬 파일 디스크립터.
-  - offset: 이동할 오프셋의 크기.
-  - whence: 오프셋 이동 기준을 설정하는 플래그.
-     - SEEK_SET: 파일의 시작 지점으로부터 offset 바이트 이동.
-     - SEEK_CUR: 현재 위치에서 offset 바이트 이동.
-     - SEEK_END: 파일 끝에서부터 offset 바이트 이동.
-
-  여기서는 파일의 크기를 알고자 하므로,
-  SEEK_END를 이용해 파일의 끝으로 이동(offset은 0)을 지정한다.
-  그러면 lseek는 파일의 총 크기(바이트 단위)를 반환한다.
- */
-  off_t device_size = lseek(backing_fd, 0, SEEK_END);
-
-  /*
-  장치 크기(device_size)는 바이트 단위이기 때문에,
-  이를 SFUSE 파일 시스템이 사용하는 블록 크기(SFUSE_BLOCK_SIZE)로 나누어
-  블록 장치가 가진 전체 블록의 수를 계산한다.
-
-  예시로, 만약 장치 크기가 8192바이트이고 블록 크기가 1024바이트라면,
-  총 블록 수(total_blocks)는 8192 / 1024 = 8이 된다.
-
-  total_blocks 값은 파일 시스템의 메타데이터와 데이터 블록을 배치할 때
-  사용된다.
-  */
-  uint32_t total_blocks = device_size / SFUSE_BLOCK_SIZE;
-
-  // 슈퍼블록을 디스크에서 로드(load) 시도.
-  // sb_load()가 성공하면 이미 파일 시스템이 포맷되어 있다는 뜻이다.
-  // sb_load()는 디스크에서 슈퍼블록 데이터를 읽어 fs->sb 구조체에 저장한다.
-  // 성공 시 0을 반환하며, 실패 시 음수를 반환한다.
-  //
-  // sb_load()가 실패하면 (즉, 음수 반환 시),
-  // 이는 슈퍼블록이 존재하지 않거나 손상된 상태를 나타내므로,
-  // 새로운 슈퍼블록을 포맷하고 초기화하는 과정을 수행해야 한다.
-  if (sb_load(backing_fd, &fs->sb) < 0) {
-
-    // 슈퍼블록 포맷: 슈퍼블록을 깨끗한 초기 상태로 설정.
-    // 이 함수는 슈퍼블록의 모든 값을 기본값 또는 초기 상태로 설정한다.
-    sb_format(&fs->sb);
-
-    // 슈퍼블록에 파일 시스템의 전체 블록 개수(total_blocks)를 설정한다.
-    // 이 값은 파일 시스템이 관리할 수 있는 블록의 최대 개수를 나타낸다.
-    fs->sb.blocks_count = total_blocks;
-
-    // inode 개수 설정: 파일 시스템이 관리할 수 있는 inode의 총 개수를 설정.
-    // inode는 파일이나 디렉터리 같은 객체의 메타데이터를 저장하는 단위이다.
-    fs->sb.inodes_count = SFUSE_INODES_COUNT;
-
-    // --- 메타데이터 영역의 크기 계산 시작 ---
-
-    // 1. 블록 비트맵(block bitmap)의 크기를 블록 단위로 계산
-    //
-    // 블록 비트맵은 각 블록이 사용 중인지 여부를 비트 단위로 관리한다.
-    // 하나의 블록을 1비트(bit)로 관리하므로,
-    // 전체 블록 수를 8로 나누면 필요한 바이트(byte) 수가 된다.
-    //
-    // 이 바이트 수를 블록 단위(SFUSE_BLOCK_SIZE)로 변환하기 위해 다음 수식을
-    // 사용:
-    //
-    // (fs->sb.blocks_count / 8 + SFUSE_BLOCK_SIZE - 1) / SFUSE_BLOCK_SIZE
-    //
-    // 이 수식은 '올림(ceil)'의 효과를 내는 표현으로,
-    // 정확히 나누어 떨어지지 않을 경우 필요한 블록을 추가로 확보하기 위한
-    // 계산법이다.
-    uint32_t block_bitmap_blocks =
-        (fs->sb.blocks_count / 8 + SFUSE_BLOCK_SIZE - 1) / SFUSE_BLOCK_SIZE;
-
-    // 2. inode 비트맵(inode bitmap)의 크기를 블록 단위로 계산
-    //
-    // inode 비트맵은 inode들이 사용 중인지 여부를 관리하는 비트맵이다.
-    // 전체 inode 개수를 8로 나누면 바이트 수가 되며,
-    // 이것을 블록 단위로 변환하는 계산법은 블록 비트맵 계산법과 동일하다.
-    uint32_t inode_bitmap_blocks =
-        (fs->sb.inodes_count / 8 + SFUSE_BLOCK_SIZE - 1) / SFUSE_BLOCK_SIZE;
-
-    // 3. inode 테이블(inode table)의 크기를 블록 단위로 계산
-    //
-    // inode 테이블은 실제 inode 구조체들을 저장하는 영역이다.
-    // 각 inode는 'struct sfuse_inode'의 크기만큼 메모리를 차지하므로,
-    // 전체 inode 개수에 inode 크기를 곱하면 inode 테이블의 총 크기가 바이트
-    // 단위로 나온다.
-    //
-    // 이것을 다시 블록 크기(SFUSE_BLOCK_SIZE)로 나누어 몇 개의 블록이 필요한지
-    // 계산한다. 여기서도 블록이 정수로 딱 떨어지지 않을 수 있으므로, 올림
-    // 효과를 내도록 처리한다.
-    uint32_t inode_table_blocks =
-        (fs->sb.inodes_count * sizeof(struct sfuse_inode) + SFUSE_BLOCK_SIZE -
-         1) /
-        SFUSE_BLOCK_SIZE;
-
-    // 슈퍼블록에서 관리하는 각 영역의 위치(블록 번호)를 설정한다.
-    // SFUSE 파일 시스템의 디스크 레이아웃은 일반적으로 다음과 같다:
-    //
-    //    파일 시스템 블록 구조:
-    // +--------------------------+
-    // | 블록 0 (슈퍼블록)        |
-    // +--------------------------+
-    // | 블록 1 (예비 블록)       |
-    // +--------------------------+
-    // | 블록 2 ~ N               |
-    // | (block bitmap)           |
-    // | [블록 사용 여부 표시]    |
-    // +--------------------------+
-    // | inode bitmap             |
-    // | [inode 사용 여부 표시]   |
-    // +--------------------------+
-    // | inode tables             |
-    // | [파일 메타데이터 저장]   |
-    // +--------------------------+
-    // | data block               |
-    // | [실제 사용자 데이터 저장]|
-    // +--------------------------+
-    //
-    // block 비트맵의 시작 위치는 슈퍼블록(블록 0)과 예비 블록(블록 1) 뒤에 위치
-    fs->sb.block_bitmap_start = 2;
-
-    // inode 비트맵은 block 비트맵 다음에 위치
-    fs->sb.inode_bitmap_start = fs->sb.block_bitmap_start + block_bitmap_blocks;
-
-    // inode 테이블은 inode 비트맵 다음에 위치
-    fs->sb.inode_table_start = fs->sb.inode_bitmap_start + inode_bitmap_blocks;
-
-    // 실제 사용자 데이터 블록은 inode 테이블 다음에 위치
-    fs->sb.data_block_start = fs->sb.inode_table_start + inode_table_blocks;
-
-    // 데이터 블록 시작 위치 이후의 블록만 실제 데이터 저장을 위해 사용
-    // 가능하므로, 전체 블록 수(total_blocks)에서 데이터 블록 시작 위치를 빼면
-    // 여유 블록 수를 구할 수 있다.
-    fs->sb.free_blocks = total_blocks - fs->sb.data_block_start;
-
-    // inode 중 루트 디렉터리를 제외한 나머지 inode들이 사용 가능
-    fs->sb.free_inodes = fs->sb.inodes_count - 1;
+  // -o snapshot: 이후 모든 읽기가 스냅숏 시점의 내용을 보도록 먼저 연결한다.
+  // 장치에 기록하거나 매핑으로 직접 접근하는 기능은 쓰지 않는다.
+  int res;
+  if (fs->opts.snapshot) {
+    res = snap_open_view(backing_fd);
+    if (res < 0) {
+      fprintf(stderr, "[SFUSE] 스냅숏을 열 수 없습니다 (%d)\n", res);
+      return res;
+    }
+    fs->opts.mmap_meta = fs->opts.dedup = fs->opts.compress = 0;
+    fs->opts.no_discard = 1;
+  }
 
-    // 위에서 설정한 슈퍼블록 데이터를 디스크에 즉시 동기화하여 저장
-    if (sb_sync(backing_fd, &fs->sb) < 0)
-      return -EIO; // 동기화 실패 시 입출력 에러 반환
+  // 슈퍼블록을 디스크에서 로드한다. 실패하면 포맷되지 않았거나 손상된 장치이다.
+  res = sb_load(backing_fd, &fs->sb);
+  if (res < 0) {
+    fprintf(stderr,
+            "[SFUSE] 유효한 슈퍼블록이 없습니다. mkfs.sfuse로 장치를 먼저 "
+            "포맷하세요.\n");
+    snap_destroy();
+    return res;
+  }
 
-    // ---- 메모리에 블록 비트맵과 inode 비트맵을 관리할 공간을 확보 ----
+  // 메타데이터 매핑은 disk_write()를 거치지 않으므로 스냅숏을 지킬 수 없다.
+  if (fs->opts.mmap_meta &&
+      (fs->sb.feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_SNAPSHOT)) {
+    fprintf(stderr, "[SFUSE] 스냅숏이 있어 -o mmap_meta를 쓰지 않습니다\n");
+    fs->opts.mmap_meta = 0;
+  }
 
-    // 비트맵 크기 계산:
-    // 비트맵은 비트 단위로 블록이나 inode의 사용 여부를 관리한다.
-    // 1 바이트(byte)는 8 비트(bit)를 가지므로, 블록과 inode의 개수를 각각 8로
-    // 나누면 비트맵이 필요한 메모리 크기가 바이트 단위로 나온다.
-    size_t bmap_bytes = fs->sb.blocks_count / 8;
-    size_t imap_bytes = fs->sb.inodes_count / 8;
+  // 비트맵 크기 계산:
+  // 1 바이트(byte)는 8 비트(bit)를 가지므로, 블록과 inode의 개수를 각각 8로
+  // 나누면 비트맵이 필요한 메모리 크기가 바이트 단위로 나온다.
+  size_t bmap_bytes = fs->sb.blocks_count / 8;
+  size_t imap_bytes = fs->sb.inodes_count / 8;
 
-    // 위에서 계산한 크기만큼 메모리를 할당하고, 그 공간을 0으로 초기화한다.
-    // calloc(1, size)는 size 크기만큼 메모리를 할당한 후 모든 비트를 0으로
-    // 설정한다. 이렇게 하면 비트맵이 초기 상태에서는 모든 블록과 inode가 "사용
-    // 가능"(free)으로 표시된다.
+  // -o mmap_meta: 비트맵은 별도 버퍼 없이 메타데이터 매핑을 직접 가리킨다.
+  if (fs->opts.mmap_meta) {
+    res = meta_map(backing_fd, &fs->sb);
+    if (res < 0) {
+      snap_destroy();
+      return res;
+    }
+    fs->block_map = meta_ptr(
+        (off_t)fs->sb.block_bitmap_start * SFUSE_BLOCK_SIZE, bmap_bytes);
+    fs->inode_map = meta_ptr(
+        (off_t)fs->sb.inode_bitmap_start * SFUSE_BLOCK_SIZE, imap_bytes);
+  } else {
     fs->block_map = calloc(1, bmap_bytes);
     fs->inode_map = calloc(1, imap_bytes);
+  }
+  if (!fs->block_map || !fs->inode_map) {
+    fs_free_maps(fs);
+    snap_destroy();
+    return -ENOMEM;
+  }
 
-    // 메모리 할당 실패 시 메모리 부족 에러 반환
-    if (!fs->block_map || !fs->inode_map)
-      return -ENOMEM;
-
-    // 비트맵의 초기 상태(모든 블록 및 inode가 사용 가능 상태)를 디스크에 동기화
-    bitmap_sync(backing_fd, fs->sb.block_bitmap_start, fs->block_map,
-                bmap_bytes);
-    bitmap_sync(backing_fd, fs->sb.inode_bitmap_start, fs->inode_map,
-                imap_bytes);
-
-    // ---- 루트 디렉터리 inode 초기화 ----
-
-    // 루트 inode 번호 설정 (1번으로 정의됨)
-    uint32_t root = SFUSE_ROOT_INO;
-
-    // inode 비트맵에서 루트 inode를 사용 중으로 표시하는 코드
-    // 비트맵(bitmap)은 각 inode의 사용 여부를 관리하는 데이터 구조로,
-    // 1비트가 1개의 inode의 상태를 나타낸다.
-    // 비트값이 0이면 해당 inode는 사용 가능(free), 1이면 사용
-    // 중(allocated)이다.
-
-    // inode 비트맵은 바이트(byte) 배열 형태로 관리된다.
-    // 배열의 각 요소(바이트)마다 8개의 inode 상태를 표현할 수 있다.
-    // 특정 inode가 속한 바이트의 위치는 inode 번호를 8로 나눈 값(root / 8)이며,
-    // 바이트 내의 정확한 비트 위치는 inode 번호를 8로 나눈 나머지(root % 8)가
-    // 된다.
-
-    // 예시:
-    // 루트 inode(root)가 5라면, inode_map[0] (바이트의 첫 번째 요소)의 5번째
-    // 비트를 설정한다.
-
-    // 이 코드의 동작 방식:
-    // 1. (1 << (root % 8)): 1을 root % 8 만큼 왼쪽으로 시프트(shift)하여 원하는
-    // 비트 위치로 설정한다.
-    // 2. inode_map[root / 8] |= (...): OR 연산으로 해당 비트를 설정하여 inode를
-    // '사용 중'으로 표시한다.
-    //
-    // 비트 연산을 사용하는 이유는 매우 빠르고 공간을 절약하기 때문이다.
-    fs->inode_map[root / 8] |= (1 << (root % 8));
-
-    // 위에서 inode 비트맵에 루트 inode를 할당했기 때문에,
-    // 슈퍼블록에서 관리하는 사용 가능한(free) inode의 개수도 하나 감소시켜야
-    // 한다.
-    fs->sb.free_inodes--;
-
-    // 루트 inode 구조체 초기화 (초기화 전에 메모리 전체를 0으로 설정)
-    struct sfuse_inode root_inode;
-    memset(&root_inode, 0, sizeof(root_inode));
-
-    // 루트 inode 메타데이터 설정 (디렉터리, 접근 권한 0755, 소유자 UID/GID
-    // 설정)
-    fs_init_inode(&fs->sb, root, S_IFDIR | 0755, fuse_get_context()->uid,
-                  fuse_get_context()->gid, &root_inode);
-
-    // ---- 루트 디렉터리의 데이터 블록 할당 및 초기화 ----
-
-    // 블록 할당 함수를 호출하여, 첫 번째 데이터 블록 인덱스를 할당 받음
-    int blk_index = alloc_block(&fs->sb, fs->block_map);
-    if (blk_index < 0)
-      return -ENOSPC; // 사용 가능한 블록 공간 부족 시 에러 반환
-
-    // 실제 블록 번호는 데이터 블록의 시작 위치에서 blk_index만큼 더한 값
-    uint32_t phys_block = fs->sb.data_block_start + blk_index;
-
-    // inode가 관리하는 직접(direct) 블록 포인터 중 첫 번째 항목을 설정
-    root_inode.direct[0] = phys_block;
-    root_inode.size =
-        SFUSE_BLOCK_SIZE; // 루트 디렉터리 크기를 블록 크기만큼 설정
-
-    // 데이터 블록 내에 루트 디렉터리의 기본 엔트리("." 및 "..")를 생성하기 위한
-    // 초기화
-    uint8_t block[SFUSE_BLOCK_SIZE] = {0}; // 블록 크기만큼 0으로 초기화
-    struct sfuse_dirent *entries =
-        (struct sfuse_dirent *)block; // 디렉터리 엔트리 구조체로 사용
-
-    // "."(현재 디렉터리)는 루트 inode를 가리킴
-    entries[0].ino = root;
-    strcpy(entries[0].name, ".");
-
-    // ".."(상위 디렉터리) 역시 루트 inode를 가리킴 (루트 디렉터리는 자신을
-    // 가리킴)
-    entries[1].ino = root;
-    strcpy(entries[1].name, "..");
-
-    // 구성된 디렉터리 데이터를 디스크의 실제 블록에 기록
-    if (write_block(backing_fd, phys_block, block) < 0)
-      return -EIO; // 블록 기록 실패 시 입출력 에러 반환
-
-    // 구성된 루트 inode를 디스크에 저장하여 동기화
-    if (inode_sync(backing_fd, &fs->sb, root, &root_inode) < 0)
-      return -EIO; // inode 동기화 실패 시 입출력 에러 반환
-
-    // ---- 모든 메타데이터의 최종 상태를 디스크에 동기화 ----
-
-    // 블록 비트맵과 inode 비트맵의 최종 상태를 디스크에 저장
-    bitmap_sync(backing_fd, fs->sb.block_bitmap_start, fs->block_map,
-                bmap_bytes);
-    bitmap_sync(backing_fd, fs->sb.inode_bitmap_start, fs->inode_map,
-                imap_bytes);
+  // 블록 체크섬 테이블을 먼저 읽어 이후 로드하는 비트맵도 검증한다.
+  // (METADATA_CSUM 기능이 없으면 아무 일도 하지 않음)
+  res = csum_init(backing_fd, &fs->sb, true);
+
+  // 블록 비트맵은 그룹 요약만 읽고 그룹별로 처음 쓸 때 로드한다.
+  // 아이노드 비트맵은 디스크에서 메모리로 한 번에 로드한다.
+  if (res == 0)
+    res = bitmap_groups_init(backing_fd, &fs->sb, fs->block_map);
+  if (res == 0)
+    res = bitmap_load(backing_fd, fs->sb.inode_bitmap_start, fs->inode_map,
+                      imap_bytes);
+  // 해제한 블록의 discard 처리 (-o nodiscard면 사용하지 않음)
+  if (res == 0 && !fs->opts.no_discard)
+    res = discard_init(backing_fd);
+  // 스냅숏 보호 준비 (이후 장치에 기록하는 모듈보다 먼저)
+  if (res == 0 && !fs->opts.snapshot)
+    res = snap_init(fs);
+  // 공유 블록 참조 수 테이블 준비 (-o dedup으로 처음 마운트하면 만듦)
+  if (res == 0)
+    res = dedup_init(backing_fd, &fs->sb, fs->block_map, fs->opts.dedup);
+  // 지연 할당 쓰기 버퍼 준비
+  if (res == 0)
+    res = dalloc_init(&fs->dalloc);
+  if (res < 0) {
+    dedup_destroy(backing_fd);
+    discard_destroy();
+    snap_destroy();
+    csum_destroy();
+    fs_free_maps(fs);
+    return res;
+  }
 
-    // 슈퍼블록의 최종 상태를 디스크에 저장하여 파일 시스템 초기화 완료
-    sb_sync(backing_fd, &fs->sb);
+  // 장치 플러시 묶음 처리 상태 준비
+  pthread_mutex_init(&fs->sync.lock, NULL);
+  pthread_cond_init(&fs->sync.done, NULL);
+  fs->sync.requested = fs->sync.completed = 0;
+  fs->sync.running = fs->sync.full = false;
+  fs->sync.result = 0;
 
-  } else {
-    // 슈퍼블록이 이미 존재(정상 로드 성공) 시, 기존 메타데이터를 디스크에서
-    // 로드
+  // 이전 마운트에서 남은 고아를 포함해 백그라운드 블록 회수 시작
+  orphan_init(fs);
+  // 조각 모음 스레드는 요청이 올 때까지 잠들어 있음
+  defrag_init(fs);
+  // 만료된 지연 할당 데이터를 주기적으로 기록
+  dalloc_start(fs);
 
-    size_t bmap_bytes = fs->sb.blocks_count / 8;
-    size_t imap_bytes = fs->sb.inodes_count / 8;
-
-    fs->block_map = calloc(1, bmap_bytes);
-    fs->inode_map = calloc(1, imap_bytes);
+  // 초기화 과정이 모두 정상적으로 완료되었으므로 성공(0)을 반환
+  return 0;
+}
 
-    // 기존 비트맵 데이터를 디스크에서 메모리로 로드하여 파일 시스템 재구성
-    bitmap_load(backing_fd, fs->sb.block_bitmap_start, fs->block_map,
-                bmap_bytes);
-    bitmap_load(backing_fd, fs->sb.inode_bitmap_start, fs->inode_map,
-                imap_bytes);
+/**
+ * @brief 블록/아이노드 비트맵과 슈퍼블록을 기록한다.
+ *
+ * 스냅숏이 있으면 비트맵과 슈퍼블록을 처음 고칠 때 원래 내용을 복사하면서
+ * 블록을 할당하므로 이미 기록한 비트맵이 다시 바뀐다. 새 복사본이 생기지
+ * 않을 때까지 다시 기록한다. (두 번째부터는 복사할 블록이 거의 없음)
+ */
+static int sync_maps(struct sfuse_fs *fs) {
+  for (int pass = 0; pass < 4; pass++) {
+    uint64_t before = snap_blocks();
+    if (bitmap_sync(fs->backing_fd, fs->sb.block_bitmap_start, fs->block_map,
+                    fs->sb.blocks_count / 8) < 0 ||
+        bitmap_sync(fs->backing_fd, fs->sb.inode_bitmap_start, fs->inode_map,
+                    fs->sb.inodes_count / 8) < 0 ||
+        sb_sync(fs->backing_fd, &fs->sb) < 0)
+      return -EIO;
+    if (snap_blocks() == before)
+      break;
   }
-
-  // 초기화 과정이 모두 정상적으로 완료되었으므로 성공(0)을 반환
   return 0;
 }
 
@@ -369,8 +216,8 @@ int fs_initialize(int backing_fd) {
  * @brief SFUSE 파일 시스템을 종료하고 리소스를 정리하는 함수.
  *
  * 파일 시스템 종료 시 호출되며, 메모리에 존재하는 파일 시스템의
- * 메타데이터(슈퍼블록, 블록 및 inode 비트맵)를 디스크에 동기화하고,
- * 할당된 메모리 리소스를 해제한다.
+ * 메타데이터(슈퍼블록, 블록 및 inode 비트맵)를 디스크에 동기화하고 장치를
+ * 플러시한 뒤, 할당된 메모리 리소스를 해제한다.
  *
  * @param private_data 종료될 파일 시스템 컨텍스트(struct sfuse_fs)의 포인터.
  */
@@ -378,34 +225,213 @@ void fs_destroy(void *private_data) {
   // 전달받은 private_data 포인터를 struct sfuse_fs 타입으로 변환
   struct sfuse_fs *fs = private_data;
 
-  // 비트맵 데이터를 디스크에 동기화하기 위한 메모리 크기 계산
-  // 블록 비트맵 크기: 전체 블록 수(blocks_count)를 비트맵 표현을 위해 바이트로
-  // 환산
-  size_t bmap_bytes = fs->sb.blocks_count / 8;
+  // 조각 모음과 고아 회수 스레드를 먼저 멈춘다. (남은 고아는 다음 마운트에서
+  // 회수)
+  defrag_destroy(fs);
+  orphan_destroy(fs);
+
+  // 기록 스레드를 멈추고 지연 할당으로 남아 있는 더티 데이터를 먼저 기록한다.
+  // 이 과정에서 블록이 할당되므로 비트맵 동기화보다 앞서야 한다.
+  dalloc_destroy(fs);
+
+  // 블록/아이노드 비트맵과 슈퍼블록을 디스크에 동기화한다. 이 작업을 통해
+  // 파일 시스템 종료 시 블록과 inode의 사용 상태가 디스크에 정확히 반영된다.
+  sync_maps(fs);
+  dedup_destroy(fs->backing_fd);
+  csum_destroy();
+  compress_cache_drop();
+
+  // 장치는 O_SYNC 없이 열리므로 종료 전에 기록한 내용을 장치에 반영한다.
+  // 커밋된 discard가 모두 끝난 뒤 스레드를 정리한다.
+  fs_sync_device(fs, false);
+  discard_destroy();
+  snap_destroy();
+  pthread_cond_destroy(&fs->sync.done);
+  pthread_mutex_destroy(&fs->sync.lock);
 
-  // inode 비트맵 크기: 전체 inode 수(inodes_count)를 비트맵 표현을 위해
-  // 바이트로 환산
-  size_t imap_bytes = fs->sb.inodes_count / 8;
+  // 파일 시스템의 종료 작업 이후 메모리에 할당된 비트맵 메모리를 해제하여,
+  // 메모리 누수를 방지한다. (매핑된 경우 매핑 해제)
+  fs_free_maps(fs);
+}
 
-  // 메모리에 존재하는 블록 비트맵 상태를 디스크에 동기화한다.
-  // 이 작업을 통해 파일 시스템 종료 시 블록의 사용 상태가 디스크에 정확히
-  // 반영된다.
-  bitmap_sync(fs->backing_fd, fs->sb.block_bitmap_start, fs->block_map,
-              bmap_bytes);
+void fs_free_maps(struct sfuse_fs *fs) {
+  bitmap_groups_destroy();
+  if (!meta_owns(fs->block_map))
+    free(fs->block_map);
+  if (!meta_owns(fs->inode_map))
+    free(fs->inode_map);
+  fs->block_map = fs->inode_map = NULL;
+  meta_unmap();
+}
 
-  // 메모리에 존재하는 inode 비트맵 상태를 디스크에 동기화한다.
-  // 파일 시스템 종료 시 inode의 사용 여부를 디스크에 저장한다.
-  bitmap_sync(fs->backing_fd, fs->sb.inode_bitmap_start, fs->inode_map,
-              imap_bytes);
+/**
+ * @brief 그동안 기록한 내용을 장치에 영구 반영한다. (fsync 묶음 처리)
+ *
+ * 요청마다 번호를 발급한다. 완료 번호가 자신의 번호 이상이면 자신이 요청하기
+ * 전에 시작된 기록을 포함하는 플러시가 끝난 것이므로 그 결과를 돌려준다.
+ * 진행 중인 플러시가 없으면 자신이 대표가 되어 지금까지 발급된 번호를 모두
+ * 포함하는 플러시를 실행한다. 진행 중인 플러시는 자신의 요청보다 먼저 시작했을
+ * 수 있으므로 끝나기를 기다린 뒤 다시 판단한다.
+ *
+ * 플러시 직전까지 해제된 블록은 플러시가 성공하면 discard 대상으로 넘긴다.
+ */
+int fs_sync_device(struct sfuse_fs *fs, bool datasync) {
+  struct sfuse_sync *s = &fs->sync;
+
+  pthread_mutex_lock(&s->lock);
+  uint64_t ticket = ++s->requested;
+  if (!datasync)
+    s->full = true;
+  while (s->completed < ticket && s->running)
+    pthread_cond_wait(&s->done, &s->lock);
+  if (s->completed >= ticket) {
+    // 다른 스레드의 플러시에 함께 처리됨
+    int res = s->result;
+    pthread_mutex_unlock(&s->lock);
+    stats_event(SFUSE_EV_FSYNC_MERGED, 1);
+    return res;
+  }
 
-  // 슈퍼블록 상태를 디스크에 동기화하여 최신의 파일 시스템 메타데이터를
-  // 유지한다.
-  sb_sync(fs->backing_fd, &fs->sb);
+  // 대표로 플러시: 지금까지 발급된 요청을 모두 포함
+  uint64_t target = s->requested;
+  bool full = s->full;
+  s->full = false;
+  s->running = true;
+  pthread_mutex_unlock(&s->lock);
+
+  // 매핑으로 바꾼 메타데이터 페이지를 먼저 기록한 뒤 장치를 플러시
+  discard_seal();
+  int res = meta_flush();
+  if (res == 0)
+    res = (full ? fsync(fs->backing_fd) : fdatasync(fs->backing_fd)) < 0
+              ? -errno
+              : 0;
+  stats_event(SFUSE_EV_DEV_FLUSH, 1);
+  if (res == 0)
+    discard_commit();
+
+  pthread_mutex_lock(&s->lock);
+  s->completed = target;
+  s->result = res;
+  s->running = false;
+  pthread_cond_broadcast(&s->done);
+  pthread_mutex_unlock(&s->lock);
+  return res;
+}
 
-  // 파일 시스템의 종료 작업 이후 메모리에 할당된 비트맵 메모리를 해제하여,
-  // 메모리 누수를 방지한다.
-  free(fs->block_map); // 블록 비트맵 메모리 해제
-  free(fs->inode_map); // inode 비트맵 메모리 해제
+/**
+ * @brief 비트맵과 슈퍼블록을 기록하고 장치를 fsync한다.
+ */
+static int checkpoint_meta(struct sfuse_fs *fs) {
+  int res = sync_maps(fs);
+  if (res < 0)
+    return res;
+  return fs_sync_device(fs, false);
+}
+
+/**
+ * @brief 더티 데이터, 비트맵, 슈퍼블록을 기록하고 장치를 fsync한다.
+ *
+ * 지연 할당을 기록하면서 블록이 할당되므로 비트맵보다 먼저 기록한다.
+ */
+int fs_checkpoint(struct sfuse_fs *fs) {
+  int res = dalloc_flush_all(fs);
+  if (res < 0)
+    return res;
+  return checkpoint_meta(fs);
+}
+
+int fs_freeze(struct sfuse_fs *fs) {
+  /* [1단계] 막기 전에 더티 데이터를 대부분 기록해 막는 시간을 줄임 */
+  int res = fs_checkpoint(fs);
+  if (res < 0)
+    return res;
+
+  /* [2단계] 요청과 백그라운드 작업을 막고 그사이 생긴 변경을 기록 */
+  defrag_io_freeze();
+  res = dalloc_flush_frozen(fs);
+  if (res == 0)
+    res = checkpoint_meta(fs);
+  if (res < 0)
+    defrag_io_thaw();
+  return res;
+}
+
+void fs_thaw(struct sfuse_fs *fs) {
+  (void)fs;
+  defrag_io_thaw();
+}
+
+/**
+ * @brief 커널이 캐시한 경로의 속성과 페이지 캐시를 무효화한다.
+ *
+ * 커널은 attr_timeout/keep_cache 설정에 따라 속성과 파일 데이터를 오래
+ * 캐시하므로, 커널 요청과 무관하게 SFUSE가 내용을 바꾼 경우 이 함수로 알린다.
+ * 커널에 해당 경로가 캐시되어 있지 않으면(-ENOENT) 무시한다.
+ *
+ * @param fs   파일 시스템의 전역 컨텍스트
+ * @param path 무효화할 경로
+ */
+void fs_invalidate_path(struct sfuse_fs *fs, const char *path) {
+  if (!fs->fuse)
+    return; // 마운트 전(초기화 단계)에는 캐시가 없음
+  int res = fuse_invalidate_path(fs->fuse, path);
+  if (res < 0 && res != -ENOENT)
+    fprintf(stderr, "[SFUSE] %s 캐시 무효화 실패: %d\n", path, res);
+}
+
+/** @brief fs_invalidate_ino()가 내려가는 최대 디렉터리 깊이 (순환 방지) */
+#define SFUSE_INVALIDATE_MAX_DEPTH 64
+
+/**
+ * @brief 디렉터리 dir 아래에서 ino를 가리키는 경로를 찾아 무효화한다.
+ *
+ * @param path dir의 경로 (len 바이트, 뒤에 이름을 붙여 씀)
+ */
+static void invalidate_walk(struct sfuse_fs *fs, uint32_t dir, char *path,
+                            size_t len, uint32_t ino, int depth) {
+  size_t size = SFUSE_NDIR_BLOCKS * SFUSE_BLOCK_SIZE;
+  struct sfuse_dirent *ents = calloc(1, size);
+  if (!ents)
+    return;
+  if (dir_load(fs->backing_fd, &fs->sb, dir, ents) < 0) {
+    free(ents);
+    return;
+  }
+  for (size_t i = 0; i < size / sizeof(*ents); i++) {
+    const struct sfuse_dirent *e = &ents[i];
+    if (e->ino == 0 || e->name[0] == '\0' || !strcmp(e->name, ".") ||
+        !strcmp(e->name, ".."))
+      continue;
+    size_t n = strnlen(e->name, SFUSE_NAME_LEN);
+    if (len + 1 + n >= PATH_MAX)
+      continue;
+    path[len] = '/';
+    memcpy(path + len + 1, e->name, n);
+    path[len + 1 + n] = '\0';
+    if (ino == 0 || e->ino == ino)
+      fs_invalidate_path(fs, path);
+    struct sfuse_inode child;
+    if (depth < SFUSE_INVALIDATE_MAX_DEPTH &&
+        inode_load(fs->backing_fd, &fs->sb, e->ino, &child) == 0 &&
+        S_ISDIR(child.mode))
+      invalidate_walk(fs, e->ino, path, len + 1 + n, ino, depth + 1);
+  }
+  path[len] = '\0';
+  free(ents);
+}
+
+void fs_invalidate_ino(struct sfuse_fs *fs, uint32_t ino) {
+  if (!fs->fuse)
+    return;
+  char *path = malloc(PATH_MAX);
+  if (!path)
+    return;
+  path[0] = '\0';
+  if (ino == 0 || ino == SFUSE_ROOT_INO)
+    fs_invalidate_path(fs, "/");
+  invalidate_walk(fs, SFUSE_ROOT_INO, path, 0, ino, 0);
+  free(path);
 }
 
 /**
@@ -441,7 +467,9 @@ int fs_resolve_path(struct sfuse_fs *fs, const char *path, uint32_t *ino_out) {
 
   // 경로 문자열을 "/" 기준으로 토큰(token)으로 나눈다.
   // 예시: "/home/user/file" → ["home", "user", "file"]
-  char *token = strtok(dup, "/");
+  // (FUSE 작업 스레드가 동시에 호출하므로 재진입 가능한 strtok_r 사용)
+  char *save = NULL;
+  char *token = strtok_r(dup, "/", &save);
 
   // 모든 토큰에 대해 순차적으로 디렉터리를 탐색
   while (token) {
@@ -471,10 +499,12 @@ int fs_resolve_path(struct sfuse_fs *fs, const char *path, uint32_t *ino_out) {
     // 현재 디렉터리의 모든 엔트리(entry)를 디스크에서 메모리로 로드한다.
     // dir_load는 cur(현재 inode 번호)에 해당하는 디렉터리 데이터를 버퍼에
     // 채운다.
-    if (dir_load(fs->backing_fd, &fs->sb, cur, buf) < 0) {
+    int res = dir_load(fs->backing_fd, &fs->sb, cur, buf);
+    if (res < 0) {
       free(buf);
       free(dup);
-      return -ENOENT; // 디렉터리를 읽을 수 없는 경우 존재하지 않음 에러 반환
+      // 체크섬 불일치는 그대로 알리고, 그 밖에는 존재하지 않음 에러 반환
+      return res == -EBADMSG ? res : -ENOENT;
     }
 
     // 버퍼의 데이터를 디렉터리 엔트리 배열로 캐스팅하여 접근 가능하도록 설정
@@ -510,7 +540,7 @@ int fs_resolve_path(struct sfuse_fs *fs, const char *path, uint32_t *ino_out) {
     cur = next_ino;
 
     // 다음 토큰으로 넘어감
-    token = strtok(NULL, "/");
+    token = strtok_r(NULL, "/", &save);
   }
 
   // 모든 토큰 탐색이 완료되면, 최종 inode 번호를 결과로 반환
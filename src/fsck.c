@@ -0,0 +1,1667 @@
+/**
+ * @file src/fsck.c
+ * @brief 파일 시스템 검사와 복구(fsck.sfuse) 구현
+ *
+ * 다시 만드는 블록 비트맵(used)은 장치의 블록 비트맵과 같은 형식이다. 비트 i는
+ * 데이터 블록 data_block_start + i를 뜻한다. meta 비트맵은 공유할 수 없는
+ * 블록(인다이렉트, 디렉터리, 압축 구간, 예약 블록, 참조 수 테이블, 스냅숏)을
+ * 표시한다. 일반 파일 데이터 블록만 참조 수 테이블로 공유될 수 있다.
+ *
+ * 파일을 지우면 아이노드 비트맵만 해제하고 레코드는 남기는 경로가 있으므로
+ * 비트맵에서 빈 아이노드의 레코드는 검사하지 않는다. 다만 체크섬이 맞지 않는
+ * 비트맵 블록이 덮는 아이노드는 레코드를 믿는다.
+ *
+ * 하드 링크가 없으므로 디렉터리가 아닌 아이노드는 엔트리 하나가 가리키고 링크
+ * 수가 1이어야 한다. 아이노드마다 상태 1바이트만 두고 디렉터리는 따로 모아
+ * 부모와 ".." 값을 기록하므로, 메모리는 아이노드당 1바이트에 디렉터리 수에
+ * 비례하는 만큼만 쓴다.
+ */
+
+#include "fsck.h"
+#include "bitmap.h"
+#include "block.h"
+#include "compress.h"
+#include "csum.h"
+#include "dedup.h"
+#include "dir.h"
+#include "disk.h"
+#include "fs.h"
+#include "inode.h"
+#include "snap.h"
+#include "super.h"
+#include <endian.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** @name 아이노드 상태 비트 */
+/** @{ */
+#define ST_USED 0x01   /**< 쓰이는 아이노드 (형식 검사 통과) */
+#define ST_DIR 0x02    /**< 디렉터리 */
+#define ST_REG 0x04    /**< 일반 파일 (블록을 공유할 수 있음) */
+#define ST_ORPHAN 0x08 /**< SFUSE_INODE_FLAG_ORPHAN */
+#define ST_LISTED 0x10 /**< 고아 목록에서 닿음 */
+#define ST_BAD 0x20    /**< 손상되어 지울 아이노드 */
+#define ST_LINKED 0x40 /**< 디렉터리 엔트리가 가리킴 (디렉터리 외) */
+#define ST_NLINK 0x80  /**< 링크 수가 1이 아님 (디렉터리 외) */
+/** @} */
+
+/** @brief 디렉터리 하나에서 검사하는 엔트리 자리 수 (직접 블록 전체) */
+#define DIR_SLOTS                                                              \
+  (SFUSE_NDIR_BLOCKS * SFUSE_BLOCK_SIZE / sizeof(struct sfuse_dirent))
+
+/** @brief lost+found에 쓰는 첫 블록의 엔트리 자리 수 (readdir과 같은 범위) */
+#define DIR_BLOCK_SLOTS (SFUSE_BLOCK_SIZE / sizeof(struct sfuse_dirent))
+
+/** @brief 아이노드 안의 블록 포인터 자리 (direct 0~11 뒤) */
+enum { SLOT_IND = SFUSE_NDIR_BLOCKS, SLOT_DIND, SLOT_TIND };
+
+/** @brief 블록 참조 종류 */
+enum { REF_LEAF, REF_META };
+
+/** @brief 디렉터리 도달 여부 */
+enum { REACH_UNKNOWN, REACH_VISITING, REACH_YES, REACH_NO };
+
+/**
+ * @enum fsck_fix_kind
+ * @brief 복구 단계에서 적용할 수정 (적용 순서대로)
+ */
+enum fsck_fix_kind {
+  FIX_CLEAR_INODE, /**< 손상된 아이노드를 지움 */
+  FIX_INODE_CSUM,  /**< 형식이 맞는 아이노드의 체크섬을 다시 기록 */
+  FIX_CLEAR_PTR,   /**< 블록 포인터를 0으로 (a: 담은 블록, 0이면 아이노드) */
+  FIX_CLONE,       /**< 이중 참조 블록을 복제해 가리킴 (b: 원래 포인터) */
+  FIX_ZERO_BLOCK,  /**< 디렉터리 블록을 다시 기록 (a: 블록, b: 0이면 비움) */
+  FIX_DIRENT,      /**< 엔트리 자리의 아이노드 번호를 b로 (0이면 지움) */
+  FIX_DOT,         /**< 없는 "." 엔트리를 더함 */
+  FIX_DOTDOT,      /**< ".."을 b로 (0이면 lost+found), 없으면 더함 */
+  FIX_LINKS,       /**< 링크 수를 b로 */
+  FIX_ORPHAN_NEXT, /**< 고아 목록 연결을 끊음 (ino 0이면 목록 머리) */
+  FIX_ORPHAN_ADD,  /**< 목록 밖의 고아를 목록 머리에 넣음 */
+  FIX_RECONNECT,   /**< lost+found에 "#번호"로 연결 */
+  FIX_NR_KINDS
+};
+
+/**
+ * @struct fsck_fix
+ * @brief 복구 단계에서 적용할 수정 하나
+ */
+struct fsck_fix {
+  uint8_t kind;      /**< enum fsck_fix_kind */
+  uint32_t ino;      /**< 대상 아이노드 (디렉터리 엔트리면 디렉터리) */
+  uint32_t slot;     /**< 포인터나 엔트리 자리 */
+  uint64_t a, b;     /**< 수정마다 다른 값 */
+};
+
+/**
+ * @struct fsck_dir
+ * @brief 검사 중인 디렉터리
+ */
+struct fsck_dir {
+  uint32_t ino;                       /**< 디렉터리 아이노드 번호 */
+  uint32_t parent;                    /**< 부모 디렉터리 (0: 없음) */
+  uint32_t pslot;                     /**< 부모 디렉터리의 엔트리 자리 */
+  uint32_t dotdot;                    /**< ".." 엔트리 값 (0: 없음) */
+  uint16_t skip;                      /**< 읽지 않을 직접 블록 (비트마스크) */
+  bool has_dot;                       /**< "." 엔트리가 있음 */
+  bool lost;                          /**< lost+found로 옮길 디렉터리 */
+  uint8_t reach;                      /**< REACH_* */
+  uint64_t direct[SFUSE_NDIR_BLOCKS]; /**< 직접 블록 포인터 */
+};
+
+/**
+ * @struct fsck_orphan
+ * @brief 고아 플래그가 있는 아이노드와 목록의 다음 번호
+ */
+struct fsck_orphan {
+  uint32_t ino;
+  uint32_t next;
+};
+
+/**
+ * @struct fsck_ref
+ * @brief 먼저 표시된 블록을 다시 가리킨 참조
+ */
+struct fsck_ref {
+  uint64_t pbn;       /**< 블록 번호 */
+  uint64_t raw;       /**< 표시 비트를 포함한 포인터 값 */
+  uint64_t container; /**< 포인터를 담은 블록 (0이면 아이노드) */
+  uint32_t ino;       /**< 참조한 아이노드 */
+  uint16_t slot;      /**< 포인터 자리 */
+  uint8_t kind;       /**< REF_LEAF / REF_META */
+  bool shared;        /**< 참조 수 테이블의 공유로 인정 */
+};
+
+/**
+ * @struct fsck_vec
+ * @brief 원소 크기를 정해 쓰는 가변 배열
+ */
+struct fsck_vec {
+  void *v;
+  size_t n, cap, elem;
+};
+
+/**
+ * @struct fsck_ctx
+ * @brief 검사 전체의 상태
+ */
+struct fsck_ctx {
+  int fd;
+  struct sfuse_super sb;
+  const struct sfuse_fsck_opts *opts;
+  struct sfuse_fsck_result *out;
+  uint64_t data_start, data_blocks;
+  uint64_t rc_lo, rc_hi; /**< 참조 수 테이블과 지문 색인 구간 [lo, hi) */
+  uint8_t *used;         /**< 다시 만든 블록 비트맵 (블록 단위로 패딩) */
+  uint8_t *meta;         /**< 공유할 수 없는 블록 */
+  uint8_t *imap;         /**< 다시 만든 아이노드 비트맵 */
+  uint8_t *state;        /**< 아이노드별 ST_* */
+  size_t bmap_bytes, imap_bytes;
+  _Atomic uint64_t next; /**< 병렬 단계의 다음 작업 번호 */
+  _Atomic int err;       /**< 병렬 단계의 입출력 오류 */
+  pthread_mutex_t lock;  /**< 아래 배열과 출력 보호 */
+  struct fsck_vec dirs, orphans, dups, fixes, snap;
+  bool snap_ok;          /**< 스냅숏을 유지함 */
+  uint32_t lpf;          /**< lost+found 아이노드 (0: 없음) */
+  uint8_t *disk_bmap;    /**< 장치의 블록 비트맵 */
+  uint8_t *disk_imap;    /**< 장치의 아이노드 비트맵 */
+  uint8_t *bmap_stale;   /**< 다시 기록할 블록 비트맵 블록 */
+  uint8_t *imap_stale;   /**< 다시 기록할 아이노드 비트맵 블록 */
+  struct sfuse_fs fs;    /**< 복구 기록에 쓰는 컨텍스트 (스냅숏 보호) */
+};
+
+/**
+ * @struct fsck_worker
+ * @brief 병렬 단계의 스레드별 상태
+ */
+struct fsck_worker {
+  struct fsck_ctx *c;
+  pthread_t thread;
+  struct fsck_vec dirs; /**< 1단계에서 찾은 디렉터리 */
+  uint8_t *buf;         /**< 아이노드 테이블 또는 디렉터리 읽기 버퍼 */
+};
+
+static const char *const problem_names[SFUSE_FSCK_NR_PROBLEMS] = {
+    [SFUSE_FSCK_BAD_INODE] = "손상된 아이노드",
+    [SFUSE_FSCK_BAD_BLOCK] = "잘못된 블록 포인터",
+    [SFUSE_FSCK_DUP_BLOCK] = "이중 할당된 블록 참조",
+    [SFUSE_FSCK_BAD_DIRENT] = "잘못된 디렉터리 엔트리",
+    [SFUSE_FSCK_UNATTACHED] = "연결되지 않은 아이노드",
+    [SFUSE_FSCK_LINK_COUNT] = "링크 수 불일치",
+    [SFUSE_FSCK_ORPHAN] = "고아 목록 오류",
+    [SFUSE_FSCK_REFCOUNT] = "참조 수 불일치",
+    [SFUSE_FSCK_SNAPSHOT] = "스냅숏 예외 테이블 오류",
+    [SFUSE_FSCK_BLOCK_BITMAP] = "블록 비트맵 차이",
+    [SFUSE_FSCK_INODE_BITMAP] = "아이노드 비트맵 차이",
+    [SFUSE_FSCK_COUNTS] = "빈 블록/아이노드 수 불일치",
+};
+
+const char *fsck_problem_name(enum sfuse_fsck_problem p) {
+  return p < SFUSE_FSCK_NR_PROBLEMS ? problem_names[p] : "?";
+}
+
+static int vec_push(struct fsck_vec *vec, const void *x) {
+  if (vec->n == vec->cap) {
+    size_t cap = vec->cap ? vec->cap * 2 : 64;
+    void *v = realloc(vec->v, cap * vec->elem);
+    if (!v)
+      return -ENOMEM;
+    vec->v = v;
+    vec->cap = cap;
+  }
+  memcpy((uint8_t *)vec->v + vec->n * vec->elem, x, vec->elem);
+  vec->n++;
+  return 0;
+}
+
+static void *vec_at(const struct fsck_vec *vec, size_t i) {
+  return (uint8_t *)vec->v + i * vec->elem;
+}
+
+static bool bit_test(const uint8_t *map, uint64_t i) {
+  return map[i / 8] & (1 << (i % 8));
+}
+
+/**
+ * @brief 비트 i를 원자적으로 1로 만든다.
+ *
+ * @return 이미 1이었으면 참
+ */
+static bool bit_set(uint8_t *map, uint64_t i) {
+  uint8_t bit = (uint8_t)(1 << (i % 8));
+  return __atomic_fetch_or(&map[i / 8], bit, __ATOMIC_ACQ_REL) & bit;
+}
+
+static void bit_clear(uint8_t *map, uint64_t i) {
+  __atomic_fetch_and(&map[i / 8], (uint8_t)~(1 << (i % 8)), __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief 문제 하나를 세고, -v이면 출력한다.
+ */
+static void report(struct fsck_ctx *c, enum sfuse_fsck_problem p,
+                   const char *fmt, ...) {
+  __atomic_add_fetch(&c->out->problems[p], 1, __ATOMIC_RELAXED);
+  if (!c->opts->verbose)
+    return;
+  va_list ap;
+  va_start(ap, fmt);
+  pthread_mutex_lock(&c->lock);
+  vprintf(fmt, ap);
+  putchar('\n');
+  pthread_mutex_unlock(&c->lock);
+  va_end(ap);
+}
+
+/**
+ * @brief 복구 단계에서 적용할 수정을 더한다.
+ */
+static void add_fix(struct fsck_ctx *c, uint8_t kind, uint32_t ino,
+                    uint32_t slot, uint64_t a, uint64_t b) {
+  struct fsck_fix f = {.kind = kind, .ino = ino, .slot = slot, .a = a, .b = b};
+  pthread_mutex_lock(&c->lock);
+  if (vec_push(&c->fixes, &f) < 0)
+    atomic_store(&c->err, -ENOMEM);
+  pthread_mutex_unlock(&c->lock);
+}
+
+static void add_locked(struct fsck_ctx *c, struct fsck_vec *vec,
+                       const void *x) {
+  pthread_mutex_lock(&c->lock);
+  if (vec_push(vec, x) < 0)
+    atomic_store(&c->err, -ENOMEM);
+  pthread_mutex_unlock(&c->lock);
+}
+
+/**
+ * @brief 스레드 n개로 fn을 실행하고 모두 끝날 때까지 기다린다.
+ *
+ * 작업은 fn이 c->next를 원자적으로 늘려 가져간다.
+ */
+static int run_workers(struct fsck_ctx *c, struct fsck_worker *w, uint32_t n,
+                       void *(*fn)(void *)) {
+  atomic_store(&c->next, 0);
+  uint32_t started = 0;
+  for (; started < n; started++)
+    if (pthread_create(&w[started].thread, NULL, fn, &w[started]) != 0)
+      break;
+  if (started == 0)
+    fn(&w[0]); // 스레드를 만들 수 없으면 현재 스레드에서 실행
+  for (uint32_t i = 0; i < started; i++)
+    pthread_join(w[i].thread, NULL);
+  return atomic_load(&c->err);
+}
+
+/* ------------------------------------------------------------------------ */
+/* 1단계: 아이노드 테이블과 블록 트리                                       */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * @brief 블록 포인터 하나를 표시하고, 인다이렉트 블록이면 따라 내려간다.
+ *
+ * @param level     0이면 데이터 블록, 1~3이면 인다이렉트 단계
+ * @param raw       포인터 값 (데이터 블록이면 표시 비트 포함)
+ * @param container 포인터를 담은 블록 (0이면 아이노드)
+ * @param slot      포인터 자리
+ * @param st        아이노드 상태 (ST_*)
+ * @param dskip     디렉터리의 직접 블록을 읽지 않도록 표시할 마스크 (NULL 가능)
+ */
+static void walk_ptr(struct fsck_ctx *c, uint32_t ino, int level, uint64_t raw,
+                     uint64_t container, uint32_t slot, uint8_t st,
+                     uint16_t *dskip) {
+  if (raw == 0)
+    return;
+  uint64_t flags = 0, pbn = raw;
+  if (level == 0 && !(st & ST_DIR)) {
+    flags = raw & (SFUSE_BLOCK_UNWRITTEN | SFUSE_BLOCK_COMPRESSED);
+    pbn = raw & ~flags;
+    if (flags == SFUSE_BLOCK_COMPRESSED && pbn == 0)
+      return; // 압축 구간보다 뒤의 클러스터 블록
+  }
+
+  /* [1단계] 범위 확인 */
+  if (flags == (SFUSE_BLOCK_UNWRITTEN | SFUSE_BLOCK_COMPRESSED) ||
+      pbn < c->data_start || pbn >= c->sb.blocks_count ||
+      (pbn >= c->rc_lo && pbn < c->rc_hi)) {
+    report(c, SFUSE_FSCK_BAD_BLOCK,
+           "아이노드 %u: 잘못된 블록 포인터 0x%" PRIx64, ino, raw);
+    add_fix(c, FIX_CLEAR_PTR, ino, slot, container, 0);
+    if (dskip && container == 0 && slot < SFUSE_NDIR_BLOCKS)
+      *dskip |= (uint16_t)(1u << slot);
+    return;
+  }
+
+  /* [2단계] 사용 표시 (이미 표시되어 있으면 이중 참조로 모음) */
+  uint64_t i = pbn - c->data_start;
+  uint8_t kind =
+      level == 0 && (st & ST_REG) && flags == 0 ? REF_LEAF : REF_META;
+  if (bit_set(c->used, i)) {
+    struct fsck_ref r = {.pbn = pbn,
+                         .raw = raw,
+                         .container = container,
+                         .ino = ino,
+                         .slot = (uint16_t)slot,
+                         .kind = kind};
+    add_locked(c, &c->dups, &r);
+    if (dskip && container == 0 && slot < SFUSE_NDIR_BLOCKS)
+      *dskip |= (uint16_t)(1u << slot);
+    return;
+  }
+  if (kind == REF_META)
+    bit_set(c->meta, i);
+  if (level == 0)
+    return;
+
+  /* [3단계] 인다이렉트 블록의 포인터를 따라감 */
+  uint64_t blk[SFUSE_ADDR_PER_BLOCK];
+  int res = read_block(c->fd, pbn, blk);
+  if (res < 0) {
+    // 내용을 믿을 수 없으므로 이 아이노드에서 떼어 냄
+    bit_clear(c->meta, i);
+    bit_clear(c->used, i);
+    report(c, SFUSE_FSCK_BAD_BLOCK,
+           "아이노드 %u: 인다이렉트 블록 %" PRIu64 " 읽기 실패 (%d)", ino,
+           pbn, res);
+    add_fix(c, FIX_CLEAR_PTR, ino, slot, container, 0);
+    return;
+  }
+  for (uint32_t e = 0; e < SFUSE_ADDR_PER_BLOCK; e++)
+    walk_ptr(c, ino, level - 1, le64toh(blk[e]), pbn, e, st, NULL);
+}
+
+/**
+ * @brief 아이노드 레코드 하나를 검사하고 블록을 표시한다.
+ */
+static void check_inode(struct fsck_worker *w, uint32_t ino,
+                        const uint8_t *rec) {
+  struct fsck_ctx *c = w->c;
+  struct sfuse_inode inode;
+  bool bad_csum = inode_decode(&c->sb, ino, rec, &inode) < 0;
+
+  /* [1단계] 형식 확인 (체크섬만 틀리면 형식과 블록 포인터를 검사해 살림) */
+  mode_t fmt = inode.mode & S_IFMT;
+  bool known = fmt == S_IFREG || fmt == S_IFDIR || fmt == S_IFLNK ||
+               fmt == S_IFCHR || fmt == S_IFBLK || fmt == S_IFIFO ||
+               fmt == S_IFSOCK;
+  bool bad_inline = inode_is_inline(&inode) &&
+                    (fmt == S_IFDIR ||
+                     inode.size > inode_inline_capacity(&c->sb));
+  if (!known || bad_inline) {
+    c->state[ino] = ST_BAD;
+    report(c, SFUSE_FSCK_BAD_INODE, "아이노드 %u: 잘못된 형식 (mode 0%o)%s",
+           ino, (unsigned)inode.mode, bad_csum ? ", 체크섬 불일치" : "");
+    add_fix(c, FIX_CLEAR_INODE, ino, 0, 0, 0);
+    return;
+  }
+  if (bad_csum) {
+    report(c, SFUSE_FSCK_BAD_INODE, "아이노드 %u: 체크섬 불일치", ino);
+    add_fix(c, FIX_INODE_CSUM, ino, 0, 0, 0);
+  }
+
+  uint8_t st = ST_USED;
+  if (fmt == S_IFDIR)
+    st |= ST_DIR;
+  else if (fmt == S_IFREG)
+    st |= ST_REG;
+  if (inode.flags & SFUSE_INODE_FLAG_ORPHAN) {
+    st |= ST_ORPHAN;
+    struct fsck_orphan o = {.ino = ino, .next = (uint32_t)inode.atime};
+    add_locked(c, &c->orphans, &o);
+  }
+  if (!(st & (ST_DIR | ST_ORPHAN)) && inode.links != 1)
+    st |= ST_NLINK;
+  c->state[ino] = st;
+  __atomic_add_fetch(&c->out->inodes, 1, __ATOMIC_RELAXED);
+  if (inode_is_inline(&inode))
+    return;
+
+  /* [2단계] 블록 트리 */
+  struct fsck_dir d = {.ino = ino};
+  uint16_t *dskip = (st & ST_DIR) ? &d.skip : NULL;
+  for (uint32_t k = 0; k < SFUSE_NDIR_BLOCKS; k++)
+    walk_ptr(c, ino, 0, inode.direct[k], 0, k, st, dskip);
+  walk_ptr(c, ino, 1, inode.indirect, 0, SLOT_IND, st, NULL);
+  walk_ptr(c, ino, 2, inode.double_indirect, 0, SLOT_DIND, st, NULL);
+  walk_ptr(c, ino, 3, inode.triple_indirect, 0, SLOT_TIND, st, NULL);
+
+  if (st & ST_DIR) {
+    memcpy(d.direct, inode.direct, sizeof(d.direct));
+    if (vec_push(&w->dirs, &d) < 0)
+      atomic_store(&c->err, -ENOMEM);
+  }
+}
+
+/**
+ * @brief 비트 구간 [lo, hi)가 모두 0인지 확인한다.
+ */
+static bool bits_clear(const uint8_t *map, uint64_t lo, uint64_t hi) {
+  for (uint64_t i = lo; i < hi;) {
+    if (i % 8 == 0 && i + 8 <= hi) {
+      if (map[i / 8])
+        return false;
+      i += 8;
+    } else if (bit_test(map, i++)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief 1단계 스레드: 아이노드 테이블을 큰 순차 읽기 단위로 가져가 검사한다.
+ */
+static void *inode_worker(void *arg) {
+  struct fsck_worker *w = arg;
+  struct fsck_ctx *c = w->c;
+  uint32_t isz = c->sb.inode_size;
+  uint64_t per_chunk = SFUSE_FSCK_CHUNK_BYTES / isz;
+  uint64_t nchunks = (c->sb.inodes_count + per_chunk - 1) / per_chunk;
+
+  for (;;) {
+    uint64_t k = atomic_fetch_add(&c->next, 1);
+    if (k >= nchunks || atomic_load(&c->err))
+      break;
+    uint64_t first = k * per_chunk;
+    uint64_t n = c->sb.inodes_count - first < per_chunk
+                     ? c->sb.inodes_count - first
+                     : per_chunk;
+    if (bits_clear(c->disk_imap, first, first + n))
+      continue; // 비트맵에서 모두 빈 구간은 읽지 않음
+    off_t off = (off_t)c->sb.inode_table_start * SFUSE_BLOCK_SIZE +
+                (off_t)(first * isz);
+    ssize_t ret = disk_read(c->fd, w->buf, n * isz, off);
+    if (ret != (ssize_t)(n * isz)) {
+      atomic_store(&c->err, ret < 0 ? (int)ret : -EIO);
+      break;
+    }
+    for (uint64_t i = 0; i < n; i++) {
+      uint32_t ino = (uint32_t)(first + i);
+      const uint8_t *rec = w->buf + i * isz;
+      uint32_t mode;
+      memcpy(&mode, rec, sizeof(mode));
+      if (ino != 0 && mode != 0 && bit_test(c->disk_imap, ino))
+        check_inode(w, ino, rec);
+    }
+  }
+  return NULL;
+}
+
+/* ------------------------------------------------------------------------ */
+/* 2단계: 디렉터리 엔트리                                                   */
+/* ------------------------------------------------------------------------ */
+
+static int dir_cmp(const void *a, const void *b) {
+  uint32_t x = ((const struct fsck_dir *)a)->ino;
+  uint32_t y = ((const struct fsck_dir *)b)->ino;
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief 디렉터리 아이노드 번호로 검사 중인 디렉터리를 찾는다.
+ */
+static struct fsck_dir *dir_find(struct fsck_ctx *c, uint32_t ino) {
+  struct fsck_dir key = {.ino = ino};
+  if (!c->dirs.n)
+    return NULL;
+  return bsearch(&key, c->dirs.v, c->dirs.n, sizeof(key), dir_cmp);
+}
+
+/**
+ * @brief 엔트리 이름이 NUL로 끝나고 비어 있지 않으며 '/'가 없는지 확인한다.
+ */
+static bool name_valid(const struct sfuse_dirent *e) {
+  const char *end = memchr(e->name, '\0', sizeof(e->name));
+  return end && end != e->name && !memchr(e->name, '/', end - e->name);
+}
+
+/**
+ * @brief 디렉터리의 엔트리 하나를 검사한다.
+ */
+static void check_dirent(struct fsck_ctx *c, struct fsck_dir *d, uint32_t s,
+                         const struct sfuse_dirent *e) {
+  uint32_t t = e->ino;
+  if (!name_valid(e)) {
+    report(c, SFUSE_FSCK_BAD_DIRENT, "디렉터리 %u: 엔트리 %u의 이름이 잘못됨",
+           d->ino, s);
+    add_fix(c, FIX_DIRENT, d->ino, s, 0, 0);
+    return;
+  }
+  if (strcmp(e->name, ".") == 0) {
+    if (t != d->ino) {
+      report(c, SFUSE_FSCK_BAD_DIRENT, "디렉터리 %u: \".\" -> %u",
+             d->ino, t);
+      add_fix(c, FIX_DIRENT, d->ino, s, 0, d->ino);
+    }
+    d->has_dot = true;
+    return;
+  }
+  if (strcmp(e->name, "..") == 0) {
+    d->dotdot = t; // 부모를 모두 구한 뒤 확인
+    return;
+  }
+
+  const char *why = NULL;
+  struct fsck_dir *td = NULL;
+  if (t >= c->sb.inodes_count || !(c->state[t] & ST_USED))
+    why = "쓰이지 않는 아이노드";
+  else if (c->state[t] & ST_ORPHAN)
+    why = "지워지는 중인 아이노드";
+  else if (!(c->state[t] & ST_DIR)) {
+    if (__atomic_fetch_or(&c->state[t], ST_LINKED, __ATOMIC_RELAXED) &
+        ST_LINKED)
+      why = "다른 엔트리가 이미 가리키는 파일";
+  } else {
+    td = dir_find(c, t);
+    uint32_t none = 0;
+    if (!td || t == d->ino ||
+        !__atomic_compare_exchange_n(&td->parent, &none, d->ino, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+      why = "이미 부모가 있는 디렉터리";
+    else
+      td->pslot = s;
+  }
+  if (why) {
+    report(c, SFUSE_FSCK_BAD_DIRENT, "디렉터리 %u: \"%s\" -> %u (%s)", d->ino,
+           e->name, t, why);
+    add_fix(c, FIX_DIRENT, d->ino, s, 0, 0);
+    return;
+  }
+
+  if (d->ino == SFUSE_ROOT_INO && td &&
+      strcmp(e->name, SFUSE_FSCK_LOST_FOUND) == 0)
+    c->lpf = t;
+}
+
+/**
+ * @brief 2단계 스레드: 디렉터리를 하나씩 가져가 엔트리를 검사한다.
+ */
+static void *dir_worker(void *arg) {
+  struct fsck_worker *w = arg;
+  struct fsck_ctx *c = w->c;
+  for (;;) {
+    uint64_t k = atomic_fetch_add(&c->next, 1);
+    if (k >= c->dirs.n || atomic_load(&c->err))
+      break;
+    struct fsck_dir *d = vec_at(&c->dirs, k);
+
+    /* [1단계] 직접 블록을 읽음 (읽을 수 없는 블록은 비우도록 표시) */
+    bool have[SFUSE_NDIR_BLOCKS] = {false};
+    memset(w->buf, 0, SFUSE_NDIR_BLOCKS * SFUSE_BLOCK_SIZE);
+    for (uint32_t b = 0; b < SFUSE_NDIR_BLOCKS; b++) {
+      if (!d->direct[b] || (d->skip & (1u << b)))
+        continue;
+      int res = read_block(c->fd, d->direct[b],
+                           w->buf + (size_t)b * SFUSE_BLOCK_SIZE);
+      if (res == -EBADMSG) {
+        // 내용은 엔트리마다 검사하고 체크섬만 다시 기록
+        report(c, SFUSE_FSCK_BAD_DIRENT,
+               "디렉터리 %u: 블록 %" PRIu64 " 체크섬 불일치", d->ino,
+               d->direct[b]);
+        add_fix(c, FIX_ZERO_BLOCK, d->ino, b, d->direct[b], 1);
+      } else if (res < 0) {
+        memset(w->buf + (size_t)b * SFUSE_BLOCK_SIZE, 0, SFUSE_BLOCK_SIZE);
+        report(c, SFUSE_FSCK_BAD_DIRENT,
+               "디렉터리 %u: 블록 %" PRIu64 " 읽기 실패 (%d)", d->ino,
+               d->direct[b], res);
+        add_fix(c, FIX_ZERO_BLOCK, d->ino, b, d->direct[b], 0);
+      }
+      have[b] = true;
+    }
+
+    /* [2단계] 엔트리 검사 */
+    // lookup처럼 없는 블록은 0으로 본다. 블록 경계에 걸친 엔트리는 아이노드
+    // 번호가 든 앞 블록이 있으면 검사한다.
+    const struct sfuse_dirent *ents = (const struct sfuse_dirent *)w->buf;
+    for (uint32_t s = 0; s < DIR_SLOTS; s++) {
+      if (!have[(size_t)s * sizeof(*ents) / SFUSE_BLOCK_SIZE] ||
+          ents[s].ino == 0)
+        continue;
+      check_dirent(c, d, s, &ents[s]);
+    }
+  }
+  return NULL;
+}
+
+/* ------------------------------------------------------------------------ */
+/* 3단계: 전체 확인                                                         */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * @brief 스냅숏 예외 테이블을 읽어 테이블 블록과 복사본을 모은다.
+ *
+ * 원본이 쓰는 블록과 겹치거나 테이블이 손상되었으면 스냅숏을 버린다. 복구하면
+ * 스냅숏 기능을 지우고, 모은 블록은 표시하지 않아 비트맵에서 해제된다.
+ */
+static int check_snapshot(struct fsck_ctx *c) {
+  if (!(c->sb.feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_SNAPSHOT))
+    return 0;
+
+  uint64_t blk[SFUSE_BLOCK_SIZE / 8];
+  uint64_t cur = c->sb.snap_table;
+  const char *why = NULL;
+  bool invalid = false;
+  for (uint64_t n = 0; cur && !why; n++) {
+    if (cur < c->data_start || cur >= c->sb.blocks_count ||
+        n > c->data_blocks) {
+      why = "테이블 연결이 잘못됨";
+      break;
+    }
+    // 테이블 블록은 체크섬 테이블을 거치지 않고 기록된다.
+    off_t off = (off_t)cur * SFUSE_BLOCK_SIZE;
+    if (disk_read(c->fd, blk, SFUSE_BLOCK_SIZE, off) != SFUSE_BLOCK_SIZE)
+      return -EIO;
+    uint64_t hdr = le64toh(blk[0]);
+    if ((uint32_t)hdr != SFUSE_SNAP_MAGIC) {
+      why = "테이블 블록의 매직 넘버가 다름";
+      break;
+    }
+    if ((hdr >> 32) & SFUSE_SNAP_F_INVALID)
+      invalid = true;
+    if (vec_push(&c->snap, &cur) < 0)
+      return -ENOMEM;
+    for (uint32_t k = 0; k < SFUSE_SNAP_ENTRIES; k++) {
+      uint64_t orig = le64toh(blk[2 + 2 * k]), copy = le64toh(blk[3 + 2 * k]);
+      if (!copy)
+        break;
+      if (orig >= c->sb.blocks_count || copy < c->data_start ||
+          copy >= c->sb.blocks_count) {
+        why = "항목이 장치 밖을 가리킴";
+        break;
+      }
+      if (vec_push(&c->snap, &copy) < 0)
+        return -ENOMEM;
+    }
+    cur = le64toh(blk[1]);
+  }
+
+  // 스냅숏 블록은 원본 파일과도, 서로와도 겹치지 않아야 함
+  size_t marked = 0;
+  for (; marked < c->snap.n && !why; marked++) {
+    uint64_t b = *(uint64_t *)vec_at(&c->snap, marked);
+    if ((b >= c->rc_lo && b < c->rc_hi) ||
+        bit_set(c->used, b - c->data_start)) {
+      why = "원본 파일이 쓰는 블록과 겹침";
+      break;
+    }
+    bit_set(c->meta, b - c->data_start);
+  }
+  if (why) {
+    // 표시한 스냅숏 블록을 되돌림
+    for (size_t k = 0; k < marked; k++) {
+      uint64_t b = *(uint64_t *)vec_at(&c->snap, k);
+      bit_clear(c->meta, b - c->data_start);
+      bit_clear(c->used, b - c->data_start);
+    }
+    report(c, SFUSE_FSCK_SNAPSHOT, "스냅숏: %s, 스냅숏을 지웁니다", why);
+    c->snap_ok = false;
+    return 0;
+  }
+  c->snap_ok = true;
+  if (invalid)
+    printf("공간이 부족해 무효가 된 스냅숏이 있습니다. (snapshot_delete로 "
+           "지우세요)\n");
+  return 0;
+}
+
+static int orphan_cmp(const void *a, const void *b) {
+  uint32_t x = ((const struct fsck_orphan *)a)->ino;
+  uint32_t y = ((const struct fsck_orphan *)b)->ino;
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief 고아 목록을 따라가 확인한다.
+ *
+ * 목록이 고아가 아닌 아이노드를 가리키거나 순환하면 거기서 끊고, 목록에서 닿지
+ * 않는 고아는 목록 머리에 다시 넣어 다음 마운트의 회수 스레드가 블록을 회수하게
+ * 한다.
+ */
+static void check_orphans(struct fsck_ctx *c) {
+  if (c->orphans.n) // 빈 벡터의 v는 NULL이라 qsort/bsearch에 넘길 수 없다
+    qsort(c->orphans.v, c->orphans.n, sizeof(struct fsck_orphan), orphan_cmp);
+  uint32_t prev = 0, cur = c->sb.last_orphan;
+  while (cur) {
+    struct fsck_orphan key = {.ino = cur};
+    struct fsck_orphan *o = NULL;
+    if (c->orphans.n)
+      o = bsearch(&key, c->orphans.v, c->orphans.n, sizeof(key), orphan_cmp);
+    if (!o || (c->state[cur] & ST_LISTED)) {
+      report(c, SFUSE_FSCK_ORPHAN, "고아 목록: %u -> %u, 고아가 아님",
+             prev, cur);
+      add_fix(c, FIX_ORPHAN_NEXT, prev, 0, 0, 0);
+      break;
+    }
+    c->state[cur] |= ST_LISTED;
+    prev = cur;
+    cur = o->next;
+  }
+  for (size_t k = 0; k < c->orphans.n; k++) {
+    uint32_t ino = ((struct fsck_orphan *)vec_at(&c->orphans, k))->ino;
+    if (c->state[ino] & ST_LISTED)
+      continue;
+    report(c, SFUSE_FSCK_ORPHAN, "아이노드 %u: 고아 목록에 없는 고아", ino);
+    add_fix(c, FIX_ORPHAN_ADD, ino, 0, 0, 0);
+  }
+}
+
+/**
+ * @brief 디렉터리가 루트에서 닿는지 부모를 따라 확인한다.
+ *
+ * 부모가 없는 디렉터리와, 루트에 닿지 않는 순환에 든 디렉터리 하나를
+ * lost+found로 옮긴다. (순환은 부모의 엔트리를 지워 끊는다) 그 아래의
+ * 디렉터리는 함께 옮겨지므로 그대로 둔다.
+ */
+static int check_tree(struct fsck_ctx *c) {
+  struct fsck_dir **path = malloc(c->dirs.n * sizeof(*path));
+  if (!path)
+    return -ENOMEM;
+  for (size_t k = 0; k < c->dirs.n; k++) {
+    struct fsck_dir *x = vec_at(&c->dirs, k);
+    size_t np = 0;
+    uint8_t res;
+    for (;;) {
+      if (x->reach == REACH_YES || x->reach == REACH_NO) {
+        res = x->reach;
+        break;
+      }
+      if (x->reach == REACH_VISITING || x->parent == 0) {
+        report(c, SFUSE_FSCK_UNATTACHED, "디렉터리 %u: 루트에서 닿지 않음%s",
+               x->ino, x->parent ? " (순환)" : "");
+        if (x->parent)
+          add_fix(c, FIX_DIRENT, x->parent, x->pslot, 0, 0);
+        add_fix(c, FIX_RECONNECT, x->ino, 0, 0, 0);
+        x->parent = 0;
+        x->lost = true;
+        if (x->reach != REACH_VISITING)
+          path[np++] = x;
+        res = REACH_NO;
+        break;
+      }
+      x->reach = REACH_VISITING;
+      path[np++] = x;
+      x = dir_find(c, x->parent);
+    }
+    while (np)
+      path[--np]->reach = res;
+  }
+  free(path);
+
+  // "."과 ".." 확인
+  for (size_t k = 0; k < c->dirs.n; k++) {
+    struct fsck_dir *d = vec_at(&c->dirs, k);
+    if (!d->has_dot) {
+      report(c, SFUSE_FSCK_BAD_DIRENT, "디렉터리 %u: \".\"이 없음", d->ino);
+      add_fix(c, FIX_DOT, d->ino, 0, 0, 0);
+    }
+    if (d->lost) {
+      add_fix(c, FIX_DOTDOT, d->ino, 0, 0, 0); // lost+found를 가리키도록
+      continue;
+    }
+    uint32_t want = d->ino == SFUSE_ROOT_INO ? SFUSE_ROOT_INO : d->parent;
+    if (d->dotdot != want) {
+      report(c, SFUSE_FSCK_BAD_DIRENT, "디렉터리 %u: \"..\"이 %u (부모 %u)",
+             d->ino, d->dotdot, want);
+      add_fix(c, FIX_DOTDOT, d->ino, 0, 0, want);
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief 디렉터리가 아닌 아이노드의 연결과 링크 수를 확인한다.
+ */
+static void check_links(struct fsck_ctx *c) {
+  for (uint32_t ino = 1; ino < c->sb.inodes_count; ino++) {
+    uint8_t st = c->state[ino];
+    if (!(st & ST_USED) || (st & (ST_DIR | ST_ORPHAN)))
+      continue;
+    if (!(st & ST_LINKED)) {
+      report(c, SFUSE_FSCK_UNATTACHED, "아이노드 %u: 어느 디렉터리에도 없음",
+             ino);
+      add_fix(c, FIX_RECONNECT, ino, 0, 0, 0);
+    }
+    if (st & ST_NLINK) {
+      report(c, SFUSE_FSCK_LINK_COUNT, "아이노드 %u: 링크 수가 1이 아님", ino);
+      add_fix(c, FIX_LINKS, ino, 0, 0, 1);
+    }
+  }
+}
+
+static int ref_cmp(const void *a, const void *b) {
+  uint64_t x = ((const struct fsck_ref *)a)->pbn;
+  uint64_t y = ((const struct fsck_ref *)b)->pbn;
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief 이중 참조를 공유, 복제, 떼어 냄으로 나눈다.
+ *
+ * 처음 표시한 참조와 이 참조가 모두 일반 파일 데이터 블록이면 참조 수 테이블
+ * (REFCOUNT 기능)이 있을 때 공유로 인정하고 참조 수를 맞춘다. 테이블이 없으면
+ * 블록을 복제해 나눠 준다. 인다이렉트, 디렉터리, 압축 구간이 얽힌 참조는 나중
+ * 참조의 포인터를 지운다.
+ */
+static void check_dups(struct fsck_ctx *c) {
+  if (c->dups.n)
+    qsort(c->dups.v, c->dups.n, sizeof(struct fsck_ref), ref_cmp);
+  bool rc = c->sb.feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_REFCOUNT;
+  for (size_t k = 0; k < c->dups.n; k++) {
+    struct fsck_ref *r = vec_at(&c->dups, k);
+    bool leaf = r->kind == REF_LEAF &&
+                !bit_test(c->meta, r->pbn - c->data_start);
+    if (leaf && rc) {
+      r->shared = true;
+      c->out->shared++;
+      continue;
+    }
+    report(c, SFUSE_FSCK_DUP_BLOCK,
+           "아이노드 %u: 블록 %" PRIu64 ", 다른 곳에서도 가리킴 (%s)", r->ino,
+           r->pbn, leaf ? "복제" : "포인터 지움");
+    add_fix(c, leaf ? FIX_CLONE : FIX_CLEAR_PTR, r->ino, r->slot,
+            r->container, r->raw);
+  }
+}
+
+/**
+ * @brief 참조 수 테이블을 다시 계산한 값과 비교한다. (REFCOUNT 기능)
+ *
+ * 공유로 인정한 일반 파일 데이터 블록은 추가 참조 수를, 나머지 블록은 0을
+ * 가져야 한다. 지문 색인 표시는 쓰이는 일반 파일 데이터 블록에만 남긴다.
+ * (지문 색인은 표시가 없는 블록의 항목을 무시한다)
+ *
+ * @param write 참이면 다른 블록을 고쳐 기록한다
+ */
+static int check_refcounts(struct fsck_ctx *c, bool write) {
+  if (!(c->sb.feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_REFCOUNT))
+    return 0;
+  uint16_t blk[SFUSE_REFCOUNT_PER_BLOCK];
+  size_t di = 0;
+  for (uint32_t t = 0; t < c->sb.refcount_blocks; t++) {
+    int res = read_block(c->fd, c->sb.refcount_start + t, blk);
+    if (res < 0 && res != -EBADMSG)
+      return res;
+    bool dirty = res < 0;
+    if (dirty && !write)
+      report(c, SFUSE_FSCK_REFCOUNT, "참조 수 테이블 블록 %u 체크섬 불일치",
+             t);
+    for (uint32_t j = 0; j < SFUSE_REFCOUNT_PER_BLOCK; j++) {
+      uint64_t idx = (uint64_t)t * SFUSE_REFCOUNT_PER_BLOCK + j;
+      if (idx >= c->data_blocks)
+        break;
+      uint64_t pbn = c->data_start + idx;
+      uint16_t v = le16toh(blk[j]), want = 0;
+      if (bit_test(c->used, idx) && !bit_test(c->meta, idx)) {
+        uint64_t extra = 0;
+        for (; di < c->dups.n &&
+               ((struct fsck_ref *)vec_at(&c->dups, di))->pbn < pbn;
+             di++)
+          ;
+        for (size_t k = di; k < c->dups.n; k++) {
+          struct fsck_ref *r = vec_at(&c->dups, k);
+          if (r->pbn != pbn)
+            break;
+          extra += r->shared;
+        }
+        if (extra > SFUSE_REFCOUNT_MASK)
+          extra = SFUSE_REFCOUNT_MASK;
+        want = (uint16_t)((v & SFUSE_REFCOUNT_INDEXED) | extra);
+      }
+      if (v == want)
+        continue;
+      if (!write)
+        report(c, SFUSE_FSCK_REFCOUNT,
+               "블록 %" PRIu64 ": 참조 수 0x%x, 예상 0x%x", pbn, v, want);
+      blk[j] = htole16(want);
+      dirty = true;
+    }
+    if (write && dirty && (res = write_block(c->fd, c->sb.refcount_start + t,
+                                             blk)) < 0)
+      return res;
+  }
+  return 0;
+}
+
+/**
+ * @brief 비트 구간 [0, n)에서 1인 비트 수를 센다.
+ */
+static uint64_t count_bits(const uint8_t *map, uint64_t n) {
+  uint64_t used = 0, i = 0;
+  for (; i + 64 <= n; i += 64) {
+    uint64_t w;
+    memcpy(&w, map + i / 8, sizeof(w));
+    used += (uint64_t)__builtin_popcountll(w);
+  }
+  for (; i < n; i++)
+    used += bit_test(map, i);
+  return used;
+}
+
+/**
+ * @brief 장치의 비트맵을 읽어 다시 만든 비트맵과 비교한다.
+ *
+ * @param map   다시 만든 비트맵
+ * @param disk  장치의 비트맵을 읽을 버퍼
+ * @param stale 비트맵 블록마다 다시 기록할지 표시할 배열
+ * @param start 비트맵 시작 블록 번호
+ * @param bytes 비트맵 크기 (바이트)
+ * @param extra 장치에만 1인 비트 수를 받을 포인터
+ * @param lack  다시 만든 비트맵에만 1인 비트 수를 받을 포인터
+ */
+static int compare_bitmap(struct fsck_ctx *c, const uint8_t *map,
+                          uint8_t *disk, uint8_t *stale, uint64_t start,
+                          size_t bytes, uint64_t *extra, uint64_t *lack) {
+  ssize_t ret =
+      disk_read(c->fd, disk, bytes, (off_t)start * SFUSE_BLOCK_SIZE);
+  if (ret != (ssize_t)bytes)
+    return ret < 0 ? (int)ret : -EIO;
+  *extra = *lack = 0;
+  for (size_t off = 0; off < bytes; off += SFUSE_BLOCK_SIZE) {
+    size_t len = bytes - off < SFUSE_BLOCK_SIZE ? bytes - off
+                                                : SFUSE_BLOCK_SIZE;
+    for (size_t i = off; i < off + len; i++) {
+      *extra += (uint64_t)__builtin_popcount(disk[i] & ~map[i] & 0xff);
+      *lack += (uint64_t)__builtin_popcount(map[i] & ~disk[i] & 0xff);
+    }
+    uint64_t k = off / SFUSE_BLOCK_SIZE;
+    stale[k] = memcmp(disk + off, map + off, len) != 0 ||
+               csum_verify(start + k, disk + off, len) < 0;
+  }
+  return 0;
+}
+
+/**
+ * @brief 그룹 g의 빈 블록 수를 다시 만든 비트맵에서 센다.
+ */
+static uint64_t group_free(const struct fsck_ctx *c, uint64_t g) {
+  uint64_t first = g * c->sb.blocks_per_group;
+  uint64_t end = first + c->sb.blocks_per_group < c->data_blocks
+                     ? first + c->sb.blocks_per_group
+                     : c->data_blocks;
+  uint64_t used = 0;
+  for (uint64_t i = first; i < end; i++)
+    used += bit_test(c->used, i);
+  return (end - first) - used;
+}
+
+/**
+ * @brief 그룹 요약 테이블 블록 t를 다시 만든 비트맵으로 채운다.
+ */
+static void summary_fill(const struct fsck_ctx *c, uint64_t t,
+                         uint64_t *raw) {
+  memset(raw, 0, SFUSE_BLOCK_SIZE);
+  for (uint64_t k = 0; k < SFUSE_SUMMARY_PER_BLOCK; k++) {
+    uint64_t g = t * SFUSE_SUMMARY_PER_BLOCK + k;
+    if (g < c->sb.groups_count)
+      raw[k] = htole64(group_free(c, g));
+  }
+}
+
+/**
+ * @brief 비트맵, 그룹 요약, 빈 블록/아이노드 수를 장치의 값과 비교한다.
+ */
+static int check_bitmaps(struct fsck_ctx *c) {
+  for (uint32_t ino = 1; ino < c->sb.inodes_count; ino++)
+    if (c->state[ino] & ST_USED)
+      c->imap[ino / 8] |= (uint8_t)(1 << (ino % 8));
+
+  uint64_t extra, lack;
+  int res = compare_bitmap(c, c->used, c->disk_bmap, c->bmap_stale,
+                           c->sb.block_bitmap_start, c->bmap_bytes, &extra,
+                           &lack);
+  if (res < 0)
+    return res;
+  c->out->leaked = extra;
+  c->out->missing = lack;
+  c->out->problems[SFUSE_FSCK_BLOCK_BITMAP] += extra + lack;
+  if (extra + lack && c->opts->verbose)
+    printf("블록 비트맵: 누수 %" PRIu64 "개, 누락 %" PRIu64 "개\n", extra,
+           lack);
+
+  res = compare_bitmap(c, c->imap, c->disk_imap, c->imap_stale,
+                       c->sb.inode_bitmap_start, c->imap_bytes, &extra, &lack);
+  if (res < 0)
+    return res;
+  c->out->problems[SFUSE_FSCK_INODE_BITMAP] += extra + lack;
+  if (extra + lack && c->opts->verbose)
+    printf("아이노드 비트맵: 사용 표시만 남은 아이노드 %" PRIu64
+           "개, 표시가 없는 아이노드 %" PRIu64 "개\n",
+           extra, lack);
+
+  c->out->blocks = count_bits(c->used, c->data_blocks);
+  c->out->free_blocks = c->data_blocks - c->out->blocks;
+  c->out->free_inodes = (uint32_t)(c->sb.inodes_count - 1 -
+                                   count_bits(c->imap, c->sb.inodes_count));
+  if (c->sb.free_blocks != c->out->free_blocks)
+    report(c, SFUSE_FSCK_COUNTS, "빈 블록 수 %" PRIu64 ", 실제 %" PRIu64,
+           c->sb.free_blocks, c->out->free_blocks);
+  if (c->sb.free_inodes != c->out->free_inodes)
+    report(c, SFUSE_FSCK_COUNTS, "빈 아이노드 수 %u, 실제 %u",
+           c->sb.free_inodes, c->out->free_inodes);
+
+  if (!(c->sb.feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_GROUP_SUMMARY))
+    return 0;
+  uint64_t want[SFUSE_SUMMARY_PER_BLOCK], have[SFUSE_SUMMARY_PER_BLOCK];
+  uint64_t sum_start = c->sb.inode_bitmap_start - c->sb.summary_blocks;
+  for (uint64_t t = 0; t * SFUSE_SUMMARY_PER_BLOCK < c->sb.groups_count; t++) {
+    summary_fill(c, t, want);
+    res = read_block(c->fd, sum_start + t, have);
+    if (res < 0 && res != -EBADMSG)
+      return res;
+    if (res < 0 || memcmp(want, have, sizeof(want)) != 0)
+      report(c, SFUSE_FSCK_COUNTS, "그룹 요약 테이블 블록 %" PRIu64 " 불일치",
+             t);
+  }
+  return 0;
+}
+
+/* ------------------------------------------------------------------------ */
+/* 복구                                                                     */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * @struct fsck_dirbuf
+ * @brief 복구 중 고치는 디렉터리의 아이노드와 직접 블록
+ */
+struct fsck_dirbuf {
+  uint32_t ino;
+  struct sfuse_inode inode;
+  bool have[SFUSE_NDIR_BLOCKS];
+  uint8_t data[SFUSE_NDIR_BLOCKS * SFUSE_BLOCK_SIZE];
+};
+
+static int dirbuf_load(struct fsck_ctx *c, struct fsck_dirbuf *db,
+                       uint32_t ino) {
+  db->ino = ino;
+  int res = inode_load(c->fd, &c->fs.sb, ino, &db->inode);
+  if (res < 0)
+    return res;
+  if (!S_ISDIR(db->inode.mode))
+    return -ENOTDIR;
+  memset(db->data, 0, sizeof(db->data));
+  for (uint32_t b = 0; b < SFUSE_NDIR_BLOCKS; b++) {
+    uint64_t blk = db->inode.direct[b];
+    db->have[b] = blk >= c->data_start && blk < c->sb.blocks_count;
+    uint8_t *dst = db->data + (size_t)b * SFUSE_BLOCK_SIZE;
+    if (db->have[b] && (res = read_block(c->fd, blk, dst)) < 0)
+      return res;
+  }
+  return 0;
+}
+
+/**
+ * @brief 엔트리 자리 s의 아이노드 번호가 있는 블록이 있는지 확인한다.
+ */
+static bool dirbuf_has(const struct fsck_dirbuf *db, uint32_t s) {
+  return s < DIR_SLOTS &&
+         db->have[(size_t)s * sizeof(struct sfuse_dirent) / SFUSE_BLOCK_SIZE];
+}
+
+static struct sfuse_dirent *dirbuf_ent(struct fsck_dirbuf *db, uint32_t s) {
+  return (struct sfuse_dirent *)db->data + s;
+}
+
+/**
+ * @brief 엔트리 자리 s가 걸친 블록을 기록한다.
+ */
+static int dirbuf_store(struct fsck_ctx *c, struct fsck_dirbuf *db,
+                        uint32_t s) {
+  size_t lo = (size_t)s * sizeof(struct sfuse_dirent);
+  size_t b0 = lo / SFUSE_BLOCK_SIZE;
+  size_t b1 = (lo + sizeof(struct sfuse_dirent) - 1) / SFUSE_BLOCK_SIZE;
+  for (size_t b = b0; b <= b1 && db->have[b]; b++) {
+    int res = write_block(c->fd, db->inode.direct[b],
+                          db->data + b * SFUSE_BLOCK_SIZE);
+    if (res < 0)
+      return res;
+  }
+  return 0;
+}
+
+/**
+ * @brief 디렉터리의 첫 블록에 엔트리를 더한다.
+ *
+ * readdir이 첫 블록의 엔트리만 나열하므로 첫 블록의 빈 자리만 쓰고, 첫 블록이
+ * 없으면 할당한다.
+ *
+ * @return 성공 시 0, 실패 시 음수 오류 코드 (-ENOSPC: 빈 자리가 없음)
+ */
+static int dirbuf_insert(struct fsck_ctx *c, struct fsck_dirbuf *db,
+                         const char *name, uint32_t child) {
+  if (!db->have[0]) {
+    int64_t i = alloc_block(&c->fs.sb, c->used);
+    if (i < 0)
+      return -ENOSPC;
+    db->inode.direct[0] = c->data_start + (uint64_t)i;
+    if (db->inode.size < SFUSE_BLOCK_SIZE)
+      db->inode.size = SFUSE_BLOCK_SIZE;
+    memset(db->data, 0, SFUSE_BLOCK_SIZE);
+    db->have[0] = true;
+    int res = write_block(c->fd, db->inode.direct[0], db->data);
+    if (res == 0)
+      res = inode_sync(c->fd, &c->fs.sb, db->ino, &db->inode);
+    if (res < 0)
+      return res;
+  }
+  for (uint32_t s = 0; s < DIR_BLOCK_SLOTS; s++) {
+    struct sfuse_dirent *e = dirbuf_ent(db, s);
+    if (e->ino != 0)
+      continue;
+    memset(e, 0, sizeof(*e));
+    e->ino = child;
+    strncpy(e->name, name, SFUSE_NAME_LEN);
+    return dirbuf_store(c, db, s);
+  }
+  return -ENOSPC;
+}
+
+/**
+ * @brief lost+found를 찾거나 루트 아래에 만든다.
+ */
+static int ensure_lost_found(struct fsck_ctx *c, struct fsck_dirbuf *db) {
+  if (c->lpf)
+    return 0;
+  int ino = alloc_inode(&c->fs.sb, c->imap);
+  if (ino < 0)
+    return ino;
+  int64_t i = alloc_block(&c->fs.sb, c->used);
+  if (i < 0) {
+    free_inode(&c->fs.sb, c->imap, (uint32_t)ino);
+    return -ENOSPC;
+  }
+
+  struct sfuse_inode inode;
+  fs_init_inode(&c->fs.sb, (uint32_t)ino, S_IFDIR | 0700, 0, 0, &inode);
+  inode.direct[0] = c->data_start + (uint64_t)i;
+  inode.size = SFUSE_BLOCK_SIZE;
+  uint8_t block[SFUSE_BLOCK_SIZE] = {0};
+  struct sfuse_dirent *ents = (struct sfuse_dirent *)block;
+  ents[0].ino = (uint32_t)ino;
+  strcpy(ents[0].name, ".");
+  ents[1].ino = SFUSE_ROOT_INO;
+  strcpy(ents[1].name, "..");
+  int res = write_block(c->fd, inode.direct[0], block);
+  if (res == 0)
+    res = inode_sync(c->fd, &c->fs.sb, (uint32_t)ino, &inode);
+  if (res == 0 && (res = dirbuf_load(c, db, SFUSE_ROOT_INO)) == 0)
+    res = dirbuf_insert(c, db, SFUSE_FSCK_LOST_FOUND, (uint32_t)ino);
+  if (res < 0) {
+    free_block(&c->fs.sb, c->used, (uint64_t)i);
+    free_inode(&c->fs.sb, c->imap, (uint32_t)ino);
+    return res;
+  }
+  c->lpf = (uint32_t)ino;
+  printf("%s 디렉터리를 만들었습니다 (아이노드 %d)\n", SFUSE_FSCK_LOST_FOUND,
+         ino);
+  return 0;
+}
+
+/**
+ * @brief 블록 포인터 하나를 바꾼다.
+ *
+ * @param container 포인터를 담은 인다이렉트 블록 (0이면 아이노드)
+ */
+static int set_ptr(struct fsck_ctx *c, uint32_t ino, uint64_t container,
+                   uint32_t slot, uint64_t val) {
+  if (container) {
+    uint64_t blk[SFUSE_ADDR_PER_BLOCK];
+    int res = read_block(c->fd, container, blk);
+    if (res < 0)
+      return res;
+    blk[slot] = htole64(val);
+    return write_block(c->fd, container, blk);
+  }
+  struct sfuse_inode inode;
+  int res = inode_load(c->fd, &c->fs.sb, ino, &inode);
+  if (res < 0)
+    return res;
+  if (slot < SFUSE_NDIR_BLOCKS)
+    inode.direct[slot] = val;
+  else if (slot == SLOT_IND)
+    inode.indirect = val;
+  else if (slot == SLOT_DIND)
+    inode.double_indirect = val;
+  else
+    inode.triple_indirect = val;
+  return inode_sync(c->fd, &c->fs.sb, ino, &inode);
+}
+
+/**
+ * @brief 이중 참조된 블록을 새 블록에 복제하고 포인터를 옮긴다.
+ */
+static int clone_block(struct fsck_ctx *c, const struct fsck_fix *f) {
+  uint8_t buf[SFUSE_BLOCK_SIZE];
+  int64_t i = alloc_block(&c->fs.sb, c->used);
+  if (i < 0)
+    return -ENOSPC;
+  uint64_t blk = c->data_start + (uint64_t)i;
+  int res = read_block(c->fd, f->b, buf);
+  if (res == 0 || res == -EBADMSG)
+    res = write_block(c->fd, blk, buf);
+  if (res == 0)
+    res = set_ptr(c, f->ino, f->a, f->slot, blk);
+  if (res < 0)
+    free_block(&c->fs.sb, c->used, (uint64_t)i);
+  return res;
+}
+
+/**
+ * @brief 수정 하나를 적용한다.
+ */
+static int apply_fix(struct fsck_ctx *c, const struct fsck_fix *f,
+                     struct fsck_dirbuf *db) {
+  struct sfuse_inode inode;
+  char name[16];
+  int res;
+  switch (f->kind) {
+  case FIX_CLEAR_INODE:
+    memset(&inode, 0, sizeof(inode));
+    return inode_sync(c->fd, &c->fs.sb, f->ino, &inode);
+  case FIX_INODE_CSUM:
+    res = inode_load(c->fd, &c->fs.sb, f->ino, &inode);
+    if (res < 0 && res != -EBADMSG)
+      return res;
+    return inode_sync(c->fd, &c->fs.sb, f->ino, &inode);
+  case FIX_CLEAR_PTR:
+    return set_ptr(c, f->ino, f->a, f->slot, 0);
+  case FIX_CLONE:
+    return clone_block(c, f);
+  case FIX_ZERO_BLOCK:
+    memset(db->data, 0, SFUSE_BLOCK_SIZE);
+    if (f->b && disk_read(c->fd, db->data, SFUSE_BLOCK_SIZE,
+                          (off_t)f->a * SFUSE_BLOCK_SIZE) != SFUSE_BLOCK_SIZE)
+      return -EIO;
+    return write_block(c->fd, f->a, db->data);
+  case FIX_DIRENT:
+    if ((res = dirbuf_load(c, db, f->ino)) < 0)
+      return res;
+    if (!dirbuf_has(db, f->slot))
+      return 0; // 포인터를 지운 블록
+    if (f->b == 0)
+      memset(dirbuf_ent(db, f->slot), 0, sizeof(struct sfuse_dirent));
+    else
+      dirbuf_ent(db, f->slot)->ino = (uint32_t)f->b;
+    return dirbuf_store(c, db, f->slot);
+  case FIX_DOT:
+    if ((res = dirbuf_load(c, db, f->ino)) < 0)
+      return res;
+    return dirbuf_insert(c, db, ".", f->ino);
+  case FIX_DOTDOT: {
+    uint32_t want = (uint32_t)f->b;
+    if (want == 0) {
+      if ((res = ensure_lost_found(c, db)) < 0)
+        return res;
+      want = c->lpf;
+    }
+    if ((res = dirbuf_load(c, db, f->ino)) < 0)
+      return res;
+    for (uint32_t s = 0; s < DIR_SLOTS; s++) {
+      struct sfuse_dirent *e = dirbuf_ent(db, s);
+      if (dirbuf_has(db, s) && e->ino && strcmp(e->name, "..") == 0) {
+        e->ino = want;
+        return dirbuf_store(c, db, s);
+      }
+    }
+    return dirbuf_insert(c, db, "..", want);
+  }
+  case FIX_LINKS:
+  case FIX_ORPHAN_ADD:
+    if ((res = inode_load(c->fd, &c->fs.sb, f->ino, &inode)) < 0)
+      return res;
+    if (f->kind == FIX_LINKS) {
+      inode.links = (uint32_t)f->b;
+    } else {
+      inode.links = 0;
+      inode.atime = c->fs.sb.last_orphan;
+    }
+    if ((res = inode_sync(c->fd, &c->fs.sb, f->ino, &inode)) == 0 &&
+        f->kind == FIX_ORPHAN_ADD)
+      c->fs.sb.last_orphan = f->ino;
+    return res;
+  case FIX_ORPHAN_NEXT:
+    if (f->ino == 0) {
+      c->fs.sb.last_orphan = 0;
+      return 0;
+    }
+    if ((res = inode_load(c->fd, &c->fs.sb, f->ino, &inode)) < 0)
+      return res;
+    inode.atime = 0;
+    return inode_sync(c->fd, &c->fs.sb, f->ino, &inode);
+  case FIX_RECONNECT:
+    if ((res = ensure_lost_found(c, db)) < 0 ||
+        (res = dirbuf_load(c, db, c->lpf)) < 0)
+      return res;
+    snprintf(name, sizeof(name), "#%u", f->ino);
+    return dirbuf_insert(c, db, name, f->ino);
+  }
+  return -EINVAL;
+}
+
+/**
+ * @brief 바뀐 비트맵 블록, 그룹 요약 블록과 슈퍼블록을 기록한다.
+ */
+static int write_maps(struct fsck_ctx *c) {
+  const struct {
+    uint8_t *map, *disk, *stale;
+    uint64_t start;
+    size_t bytes;
+  } maps[] = {
+      {c->imap, c->disk_imap, c->imap_stale, c->sb.inode_bitmap_start,
+       c->imap_bytes},
+      {c->used, c->disk_bmap, c->bmap_stale, c->sb.block_bitmap_start,
+       c->bmap_bytes},
+  };
+  for (size_t m = 0; m < sizeof(maps) / sizeof(maps[0]); m++) {
+    for (size_t off = 0; off < maps[m].bytes; off += SFUSE_BLOCK_SIZE) {
+      size_t len = maps[m].bytes - off < SFUSE_BLOCK_SIZE
+                       ? maps[m].bytes - off
+                       : SFUSE_BLOCK_SIZE;
+      uint64_t k = off / SFUSE_BLOCK_SIZE;
+      if (!maps[m].stale[k] &&
+          memcmp(maps[m].map + off, maps[m].disk + off, len) == 0)
+        continue;
+      int res = bitmap_sync(c->fd, maps[m].start + k, maps[m].map + off, len);
+      if (res < 0)
+        return res;
+      memcpy(maps[m].disk + off, maps[m].map + off, len);
+      maps[m].stale[k] = 0;
+    }
+  }
+
+  if (c->sb.feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_GROUP_SUMMARY) {
+    uint64_t want[SFUSE_SUMMARY_PER_BLOCK], have[SFUSE_SUMMARY_PER_BLOCK];
+    uint64_t sum_start = c->sb.inode_bitmap_start - c->sb.summary_blocks;
+    for (uint64_t t = 0; t * SFUSE_SUMMARY_PER_BLOCK < c->sb.groups_count;
+         t++) {
+      summary_fill(c, t, want);
+      int res = read_block(c->fd, sum_start + t, have);
+      if (res == 0 && memcmp(want, have, sizeof(want)) == 0)
+        continue;
+      if ((res = write_block(c->fd, sum_start + t, want)) < 0)
+        return res;
+    }
+  }
+
+  c->fs.sb.free_blocks = c->data_blocks - count_bits(c->used, c->data_blocks);
+  c->fs.sb.free_inodes = (uint32_t)(c->sb.inodes_count - 1 -
+                                    count_bits(c->imap, c->sb.inodes_count));
+  return sb_sync(c->fd, &c->fs.sb);
+}
+
+/**
+ * @brief 모은 수정을 적용하고 비트맵과 슈퍼블록을 기록한다.
+ *
+ * 모든 블록의 사용 여부가 정해진 뒤에 호출하므로, 복제나 lost+found에 쓰는 새
+ * 블록과 스냅숏 복사본은 정말 빈 블록에서 할당된다.
+ */
+static int repair(struct fsck_ctx *c) {
+  /* [1단계] 기록 컨텍스트 준비 */
+  struct sfuse_fs *fs = &c->fs;
+  fs->backing_fd = c->fd;
+  fs->sb = c->sb;
+  fs->block_map = c->used;
+  fs->inode_map = c->imap;
+  fs->sb.free_blocks = c->out->free_blocks;
+  fs->sb.free_inodes = c->out->free_inodes;
+  // 스냅숏 복사본을 반영하는 장치 플러시(fs_sync_device)의 묶음 처리 상태
+  pthread_mutex_init(&fs->sync.lock, NULL);
+  pthread_cond_init(&fs->sync.done, NULL);
+  bool snapshot = fs->sb.feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_SNAPSHOT;
+  if (snapshot && !c->snap_ok) {
+    // 테이블 블록과 복사본은 표시하지 않았으므로 비트맵에서 해제된다
+    fs->sb.feature_ro_compat &= ~SFUSE_FEATURE_RO_COMPAT_SNAPSHOT;
+    fs->sb.snap_table = 0;
+    fs->sb.snap_time = 0;
+  } else if (snapshot) {
+    // 복구 기록도 원본 마운트처럼 스냅숏 블록을 먼저 복사한다
+    int res = snap_init(fs);
+    if (res < 0)
+      return res;
+  }
+
+  /* [2단계] 종류 순서대로 수정 적용 */
+  struct fsck_dirbuf *db = malloc(sizeof(*db));
+  if (!db)
+    return -ENOMEM;
+  for (uint8_t kind = 0; kind < FIX_NR_KINDS; kind++) {
+    for (size_t k = 0; k < c->fixes.n; k++) {
+      const struct fsck_fix *f = vec_at(&c->fixes, k);
+      if (f->kind != kind)
+        continue;
+      int res = apply_fix(c, f, db);
+      if (res < 0) {
+        fprintf(stderr, "아이노드 %u: 수정(종류 %u) 적용 실패 (%d)\n",
+                f->ino, kind, res);
+        c->out->unfixed++;
+      }
+    }
+  }
+  free(db);
+
+  /* [3단계] 참조 수 테이블 */
+  int res = check_refcounts(c, true);
+  if (res < 0)
+    return res;
+
+  /* [4단계] 비트맵, 그룹 요약, 슈퍼블록 */
+  // 스냅숏 복사본을 할당하면 이미 기록한 비트맵 블록이 바뀔 수 있으므로 새
+  // 복사본이 생기지 않을 때까지 다시 기록한다. (두 번째부터는 복사할 블록이
+  // 없다)
+  for (int pass = 0; pass < 4; pass++) {
+    uint64_t before = snap_blocks();
+    if ((res = write_maps(c)) < 0)
+      return res;
+    if (snap_blocks() == before)
+      break;
+  }
+  c->out->free_blocks = fs->sb.free_blocks;
+  c->out->free_inodes = fs->sb.free_inodes;
+  c->out->blocks = c->data_blocks - fs->sb.free_blocks;
+  return fsync(c->fd) < 0 ? -errno : 0;
+}
+
+/**
+ * @brief 검사에 쓰는 메모리를 할당한다.
+ */
+static int ctx_alloc(struct fsck_ctx *c) {
+  c->bmap_bytes = c->sb.blocks_count / 8;
+  c->imap_bytes = c->sb.inodes_count / 8;
+  size_t bchunks = (c->bmap_bytes + SFUSE_BLOCK_SIZE - 1) / SFUSE_BLOCK_SIZE;
+  size_t ichunks = (c->imap_bytes + SFUSE_BLOCK_SIZE - 1) / SFUSE_BLOCK_SIZE;
+  // 64비트 단위로 셀 수 있도록 블록 단위로 패딩
+  c->used = calloc(bchunks + 1, SFUSE_BLOCK_SIZE);
+  c->meta = calloc(bchunks + 1, SFUSE_BLOCK_SIZE);
+  c->disk_bmap = calloc(bchunks + 1, SFUSE_BLOCK_SIZE);
+  c->bmap_stale = calloc(bchunks + 1, 1);
+  c->imap = calloc(ichunks + 1, SFUSE_BLOCK_SIZE);
+  c->disk_imap = calloc(ichunks + 1, SFUSE_BLOCK_SIZE);
+  c->imap_stale = calloc(ichunks + 1, 1);
+  c->state = calloc(c->sb.inodes_count, 1);
+  if (!c->used || !c->meta || !c->disk_bmap || !c->bmap_stale || !c->imap ||
+      !c->disk_imap || !c->imap_stale || !c->state)
+    return -ENOMEM;
+  c->dirs.elem = sizeof(struct fsck_dir);
+  c->orphans.elem = sizeof(struct fsck_orphan);
+  c->dups.elem = sizeof(struct fsck_ref);
+  c->fixes.elem = sizeof(struct fsck_fix);
+  c->snap.elem = sizeof(uint64_t);
+  return 0;
+}
+
+static void ctx_free(struct fsck_ctx *c) {
+  free(c->used);
+  free(c->meta);
+  free(c->disk_bmap);
+  free(c->bmap_stale);
+  free(c->imap);
+  free(c->disk_imap);
+  free(c->imap_stale);
+  free(c->state);
+  free(c->dirs.v);
+  free(c->orphans.v);
+  free(c->dups.v);
+  free(c->fixes.v);
+  free(c->snap.v);
+  pthread_mutex_destroy(&c->lock);
+  free(c);
+}
+
+/**
+ * @brief 1단계에서 쓸 장치의 아이노드 비트맵을 disk_imap에 읽는다.
+ *
+ * 체크섬이 맞지 않는 블록은 모두 할당된 것으로 보고 레코드로 판단한다.
+ * (disk_imap은 4단계에서 다시 읽는다)
+ */
+static int load_inode_bitmap(struct fsck_ctx *c) {
+  ssize_t ret = disk_read(c->fd, c->disk_imap, c->imap_bytes,
+                          (off_t)c->sb.inode_bitmap_start * SFUSE_BLOCK_SIZE);
+  if (ret != (ssize_t)c->imap_bytes)
+    return ret < 0 ? (int)ret : -EIO;
+  for (size_t off = 0; off < c->imap_bytes; off += SFUSE_BLOCK_SIZE) {
+    size_t len = c->imap_bytes - off < SFUSE_BLOCK_SIZE ? c->imap_bytes - off
+                                                        : SFUSE_BLOCK_SIZE;
+    if (csum_verify(c->sb.inode_bitmap_start + off / SFUSE_BLOCK_SIZE,
+                    c->disk_imap + off, len) < 0)
+      memset(c->disk_imap + off, 0xff, len);
+  }
+  return 0;
+}
+
+/**
+ * @brief 1단계와 2단계를 병렬로 실행한다.
+ */
+static int scan(struct fsck_ctx *c, struct fsck_worker *w, uint32_t n) {
+  printf("1단계: 아이노드 테이블과 블록 트리 검사 (스레드 %u개)\n", n);
+  int res = load_inode_bitmap(c);
+  if (res == 0)
+    res = run_workers(c, w, n, inode_worker);
+  if (res < 0)
+    return res;
+
+  // 스레드별 디렉터리를 모아 번호 순으로 정렬 (이진 탐색용)
+  for (uint32_t i = 0; i < n; i++) {
+    for (size_t k = 0; k < w[i].dirs.n; k++)
+      if (vec_push(&c->dirs, vec_at(&w[i].dirs, k)) < 0)
+        return -ENOMEM;
+    free(w[i].dirs.v);
+    w[i].dirs.v = NULL;
+  }
+  if (c->dirs.n)
+    qsort(c->dirs.v, c->dirs.n, sizeof(struct fsck_dir), dir_cmp);
+  c->out->dirs = c->dirs.n;
+  struct fsck_dir *root = dir_find(c, SFUSE_ROOT_INO);
+  if (!root) {
+    fprintf(stderr, "루트 디렉터리가 손상되어 복구할 수 없습니다\n");
+    return -EUCLEAN;
+  }
+  root->parent = SFUSE_ROOT_INO; // 다른 디렉터리의 엔트리가 가리킬 수 없음
+  root->reach = REACH_YES;
+
+  if ((res = check_snapshot(c)) < 0)
+    return res;
+  check_dups(c);
+
+  printf("2단계: 디렉터리 엔트리 검사\n");
+  return run_workers(c, w, n, dir_worker);
+}
+
+int fsck_run(int fd, const struct sfuse_fsck_opts *opts,
+             struct sfuse_fsck_result *out) {
+  memset(out, 0, sizeof(*out));
+  struct fsck_ctx *c = calloc(1, sizeof(*c));
+  if (!c)
+    return -ENOMEM;
+  pthread_mutex_init(&c->lock, NULL);
+  c->fd = fd;
+  c->opts = opts;
+  c->out = out;
+
+  /* [1단계] 슈퍼블록과 메모리 준비 */
+  int res = sb_load(fd, &c->sb);
+  if (res < 0) {
+    fprintf(stderr, "유효한 SFUSE 슈퍼블록이 없습니다 (%d)\n", res);
+    ctx_free(c);
+    return -EINVAL;
+  }
+  c->data_start = c->sb.data_block_start;
+  c->data_blocks = c->sb.blocks_count - c->sb.data_block_start;
+  if ((res = ctx_alloc(c)) < 0 || (res = csum_init(fd, &c->sb, true)) < 0) {
+    ctx_free(c);
+    return res;
+  }
+  if (c->sb.feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_REFCOUNT) {
+    // 참조 수 테이블과 지문 색인은 데이터 영역에서 할당된 예약 구간
+    c->rc_lo = c->sb.refcount_start;
+    c->rc_hi = c->rc_lo + c->sb.refcount_blocks + c->sb.dedup_index_blocks;
+    for (uint64_t b = c->rc_lo; b < c->rc_hi; b++) {
+      bit_set(c->used, b - c->data_start);
+      bit_set(c->meta, b - c->data_start);
+    }
+  }
+
+  uint32_t n = opts->threads;
+  if (n == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    n = cpus > 0 ? (uint32_t)cpus : 1;
+  }
+  if (n > SFUSE_FSCK_MAX_THREADS)
+    n = SFUSE_FSCK_MAX_THREADS;
+  out->threads = n;
+  struct fsck_worker *w = calloc(n, sizeof(*w));
+  for (uint32_t i = 0; w && i < n; i++) {
+    w[i].c = c;
+    w[i].dirs.elem = sizeof(struct fsck_dir);
+    w[i].buf = malloc(SFUSE_FSCK_CHUNK_BYTES);
+    if (!w[i].buf)
+      res = -ENOMEM;
+  }
+
+  /* [2단계] 병렬 검사 */
+  if (!w)
+    res = -ENOMEM;
+  if (res == 0)
+    res = scan(c, w, n);
+  for (uint32_t i = 0; w && i < n; i++) {
+    free(w[i].buf);
+    free(w[i].dirs.v);
+  }
+  free(w);
+
+  /* [3단계] 전체 확인 */
+  if (res == 0) {
+    printf("3단계: 연결, 고아 목록, 참조 수 확인\n");
+    check_orphans(c);
+    if ((res = check_tree(c)) == 0)
+      check_links(c);
+  }
+  if (res == 0)
+    res = check_refcounts(c, false);
+  if (res == 0) {
+    printf("4단계: 비트맵과 빈 블록 수 비교\n");
+    res = check_bitmaps(c);
+  }
+  if (res == 0)
+    res = atomic_load(&c->err);
+
+  /* [4단계] 복구 */
+  uint64_t total = 0;
+  for (int p = 0; p < SFUSE_FSCK_NR_PROBLEMS; p++)
+    total += out->problems[p];
+  if (res == 0 && total && opts->repair) {
+    printf("5단계: 복구\n");
+    res = repair(c);
+  } else if (res == 0) {
+    out->unfixed = total;
+  }
+
+  snap_destroy();
+  csum_destroy();
+  ctx_free(c);
+  return res;
+}
@@ -8,15 +8,30 @@
  */
 
 #include "inode.h"
+#include "bitmap.h" ///< 블록 할당/해제 (alloc_block/free_block)
 #include "block.h" ///< 블록 읽기/쓰기 (read_block/write_block)
+#include "compress.h" ///< 압축 구간 캐시 (compress_forget)
+#include "csum.h"  ///< 아이노드 레코드 체크섬 (crc32c)
+#include "dedup.h" ///< 공유 블록 참조 수 (dedup_release)
 #include "disk.h"  ///< 디스크 읽기/쓰기 함수 (disk_read/disk_write)
+#include "meta.h"  ///< 메타데이터 매핑 (-o mmap_meta)
+#include "stats.h"
 #include "super.h"
+#include <endian.h>
 #include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
 #include <string.h>
 #include <sys/stat.h> ///< 파일 타입 매크로 (S_ISDIR)
 #include <time.h>
 #include <unistd.h>
 
+/** @brief 아이노드 세대 번호를 관리하는 해시 버킷 수 (2의 거듭제곱) */
+#define SFUSE_INODE_GEN_BUCKETS 1024
+
+/** @brief 버킷별 아이노드 기록 세대 번호 (inode_sync()마다 증가) */
+static atomic_uint inode_gens[SFUSE_INODE_GEN_BUCKETS];
+
 /**
  * @brief 새로운 아이노드를 기본 값으로 초기화한다.
  *
@@ -36,8 +51,11 @@
  *     추가적인 데이터 블록 참조가 없음을 나타낸다.
  *   - 링크 수(links)를 초기화한다. 만약 디렉터리라면 기본적으로 2개(자기 자신
  *     '.'과 상위 디렉터리 '..'), 파일이라면 1개로 설정한다.
+ *   - 인라인 데이터 기능이 켜진 파일 시스템에서는 일반 파일과 심볼릭 링크를
+ *     인라인 상태로 시작한다. 내용이 용량을 넘으면 쓰기 경로에서 블록으로
+ *     옮겨진다.
  *
- * @param sb     슈퍼블록 정보 포인터 (미사용 파라미터)
+ * @param sb     슈퍼블록 정보 포인터 (인라인 데이터 기능 확인용)
  * @param ino    초기화할 아이노드 번호 (미사용 파라미터)
  * @param mode   새 아이노드의 파일 타입(파일/디렉터리 등)과 접근 권한
  * @param uid    새 아이노드를 소유할 사용자의 사용자 ID
@@ -46,7 +64,6 @@
  */
 void fs_init_inode(const struct sfuse_super *sb, uint32_t ino, mode_t mode,
                    uid_t uid, gid_t gid, struct sfuse_inode *inode) {
-  (void)sb;  // 미사용 파라미터로 인한 컴파일러 경고 방지
   (void)ino; // 미사용 파라미터로 인한 컴파일러 경고 방지
 
   // inode 메모리를 0으로 초기화하여 깨끗한 상태로 시작
@@ -63,19 +80,97 @@ void fs_init_inode(const struct sfuse_super *sb, uint32_t ino, mode_t mode,
   inode->size = 0;
 
   // 접근(atime), 수정(mtime), 상태 변경(ctime) 시간을 현재 시각으로 초기화
-  inode->atime = inode->mtime = inode->ctime = (uint32_t)time(NULL);
+  inode->atime = inode->mtime = inode->ctime = (int64_t)time(NULL);
 
   // Direct 블록 포인터를 모두 0으로 초기화하여 데이터 블록을 아직 가리키지 않음
   for (int i = 0; i < SFUSE_NDIR_BLOCKS; i++)
     inode->direct[i] = 0;
 
-  // Single indirect, Double indirect 블록 포인터도 데이터가 없음을 나타내기
+  // Single/Double/Triple indirect 블록 포인터도 데이터가 없음을 나타내기
   // 위해 0 설정
   inode->indirect = 0;
   inode->double_indirect = 0;
+  inode->triple_indirect = 0;
 
   // 디렉터리면 기본 링크 수를 2로, 파일이면 1로 설정
   inode->links = (S_ISDIR(mode) ? 2 : 1);
+
+  // 작은 파일과 심볼릭 링크는 데이터 블록 없이 아이노드 안에서 시작
+  if ((sb->feature_incompat & SFUSE_FEATURE_INCOMPAT_INLINE_DATA) &&
+      (S_ISREG(mode) || S_ISLNK(mode)))
+    inode->flags |= SFUSE_INODE_FLAG_INLINE;
+}
+
+/**
+ * @brief 아이노드의 바이트 순서를 리틀 엔디언과 호스트 순서 사이에서 변환한다.
+ *
+ * 리틀 엔디언 변환은 양방향이 같은 연산이므로 inode_load()와 inode_sync()가
+ * 모두 이 함수를 사용한다. flags 필드는 변환 후의 값으로 인라인 여부를 판단하므로
+ * dst의 flags가 먼저 채워진다.
+ *
+ * @param dst 변환 결과를 저장할 아이노드
+ * @param src 변환할 아이노드
+ */
+static void inode_swab(struct sfuse_inode *dst, const struct sfuse_inode *src) {
+  dst->mode = le32toh(src->mode);
+  dst->uid = le32toh(src->uid);
+  dst->gid = le32toh(src->gid);
+  dst->links = le32toh(src->links);
+  dst->flags = le32toh(src->flags);
+  dst->reserved = le32toh(src->reserved);
+  dst->size = le64toh(src->size);
+  dst->atime = (int64_t)le64toh((uint64_t)src->atime);
+  dst->mtime = (int64_t)le64toh((uint64_t)src->mtime);
+  dst->ctime = (int64_t)le64toh((uint64_t)src->ctime);
+
+  // 인라인 데이터는 바이트 배열이므로 변환 없이 그대로 복사
+  if (dst->flags & SFUSE_INODE_FLAG_INLINE) {
+    memcpy(dst->inline_data, src->inline_data, sizeof(dst->inline_data));
+    return;
+  }
+
+  for (int i = 0; i < SFUSE_NDIR_BLOCKS; i++)
+    dst->direct[i] = le64toh(src->direct[i]);
+  dst->indirect = le64toh(src->indirect);
+  dst->double_indirect = le64toh(src->double_indirect);
+  dst->triple_indirect = le64toh(src->triple_indirect);
+  memset(dst->inline_data + (SFUSE_INODE_CORE_SIZE - SFUSE_INODE_INLINE_OFFSET),
+         0, sizeof(dst->inline_data) -
+                (SFUSE_INODE_CORE_SIZE - SFUSE_INODE_INLINE_OFFSET));
+}
+
+/**
+ * @brief 온디스크 아이노드 레코드의 체크섬을 계산한다.
+ *
+ * 체크섬 자리인 reserved 필드를 0으로 본 레코드 전체에 아이노드 번호를 섞어
+ * 계산하므로, 다른 번호의 위치에 잘못 기록된 레코드도 걸러진다. 0은 아직
+ * 기록된 적 없는 레코드(포맷 직후)를 뜻하므로 결과가 0이면 1로 바꾼다.
+ *
+ * @param ino  아이노드 번호
+ * @param raw  리틀 엔디언 레코드 (reserved 필드는 계산 중에만 0으로 바뀜)
+ * @param size 레코드 크기 (sb->inode_size)
+ * @return 체크섬 값
+ */
+static uint32_t inode_csum(uint32_t ino, struct sfuse_inode *raw,
+                           uint32_t size) {
+  uint32_t saved = raw->reserved;
+  uint32_t le_ino = htole32(ino);
+  raw->reserved = 0;
+  uint32_t c = crc32c(crc32c(0, &le_ino, sizeof(le_ino)), raw, size);
+  raw->reserved = saved;
+  return c ? c : 1;
+}
+
+/**
+ * @brief 아이노드 레코드의 디스크 내 바이트 오프셋을 계산한다.
+ *
+ * @param sb  슈퍼블록 정보 포인터 (아이노드 테이블 위치와 레코드 크기)
+ * @param ino 아이노드 번호
+ * @return 아이노드 레코드의 바이트 오프셋
+ */
+static off_t inode_offset(const struct sfuse_super *sb, uint32_t ino) {
+  return ((off_t)sb->inode_table_start * SFUSE_BLOCK_SIZE) +
+         ((off_t)ino * sb->inode_size);
 }
 
 /**
@@ -93,12 +188,13 @@ void fs_init_inode(const struct sfuse_super *sb, uint32_t ino, mode_t mode,
  * 2. 디스크 내의 아이노드 위치(offset)를 계산한다.
  *    - 슈퍼블록의 inode_table_start는 아이노드 테이블의 시작 위치를 나타내는
  *      블록 번호이다.
- *    - 아이노드의 크기(sizeof(*inode))에 아이노드 번호를 곱해 정확한 위치를
- *      계산한다.
+ *    - 아이노드 레코드 크기(sb->inode_size)에 아이노드 번호를 곱해 정확한
+ *      위치를 계산한다.
  *
  * 3. 계산된 위치에서 아이노드 데이터를 읽어 inode 버퍼에 저장한다.
  *    - 읽은 데이터의 크기가 아이노드 구조체 크기와 일치하지 않으면 입출력
  *      오류(EIO)를 반환한다.
+ *    - 메타데이터 영역이 매핑되어 있으면(-o mmap_meta) 매핑에서 복사한다.
  *
  * @param fd      디바이스 파일 디스크립터
  * @param sb      슈퍼블록 정보 포인터 (아이노드 테이블의 위치와 총 개수 정보
@@ -109,6 +205,7 @@ void fs_init_inode(const struct sfuse_super *sb, uint32_t ino, mode_t mode,
  * @return 성공 시 0 반환, 실패 시 음수의 오류 코드 반환
  *         -EINVAL : 유효하지 않은 아이노드 번호(ino가 0이거나 유효 범위를 초과)
  *         -EIO    : 아이노드 데이터를 읽는 중 입출력 오류 발생
+ *         -EBADMSG: 레코드 체크섬 불일치 (METADATA_CSUM)
  */
 int inode_load(int fd, const struct sfuse_super *sb, uint32_t ino,
                struct sfuse_inode *inode) {
@@ -117,24 +214,56 @@ int inode_load(int fd, const struct sfuse_super *sb, uint32_t ino,
     return -EINVAL; // ino가 유효하지 않음 (0이거나 최대 범위 초과)
 
   /* [2단계] 디스크에서 아이노드가 저장된 위치(offset) 계산 */
-  off_t off = ((off_t)sb->inode_table_start * SFUSE_BLOCK_SIZE) +
-              (ino * sizeof(*inode));
+  off_t off = inode_offset(sb, ino);
   /*
    * inode_table_start 블록 번호를 실제 바이트 단위로 변환하기 위해 블록
-   * 크기(SFUSE_BLOCK_SIZE)를 곱함. 거기에 inode 번호(ino)에 inode
-   * 크기(sizeof(*inode))를 곱하여 정확한 위치 계산.
+   * 크기(SFUSE_BLOCK_SIZE)를 곱함. 거기에 inode 번호(ino)에 온디스크 레코드
+   * 크기(sb->inode_size)를 곱하여 정확한 위치 계산.
    */
 
-  /* [3단계] 디스크에서 아이노드 데이터를 읽어 메모리에 로드 */
-  ssize_t ret = disk_read(fd, inode, sizeof(*inode), off);
-  if (ret < 0)
-    return (int)ret; // 디스크 읽기 오류 발생 시 해당 오류 코드 반환
+  /* [3단계] 디스크에서 아이노드 레코드 전체를 읽어 메모리에 로드 */
+  // 인라인 데이터도 레코드 안에 있으므로 이 한 번의 읽기로 함께 로드된다.
+  // 메타데이터 매핑이 있으면 시스템 호출 없이 매핑에서 복사한다.
+  struct sfuse_inode raw;
+  memset(&raw, 0, sizeof(raw));
+  const void *mapped = meta_ptr(off, sb->inode_size);
+  if (mapped) {
+    memcpy(&raw, mapped, sb->inode_size);
+  } else {
+    ssize_t ret = disk_read(fd, &raw, sb->inode_size, off);
+    if (ret < 0)
+      return (int)ret; // 디스크 읽기 오류 발생 시 해당 오류 코드 반환
+
+    // 읽은 데이터 크기가 아이노드 레코드 크기와 불일치 시 입출력 오류 반환
+    if ((size_t)ret != sb->inode_size)
+      return -EIO;
+  }
 
-  // 읽은 데이터 크기가 아이노드 크기와 불일치 시 입출력 오류 반환
-  if ((size_t)ret != sizeof(*inode))
-    return -EIO;
+  // 체크섬 검증과 바이트 순서 변환
+  int res = inode_decode(sb, ino, &raw, inode);
+  if (res == -EBADMSG) {
+    stats_event(SFUSE_EV_CSUM_ERROR, 1);
+    fprintf(stderr, "[SFUSE] 아이노드 %u 체크섬 불일치\n", ino);
+  }
+  return res; // 성공 시 0 (아이노드 로드 완료)
+}
+
+int inode_decode(const struct sfuse_super *sb, uint32_t ino, const void *rec,
+                 struct sfuse_inode *inode) {
+  struct sfuse_inode raw;
+  memset(&raw, 0, sizeof(raw));
+  memcpy(&raw, rec, sb->inode_size);
 
-  return 0; // 성공적으로 아이노드 로드 완료
+  // 디스크의 리틀 엔디언 값을 호스트 바이트 순서로 변환 (불일치해도 채움)
+  inode_swab(inode, &raw);
+
+  // 레코드 체크섬 검증 (reserved 필드, 0이면 아직 기록된 적 없는 레코드)
+  if (sb->feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_METADATA_CSUM) {
+    uint32_t want = le32toh(raw.reserved);
+    if (want && want != inode_csum(ino, &raw, sb->inode_size))
+      return -EBADMSG;
+  }
+  return 0;
 }
 
 /**
@@ -152,14 +281,16 @@ int inode_load(int fd, const struct sfuse_super *sb, uint32_t ino,
  *
  * 2. 기록할 아이노드 데이터의 디스크 내 위치(offset)를 계산한다.
  *    - 아이노드 테이블의 시작 위치(inode_table_start)를 블록 단위에서 바이트
- *      단위로 변환하고, 여기에 아이노드 번호(ino)와 아이노드의
- *      크기(sizeof(*inode))를 곱하여 정확한 위치를 얻는다.
+ *      단위로 변환하고, 여기에 아이노드 번호(ino)와 레코드
+ *      크기(sb->inode_size)를 곱하여 정확한 위치를 얻는다.
  *
  * 3. 메모리 상의 아이노드 데이터를 계산된 위치에 디스크로 기록한다.
  *    - 기록 후, 실제로 기록된 바이트 수가 아이노드의 크기와 정확히 일치하는지
  *      확인한다.
  *    - 기록된 바이트 수가 일치하지 않거나 오류가 발생하면 적절한 오류 코드를
  *      반환한다.
+ *    - 메타데이터 영역이 매핑되어 있으면 매핑에 복사하고 페이지를 더티로
+ *      표시한다. 장치 기록은 커밋 시점(fs_sync_device())에 이루어진다.
  *
  * @param fd      디바이스 파일 디스크립터 (디스크 접근을 위한 식별자)
  * @param sb      슈퍼블록 정보 (아이노드 테이블 위치 정보 포함)
@@ -177,26 +308,103 @@ int inode_sync(int fd, const struct sfuse_super *sb, uint32_t ino,
     return -EINVAL; // 아이노드 번호가 유효하지 않을 경우
 
   /* [2단계] 아이노드 데이터를 기록할 디스크의 정확한 위치(offset) 계산 */
-  off_t off = ((off_t)sb->inode_table_start * SFUSE_BLOCK_SIZE) +
-              (ino * sizeof(*inode));
+  off_t off = inode_offset(sb, ino);
   /*
    * inode_table_start는 블록 번호를 나타내므로 바이트 단위로 변환하기 위해
    * SFUSE_BLOCK_SIZE를 곱한다.
-   * 아이노드 번호(ino)에 아이노드 크기를 곱해 정확한 바이트 오프셋을 결정한다.
+   * 아이노드 번호(ino)에 레코드 크기를 곱해 정확한 바이트 오프셋을 결정한다.
    */
 
-  /* [3단계] 메모리의 아이노드를 디스크의 해당 위치에 기록 */
-  ssize_t ret = disk_write(fd, inode, sizeof(*inode), off);
-  if (ret < 0)
-    return (int)ret; // 디스크 기록 오류가 발생했을 때 오류 코드 반환
+  /* [3단계] 메모리의 아이노드를 리틀 엔디언으로 변환하여 디스크에 기록 */
+  // METADATA_CSUM이면 reserved 필드에 레코드 체크섬을 담는다.
+  struct sfuse_inode raw;
+  inode_swab(&raw, inode);
+  if (sb->feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_METADATA_CSUM)
+    raw.reserved = htole32(inode_csum(ino, &raw, sb->inode_size));
+  void *mapped = meta_ptr(off, sb->inode_size);
+  if (mapped) {
+    // 매핑에 복사하고 페이지를 더티로 표시 (커밋 시점에 msync)
+    memcpy(mapped, &raw, sb->inode_size);
+    meta_dirty(mapped, sb->inode_size);
+  } else {
+    ssize_t ret = disk_write(fd, &raw, sb->inode_size, off);
+    if (ret < 0)
+      return (int)ret; // 디스크 기록 오류가 발생했을 때 오류 코드 반환
+
+    if ((size_t)ret != sb->inode_size)
+      return -EIO; // 기록된 데이터의 크기가 아이노드 크기와 다르면 입출력
+                   // 오류 반환
+  }
 
-  if ((size_t)ret != sizeof(*inode))
-    return -EIO; // 기록된 데이터의 크기가 아이노드 크기와 다르면 입출력 오류
-                 // 반환
+  // 메모리에 아이노드를 캐시한 열린 파일 핸들이 변경을 감지하도록 함
+  atomic_fetch_add(&inode_gens[ino & (SFUSE_INODE_GEN_BUCKETS - 1)], 1);
 
   return 0; // 성공적으로 아이노드를 디스크에 기록함
 }
 
+/**
+ * @brief 아이노드가 마지막으로 기록된 세대 번호를 반환한다.
+ *
+ * @param ino 아이노드 번호
+ * @return 현재 세대 번호
+ */
+uint32_t inode_generation(uint32_t ino) {
+  return atomic_load(&inode_gens[ino & (SFUSE_INODE_GEN_BUCKETS - 1)]);
+}
+
+/**
+ * @brief 논리 블록 번호가 블록 맵의 어느 경로에 위치하는지 계산한다.
+ *
+ * 블록 맵은 Direct(12개) → Single → Double → Triple indirect 순서로 구성된다.
+ * 인다이렉트 블록 하나는 64비트 주소 SFUSE_ADDR_PER_BLOCK(512)개를 담으므로,
+ * 각 단계가 표현하는 논리 블록 수는 512, 512², 512³개이다.
+ *
+ * @param inode  대상 아이노드
+ * @param lbn    논리 블록 번호
+ * @param root   경로의 시작점(아이노드 내 포인터 필드)을 돌려받을 포인터
+ * @param idx    각 인다이렉트 단계에서의 인덱스를 돌려받을 배열 (최대 3개)
+ * @return 인다이렉트 단계 수(0~3), 표현 범위를 넘으면 -EFBIG
+ */
+static int bmap_path(const struct sfuse_inode *inode, uint64_t lbn,
+                     const uint64_t **root, uint32_t idx[3]) {
+  const uint64_t per = SFUSE_ADDR_PER_BLOCK;
+
+  // Direct 블록
+  if (lbn < SFUSE_NDIR_BLOCKS) {
+    *root = &inode->direct[lbn];
+    return 0;
+  }
+  lbn -= SFUSE_NDIR_BLOCKS;
+
+  // Single indirect 블록
+  if (lbn < per) {
+    *root = &inode->indirect;
+    idx[0] = (uint32_t)lbn;
+    return 1;
+  }
+  lbn -= per;
+
+  // Double indirect 블록
+  if (lbn < per * per) {
+    *root = &inode->double_indirect;
+    idx[0] = (uint32_t)(lbn / per);
+    idx[1] = (uint32_t)(lbn % per);
+    return 2;
+  }
+  lbn -= per * per;
+
+  // Triple indirect 블록
+  if (lbn < per * per * per) {
+    *root = &inode->triple_indirect;
+    idx[0] = (uint32_t)(lbn / (per * per));
+    idx[1] = (uint32_t)((lbn / per) % per);
+    idx[2] = (uint32_t)(lbn % per);
+    return 3;
+  }
+
+  return -EFBIG; // 블록 맵이 표현할 수 있는 최대 파일 크기 초과
+}
+
 /**
  * @brief 논리 블록 번호(Logical Block Number, LBN)를 물리 블록 번호(Physical
  * Block Number, PBN)로 변환한다.
@@ -209,17 +417,18 @@ int inode_sync(int fd, const struct sfuse_super *sb, uint32_t ino,
  *
  * LBN에서 PBN 변환 방법:
  *   - [Direct Block 처리]
- *     * LBN이 SFUSE_NDIR_BLOCKS(보통 12개)보다 작으면, direct 배열에서 직접
+ *     * LBN이 SFUSE_NDIR_BLOCKS(12개)보다 작으면, direct 배열에서 직접
  *       찾아 반환한다.
- *   - [Single Indirect Block 처리]
- *     * Direct 블록으로 표현할 수 있는 범위를 넘어가면, Single indirect
- *       블록에서 찾는다.
- *     * Single indirect 블록이 가리키는 블록 하나에는 여러 개의 블록 주소를
- *       담을 수 있다.
- *   - [Double Indirect Block 처리]
- *     * Single indirect 블록 범위도 초과하면, Double indirect 블록을 참조해야
- *       한다.
- *     * Double indirect 블록은 두 단계의 포인터를 거쳐 주소를 참조한다.
+ *   - [Single/Double/Triple Indirect Block 처리]
+ *     * 그 이상은 bmap_path()가 계산한 인덱스를 따라 인다이렉트 블록을 한
+ *       단계씩 읽으며 주소를 찾는다. 인다이렉트 블록에는 64비트 리틀 엔디언
+ *       블록 주소가 저장된다.
+ *
+ * 경로 중간 또는 마지막 주소가 0이면 아직 할당되지 않은 블록(hole)이다.
+ * 마지막 주소에 SFUSE_BLOCK_UNWRITTEN 비트가 있으면 fallocate로 예약만 되고
+ * 아직 기록되지 않은 블록으로, 플래그를 뗀 번호를 돌려주고 1을 반환한다.
+ * SFUSE_BLOCK_COMPRESSED 비트가 있으면 압축 클러스터의 블록으로, 플래그를 뗀
+ * 번호(0일 수 있음)를 돌려주고 2를 반환한다.
  *
  * @param fd       디바이스 파일 디스크립터 (디스크 접근용)
  * @param sb       슈퍼블록 정보 (현재 사용하지 않음)
@@ -228,73 +437,546 @@ int inode_sync(int fd, const struct sfuse_super *sb, uint32_t ino,
  * @param buf      블록 데이터를 읽기 위한 임시 버퍼 (크기: SFUSE_BLOCK_SIZE)
  * @param pbn_out  변환된 물리 블록 번호를 저장할 출력 포인터
  *
- * @return 성공 시 0, 실패 시 음수의 오류 코드 반환
+ * @return 성공 시 0, 예약만 된(unwritten) 블록이면 1, 압축 클러스터의 블록이면
+ *         2, 실패 시 음수의 오류 코드 반환
  *         -ENOENT : 요청한 블록이 할당되지 않아 존재하지 않음
+ *         -EFBIG  : 최대 파일 크기를 넘는 논리 블록 번호
  *         -EIO    : 블록 데이터를 디스크에서 읽을 때 입출력 오류 발생
  */
 int logical_to_physical(int fd, const struct sfuse_super *sb,
-                        const struct sfuse_inode *inode, uint32_t lbn,
-                        void *buf, uint32_t *pbn_out) {
+                        const struct sfuse_inode *inode, uint64_t lbn,
+                        void *buf, uint64_t *pbn_out) {
 
   (void)sb; // 미사용 파라미터로 인한 컴파일러 경고 방지
 
-  /* --- [1단계: Direct 블록 확인] --- */
-  if (lbn < SFUSE_NDIR_BLOCKS) {
-    // 요청한 논리 블록 번호가 Direct 블록의 범위 내에 있음
-    *pbn_out = inode->direct[lbn]; // 직접적인 배열 참조로 즉시 얻을 수 있음
+  // 인라인 아이노드는 데이터 블록이 없다.
+  if (inode_is_inline(inode))
+    return -ENOENT;
+
+  /* --- [1단계: 블록 맵 경로 계산] --- */
+  const uint64_t *root;
+  uint32_t idx[3];
+  int depth = bmap_path(inode, lbn, &root, idx);
+  if (depth < 0)
+    return depth;
+
+  /* --- [2단계: 인다이렉트 블록을 단계별로 따라감] --- */
+  uint64_t blk = *root;
+  for (int d = 0; d < depth; d++) {
+    if (blk == 0)
+      return -ENOENT; // 중간 단계 인다이렉트 블록이 아직 할당되지 않음
+
+    if (read_block(fd, blk, buf) < 0)
+      return -EIO; // 인다이렉트 블록을 읽는 도중 오류 발생
+
+    blk = le64toh(((uint64_t *)buf)[idx[d]]);
+  }
+
+  /* --- [3단계: 최종 물리 블록 번호 확인] --- */
+  if (blk == 0)
+    return -ENOENT; // 데이터 블록이 할당되지 않음 (hole)
+
+  // 예약만 되고 기록되지 않은 블록은 0으로 읽혀야 한다.
+  if (blk & SFUSE_BLOCK_UNWRITTEN) {
+    *pbn_out = blk & ~SFUSE_BLOCK_UNWRITTEN;
+    return 1;
+  }
+  // 압축 클러스터의 블록은 호출자가 클러스터 단위로 풀어서 읽는다.
+  if (blk & SFUSE_BLOCK_COMPRESSED) {
+    *pbn_out = blk & ~SFUSE_BLOCK_COMPRESSED;
+    return 2;
+  }
+
+  *pbn_out = blk;
+  return 0; // 성공적으로 물리 블록 번호 변환 완료
+}
+
+/**
+ * @brief 새 인다이렉트 블록을 할당하고 0으로 초기화한다.
+ *
+ * @param fd        디바이스 파일 디스크립터
+ * @param sb        슈퍼블록 정보 포인터
+ * @param block_map 블록 비트맵 버퍼
+ * @param pbn_out   할당된 물리 블록 번호
+ * @return 성공 시 0, 실패 시 음수의 오류 코드
+ */
+static int alloc_index_block(int fd, struct sfuse_super *sb,
+                             uint8_t *block_map, uint64_t *pbn_out) {
+  int64_t off = alloc_block(sb, block_map);
+  if (off < 0)
+    return (int)off;
+
+  uint64_t pbn = sb->data_block_start + (uint64_t)off;
+  uint8_t zero[SFUSE_BLOCK_SIZE] = {0};
+  int res = write_block(fd, pbn, zero);
+  if (res < 0) {
+    free_block(sb, block_map, (uint64_t)off);
+    return res;
+  }
+
+  *pbn_out = pbn;
+  return 0;
+}
+
+/**
+ * @brief 논리 블록 번호에 물리 블록을 연결한다.
+ *
+ * 블록 맵 경로를 따라 내려가면서 비어 있는 인다이렉트 블록은 새로 할당하고,
+ * 마지막 단계의 주소 칸에 pbn을 기록한다. pbn이 0(연결 해제)인데 경로가 아직
+ * 없다면 아무 일도 하지 않는다.
+ *
+ * @param fd        디바이스 파일 디스크립터
+ * @param sb        슈퍼블록 정보 포인터 (인다이렉트 블록 할당 시 갱신)
+ * @param block_map 블록 비트맵 버퍼
+ * @param inode     대상 아이노드 포인터
+ * @param lbn       연결할 논리 블록 번호
+ * @param pbn       연결할 물리 블록 번호 (0이면 연결 해제)
+ * @return 성공 시 0, 실패 시 음수의 오류 코드 반환
+ */
+int inode_set_block(int fd, struct sfuse_super *sb, uint8_t *block_map,
+                    struct sfuse_inode *inode, uint64_t lbn, uint64_t pbn) {
+  // 인라인 아이노드는 먼저 inode_inline_migrate()로 전환해야 한다.
+  if (inode_is_inline(inode))
+    return -EINVAL;
+
+  const uint64_t *croot;
+  uint32_t idx[3];
+  int depth = bmap_path(inode, lbn, &croot, idx);
+  if (depth < 0)
+    return depth;
+
+  // bmap_path는 const 아이노드를 받으므로, 같은 필드를 쓰기 가능하게 되돌린다.
+  uint64_t *root = (uint64_t *)croot;
+
+  // Direct 블록은 아이노드 안에서 바로 갱신
+  if (depth == 0) {
+    *root = pbn;
     return 0;
   }
 
-  /* --- [2단계: Single Indirect 블록 확인] --- */
-  lbn -= SFUSE_NDIR_BLOCKS; // Direct 블록의 범위를 초과했으므로, Single
-                            // indirect 범위로 보정
+  int res;
+  if (*root == 0) {
+    if (pbn == 0)
+      return 0; // 해제할 경로가 없음
+    res = alloc_index_block(fd, sb, block_map, root);
+    if (res < 0)
+      return res;
+  }
 
-  uint32_t entries = SFUSE_BLOCK_SIZE / sizeof(uint32_t);
-  // 하나의 블록에 저장 가능한 블록 주소의 개수를 계산
-  // (예: 4096 바이트 블록 / 4 바이트 주소 = 1024개의 블록 주소 저장 가능)
+  uint8_t buf[SFUSE_BLOCK_SIZE];
+  uint64_t blk = *root;
+  for (int d = 0; d < depth; d++) {
+    res = read_block(fd, blk, buf);
+    if (res < 0)
+      return res;
+    uint64_t *ptrs = (uint64_t *)buf;
+
+    // 마지막 단계: 데이터 블록 주소 기록
+    if (d == depth - 1) {
+      ptrs[idx[d]] = htole64(pbn);
+      return write_block(fd, blk, buf);
+    }
+
+    // 중간 단계: 다음 인다이렉트 블록이 없으면 할당
+    uint64_t next = le64toh(ptrs[idx[d]]);
+    if (next == 0) {
+      if (pbn == 0)
+        return 0;
+      res = alloc_index_block(fd, sb, block_map, &next);
+      if (res < 0)
+        return res;
+      ptrs[idx[d]] = htole64(next);
+      res = write_block(fd, blk, buf);
+      if (res < 0)
+        return res;
+    }
+    blk = next;
+  }
 
-  if (lbn < entries) {
-    // Single indirect 블록에서 찾을 수 있는 범위 내에 있음
-    if (inode->indirect == 0)
-      return -ENOENT; // Single indirect 블록 자체가 아직 할당되지 않은 상태
+  return 0;
+}
+
+/**
+ * @brief 물리 블록을 블록 비트맵에 반환한다.
+ *
+ * 중복 제거로 다른 파일과 공유하는 블록은 참조 수만 줄이고 반환하지 않는다.
+ *
+ * @param sb        슈퍼블록 정보 포인터
+ * @param block_map 블록 비트맵 버퍼
+ * @param pbn       해제할 물리 블록 번호
+ */
+static void release_block(struct sfuse_super *sb, uint8_t *block_map,
+                          uint64_t pbn) {
+  // 압축 구간의 블록이면 푼 클러스터 캐시에서도 뺌
+  if (pbn & SFUSE_BLOCK_COMPRESSED)
+    compress_forget(pbn & ~SFUSE_BLOCK_COMPRESSED);
+  // 예약(unwritten)/압축 표시 제거
+  pbn &= ~(SFUSE_BLOCK_UNWRITTEN | SFUSE_BLOCK_COMPRESSED);
+
+  // 데이터 영역 밖의 번호는 손상된 포인터이므로 비트맵을 건드리지 않는다.
+  if (pbn < sb->data_block_start || pbn >= sb->blocks_count)
+    return;
+  if (dedup_release(pbn))
+    return;
+  free_block(sb, block_map, pbn - sb->data_block_start);
+}
+
+/**
+ * @brief 인다이렉트 블록 트리에서 [from, to) 범위의 블록을 재귀적으로 해제한다.
+ *
+ * @param fd        디바이스 파일 디스크립터
+ * @param sb        슈퍼블록 정보 포인터
+ * @param block_map 블록 비트맵 버퍼
+ * @param blk       현재 인다이렉트 블록 번호
+ * @param level     현재 단계 (1이면 항목이 데이터 블록)
+ * @param base      이 인다이렉트 블록이 표현하는 첫 논리 블록 번호
+ * @param from      해제를 시작할 논리 블록 번호
+ * @param to        해제를 끝낼 논리 블록 번호 (이 번호는 제외)
+ * @param emptied   이 블록의 모든 항목이 비었는지 돌려받을 포인터
+ * @return 성공 시 0, 실패 시 음수의 오류 코드
+ */
+static int free_tree(int fd, struct sfuse_super *sb, uint8_t *block_map,
+                     uint64_t blk, int level, uint64_t base, uint64_t from,
+                     uint64_t to, bool *emptied) {
+  uint8_t buf[SFUSE_BLOCK_SIZE];
+  int res = read_block(fd, blk, buf);
+  if (res < 0)
+    return res;
+
+  uint64_t *ptrs = (uint64_t *)buf;
+  uint64_t span = 1; // 항목 하나가 표현하는 논리 블록 수
+  for (int l = 1; l < level; l++)
+    span *= SFUSE_ADDR_PER_BLOCK;
+
+  bool dirty = false;
+  bool empty = true;
+  for (uint32_t i = 0; i < SFUSE_ADDR_PER_BLOCK; i++) {
+    uint64_t child = le64toh(ptrs[i]);
+    if (child == 0)
+      continue;
+
+    uint64_t first = base + i * span;
+    // 범위 전체가 [from, to) 밖이면 유지
+    if (first + span <= from || first >= to) {
+      empty = false;
+      continue;
+    }
+
+    bool child_empty = true;
+    if (level > 1) {
+      res = free_tree(fd, sb, block_map, child, level - 1, first, from, to,
+                      &child_empty);
+      if (res < 0)
+        return res;
+    }
+
+    if (child_empty) {
+      release_block(sb, block_map, child);
+      ptrs[i] = 0;
+      dirty = true;
+    } else {
+      empty = false;
+    }
+  }
+
+  // 일부만 해제된 인다이렉트 블록은 갱신된 내용을 기록한다.
+  if (dirty && !empty) {
+    res = write_block(fd, blk, buf);
+    if (res < 0)
+      return res;
+  }
+
+  *emptied = empty;
+  return 0;
+}
+
+/**
+ * @brief 논리 블록 범위 [from_lbn, to_lbn)의 데이터 블록을 해제한다.
+ *
+ * Direct 블록부터 Triple indirect 트리까지 차례로 순회하며, 범위에 해당하는
+ * 데이터 블록을 비트맵에 반환한다. 모든 항목이 비게 된 인다이렉트 블록도 함께
+ * 해제하고 아이노드의 포인터를 0으로 만든다.
+ *
+ * @param fd        디바이스 파일 디스크립터
+ * @param sb        슈퍼블록 정보 포인터 (free_blocks 갱신)
+ * @param block_map 블록 비트맵 버퍼
+ * @param inode     대상 아이노드 포인터
+ * @param from_lbn  해제를 시작할 논리 블록 번호
+ * @param to_lbn    해제를 끝낼 논리 블록 번호 (이 번호는 제외)
+ * @return 성공 시 0, 실패 시 음수의 오류 코드 반환
+ */
+int inode_punch_blocks(int fd, struct sfuse_super *sb, uint8_t *block_map,
+                       struct sfuse_inode *inode, uint64_t from_lbn,
+                       uint64_t to_lbn) {
+  const uint64_t per = SFUSE_ADDR_PER_BLOCK;
+
+  // 인라인 아이노드는 해제할 블록이 없다.
+  if (inode_is_inline(inode) || from_lbn >= to_lbn)
+    return 0;
+
+  /* [1단계] Direct 블록 해제 */
+  for (uint64_t i = from_lbn; i < SFUSE_NDIR_BLOCKS && i < to_lbn; i++) {
+    if (inode->direct[i]) {
+      release_block(sb, block_map, inode->direct[i]);
+      inode->direct[i] = 0;
+    }
+  }
+
+  /* [2단계] Single/Double/Triple indirect 트리 해제 */
+  uint64_t *roots[3] = {&inode->indirect, &inode->double_indirect,
+                        &inode->triple_indirect};
+  uint64_t base = SFUSE_NDIR_BLOCKS;
+  uint64_t span = per;
+  for (int level = 1; level <= 3; level++) {
+    uint64_t *root = roots[level - 1];
+    if (*root && base + span > from_lbn && base < to_lbn) {
+      bool emptied = false;
+      int res = free_tree(fd, sb, block_map, *root, level, base, from_lbn,
+                          to_lbn, &emptied);
+      if (res < 0)
+        return res;
+      if (emptied) {
+        release_block(sb, block_map, *root);
+        *root = 0;
+      }
+    }
+    base += span;
+    span *= per;
+  }
+
+  return 0;
+}
 
-    // indirect 블록 번호가 존재하면, 해당 블록을 디스크에서 읽는다
-    if (read_block(fd, inode->indirect, buf) < 0)
-      return -EIO; // indirect 블록을 읽는 도중 오류가 발생하면 입출력 오류 반환
+/**
+ * @brief 지정된 논리 블록 이후의 모든 데이터 블록과 인다이렉트 블록을 해제한다.
+ *
+ * @param fd        디바이스 파일 디스크립터
+ * @param sb        슈퍼블록 정보 포인터 (free_blocks 갱신)
+ * @param block_map 블록 비트맵 버퍼
+ * @param inode     대상 아이노드 포인터
+ * @param from_lbn  해제를 시작할 논리 블록 번호
+ * @return 성공 시 0, 실패 시 음수의 오류 코드 반환
+ */
+int inode_free_blocks(int fd, struct sfuse_super *sb, uint8_t *block_map,
+                      struct sfuse_inode *inode, uint64_t from_lbn) {
+  return inode_punch_blocks(fd, sb, block_map, inode, from_lbn, UINT64_MAX);
+}
 
-    // indirect 블록에서 블록 주소 배열을 가져옴
-    uint32_t *ptrs = (uint32_t *)buf;
-    *pbn_out = ptrs[lbn]; // indirect 블록의 주소 배열에서 요청한 논리 블록의
-                          // 물리 블록 번호를 얻음
+/**
+ * @brief 인라인 데이터를 새 데이터 블록으로 옮기고 블록 맵 형식으로 전환한다.
+ *
+ * 인라인 데이터 용량은 블록 크기보다 작으므로 항상 블록 하나로 충분하다.
+ * 파일 크기가 0이면 블록을 할당하지 않고 플래그만 해제한다.
+ *
+ * @param fd        디바이스 파일 디스크립터
+ * @param sb        슈퍼블록 정보 포인터 (블록 할당 시 갱신)
+ * @param block_map 블록 비트맵 버퍼
+ * @param inode     인라인 데이터를 가진 아이노드 포인터
+ * @return 성공 시 0, 실패 시 음수의 오류 코드 반환
+ *         -ENOSPC : 데이터 블록 부족
+ *         -EIO    : 디스크 쓰기 실패
+ */
+int inode_inline_migrate(int fd, struct sfuse_super *sb, uint8_t *block_map,
+                         struct sfuse_inode *inode) {
+  if (!inode_is_inline(inode))
     return 0;
+
+  /* [1단계] 인라인 데이터를 블록 크기 버퍼로 복사 */
+  uint8_t block[SFUSE_BLOCK_SIZE] = {0};
+  uint64_t len = inode->size;
+  if (len > inode_inline_capacity(sb))
+    len = inode_inline_capacity(sb);
+  memcpy(block, inode->inline_data, len);
+
+  /* [2단계] 데이터가 있으면 새 블록에 기록 */
+  uint64_t pbn = 0;
+  if (len > 0) {
+    int64_t off = alloc_block(sb, block_map);
+    if (off < 0)
+      return -ENOSPC;
+    pbn = sb->data_block_start + (uint64_t)off;
+    if (write_block(fd, pbn, block) < 0) {
+      free_block(sb, block_map, (uint64_t)off);
+      return -EIO;
+    }
   }
 
-  /* --- [3단계: Double Indirect 블록 확인] --- */
-  lbn -= entries; // Single indirect 블록의 범위를 초과하였으므로, Double
-                  // indirect 블록을 처리하기 위해 보정
+  /* [3단계] 블록 포인터 영역을 초기화하고 블록 맵 형식으로 전환 */
+  memset(inode->inline_data, 0, sizeof(inode->inline_data));
+  inode->flags &= ~SFUSE_INODE_FLAG_INLINE;
+  inode->direct[0] = pbn;
 
-  uint32_t idx1 = lbn / entries; // Double indirect 첫 번째 레벨의 인덱스 계산
-  uint32_t idx2 = lbn % entries; // Double indirect 두 번째 레벨의 인덱스 계산
+  return 0;
+}
 
-  if (inode->double_indirect == 0)
-    return -ENOENT; // Double indirect 블록 자체가 할당되지 않은 상태
+/**
+ * @brief 논리 블록 lbn을 담고 있는 블록 맵 단위(leaf)를 통째로 읽는다.
+ *
+ * @param fd       디바이스 파일 디스크립터
+ * @param inode    대상 아이노드 포인터
+ * @param lbn      논리 블록 번호
+ * @param ptrs     포인터를 받을 배열 (SFUSE_ADDR_PER_BLOCK개)
+ * @param base_out 첫 항목의 논리 블록 번호
+ * @return 성공 시 항목 수, 실패 시 음수의 오류 코드 반환
+ */
+int inode_map_leaf(int fd, const struct sfuse_inode *inode, uint64_t lbn,
+                   uint64_t *ptrs, uint64_t *base_out) {
+  if (inode_is_inline(inode))
+    return -EINVAL;
 
-  // double indirect의 첫 번째 레벨 블록을 읽는다.
-  if (read_block(fd, inode->double_indirect, buf) < 0)
-    return -EIO; // 첫 번째 레벨 블록을 읽을 때 오류 발생 시 입출력 오류 반환
+  /* [1단계] Direct 블록은 아이노드 안의 배열을 그대로 복사 */
+  if (lbn < SFUSE_NDIR_BLOCKS) {
+    memcpy(ptrs, inode->direct, sizeof(inode->direct));
+    *base_out = 0;
+    return SFUSE_NDIR_BLOCKS;
+  }
 
-  uint32_t *ptrs1 = (uint32_t *)buf;
-  uint32_t block2 = ptrs1[idx1]; // 두 번째 레벨 블록 번호를 얻음
+  /* [2단계] 마지막 단계 인다이렉트 블록까지 따라감 */
+  const uint64_t *root;
+  uint32_t idx[3];
+  int depth = bmap_path(inode, lbn, &root, idx);
+  if (depth < 0)
+    return depth;
+
+  *base_out = lbn - idx[depth - 1];
+  uint64_t blk = *root;
+  uint8_t buf[SFUSE_BLOCK_SIZE];
+  for (int d = 0; d < depth; d++) {
+    if (blk == 0) {
+      // 경로가 비어 있으면 leaf 전체가 구멍
+      memset(ptrs, 0, SFUSE_ADDR_PER_BLOCK * sizeof(uint64_t));
+      return SFUSE_ADDR_PER_BLOCK;
+    }
+    if (read_block(fd, blk, buf) < 0)
+      return -EIO;
+    if (d < depth - 1)
+      blk = le64toh(((const uint64_t *)buf)[idx[d]]);
+  }
 
-  if (block2 == 0)
-    return -ENOENT; // 두 번째 레벨 블록이 할당되지 않은 경우
+  /* [3단계] leaf의 포인터를 호스트 바이트 순서로 변환 */
+  const uint64_t *raw = (const uint64_t *)buf;
+  for (uint32_t i = 0; i < SFUSE_ADDR_PER_BLOCK; i++)
+    ptrs[i] = le64toh(raw[i]);
+  return SFUSE_ADDR_PER_BLOCK;
+}
 
-  // 두 번째 레벨 블록을 디스크에서 읽는다.
-  if (read_block(fd, block2, buf) < 0)
-    return -EIO; // 두 번째 레벨 블록을 읽을 때 오류 발생 시 입출력 오류 반환
+/**
+ * @brief 인다이렉트 블록 트리에서 start 이후 첫 데이터 블록 또는 구멍을 찾는다.
+ *
+ * 비어 있는 인다이렉트 포인터는 하위 트리 전체를 구멍으로 보고 읽지 않고
+ * 건너뛴다.
+ *
+ * @param fd      디바이스 파일 디스크립터
+ * @param blk     현재 인다이렉트 블록 번호
+ * @param level   현재 단계 (1이면 항목이 데이터 블록)
+ * @param base    이 인다이렉트 블록이 표현하는 첫 논리 블록 번호
+ * @param start   검색을 시작할 논리 블록 번호
+ * @param data    참이면 데이터 블록을, 거짓이면 구멍을 찾는다
+ * @param lbn_out 찾은 논리 블록 번호
+ * @return 찾으면 1, 이 트리에 없으면 0, 실패 시 음수의 오류 코드
+ */
+static int seek_tree(int fd, uint64_t blk, int level, uint64_t base,
+                     uint64_t start, bool data, uint64_t *lbn_out) {
+  uint8_t buf[SFUSE_BLOCK_SIZE];
+  if (read_block(fd, blk, buf) < 0)
+    return -EIO;
 
-  uint32_t *ptrs2 = (uint32_t *)buf;
-  *pbn_out = ptrs2[idx2]; // 최종적으로 변환된 물리 블록 번호를 얻음
+  const uint64_t *ptrs = (const uint64_t *)buf;
+  uint64_t span = 1; // 항목 하나가 표현하는 논리 블록 수
+  for (int l = 1; l < level; l++)
+    span *= SFUSE_ADDR_PER_BLOCK;
+
+  uint32_t i = start > base ? (uint32_t)((start - base) / span) : 0;
+  for (; i < SFUSE_ADDR_PER_BLOCK; i++) {
+    uint64_t child = le64toh(ptrs[i]);
+    uint64_t first = base + i * span;
+    uint64_t from = first > start ? first : start;
+
+    if (child == 0) {
+      if (!data) {
+        *lbn_out = from;
+        return 1;
+      }
+      continue;
+    }
+    if (level == 1) {
+      // 예약(unwritten) 블록은 0으로 읽히므로 구멍으로 취급
+      bool written = !(child & SFUSE_BLOCK_UNWRITTEN);
+      if (written == data) {
+        *lbn_out = from;
+        return 1;
+      }
+      continue;
+    }
+    int res = seek_tree(fd, child, level - 1, first, start, data, lbn_out);
+    if (res != 0)
+      return res;
+  }
+  return 0;
+}
 
-  return 0; // 성공적으로 물리 블록 번호 변환 완료
+/**
+ * @brief start_lbn 이후 첫 데이터 블록 또는 구멍의 논리 블록 번호를 찾는다.
+ *
+ * SEEK_DATA/SEEK_HOLE 구현에 사용한다. 블록 맵을 Direct → Single → Double →
+ * Triple 순서로 따라가며, 할당되지 않은 인다이렉트 하위 트리는 한 번에
+ * 건너뛴다. 예약(unwritten) 블록은 구멍으로 본다.
+ *
+ * @param fd        디바이스 파일 디스크립터
+ * @param inode     대상 아이노드 포인터 (인라인 아이노드가 아니어야 함)
+ * @param start_lbn 검색을 시작할 논리 블록 번호
+ * @param data      참이면 데이터 블록을, 거짓이면 구멍을 찾는다
+ * @param lbn_out   찾은 논리 블록 번호
+ * @return 성공 시 0, 실패 시 음수의 오류 코드 반환
+ *         -ENXIO : start_lbn 이후에 데이터 블록이 없음
+ *         -EIO   : 인다이렉트 블록 읽기 실패
+ */
+int inode_seek_block(int fd, const struct sfuse_inode *inode,
+                     uint64_t start_lbn, bool data, uint64_t *lbn_out) {
+  const uint64_t per = SFUSE_ADDR_PER_BLOCK;
+
+  if (inode_is_inline(inode))
+    return -EINVAL;
+
+  /* [1단계] Direct 블록 검사 */
+  for (uint64_t i = start_lbn; i < SFUSE_NDIR_BLOCKS; i++) {
+    uint64_t blk = inode->direct[i];
+    bool written = blk && !(blk & SFUSE_BLOCK_UNWRITTEN);
+    if (written == data) {
+      *lbn_out = i;
+      return 0;
+    }
+  }
+
+  /* [2단계] Single/Double/Triple indirect 트리 검사 */
+  const uint64_t roots[3] = {inode->indirect, inode->double_indirect,
+                             inode->triple_indirect};
+  uint64_t base = SFUSE_NDIR_BLOCKS;
+  uint64_t span = per;
+  for (int level = 1; level <= 3; level++) {
+    if (base + span > start_lbn) {
+      uint64_t from = base > start_lbn ? base : start_lbn;
+      if (roots[level - 1] == 0) {
+        if (!data) {
+          *lbn_out = from;
+          return 0;
+        }
+      } else {
+        int res = seek_tree(fd, roots[level - 1], level, base, from, data,
+                            lbn_out);
+        if (res < 0)
+          return res;
+        if (res > 0)
+          return 0;
+      }
+    }
+    base += span;
+    span *= per;
+  }
+
+  // 블록 맵이 표현하는 범위 이후는 모두 구멍이다.
+  if (data)
+    return -ENXIO;
+  *lbn_out = base > start_lbn ? base : start_lbn;
+  return 0;
 }
@@ -13,12 +13,35 @@
 #include <fcntl.h>
 #include <fuse.h>
 #include <fuse_opt.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+/** @brief struct sfuse_mount_opts 필드에 값을 저장하는 마운트 옵션 */
+#define SFUSE_OPT(t, p, v) {t, offsetof(struct sfuse_mount_opts, p), v}
+
+/**
+ * @brief SFUSE가 직접 처리하는 마운트 옵션 목록
+ *
+ * 여기서 처리한 옵션은 인자 목록에서 제거되고, sfuse_init_cb()가 FUSE 설정에
+ * 반영한다.
+ */
+static const struct fuse_opt sfuse_opts[] = {
+    SFUSE_OPT("entry_timeout=%lf", entry_timeout, 0),
+    SFUSE_OPT("attr_timeout=%lf", attr_timeout, 0),
+    SFUSE_OPT("negative_timeout=%lf", negative_timeout, 0),
+    SFUSE_OPT("no_writeback_cache", no_writeback_cache, 1),
+    SFUSE_OPT("no_keep_cache", no_keep_cache, 1),
+    SFUSE_OPT("mmap_meta", mmap_meta, 1),
+    SFUSE_OPT("nodiscard", no_discard, 1),
+    SFUSE_OPT("compress", compress, 1),
+    SFUSE_OPT("dedup", dedup, 1),
+    SFUSE_OPT("snapshot", snapshot, 1),
+    FUSE_OPT_END};
+
 /**
  * @brief 프로그램 메인 함수
  *
@@ -59,7 +82,18 @@ int main(int argc, char *argv[]) {
             "  -o nonempty: 마운트 지점이 비어있지 않아도 마운트를 허용한다.\n"
             "  -o direct_io: 커널 페이지 캐시를 우회하여 직접 입출력을 "
             "활성화한다.\n"
-            "  -o auto_unmount: 프로그램 종료 시 자동으로 마운트를 해제한다.\n",
+            "  -o auto_unmount: 프로그램 종료 시 자동으로 마운트를 해제한다.\n"
+            "\nSFUSE 캐시 옵션들:\n"
+            "  -o entry_timeout=T: 디렉터리 항목 캐시 시간(초, 기본값 60)\n"
+            "  -o attr_timeout=T: 속성 캐시 시간(초, 기본값 60)\n"
+            "  -o negative_timeout=T: 없는 항목 캐시 시간(초, 기본값 10)\n"
+            "  -o no_writeback_cache: 커널 writeback 캐시를 끈다.\n"
+            "  -o no_keep_cache: 파일을 열 때마다 페이지 캐시를 버린다.\n"
+            "  -o mmap_meta: 비트맵과 아이노드 테이블을 mmap으로 접근한다.\n"
+            "  -o nodiscard: 해제한 블록을 장치에 discard(TRIM)하지 않는다.\n"
+            "  -o compress: 새로 만드는 파일의 데이터를 압축해 기록한다.\n"
+            "  -o dedup: 내용이 같은 데이터 블록을 하나만 기록해 공유한다.\n"
+            "  -o snapshot: 장치의 스냅숏을 읽기 전용으로 마운트한다.\n",
             argv[0]);
     return EXIT_SUCCESS;
   }
@@ -81,10 +115,11 @@ int main(int argc, char *argv[]) {
    * 블록 디바이스 파일을 열고 파일 디스크립터를 획득한다.
    *
    * open(): 파일이나 디바이스를 열 때 사용.
-   * O_RDWR: 읽기 및 쓰기 모드,
-   * O_SYNC: 데이터를 즉시 디스크에 쓰는 동기화 모드를 설정한다.
+   * O_RDWR: 읽기 및 쓰기 모드.
+   * O_SYNC는 쓰지 않는다. 기록은 장치의 쓰기 캐시를 거치고, 영구 반영은
+   * fsync 요청과 언마운트 시점에 fs_sync_device()가 묶어서 수행한다.
    */
-  int backing_fd = open(dev_path, O_RDWR | O_SYNC);
+  int backing_fd = open(dev_path, O_RDWR);
   if (backing_fd < 0) {
     perror("디바이스 열기 실패");
     return EXIT_FAILURE;
@@ -136,6 +171,20 @@ int main(int argc, char *argv[]) {
     fuse_opt_add_arg(&args, argv[i]);
   }
 
+  /*
+   * SFUSE 캐시 옵션을 기본값으로 채운 뒤 명령줄 값으로 덮어쓴다.
+   * 처리된 옵션은 args에서 제거되어 FUSE에는 전달되지 않는다.
+   */
+  fs->opts.entry_timeout = SFUSE_DEFAULT_ENTRY_TIMEOUT;
+  fs->opts.attr_timeout = SFUSE_DEFAULT_ATTR_TIMEOUT;
+  fs->opts.negative_timeout = SFUSE_DEFAULT_NEGATIVE_TIMEOUT;
+  if (fuse_opt_parse(&args, &fs->opts, sfuse_opts, NULL) < 0) {
+    fuse_opt_free_args(&args);
+    close(backing_fd);
+    free(fs);
+    return EXIT_FAILURE;
+  }
+
   /*
    * 필수 옵션을 추가하여 SFUSE 운영에 필요한 기본 설정을 활성화한다.
    * -o:
@@ -153,6 +202,11 @@ int main(int argc, char *argv[]) {
    */
   fuse_opt_add_arg(&args, "-o");
   fuse_opt_add_arg(&args, "allow_other");
+  // 스냅숏 마운트는 커널에서도 읽기 전용으로 마운트한다.
+  if (fs->opts.snapshot) {
+    fuse_opt_add_arg(&args, "-o");
+    fuse_opt_add_arg(&args, "ro");
+  }
   // fuse_opt_add_arg(&args, "default_permissions");
   fuse_opt_add_arg(&args, "-d");
 
@@ -0,0 +1,112 @@
+/**
+ * @file src/meta.c
+ * @brief 메타데이터 영역 메모리 매핑 구현
+ *
+ * 더티 표시는 페이지마다 1바이트이다. 서로 다른 스레드가 다른 아이노드를
+ * 기록하므로 잠금 없이 원자 연산으로 표시하고, meta_flush()는 표시를 지우면서
+ * 연속된 더티 페이지를 하나의 msync() 호출로 묶는다.
+ */
+
+#include "meta.h"
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/**
+ * @struct meta_state
+ * @brief 현재 매핑 상태
+ */
+static struct meta_state {
+  uint8_t *base;          /**< 매핑 시작 주소 (NULL이면 매핑 없음) */
+  size_t size;            /**< 매핑 크기 (바이트) */
+  size_t page;            /**< 페이지 크기 */
+  size_t npages;          /**< 매핑의 페이지 수 */
+  _Atomic uint8_t *dirty; /**< 페이지별 더티 표시 */
+} meta;
+
+int meta_map(int fd, const struct sfuse_super *sb) {
+  size_t size = (size_t)sb->journal_start * SFUSE_BLOCK_SIZE;
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t npages = (size + page - 1) / page;
+
+  _Atomic uint8_t *dirty = calloc(npages, sizeof(*dirty));
+  if (!dirty)
+    return -ENOMEM;
+  void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    int err = -errno;
+    free(dirty);
+    return err;
+  }
+
+  meta.base = base;
+  meta.size = size;
+  meta.page = page;
+  meta.npages = npages;
+  meta.dirty = dirty;
+  return 0;
+}
+
+void meta_unmap(void) {
+  if (!meta.base)
+    return;
+  munmap(meta.base, meta.size);
+  free(meta.dirty);
+  memset(&meta, 0, sizeof(meta));
+}
+
+void *meta_ptr(off_t off, size_t len) {
+  if (!meta.base || off < 0 || (size_t)off > meta.size ||
+      len > meta.size - (size_t)off)
+    return NULL;
+  return meta.base + off;
+}
+
+bool meta_owns(const void *p) {
+  const uint8_t *q = p;
+  return meta.base && q >= meta.base && q < meta.base + meta.size;
+}
+
+void meta_dirty(const void *p, size_t len) {
+  if (!meta_owns(p) || len == 0)
+    return;
+  size_t off = (size_t)((const uint8_t *)p - meta.base);
+  size_t first = off / meta.page;
+  size_t last = (off + len - 1) / meta.page;
+  for (size_t i = first; i <= last && i < meta.npages; i++)
+    atomic_store_explicit(&meta.dirty[i], 1, memory_order_relaxed);
+}
+
+int meta_flush(void) {
+  if (!meta.base)
+    return 0;
+
+  size_t i = 0;
+  while (i < meta.npages) {
+    // 연속된 더티 페이지 구간 [i, j)를 찾으며 표시를 지움
+    if (!atomic_exchange_explicit(&meta.dirty[i], 0, memory_order_acquire)) {
+      i++;
+      continue;
+    }
+    size_t j = i + 1;
+    while (j < meta.npages &&
+           atomic_exchange_explicit(&meta.dirty[j], 0, memory_order_acquire))
+      j++;
+
+    size_t len = (j - i) * meta.page;
+    if (i * meta.page + len > meta.size)
+      len = meta.size - i * meta.page;
+    if (msync(meta.base + i * meta.page, len, MS_SYNC) < 0) {
+      int err = -errno;
+      for (size_t k = i; k < j; k++) // 다음 커밋 때 다시 시도
+        atomic_store(&meta.dirty[k], 1);
+      return err;
+    }
+    i = j;
+  }
+  return 0;
+}
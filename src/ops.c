@@ -1,14 +1,27 @@
 // ops.c: FUSE 콜백 구현
 // ops.c: FUSE 콜백 구현
+#define _GNU_SOURCE // SEEK_DATA, SEEK_HOLE
 #include "ops.h"
 #include "bitmap.h"
 #include "block.h"
+#include "compress.h"
+#include "csum.h"
+#include "ctl.h"
+#include "dalloc.h"
+#include "dedup.h"
+#include "defrag.h"
 #include "dir.h"
+#include "disk.h"
+#include "file.h"
 #include "fs.h"
 #include "inode.h"
+#include "orphan.h"
+#include "stats.h"
 #include "super.h"
 #include <errno.h>
 #include <fcntl.h>
+#include <linux/falloc.h>
+#include <linux/fs.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,42 +32,104 @@
 /* FUSE 초기화 콜백 (FUSE3 API) */
 static void *sfuse_init_cb(struct fuse_conn_info *conn,
                            struct fuse_config *cfg) {
-  (void)conn;
-  (void)cfg;
   struct sfuse_fs *fs = get_fs_context();
   // 파일시스템 초기화 (슈퍼블록/비트맵 로드, 루트 아이노드 설정)
   if (fs_initialize(fs->backing_fd) < 0) {
     fprintf(stderr, "[SFUSE] FS initialization failed\n");
     exit(EXIT_FAILURE);
   }
+  ctl_init();
+  fs->fuse = fuse_get_context()->fuse;
+
+  /* [1단계] 커널 항목/속성 캐시 시간 설정 */
+  // 장치의 모든 변경이 SFUSE를 거치므로 매 요청마다 재검증할 필요가 없다.
+  // 요청과 무관하게 SFUSE가 바꾼 내용은 fs_invalidate_path()로 알린다.
+  const struct sfuse_mount_opts *mo = &fs->opts;
+  cfg->entry_timeout = mo->entry_timeout;
+  cfg->attr_timeout = mo->attr_timeout;
+  cfg->negative_timeout = mo->negative_timeout;
+
+  /* [2단계] 커널 기능 협상 */
+  // 아이노드 시각은 초 단위로 저장된다.
+  conn->time_gran = 1000000000;
+  // 작은 쓰기를 커널 페이지 캐시에서 모아 큰 요청으로 전달받음
+  if (!mo->no_writeback_cache && (conn->capable & FUSE_CAP_WRITEBACK_CACHE))
+    conn->want |= FUSE_CAP_WRITEBACK_CACHE;
+  // 같은 디렉터리에 대한 lookup/readdir을 동시에 처리
+  if (conn->capable & FUSE_CAP_PARALLEL_DIROPS)
+    conn->want |= FUSE_CAP_PARALLEL_DIROPS;
+  // read 응답 데이터를 복사 없이 splice로 커널에 넘김. write 요청은 write_buf
+  // 콜백이 없으므로 splice로 받아도 이득이 없어 SPLICE_READ는 켜지 않는다.
+  conn->want |= conn->capable & (FUSE_CAP_SPLICE_WRITE | FUSE_CAP_SPLICE_MOVE);
+
+  /* [3단계] 요청 크기와 동시 요청 수 */
+  // max_read는 -o max_read로도 지정해야 적용되므로 커널 한도(0)를 그대로 둔다.
+  conn->max_write = SFUSE_MAX_WRITE;
+  conn->max_readahead = SFUSE_MAX_READAHEAD;
+  conn->max_background = SFUSE_MAX_BACKGROUND;
+  conn->congestion_threshold = SFUSE_MAX_BACKGROUND * 3 / 4;
   return fs;
 }
 
-/* FUSE 종료 콜백 */
-static void sfuse_destroy_cb(void *private_data) {
-  struct sfuse_fs *fs = private_data;
-  size_t bmap_bytes = fs->sb.blocks_count / 8;
-  size_t imap_bytes = fs->sb.inodes_count / 8;
-  bitmap_sync(fs->backing_fd, fs->sb.block_bitmap_start, fs->block_map,
-              bmap_bytes);
-  bitmap_sync(fs->backing_fd, fs->sb.inode_bitmap_start, fs->inode_map,
-              imap_bytes);
-  sb_sync(fs->backing_fd, &fs->sb);
-  free(fs->block_map);
-  free(fs->inode_map);
+/* FUSE 종료 콜백 (회수/discard 스레드 정지와 동기화는 fs_destroy()가 처리) */
+static void sfuse_destroy_cb(void *private_data) { fs_destroy(private_data); }
+
+/* fi->fh에 저장된 열린 파일 객체 (open/create를 거치지 않았으면 NULL) */
+static struct sfuse_file *sfuse_file_of(const struct fuse_file_info *fi) {
+  return fi ? (struct sfuse_file *)(uintptr_t)fi->fh : NULL;
+}
+
+/* 열린 파일이면 핸들의 아이노드 번호를, 아니면 경로를 탐색하여 돌려준다. */
+static int sfuse_lookup(struct sfuse_fs *fs, const char *path,
+                        const struct fuse_file_info *fi, uint32_t *ino) {
+  struct sfuse_file *f = sfuse_file_of(fi);
+  if (f) {
+    *ino = f->ino;
+    return 0;
+  }
+  int res = fs_resolve_path(fs, path, ino);
+  if (res < 0)
+    return res == -EBADMSG ? res : -ENOENT;
+  return 0;
+}
+
+/*
+ * 블록 맵 조회. 열린 파일 핸들이 있으면 캐시된 leaf를 사용하고, 없으면
+ * 인다이렉트 블록을 따라간다. 반환 값은 logical_to_physical()과 같다.
+ */
+static int sfuse_bmap(struct sfuse_fs *fs, struct sfuse_file *f,
+                      const struct sfuse_inode *inode, uint64_t lbn, void *buf,
+                      uint64_t *pbn) {
+  if (f)
+    return file_bmap(fs, f, lbn, pbn);
+  return logical_to_physical(fs->backing_fd, &fs->sb, inode, lbn, buf, pbn);
 }
 
 /* getattr */
 static int sfuse_getattr_cb(const char *path, struct stat *stbuf,
                             struct fuse_file_info *fi) {
-  (void)fi;
   struct sfuse_fs *fs = get_fs_context();
-  uint32_t ino;
-  if (fs_resolve_path(fs, path, &ino) < 0)
-    return -ENOENT;
+  enum sfuse_ctl_node node = ctl_node(path);
+  if (node)
+    return ctl_getattr(node, stbuf);
+  struct sfuse_file *f = sfuse_file_of(fi);
   struct sfuse_inode inode;
-  if (inode_load(fs->backing_fd, &fs->sb, ino, &inode) < 0)
-    return -EIO;
+  if (f) {
+    // fstat: 열린 파일의 캐시된 아이노드 사용
+    pthread_mutex_lock(&f->lock);
+    int res = file_revalidate(fs, f);
+    inode = f->inode;
+    pthread_mutex_unlock(&f->lock);
+    if (res < 0)
+      return -EIO;
+  } else {
+    uint32_t ino;
+    int res = sfuse_lookup(fs, path, NULL, &ino);
+    if (res < 0)
+      return res;
+    if (inode_load(fs->backing_fd, &fs->sb, ino, &inode) < 0)
+      return -EIO;
+  }
   memset(stbuf, 0, sizeof(*stbuf));
   stbuf->st_mode = inode.mode;
   stbuf->st_nlink = S_ISDIR(inode.mode) ? 2 : 1; // 디렉터리는 링크수 2로 고정
@@ -70,6 +145,9 @@ static int sfuse_getattr_cb(const char *path, struct stat *stbuf,
 /* access */
 static int sfuse_access_cb(const char *path, int mask) {
   struct sfuse_fs *fs = get_fs_context();
+  enum sfuse_ctl_node node = ctl_node(path);
+  if (node)
+    return node == SFUSE_CTL_UNKNOWN ? -ENOENT : 0;
   uint32_t ino;
   if (fs_resolve_path(fs, path, &ino) < 0)
     return -ENOENT;
@@ -82,6 +160,9 @@ static int sfuse_readdir_cb(const char *path, void *buf, fuse_fill_dir_t filler,
                             off_t offset, struct fuse_file_info *fi,
                             enum fuse_readdir_flags flags) {
   struct sfuse_fs *fs = get_fs_context();
+  enum sfuse_ctl_node node = ctl_node(path);
+  if (node)
+    return node == SFUSE_CTL_ROOT ? ctl_readdir(buf, filler) : -ENOTDIR;
   uint32_t ino;
 
   if (fs_resolve_path(fs, path, &ino) < 0)
@@ -105,7 +186,7 @@ static int sfuse_readdir_cb(const char *path, void *buf, fuse_fill_dir_t filler,
   size_t total_entries = inode.size / sizeof(struct sfuse_dirent);
 
   for (int b = 0; b < SFUSE_NDIR_BLOCKS; b++) {
-    uint32_t blkno = inode.direct[b];
+    uint64_t blkno = inode.direct[b];
     if (!blkno)
       continue;
 
@@ -145,103 +226,398 @@ static int sfuse_readdir_cb(const char *path, void *buf, fuse_fill_dir_t filler,
 /* open */
 static int sfuse_open_cb(const char *path, struct fuse_file_info *fi) {
   struct sfuse_fs *fs = get_fs_context();
+  enum sfuse_ctl_node node = ctl_node(path);
+  if (node)
+    return ctl_open(fs, node, fi);
   uint32_t ino;
 
   if (fs_resolve_path(fs, path, &ino) < 0)
     return -ENOENT;
 
-  struct sfuse_inode inode;
-  if (inode_load(fs->backing_fd, &fs->sb, ino, &inode) < 0)
-    return -EIO;
+  // 열린 파일 객체를 만들어 이후 read/write가 경로 탐색 없이 처리되게 함
+  struct sfuse_file *f;
+  int res = file_open(fs, ino, fi->flags, &f);
+  if (res < 0)
+    return res;
+  fi->fh = (uint64_t)(uintptr_t)f;
+
+  // 모든 쓰기가 커널을 거치므로 다시 열어도 페이지 캐시를 유지
+  fi->keep_cache = !fs->opts.no_keep_cache;
 
   // 디렉터리도 정상적으로 open 가능하게 처리
   return 0;
 }
 
-/* read */
-static int sfuse_read_cb(const char *path, char *buf, size_t size, off_t offset,
-                         struct fuse_file_info *fi) {
-  (void)fi;
-  struct sfuse_fs *fs = get_fs_context();
-  uint32_t ino;
-  if (fs_resolve_path(fs, path, &ino) < 0)
-    return -ENOENT;
-  struct sfuse_inode inode;
-  inode_load(fs->backing_fd, &fs->sb, ino, &inode);
-  if (S_ISDIR(inode.mode))
-    return -EISDIR;
-  if (offset >= inode.size)
+/*
+ * 아이노드의 [offset, offset + size) 범위를 읽는다. 파일 크기 이후는 읽지
+ * 않는다. 구멍과 예약(unwritten) 블록은 장치 I/O 없이 0으로 채우고, 물리적으로
+ * 이어진 데이터 블록은 모아서 한 번의 disk_read()로 읽는다. 압축 클러스터의
+ * 블록은 compress_read()로 풀어서 읽는다.
+ * read 콜백과 copy_file_range 콜백이 함께 사용한다.
+ */
+static ssize_t sfuse_read_inode(struct sfuse_fs *fs, uint32_t ino,
+                                const struct sfuse_inode *inode,
+                                struct sfuse_file *f, char *buf, size_t size,
+                                uint64_t offset) {
+  if (offset >= inode->size)
     return 0;
   // 파일 크기를 넘어서는 부분은 읽지 않음
   size_t to_read = size;
-  if (offset + to_read > inode.size)
-    to_read = inode.size - offset;
+  if (offset + to_read > inode->size)
+    to_read = inode->size - offset;
+
+  // 인라인 데이터는 inode_load()로 이미 읽혔으므로 추가 I/O 없이 복사
+  if (inode_is_inline(inode)) {
+    memcpy(buf, inode->inline_data + offset, to_read);
+    return to_read;
+  }
+
   size_t done = 0;
-  uint32_t pbn;
+  uint64_t pbn;
   uint8_t tmp[SFUSE_BLOCK_SIZE];
   // 오프셋부터 필요한 바이트만큼 읽기
   while (done < to_read) {
-    off_t cur = offset + done;
-    uint32_t lbn = cur / SFUSE_BLOCK_SIZE;
+    uint64_t cur = offset + done;
+    uint64_t lbn = cur / SFUSE_BLOCK_SIZE;
     size_t boff = cur % SFUSE_BLOCK_SIZE;
     size_t chunk = SFUSE_BLOCK_SIZE - boff;
     if (chunk > to_read - done)
       chunk = to_read - done;
-    logical_to_physical(fs->backing_fd, &fs->sb, &inode, lbn, tmp, &pbn);
-    read_block(fs->backing_fd, pbn, tmp);
-    memcpy(buf + done, tmp + boff, chunk);
-    done += chunk;
+    // 아직 블록이 할당되지 않은 더티 데이터를 먼저 확인
+    if (dalloc_read(fs, ino, lbn, boff, buf + done, chunk) == 0) {
+      done += chunk;
+      continue;
+    }
+    int res = sfuse_bmap(fs, f, inode, lbn, tmp, &pbn);
+    if (res == -ENOENT || res == 1) {
+      // 할당되지 않은 블록(hole)과 예약만 된 블록은 0으로 읽힌다.
+      memset(buf + done, 0, chunk);
+      done += chunk;
+      continue;
+    }
+    if (res == 2) {
+      // 압축 클러스터의 블록은 클러스터 첫 포인터의 구간을 풀어서 읽는다.
+      uint64_t idx = lbn % SFUSE_COMPRESS_CLUSTER_BLOCKS;
+      if (idx != 0 && sfuse_bmap(fs, f, inode, lbn - idx, tmp, &pbn) != 2)
+        res = -EIO;
+      else
+        res = compress_read(fs->backing_fd, pbn, idx, boff, buf + done, chunk);
+      if (res < 0)
+        return done ? (ssize_t)done : res;
+      done += chunk;
+      continue;
+    }
+    if (res < 0)
+      return done ? (ssize_t)done : res;
+
+    // 뒤따르는 블록이 물리적으로 이어져 있으면 한 번에 읽음
+    size_t run = chunk;
+    if (boff == 0 && chunk == SFUSE_BLOCK_SIZE) {
+      uint64_t next;
+      while (to_read - done - run >= SFUSE_BLOCK_SIZE) {
+        uint64_t nlbn = lbn + run / SFUSE_BLOCK_SIZE;
+        if (dalloc_contains(fs, ino, nlbn) ||
+            sfuse_bmap(fs, f, inode, nlbn, tmp, &next) != 0 ||
+            next != pbn + run / SFUSE_BLOCK_SIZE)
+          break;
+        run += SFUSE_BLOCK_SIZE;
+      }
+    }
+    ssize_t n = disk_read(fs->backing_fd, buf + done, run,
+                          (off_t)pbn * SFUSE_BLOCK_SIZE + (off_t)boff);
+    if (n != (ssize_t)run)
+      return done ? (ssize_t)done : -EIO;
+    // 블록 전체를 읽었으면 데이터 체크섬 검증 (DATA_CSUM)
+    if (boff == 0 && run % SFUSE_BLOCK_SIZE == 0 &&
+        csum_data_verify(pbn, buf + done, run / SFUSE_BLOCK_SIZE) < 0)
+      return done ? (ssize_t)done : -EIO;
+    done += run;
   }
   return done;
 }
 
-/* write */
-static int sfuse_write_cb(const char *path, const char *buf, size_t size,
-                          off_t offset, struct fuse_file_info *fi) {
-  (void)fi;
+/* read */
+static int sfuse_read_cb(const char *path, char *buf, size_t size, off_t offset,
+                         struct fuse_file_info *fi) {
   struct sfuse_fs *fs = get_fs_context();
+  if (ctl_node(path))
+    return ctl_read(fi, buf, size, offset);
+  struct sfuse_file *f = sfuse_file_of(fi);
+  if (f) {
+    // 열린 파일: 경로 탐색과 아이노드 읽기 없이 캐시로 처리 (같은 핸들의
+    // 요청이 동시에 올 수 있으므로 캐시를 잠금)
+    defrag_io_begin(f->ino);
+    pthread_mutex_lock(&f->lock);
+    ssize_t n = -EIO;
+    if (file_revalidate(fs, f) == 0)
+      n = sfuse_read_inode(fs, f->ino, &f->inode, f, buf, size,
+                           (uint64_t)offset);
+    if (n > 0)
+      file_readahead(fs, f, (uint64_t)offset, (size_t)n);
+    pthread_mutex_unlock(&f->lock);
+    defrag_io_end(f->ino);
+    return (int)n;
+  }
+
   uint32_t ino;
   if (fs_resolve_path(fs, path, &ino) < 0)
     return -ENOENT;
   struct sfuse_inode inode;
-  inode_load(fs->backing_fd, &fs->sb, ino, &inode);
-  if (S_ISDIR(inode.mode))
-    return -EISDIR;
+  ssize_t n;
+  defrag_io_begin(ino);
+  if (inode_load(fs->backing_fd, &fs->sb, ino, &inode) < 0)
+    n = -EIO;
+  else if (S_ISDIR(inode.mode))
+    n = -EISDIR;
+  else
+    n = sfuse_read_inode(fs, ino, &inode, NULL, buf, size, (uint64_t)offset);
+  defrag_io_end(ino);
+  return (int)n;
+}
+
+/*
+ * 이미 기록된 데이터 블록 lbn(물리 블록 pbn)의 내용을 block으로 바꾼다.
+ * 중복 제거로 다른 파일과 공유하는 블록은 제자리에서 고치지 않고 새 블록에
+ * 기록해 연결한 뒤 공유 블록의 참조를 놓는다. (copy-on-write)
+ * 새 블록으로 옮겼으면 1을 돌려주며, 호출자가 아이노드를 기록해야 한다.
+ */
+static int sfuse_store_block(struct sfuse_fs *fs, struct sfuse_inode *inode,
+                             uint64_t lbn, uint64_t pbn, const void *block) {
+  if (!dedup_write_begin(pbn)) {
+    int res = write_block(fs->backing_fd, pbn, block) < 0 ? -EIO : 0;
+    dedup_write_end(pbn);
+    return res;
+  }
+  dedup_write_end(pbn);
+
+  // 지연 할당 버퍼가 예약한 블록은 사용할 수 없음
+  if (fs->sb.free_blocks <= dalloc_reserved(fs))
+    return -ENOSPC;
+  int64_t off = alloc_block(&fs->sb, fs->block_map);
+  if (off < 0)
+    return -ENOSPC;
+  uint64_t copy = fs->sb.data_block_start + (uint64_t)off;
+  int res = write_block(fs->backing_fd, copy, block) < 0
+                ? -EIO
+                : inode_set_block(fs->backing_fd, &fs->sb, fs->block_map,
+                                  inode, lbn, copy);
+  if (res < 0) {
+    free_block(&fs->sb, fs->block_map, (uint64_t)off);
+    return res;
+  }
+  // 그사이 다른 파일이 참조를 놓아 마지막 참조가 되었으면 해제
+  if (!dedup_release(pbn))
+    free_block(&fs->sb, fs->block_map, pbn - fs->sb.data_block_start);
+  stats_event(SFUSE_EV_DEDUP_COW, 1);
+  return 1;
+}
+
+/*
+ * 아이노드에 데이터를 기록하고 크기/시간을 갱신한다.
+ * 인라인 용량 안의 쓰기는 아이노드 레코드에만 반영하고, 용량을 넘어서면
+ * 인라인 데이터를 블록 경로로 옮긴 뒤 기록한다.
+ * 이미 할당된 블록은 제자리에서 갱신하고(공유 블록은 새 블록에 복사),
+ * 할당되지 않은 블록은 지연 할당 버퍼(dalloc)에 모아 두었다가
+ * write-back/fsync 시점에 연속 할당한다. 압축 클러스터의 블록은 클러스터를
+ * 더티 버퍼로 풀어 낸 뒤 갱신한다.
+ * write 콜백과 symlink 콜백이 함께 사용한다.
+ */
+static int sfuse_write_inode(struct sfuse_fs *fs, uint32_t ino,
+                             struct sfuse_inode *inode, struct sfuse_file *f,
+                             const char *buf, size_t size, uint64_t offset) {
+  if (inode_is_inline(inode)) {
+    if (offset + size <= inode_inline_capacity(&fs->sb)) {
+      // 기존 크기와 쓰기 시작점 사이의 빈 공간은 0으로 채움
+      if (offset > inode->size)
+        memset(inode->inline_data + inode->size, 0, offset - inode->size);
+      memcpy(inode->inline_data + offset, buf, size);
+      if (offset + size > inode->size)
+        inode->size = offset + size;
+      inode->mtime = inode->ctime = (int64_t)time(NULL);
+      if (inode_sync(fs->backing_fd, &fs->sb, ino, inode) < 0)
+        return -EIO;
+      if (f)
+        file_synced(f);
+      return size;
+    }
+    // 인라인 용량을 넘어서므로 기존 내용을 0번 블록의 더티 데이터로 옮김
+    uint8_t head[SFUSE_INODE_INLINE_MAX];
+    size_t head_len = inode->size;
+    memcpy(head, inode->inline_data, head_len);
+    memset(inode->inline_data, 0, sizeof(inode->inline_data));
+    inode->flags &= ~SFUSE_INODE_FLAG_INLINE;
+    if (head_len > 0) {
+      int res = dalloc_write(fs, ino, 0, 0, head, head_len, true);
+      if (res < 0) {
+        // 옮기지 못했으면 인라인 상태로 되돌림
+        memcpy(inode->inline_data, head, head_len);
+        inode->flags |= SFUSE_INODE_FLAG_INLINE;
+        return res;
+      }
+    }
+  }
+
   size_t written = 0;
-  uint32_t pbn;
+  uint64_t pbn;
   uint8_t tmp[SFUSE_BLOCK_SIZE];
+  int err = 0;
   // 데이터 쓰기: 필요한 블록을 할당하거나 찾아서 부분 갱신
   while (written < size) {
-    off_t cur = offset + written;
-    uint32_t lbn = cur / SFUSE_BLOCK_SIZE;
+    uint64_t cur = offset + written;
+    uint64_t lbn = cur / SFUSE_BLOCK_SIZE;
     size_t boff = cur % SFUSE_BLOCK_SIZE;
     size_t chunk = SFUSE_BLOCK_SIZE - boff;
     if (chunk > size - written)
       chunk = size - written;
-    if (logical_to_physical(fs->backing_fd, &fs->sb, &inode, lbn, tmp, &pbn) <
-        0) {
-      // 아직 물리 블록 할당 안 된 경우 새 블록 할당
-      int new_off = alloc_block(&fs->sb, fs->block_map);
-      pbn = fs->sb.data_block_start + new_off;
-      if (lbn < SFUSE_NDIR_BLOCKS)
-        inode.direct[lbn] = pbn;
+    // 이미 버퍼에 있는 더티 블록이면 메모리에서 갱신
+    int res = dalloc_write(fs, ino, lbn, boff, buf + written, chunk, false);
+    if (res == 0) {
+      written += chunk;
+      continue;
+    }
+    res = sfuse_bmap(fs, f, inode, lbn, tmp, &pbn);
+    if (res == 2) {
+      // 압축 클러스터는 더티 버퍼로 풀어 낸 뒤 같은 블록을 다시 처리. 앞서
+      // 갱신한 블록 맵을 잃지 않도록 아이노드를 먼저 기록한다.
+      res = inode_sync(fs->backing_fd, &fs->sb, ino, inode);
+      if (res == 0)
+        res = dalloc_expand(fs, ino, lbn);
+      if (res >= 0)
+        res = f ? file_revalidate(fs, f)
+                : inode_load(fs->backing_fd, &fs->sb, ino, inode);
+      if (res < 0) {
+        err = res;
+        break;
+      }
+      continue;
+    }
+    if (res == -ENOENT) {
+      // 아직 물리 블록 할당 안 된 경우 할당을 미루고 더티 버퍼에 보관
+      res = dalloc_write(fs, ino, lbn, boff, buf + written, chunk, true);
+      if (res < 0) {
+        err = res;
+        break;
+      }
+      written += chunk;
+      continue;
+    } else if (res < 0) {
+      err = res;
+      break;
+    } else if (res == 1) {
+      // fallocate로 예약만 된 블록은 디스크 내용을 읽지 않고 0에서 시작
+      memset(tmp, 0, sizeof(tmp));
+    } else if (chunk < SFUSE_BLOCK_SIZE && // 블록 전체를 덮어쓰면 읽지 않음
+               read_block(fs->backing_fd, pbn, tmp) < 0) {
+      err = -EIO;
+      break;
     }
-    read_block(fs->backing_fd, pbn, tmp);
     memcpy(tmp + boff, buf + written, chunk);
-    write_block(fs->backing_fd, pbn, tmp);
+    if (res == 1) {
+      // 처음 기록된 예약 블록은 unwritten 표시를 지움
+      res = write_block(fs->backing_fd, pbn, tmp) < 0
+                ? -EIO
+                : inode_set_block(fs->backing_fd, &fs->sb, fs->block_map,
+                                  inode, lbn, pbn);
+      if (f)
+        file_map_invalidate(f);
+    } else {
+      res = sfuse_store_block(fs, inode, lbn, pbn, tmp);
+      if (res == 1 && f)
+        file_map_invalidate(f);
+    }
+    if (res < 0) {
+      err = res;
+      break;
+    }
     written += chunk;
   }
-  if (offset + written > inode.size)
-    inode.size = offset + written;
-  inode.mtime = inode.ctime = (uint32_t)time(NULL);
-  inode_sync(fs->backing_fd, &fs->sb, ino, &inode);
+  if (offset + written > inode->size)
+    inode->size = offset + written;
+  inode->mtime = inode->ctime = (int64_t)time(NULL);
+  // 블록 맵이 바뀌었을 수 있으므로 부분 쓰기여도 아이노드는 기록
+  if (inode_sync(fs->backing_fd, &fs->sb, ino, inode) < 0)
+    return -EIO;
+  if (f)
+    file_synced(f);
+  if (written == 0 && err < 0)
+    return err;
   return written;
 }
 
+/* write */
+static int sfuse_write_cb(const char *path, const char *buf, size_t size,
+                          off_t offset, struct fuse_file_info *fi) {
+  struct sfuse_fs *fs = get_fs_context();
+  if (ctl_node(path))
+    return ctl_write(fs, buf, size);
+  struct sfuse_file *f = sfuse_file_of(fi);
+  if (f && f->accmode == O_RDONLY)
+    return -EBADF;
+  // 한도를 넘은 더티 데이터를 먼저 기록 (아이노드를 읽기 전에 수행해야 기록
+  // 과정에서 갱신된 블록 맵을 덮어쓰지 않음)
+  dalloc_writeback(fs);
+  if (f) {
+    // 열린 파일: 기록으로 아이노드가 바뀌었으면 캐시를 다시 읽음
+    // (재배치가 블록 맵을 바꾸지 못하도록 잠근 뒤 확인)
+    defrag_io_begin(f->ino);
+    pthread_mutex_lock(&f->lock);
+    int res = -EIO;
+    if (file_revalidate(fs, f) == 0)
+      res = sfuse_write_inode(fs, f->ino, &f->inode, f, buf, size,
+                              (uint64_t)offset);
+    pthread_mutex_unlock(&f->lock);
+    defrag_io_end(f->ino);
+    return res;
+  }
+
+  uint32_t ino;
+  if (fs_resolve_path(fs, path, &ino) < 0)
+    return -ENOENT;
+  struct sfuse_inode inode;
+  int res;
+  defrag_io_begin(ino);
+  if (inode_load(fs->backing_fd, &fs->sb, ino, &inode) < 0)
+    res = -EIO;
+  else if (S_ISDIR(inode.mode))
+    res = -EISDIR;
+  else
+    res = sfuse_write_inode(fs, ino, &inode, NULL, buf, size, (uint64_t)offset);
+  defrag_io_end(ino);
+  return res;
+}
+
+/* release */
+static int sfuse_release_cb(const char *path, struct fuse_file_info *fi) {
+  if (ctl_node(path)) {
+    ctl_release(fi);
+    return 0;
+  }
+  // 파일을 닫을 때 바로 기록하지 않음 (만료되면 기록 스레드가 기록)
+  file_close(sfuse_file_of(fi));
+  fi->fh = 0;
+  return 0;
+}
+
+/*
+ * 새 아이노드가 압축 플래그를 물려받는지 정한다. -o compress로 마운트했거나
+ * 부모 디렉터리에 chattr +c가 되어 있으면 새 파일과 디렉터리도 압축한다.
+ */
+static void sfuse_inherit_flags(struct sfuse_fs *fs, uint32_t parent,
+                                struct sfuse_inode *inode) {
+  struct sfuse_inode dir;
+  if (fs->opts.compress ||
+      ((fs->sb.feature_incompat & SFUSE_FEATURE_INCOMPAT_COMPRESS) &&
+       inode_load(fs->backing_fd, &fs->sb, parent, &dir) == 0 &&
+       (dir.flags & SFUSE_INODE_FLAG_COMPRESS)))
+    inode->flags |= SFUSE_INODE_FLAG_COMPRESS;
+}
+
 /* create */
 static int sfuse_create_cb(const char *path, mode_t mode,
                            struct fuse_file_info *fi) {
   struct sfuse_fs *fs = get_fs_context();
+  if (ctl_node(path))
+    return -EEXIST;
   uint32_t parent;
   char *name = fs_split_path(path, &parent);
   int ino = alloc_inode(&fs->sb, fs->inode_map);
@@ -252,17 +628,25 @@ static int sfuse_create_cb(const char *path, mode_t mode,
   struct sfuse_inode newnode;
   fs_init_inode(&fs->sb, ino, mode, fuse_get_context()->uid,
                 fuse_get_context()->gid, &newnode);
+  sfuse_inherit_flags(fs, parent, &newnode);
   inode_sync(fs->backing_fd, &fs->sb, ino, &newnode);
   dir_add_entry(fs->backing_fd, &fs->sb, parent, name, ino, fs->block_map,
                 fs->inode_map, &fs->sb);
   free(name);
-  fi->fh = ino;
+  struct sfuse_file *f;
+  int res = file_open(fs, ino, fi->flags, &f);
+  if (res < 0)
+    return res;
+  fi->fh = (uint64_t)(uintptr_t)f;
+  fi->keep_cache = !fs->opts.no_keep_cache;
   return 0;
 }
 
 /* mkdir */
 static int sfuse_mkdir_cb(const char *path, mode_t mode) {
   struct sfuse_fs *fs = get_fs_context();
+  if (ctl_node(path))
+    return -EEXIST;
   uint32_t parent;
   char *name = fs_split_path(path, &parent);
   if (!name)
@@ -277,6 +661,7 @@ static int sfuse_mkdir_cb(const char *path, mode_t mode) {
   struct sfuse_inode dir_inode;
   fs_init_inode(&fs->sb, ino, mode | S_IFDIR, fuse_get_context()->uid,
                 fuse_get_context()->gid, &dir_inode);
+  sfuse_inherit_flags(fs, parent, &dir_inode);
 
   int blk_index = alloc_block(&fs->sb, fs->block_map);
   if (blk_index < 0) {
@@ -307,6 +692,8 @@ static int sfuse_mkdir_cb(const char *path, mode_t mode) {
 /* unlink */
 static int sfuse_unlink_cb(const char *path) {
   struct sfuse_fs *fs = get_fs_context();
+  if (ctl_node(path))
+    return -EPERM;
   uint32_t parent;
   char *name = fs_split_path(path, &parent);
   if (!name)
@@ -319,25 +706,41 @@ static int sfuse_unlink_cb(const char *path) {
   }
 
   struct sfuse_inode inode;
+  defrag_io_begin(ino);
   inode_load(fs->backing_fd, &fs->sb, ino, &inode);
   if (S_ISDIR(inode.mode)) {
+    defrag_io_end(ino);
     free(name);
     return -EISDIR;
   }
 
-  for (int i = 0; i < SFUSE_NDIR_BLOCKS; i++) {
-    if (inode.direct[i])
-      free_block(&fs->sb, fs->block_map,
-                 inode.direct[i] - fs->sb.data_block_start);
+  // 아직 할당되지 않은 더티 데이터는 기록 없이 버림
+  dalloc_truncate(fs, ino, 0);
+
+  // 해제한 아이노드 레코드는 비워서 기록 (해제된 블록을 가리키는 레코드가
+  // 남으면 재배치가 번호를 다시 받은 파일과 혼동할 수 있음)
+  bool orphan = orphan_wanted(&inode);
+  bool release = true;
+  if (orphan) {
+    // 큰 파일: 이름만 지우고 블록은 고아 회수 스레드가 묶음으로 해제
+    dir_remove_entry(fs->backing_fd, &fs->sb, parent, name);
+    release = orphan_add(fs, ino, &inode) < 0;
   }
-
-  free_inode(&fs->sb, fs->inode_map, ino);
-  dir_remove_entry(fs->backing_fd, &fs->sb, parent, name);
+  if (release) {
+    // Direct 블록부터 Triple indirect 트리까지 모든 블록 해제
+    inode_free_blocks(fs->backing_fd, &fs->sb, fs->block_map, &inode, 0);
+    inode.links = 0;
+    inode_sync(fs->backing_fd, &fs->sb, ino, &inode);
+    free_inode(&fs->sb, fs->inode_map, ino);
+    if (!orphan)
+      dir_remove_entry(fs->backing_fd, &fs->sb, parent, name);
+  }
+  defrag_io_end(ino);
 
   // 상위 디렉터리 inode 정확히 업데이트
   struct sfuse_inode parent_inode;
   inode_load(fs->backing_fd, &fs->sb, parent, &parent_inode);
-  parent_inode.mtime = parent_inode.ctime = time(NULL);
+  parent_inode.mtime = parent_inode.ctime = (int64_t)time(NULL);
   inode_sync(fs->backing_fd, &fs->sb, parent, &parent_inode);
 
   bitmap_sync(fs->backing_fd, fs->sb.block_bitmap_start, fs->block_map,
@@ -353,6 +756,8 @@ static int sfuse_unlink_cb(const char *path) {
 /* rmdir */
 static int sfuse_rmdir_cb(const char *path) {
   struct sfuse_fs *fs = get_fs_context();
+  if (ctl_node(path))
+    return -EPERM;
 
   /* inode 번호 얻기 */
   uint32_t ino;
@@ -428,11 +833,9 @@ static int sfuse_rmdir_cb(const char *path) {
     return -ENOENT;
   }
 
-  /* 디렉터리 직접 블록 해제 */
-  uint8_t zero_block[SFUSE_BLOCK_SIZE] = {0};
+  /* 디렉터리 직접 블록 해제 (0으로 덮지 않고 커밋 뒤 discard) */
   for (int i = 0; i < 12; ++i) {
     if (inode.direct[i]) {
-      write_block(fs->backing_fd, inode.direct[i], zero_block);
       free_block(&fs->sb, fs->block_map,
                  inode.direct[i] - fs->sb.data_block_start);
       inode.direct[i] = 0;
@@ -446,7 +849,7 @@ static int sfuse_rmdir_cb(const char *path) {
 
   /* 상위 디렉터리 메타데이터 갱신 */
   time_t now = time(NULL);
-  parent_inode.mtime = parent_inode.ctime = (uint32_t)now;
+  parent_inode.mtime = parent_inode.ctime = (int64_t)now;
   inode_sync(fs->backing_fd, &fs->sb, parent_ino, &parent_inode);
 
   /* 비트맵 및 슈퍼블록 동기화 */
@@ -465,6 +868,8 @@ static int sfuse_rename_cb(const char *oldpath, const char *newpath,
                            unsigned int flags) {
   (void)flags;
   struct sfuse_fs *fs = get_fs_context();
+  if (ctl_node(oldpath) || ctl_node(newpath))
+    return -EPERM;
   uint32_t oldp, newp;
   char *oldn = fs_split_path(oldpath, &oldp);
   char *newn = fs_split_path(newpath, &newp);
@@ -479,98 +884,748 @@ static int sfuse_rename_cb(const char *oldpath, const char *newpath,
   return 0;
 }
 
+/*
+ * 바이트 범위 [start, end)의 양 끝에 걸친 압축 클러스터를 더티 버퍼로 풀어
+ * 낸다. 범위에 완전히 포함된 클러스터는 통째로 해제되므로 풀지 않는다.
+ * 클러스터를 풀었으면 inode를 장치에서 다시 읽는다.
+ */
+static int sfuse_expand_range(struct sfuse_fs *fs, uint32_t ino,
+                              struct sfuse_inode *inode, uint64_t start,
+                              uint64_t end) {
+  const uint64_t span = SFUSE_COMPRESS_CLUSTER_BLOCKS * SFUSE_BLOCK_SIZE;
+  if (inode_is_inline(inode) || start >= end)
+    return 0;
+  int expanded = 0;
+  if (start % span) {
+    int res = dalloc_expand(fs, ino, start / SFUSE_BLOCK_SIZE);
+    if (res < 0)
+      return res;
+    expanded |= res;
+  }
+  if (end % span && (start % span == 0 || end / span != start / span)) {
+    int res = dalloc_expand(fs, ino, end / SFUSE_BLOCK_SIZE);
+    if (res < 0)
+      return res;
+    expanded |= res;
+  }
+  if (expanded && inode_load(fs->backing_fd, &fs->sb, ino, inode) < 0)
+    return -EIO;
+  return 0;
+}
+
+/*
+ * 이미 기록된 데이터 블록의 [from, to) 바이트를 0으로 채운다.
+ * 구멍이나 예약(unwritten) 블록은 이미 0으로 읽히므로 건드리지 않는다.
+ * 지연 할당 버퍼의 블록은 호출자가 dalloc_punch()로 처리한다. 압축 클러스터는
+ * 호출자가 sfuse_expand_range()로 먼저 풀어 두어야 한다. 공유 블록은 새
+ * 블록으로 옮겨지므로 호출자가 inode를 기록해야 한다.
+ */
+static int sfuse_zero_range(struct sfuse_fs *fs, struct sfuse_inode *inode,
+                            uint64_t lbn, size_t from, size_t to) {
+  uint8_t block[SFUSE_BLOCK_SIZE];
+  uint64_t pbn;
+  int res = logical_to_physical(fs->backing_fd, &fs->sb, inode, lbn, block,
+                                &pbn);
+  if (res == -ENOENT || res == 1)
+    return 0;
+  if (res == 2)
+    return -EIO; // 압축 구간을 제자리에서 고칠 수 없음
+  if (res < 0)
+    return res;
+  if (read_block(fs->backing_fd, pbn, block) < 0)
+    return -EIO;
+  memset(block + from, 0, to - from);
+  res = sfuse_store_block(fs, inode, lbn, pbn, block);
+  return res < 0 ? res : 0;
+}
+
+/* truncate: 재배치 잠금을 잡고 호출 */
+static int sfuse_truncate_inode(struct sfuse_fs *fs, uint32_t ino,
+                                uint64_t new_size) {
+  struct sfuse_inode inode;
+  if (inode_load(fs->backing_fd, &fs->sb, ino, &inode) < 0)
+    return -EIO;
+
+  uint64_t nblocks = (new_size + SFUSE_BLOCK_SIZE - 1) / SFUSE_BLOCK_SIZE;
+
+  // 파일 끝이 걸친 압축 클러스터는 일부만 해제하거나 고칠 수 없으므로 먼저
+  // 더티 버퍼로 풀어 둠
+  uint64_t edge = new_size < inode.size ? new_size : inode.size;
+  if (new_size != inode.size && !inode_is_inline(&inode) &&
+      edge % (SFUSE_COMPRESS_CLUSTER_BLOCKS * SFUSE_BLOCK_SIZE)) {
+    int res = dalloc_expand(fs, ino, edge / SFUSE_BLOCK_SIZE);
+    if (res < 0)
+      return res;
+    if (res > 0 && inode_load(fs->backing_fd, &fs->sb, ino, &inode) < 0)
+      return -EIO;
+  }
+
+  // 새 크기 이후의 더티 데이터는 할당 없이 버림
+  dalloc_truncate(fs, ino, new_size);
+
+  if (inode_is_inline(&inode)) {
+    if (new_size <= inode_inline_capacity(&fs->sb)) {
+      // 인라인 데이터 안에서 크기만 조정 (늘어난 부분은 0)
+      if (new_size > inode.size)
+        memset(inode.inline_data + inode.size, 0, new_size - inode.size);
+      else
+        memset(inode.inline_data + new_size, 0, inode.size - new_size);
+      inode.size = new_size;
+      inode.mtime = inode.ctime = (int64_t)time(NULL);
+      return inode_sync(fs->backing_fd, &fs->sb, ino, &inode) < 0 ? -EIO : 0;
+    }
+    // 인라인 용량을 넘어서는 확장은 블록으로 옮긴 뒤 처리
+    int res = inode_inline_migrate(fs->backing_fd, &fs->sb, fs->block_map,
+                                   &inode);
+    if (res < 0)
+      return res;
+  }
+
+  if (new_size > inode.size) {
+    // 파일 크기 확장은 블록을 할당하지 않고 구멍(hole)으로 남긴다. 구멍은
+    // 0으로 읽히므로, 기존 마지막 블록의 크기 이후 부분만 0으로 정리한다.
+    uint64_t boff = inode.size % SFUSE_BLOCK_SIZE;
+    if (boff) {
+      int res = sfuse_zero_range(fs, &inode, inode.size / SFUSE_BLOCK_SIZE,
+                                 boff, SFUSE_BLOCK_SIZE);
+      if (res < 0)
+        return res;
+    }
+  } else if (new_size < inode.size) {
+    // 큰 파일을 비울 때는 블록 맵을 고아로 넘겨 백그라운드에서 해제하고,
+    // 그 밖에는 새 크기 이후의 블록을 바로 해제
+    int res = -EAGAIN;
+    if (new_size == 0 && orphan_wanted(&inode))
+      res = orphan_detach(fs, ino, &inode);
+    if (res < 0)
+      res = inode_free_blocks(fs->backing_fd, &fs->sb, fs->block_map, &inode,
+                              nblocks);
+    if (res < 0)
+      return res;
+    // 새 마지막 블록의 크기 이후 부분을 0으로 정리 (이후 쓰기로 파일이
+    // 다시 커졌을 때 예전 데이터가 보이지 않도록)
+    uint64_t boff = new_size % SFUSE_BLOCK_SIZE;
+    if (boff) {
+      res = sfuse_zero_range(fs, &inode, new_size / SFUSE_BLOCK_SIZE, boff,
+                             SFUSE_BLOCK_SIZE);
+      if (res < 0)
+        return res;
+    }
+  }
+
+  inode.size = new_size;
+  inode.mtime = inode.ctime = (int64_t)time(NULL);
+  inode_sync(fs->backing_fd, &fs->sb, ino, &inode);
+
+  bitmap_sync(fs->backing_fd, fs->sb.block_bitmap_start, fs->block_map,
+              fs->sb.blocks_count / 8);
+  sb_sync(fs->backing_fd, &fs->sb);
+  return 0;
+}
+
 /* truncate */
 static int sfuse_truncate_cb(const char *path, off_t size,
                              struct fuse_file_info *fi) {
   struct sfuse_fs *fs = get_fs_context();
+  // "echo cmd > control"의 O_TRUNC는 무시
+  enum sfuse_ctl_node node = ctl_node(path);
+  if (node)
+    return node == SFUSE_CTL_CONTROL ? 0 : -EACCES;
   uint32_t ino;
 
-  if (fs_resolve_path(fs, path, &ino) < 0)
+  if (sfuse_lookup(fs, path, fi, &ino) < 0)
     return -ENOENT;
 
-  struct sfuse_inode inode;
-  if (inode_load(fs->backing_fd, &fs->sb, ino, &inode) < 0)
-    return -EIO;
+  if (size < 0)
+    return -EINVAL;
 
-  if (size > inode.size) {
-    // 파일 크기 확장 시 새로 추가되는 영역 0으로 초기화
-    uint8_t zero_block[SFUSE_BLOCK_SIZE] = {0};
-    while (inode.size < size) {
-      int blk_index = alloc_block(&fs->sb, fs->block_map);
+  defrag_io_begin(ino);
+  int res = sfuse_truncate_inode(fs, ino, (uint64_t)size);
+  defrag_io_end(ino);
+  return res;
+}
+
+/*
+ * fallocate의 할당 모드: 구멍으로 남아 있는 [start, end) 블록에 물리 블록을
+ * 연속으로 할당하고 unwritten으로 표시한다. 데이터 블록은 0으로 채우지 않으며,
+ * 읽기는 0을 돌려주고 첫 쓰기에서 표시가 지워진다.
+ */
+static int sfuse_preallocate(struct sfuse_fs *fs, uint32_t ino,
+                             struct sfuse_inode *inode, uint64_t start,
+                             uint64_t end) {
+  uint8_t tmp[SFUSE_BLOCK_SIZE];
+  uint64_t pbn;
+  uint64_t lbn = start;
+
+  while (lbn < end) {
+    // 구멍이 아닌 블록(기록됨, 예약됨, 더티 버퍼)은 건너뜀
+    int res = logical_to_physical(fs->backing_fd, &fs->sb, inode, lbn, tmp,
+                                  &pbn);
+    if (res != -ENOENT) {
+      if (res < 0)
+        return res;
+      lbn++;
+      continue;
+    }
+    if (dalloc_contains(fs, ino, lbn)) {
+      lbn++;
+      continue;
+    }
+
+    // 연속된 구멍의 길이를 구해 한 번에 연속 할당
+    uint64_t run = 1;
+    while (lbn + run < end && !dalloc_contains(fs, ino, lbn + run) &&
+           logical_to_physical(fs->backing_fd, &fs->sb, inode, lbn + run, tmp,
+                               &pbn) == -ENOENT)
+      run++;
+
+    while (run > 0) {
+      // 지연 할당 버퍼가 예약한 블록(인다이렉트 블록 여유 포함)은 사용할 수
+      // 없음. 버퍼 기록과 같은 빈 구간을 잡지 않도록 확인과 할당을 버퍼 잠금
+      // 안에서 함
+      struct sfuse_dalloc *da = &fs->dalloc;
+      uint64_t got;
+      int64_t blk_index = -ENOSPC;
+      pthread_mutex_lock(&da->lock);
+      if (fs->sb.free_blocks >= da->nblocks + SFUSE_DALLOC_META_SLACK + run)
+        blk_index = alloc_block_run(&fs->sb, fs->block_map, run, &got);
+      pthread_mutex_unlock(&da->lock);
       if (blk_index < 0)
         return -ENOSPC;
-      uint32_t phys_block = fs->sb.data_block_start + blk_index;
-      size_t direct_index = inode.size / SFUSE_BLOCK_SIZE;
-      if (direct_index >= SFUSE_NDIR_BLOCKS)
-        return -EFBIG; // 직접 블록만 지원한다고 가정
-      inode.direct[direct_index] = phys_block;
-      write_block(fs->backing_fd, phys_block, zero_block);
-      inode.size += SFUSE_BLOCK_SIZE;
-    }
-  } else if (size < inode.size) {
-    // 파일 크기 축소 시 블록 해제
-    while (inode.size > size) {
-      size_t direct_index = (inode.size - 1) / SFUSE_BLOCK_SIZE;
-      if (direct_index < SFUSE_NDIR_BLOCKS && inode.direct[direct_index]) {
-        free_block(&fs->sb, fs->block_map,
-                   inode.direct[direct_index] - fs->sb.data_block_start);
-        inode.direct[direct_index] = 0;
+      for (uint64_t i = 0; i < got; i++) {
+        pbn = fs->sb.data_block_start + (uint64_t)blk_index + i;
+        res = inode_set_block(fs->backing_fd, &fs->sb, fs->block_map, inode,
+                              lbn + i, pbn | SFUSE_BLOCK_UNWRITTEN);
+        if (res < 0) {
+          // 아직 블록 맵에 연결하지 않은 나머지 블록은 반환
+          for (uint64_t j = i; j < got; j++)
+            free_block(&fs->sb, fs->block_map, (uint64_t)blk_index + j);
+          return res;
+        }
       }
-      inode.size -= SFUSE_BLOCK_SIZE;
+      lbn += got;
+      run -= got;
     }
   }
+  return 0;
+}
 
-  inode.size = size;
-  inode.mtime = inode.ctime = time(NULL);
-  inode_sync(fs->backing_fd, &fs->sb, ino, &inode);
+/*
+ * fallocate의 PUNCH_HOLE 모드: 바이트 범위 [start, end)를 0으로 만들고, 범위에
+ * 완전히 포함된 블록은 해제하여 구멍으로 되돌린다. 파일 크기는 바뀌지 않는다.
+ */
+static int sfuse_punch_hole(struct sfuse_fs *fs, uint32_t ino,
+                            struct sfuse_inode *inode, uint64_t start,
+                            uint64_t end) {
+  if (inode_is_inline(inode)) {
+    // 인라인 데이터는 크기 안쪽 부분만 0으로 채움
+    if (start < inode->size)
+      memset(inode->inline_data + start, 0,
+             (end < inode->size ? end : inode->size) - start);
+    return 0;
+  }
+
+  int res = sfuse_expand_range(fs, ino, inode, start, end);
+  if (res < 0)
+    return res;
+  dalloc_punch(fs, ino, start, end);
+
+  uint64_t first = start / SFUSE_BLOCK_SIZE;
+  uint64_t last = end / SFUSE_BLOCK_SIZE;
+  size_t head = start % SFUSE_BLOCK_SIZE;
+  size_t tail = end % SFUSE_BLOCK_SIZE;
+
+  if (first == last) {
+    // 블록 하나 안쪽의 범위
+    return sfuse_zero_range(fs, inode, first, head, tail);
+  }
+  if (head) {
+    res = sfuse_zero_range(fs, inode, first, head, SFUSE_BLOCK_SIZE);
+    if (res < 0)
+      return res;
+    first++;
+  }
+  if (tail) {
+    res = sfuse_zero_range(fs, inode, last, 0, tail);
+    if (res < 0)
+      return res;
+  }
+  if (first < last)
+    return inode_punch_blocks(fs->backing_fd, &fs->sb, fs->block_map, inode,
+                              first, last);
+  return 0;
+}
 
+/* fallocate */
+/* fallocate: 재배치 잠금을 잡고 호출 */
+static int sfuse_fallocate_inode(struct sfuse_fs *fs, uint32_t ino, int mode,
+                                 uint64_t start, uint64_t end) {
+  struct sfuse_inode inode;
+  if (inode_load(fs->backing_fd, &fs->sb, ino, &inode) < 0)
+    return -EIO;
+  if (S_ISDIR(inode.mode))
+    return -EISDIR;
+  if (!S_ISREG(inode.mode))
+    return -ENODEV;
+
+  int res;
+  if (mode & FALLOC_FL_PUNCH_HOLE) {
+    res = sfuse_punch_hole(fs, ino, &inode, start, end);
+  } else {
+    if (!(fs->sb.feature_incompat & SFUSE_FEATURE_INCOMPAT_UNWRITTEN))
+      return -EOPNOTSUPP;
+    res = 0;
+    if (inode_is_inline(&inode) && end > inode_inline_capacity(&fs->sb))
+      res = inode_inline_migrate(fs->backing_fd, &fs->sb, fs->block_map,
+                                 &inode);
+    if (res == 0 && !inode_is_inline(&inode))
+      res = sfuse_preallocate(fs, ino, &inode, start / SFUSE_BLOCK_SIZE,
+                              (end + SFUSE_BLOCK_SIZE - 1) / SFUSE_BLOCK_SIZE);
+    if (res == 0 && !(mode & FALLOC_FL_KEEP_SIZE) && end > inode.size)
+      inode.size = end;
+  }
+
+  // 실패하더라도 이미 연결된 블록이 남도록 아이노드와 비트맵을 기록
+  inode.mtime = inode.ctime = (int64_t)time(NULL);
+  if (inode_sync(fs->backing_fd, &fs->sb, ino, &inode) < 0)
+    return -EIO;
   bitmap_sync(fs->backing_fd, fs->sb.block_bitmap_start, fs->block_map,
               fs->sb.blocks_count / 8);
   sb_sync(fs->backing_fd, &fs->sb);
-  return 0;
+  return res;
+}
+
+/* fallocate */
+static int sfuse_fallocate_cb(const char *path, int mode, off_t offset,
+                              off_t length, struct fuse_file_info *fi) {
+  struct sfuse_fs *fs = get_fs_context();
+  if (ctl_node(path))
+    return -EOPNOTSUPP;
+  uint32_t ino;
+
+  if (offset < 0 || length <= 0)
+    return -EINVAL;
+  // 지원 모드: 0, KEEP_SIZE, PUNCH_HOLE|KEEP_SIZE
+  if (mode & ~(FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE))
+    return -EOPNOTSUPP;
+  if ((mode & FALLOC_FL_PUNCH_HOLE) && !(mode & FALLOC_FL_KEEP_SIZE))
+    return -EOPNOTSUPP;
+
+  uint64_t start = (uint64_t)offset;
+  uint64_t end = start + (uint64_t)length;
+  if (end < start)
+    return -EFBIG;
+
+  if (sfuse_lookup(fs, path, fi, &ino) < 0)
+    return -ENOENT;
+
+  // 한도를 넘은 더티 데이터를 먼저 기록 (기록 과정에서 아이노드가 갱신됨)
+  dalloc_writeback(fs);
+
+  defrag_io_begin(ino);
+  int res = sfuse_fallocate_inode(fs, ino, mode, start, end);
+  defrag_io_end(ino);
+  return res;
+}
+
+/* lseek (SEEK_DATA / SEEK_HOLE) */
+static off_t sfuse_lseek_cb(const char *path, off_t off, int whence,
+                            struct fuse_file_info *fi) {
+  struct sfuse_fs *fs = get_fs_context();
+  if (ctl_node(path))
+    return -ENXIO;
+  uint32_t ino;
+
+  // SEEK_SET/CUR/END는 커널이 처리하고 데이터/구멍 검색만 전달된다.
+  if (whence != SEEK_DATA && whence != SEEK_HOLE)
+    return -EINVAL;
+  if (off < 0)
+    return -ENXIO;
+
+  if (sfuse_lookup(fs, path, fi, &ino) < 0)
+    return -ENOENT;
+
+  // 지연 할당 버퍼의 데이터도 블록 맵에서 보이도록 먼저 기록
+  int res = dalloc_flush_inode(fs, ino);
+  if (res < 0)
+    return res;
+
+  struct sfuse_inode inode;
+  if (inode_load(fs->backing_fd, &fs->sb, ino, &inode) < 0)
+    return -EIO;
+
+  uint64_t pos = (uint64_t)off;
+  if (pos >= inode.size)
+    return -ENXIO;
+
+  // 인라인 데이터는 전체가 하나의 데이터 구간이다.
+  if (inode_is_inline(&inode))
+    return whence == SEEK_DATA ? off : (off_t)inode.size;
+
+  uint64_t lbn;
+  res = inode_seek_block(fs->backing_fd, &inode, pos / SFUSE_BLOCK_SIZE,
+                         whence == SEEK_DATA, &lbn);
+  if (whence == SEEK_DATA) {
+    if (res < 0)
+      return res;
+    uint64_t found = lbn * SFUSE_BLOCK_SIZE;
+    if (found < pos)
+      found = pos; // 시작 오프셋이 데이터 블록 안에 있음
+    return found >= inode.size ? -ENXIO : (off_t)found;
+  }
+
+  if (res < 0)
+    return res;
+  // 파일 끝은 항상 구멍으로 본다.
+  uint64_t found = lbn * SFUSE_BLOCK_SIZE;
+  if (found < pos)
+    found = pos;
+  return found > inode.size ? (off_t)inode.size : (off_t)found;
+}
+
+/** @brief copy_file_range가 한 번에 읽고 쓰는 최대 바이트 수 (1MiB) */
+#define SFUSE_COPY_CHUNK (SFUSE_DALLOC_IO_BLOCKS * SFUSE_BLOCK_SIZE)
+
+/*
+ * 바이트 범위 [start, end)에 기록된 데이터(디스크 또는 더티 버퍼)가 있는지
+ * 확인한다. 오류가 나면 데이터가 있는 것으로 본다.
+ */
+static bool sfuse_range_has_data(struct sfuse_fs *fs, uint32_t ino,
+                                 const struct sfuse_inode *inode,
+                                 uint64_t start, uint64_t end) {
+  if (inode_is_inline(inode))
+    return true;
+  uint64_t first = start / SFUSE_BLOCK_SIZE;
+  uint64_t last = (end + SFUSE_BLOCK_SIZE - 1) / SFUSE_BLOCK_SIZE;
+  for (uint64_t lbn = first; lbn < last; lbn++)
+    if (dalloc_contains(fs, ino, lbn))
+      return true;
+  uint64_t lbn;
+  int res = inode_seek_block(fs->backing_fd, inode, first, true, &lbn);
+  if (res == -ENXIO)
+    return false;
+  return res < 0 || lbn < last;
+}
+
+/*
+ * 원본 블록 [lbn_in, lbn_in + count)를 복사하지 않고 대상 블록 lbn_out부터
+ * 공유한다. (원본 잠금 배타 상태) 대상 블록이 구멍이고 두 블록 모두 더티
+ * 버퍼에 없을 때만 공유하며, 원본이 구멍이나 예약 블록이면 대상을 구멍으로
+ * 둔다. 압축 클러스터, 이미 기록된 대상 블록처럼 공유할 수 없는 블록이나
+ * 참조 수 테이블이 없으면 멈추고, 처리한 블록 수를 돌려준다.
+ */
+static int64_t sfuse_share_blocks(struct sfuse_fs *fs, uint32_t ino_in,
+                                  const struct sfuse_inode *src,
+                                  uint32_t ino_out, struct sfuse_inode *dst,
+                                  uint64_t lbn_in, uint64_t lbn_out,
+                                  uint64_t count) {
+  uint8_t tmp[SFUSE_BLOCK_SIZE];
+  uint64_t done = 0;
+  int err = 0;
+  while (done < count) {
+    uint64_t li = lbn_in + done, lo = lbn_out + done;
+    uint64_t pbn, dpbn;
+    if (dalloc_contains(fs, ino_in, li) || dalloc_contains(fs, ino_out, lo))
+      break;
+    int res = logical_to_physical(fs->backing_fd, &fs->sb, dst, lo, tmp, &dpbn);
+    if (res != -ENOENT) {
+      err = res < 0 ? res : 0;
+      break;
+    }
+    res = logical_to_physical(fs->backing_fd, &fs->sb, src, li, tmp, &pbn);
+    if (res == -ENOENT || res == 1) {
+      done++; // 0으로 읽히는 블록은 구멍으로 둠
+      continue;
+    }
+    // 인다이렉트 블록을 새로 할당할 수 있으므로 예약분은 남겨 둠
+    if (res != 0 || fs->sb.free_blocks <= dalloc_reserved(fs)) {
+      err = res < 0 ? res : 0;
+      break;
+    }
+    res = dedup_share(fs->backing_fd, pbn);
+    if (res == 1) {
+      res = inode_set_block(fs->backing_fd, &fs->sb, fs->block_map, dst, lo,
+                            pbn);
+      if (res < 0)
+        dedup_release(pbn); // 연결하지 못한 참조를 되돌림
+    }
+    if (res <= 0) {
+      err = res;
+      break;
+    }
+    done++;
+  }
+
+  if (done > 0) {
+    uint64_t end = (lbn_out + done) * SFUSE_BLOCK_SIZE;
+    if (end > dst->size)
+      dst->size = end;
+    dst->mtime = dst->ctime = (int64_t)time(NULL);
+    if (inode_sync(fs->backing_fd, &fs->sb, ino_out, dst) < 0)
+      return -EIO;
+  }
+  if (done == 0 && err < 0)
+    return err;
+  return (int64_t)done;
+}
+
+/* copy_file_range: defrag_io_lock_pair()로 두 파일의 재배치 잠금을 잡고 호출
+ * (기록 사이에 놓았다가 다시 잡음) */
+static ssize_t sfuse_copy_inode(struct sfuse_fs *fs, uint32_t ino_in,
+                                uint64_t pos_in, uint32_t ino_out,
+                                uint64_t pos_out, size_t len) {
+  struct sfuse_inode src, dst;
+  if (inode_load(fs->backing_fd, &fs->sb, ino_in, &src) < 0 ||
+      inode_load(fs->backing_fd, &fs->sb, ino_out, &dst) < 0)
+    return -EIO;
+  if (S_ISDIR(src.mode) || S_ISDIR(dst.mode))
+    return -EISDIR;
+  if (pos_in >= src.size)
+    return 0;
+  if (len > src.size - pos_in)
+    len = src.size - pos_in;
+
+  // 데이터는 FUSE 채널을 거치지 않는다. 블록 경계가 맞는 범위는 원본 블록을
+  // 대상 파일과 공유하고(참조 수 테이블이 있을 때), 나머지는 원본 블록에서
+  // 읽어 대상 파일에 기록한다. 원본 읽기는 이어진 블록을 모아 큰 단위로, 대상
+  // 쓰기는 지연 할당을 거쳐 연속된 블록에 기록된다.
+  char *buf = malloc(SFUSE_COPY_CHUNK);
+  if (!buf)
+    return -ENOMEM;
+
+  size_t copied = 0;
+  ssize_t err = 0;
+  while (copied < len) {
+    size_t chunk = len - copied;
+    if (chunk > SFUSE_COPY_CHUNK)
+      chunk = SFUSE_COPY_CHUNK;
+    uint64_t cur_in = pos_in + copied;
+    uint64_t cur_out = pos_out + copied;
+
+    // 원본 범위가 모두 구멍이고 대상 범위가 파일 끝 이후면 구멍으로 남김
+    if (cur_out >= dst.size && !inode_is_inline(&dst) &&
+        !sfuse_range_has_data(fs, ino_in, &src, cur_in, cur_in + chunk)) {
+      copied += chunk;
+      continue;
+    }
+
+    ssize_t n = 0;
+    if (cur_in % SFUSE_BLOCK_SIZE == 0 && cur_out % SFUSE_BLOCK_SIZE == 0 &&
+        chunk >= SFUSE_BLOCK_SIZE && !inode_is_inline(&src) &&
+        !inode_is_inline(&dst)) {
+      int64_t shared = sfuse_share_blocks(
+          fs, ino_in, &src, ino_out, &dst, cur_in / SFUSE_BLOCK_SIZE,
+          cur_out / SFUSE_BLOCK_SIZE, chunk / SFUSE_BLOCK_SIZE);
+      if (shared < 0) {
+        err = shared;
+        break;
+      }
+      n = (ssize_t)shared * SFUSE_BLOCK_SIZE;
+    }
+    if (n == 0) {
+      n = sfuse_read_inode(fs, ino_in, &src, NULL, buf, chunk, cur_in);
+      if (n <= 0) {
+        err = n;
+        break;
+      }
+      n = sfuse_write_inode(fs, ino_out, &dst, NULL, buf, (size_t)n, cur_out);
+      if (n <= 0) {
+        err = n;
+        break;
+      }
+    }
+    copied += (size_t)n;
+
+    // 더티 데이터가 한도를 넘으면 기록하고, 바뀐 블록 맵을 다시 읽음
+    // (두 파일의 더티 데이터도 기록될 수 있도록 잠시 잠금을 놓음)
+    defrag_io_end_pair(ino_in, ino_out);
+    dalloc_writeback(fs);
+    defrag_io_lock_pair(ino_in, ino_out);
+    if (inode_load(fs->backing_fd, &fs->sb, ino_in, &src) < 0 ||
+        inode_load(fs->backing_fd, &fs->sb, ino_out, &dst) < 0) {
+      err = -EIO;
+      break;
+    }
+  }
+  free(buf);
+
+  // 구멍으로 남긴 범위가 파일 끝이면 크기만 늘림
+  if (copied > 0 && pos_out + copied > dst.size) {
+    dst.size = pos_out + copied;
+    dst.mtime = dst.ctime = (int64_t)time(NULL);
+    if (inode_sync(fs->backing_fd, &fs->sb, ino_out, &dst) < 0)
+      return -EIO;
+  }
+
+  if (copied == 0 && err < 0)
+    return err;
+  return (ssize_t)copied;
+}
+
+/* copy_file_range */
+static ssize_t sfuse_copy_file_range_cb(const char *path_in,
+                                        struct fuse_file_info *fi_in,
+                                        off_t off_in, const char *path_out,
+                                        struct fuse_file_info *fi_out,
+                                        off_t off_out, size_t len, int flags) {
+  struct sfuse_fs *fs = get_fs_context();
+  if (ctl_node(path_in) || ctl_node(path_out))
+    return -EOPNOTSUPP;
+  uint32_t ino_in, ino_out;
+
+  if (flags != 0 || off_in < 0 || off_out < 0)
+    return -EINVAL;
+  if (sfuse_lookup(fs, path_in, fi_in, &ino_in) < 0 ||
+      sfuse_lookup(fs, path_out, fi_out, &ino_out) < 0)
+    return -ENOENT;
+
+  uint64_t pos_in = (uint64_t)off_in;
+  uint64_t pos_out = (uint64_t)off_out;
+  // 같은 파일 안에서 겹치는 범위의 복사는 허용하지 않음
+  if (ino_in == ino_out && pos_in < pos_out + len && pos_out < pos_in + len)
+    return -EINVAL;
+
+  // 한도를 넘은 더티 데이터를 먼저 기록 (아이노드를 읽기 전에 수행)
+  dalloc_writeback(fs);
+
+  defrag_io_lock_pair(ino_in, ino_out);
+  ssize_t res = sfuse_copy_inode(fs, ino_in, pos_in, ino_out, pos_out, len);
+  defrag_io_end_pair(ino_in, ino_out);
+  return res;
 }
 
 /* utimens */
 static int sfuse_utimens_cb(const char *path, const struct timespec tv[2],
                             struct fuse_file_info *fi) {
   struct sfuse_fs *fs = get_fs_context();
+  if (ctl_node(path))
+    return -EPERM;
   uint32_t ino;
 
   if (fs_resolve_path(fs, path, &ino) < 0)
     return -ENOENT;
 
   struct sfuse_inode inode;
-  if (inode_load(fs->backing_fd, &fs->sb, ino, &inode) < 0)
+  defrag_io_begin(ino);
+  if (inode_load(fs->backing_fd, &fs->sb, ino, &inode) < 0) {
+    defrag_io_end(ino);
     return -EIO;
+  }
 
   inode.atime = tv[0].tv_sec;
   inode.mtime = tv[1].tv_sec;
-  inode.ctime = time(NULL); // ctime은 현재 시간으로 업데이트
+  inode.ctime = (int64_t)time(NULL); // ctime은 현재 시간으로 업데이트
   inode_sync(fs->backing_fd, &fs->sb, ino, &inode);
+  defrag_io_end(ino);
 
   return 0;
 }
 
+/* symlink */
+static int sfuse_symlink_cb(const char *target, const char *linkpath) {
+  struct sfuse_fs *fs = get_fs_context();
+  if (ctl_node(linkpath))
+    return -EEXIST;
+  size_t len = strlen(target);
+  if (len >= SFUSE_BLOCK_SIZE)
+    return -ENAMETOOLONG;
+
+  uint32_t parent;
+  char *name = fs_split_path(linkpath, &parent);
+  if (!name)
+    return -EINVAL;
+
+  int ino = alloc_inode(&fs->sb, fs->inode_map);
+  if (ino < 0) {
+    free(name);
+    return -ENOSPC;
+  }
+
+  // 링크 대상 경로를 파일 내용으로 기록 (짧으면 인라인으로 저장됨)
+  struct sfuse_inode inode;
+  fs_init_inode(&fs->sb, ino, S_IFLNK | 0777, fuse_get_context()->uid,
+                fuse_get_context()->gid, &inode);
+  int res = sfuse_write_inode(fs, ino, &inode, NULL, target, len, 0);
+  if (res < 0) {
+    inode_free_blocks(fs->backing_fd, &fs->sb, fs->block_map, &inode, 0);
+    free_inode(&fs->sb, fs->inode_map, ino);
+    free(name);
+    return res;
+  }
+
+  res = dir_add_entry(fs->backing_fd, &fs->sb, parent, name, ino,
+                      fs->block_map, fs->inode_map, &fs->sb);
+  free(name);
+  return res < 0 ? res : 0;
+}
+
+/* readlink */
+static int sfuse_readlink_cb(const char *path, char *buf, size_t size) {
+  struct sfuse_fs *fs = get_fs_context();
+  uint32_t ino;
+  if (fs_resolve_path(fs, path, &ino) < 0)
+    return -ENOENT;
+
+  struct sfuse_inode inode;
+  if (inode_load(fs->backing_fd, &fs->sb, ino, &inode) < 0)
+    return -EIO;
+  if (!S_ISLNK(inode.mode))
+    return -EINVAL;
+  if (size == 0)
+    return -EINVAL;
+
+  // FUSE는 NUL로 끝나는 문자열을 기대하므로 마지막 바이트를 남겨 둠
+  size_t len = inode.size < size - 1 ? inode.size : size - 1;
+  if (inode_is_inline(&inode)) {
+    memcpy(buf, inode.inline_data, len);
+  } else if (len > 0 && dalloc_read(fs, ino, 0, 0, buf, len) < 0) {
+    uint8_t block[SFUSE_BLOCK_SIZE];
+    uint64_t pbn;
+    // 링크 대상은 블록 크기보다 짧으므로 첫 블록만 읽음
+    if (logical_to_physical(fs->backing_fd, &fs->sb, &inode, 0, block, &pbn) <
+            0 ||
+        read_block(fs->backing_fd, pbn, block) < 0)
+      return -EIO;
+    memcpy(buf, block, len);
+  }
+  buf[len] = '\0';
+  return 0;
+}
+
 /* flush */
+/* close()마다 호출된다. 쓰기는 이미 지연 할당 버퍼나 장치에 반영되어 있고
+ * 더티 데이터는 write-back이 기록하므로, 장치 플러시는 fsync에만 맡긴다. */
 static int sfuse_flush_cb(const char *path, struct fuse_file_info *fi) {
   (void)path;
   (void)fi;
-  struct sfuse_fs *fs = get_fs_context();
-  if (fsync(fs->backing_fd) < 0)
-    return -errno;
   return 0;
 }
 
 /* fsync */
 static int sfuse_fsync_cb(const char *path, int datasync,
                           struct fuse_file_info *fi) {
-  (void)path;
-  (void)fi;
   struct sfuse_fs *fs = get_fs_context();
-  int res = datasync ? fdatasync(fs->backing_fd) : fsync(fs->backing_fd);
-  if (res < 0)
-    return -errno;
-  return 0;
+  if (ctl_node(path))
+    return 0;
+
+  // 지연 할당된 더티 데이터를 연속 블록에 기록하고 할당 정보를 반영
+  uint32_t ino;
+  if (sfuse_lookup(fs, path, fi, &ino) == 0) {
+    int err = dalloc_flush_inode(fs, ino);
+    if (err < 0)
+      return err;
+    // 할당 정보를 기록하지 못했으면 장치 플러시로 성공을 알리지 않음
+    err = bitmap_sync(fs->backing_fd, fs->sb.block_bitmap_start, fs->block_map,
+                      fs->sb.blocks_count / 8);
+    if (err < 0)
+      return err;
+    err = sb_sync(fs->backing_fd, &fs->sb);
+    if (err < 0)
+      return err;
+  }
+
+  // 동시에 들어온 fsync는 장치 플러시 한 번으로 묶어 처리
+  return fs_sync_device(fs, datasync != 0);
 }
 
 /* statfs */
@@ -588,8 +1643,13 @@ static int sfuse_statfs_cb(const char *path, struct statvfs *stbuf) {
   /* 블록 개수 설정 (슈퍼블록 값 활용) */
   stbuf->f_blocks =
       fs->sb.blocks_count - fs->sb.data_block_start; // 데이터 블록의 전체 개수
-  stbuf->f_bfree = fs->sb.free_blocks;               // 빈 블록 개수 (여유 공간)
-  stbuf->f_bavail = fs->sb.free_blocks; // 일반 사용자가 쓸 수 있는 빈 블록 수
+  // 지연 할당으로 예약된 블록은 사용 중으로 보고 (두 값을 따로 읽으므로 그
+  // 사이 기록이 끝나면 예약이 빈 블록보다 클 수 있어 0에서 멈춤)
+  uint64_t reserved = dalloc_reserved(fs);
+  uint64_t free_blocks = fs->sb.free_blocks;
+  free_blocks = free_blocks > reserved ? free_blocks - reserved : 0;
+  stbuf->f_bfree = free_blocks;  // 빈 블록 개수 (여유 공간)
+  stbuf->f_bavail = free_blocks; // 일반 사용자가 쓸 수 있는 빈 블록 수
 
   /* 아이노드 정보 설정 (VSFS 슈퍼블록 값 활용) */
   stbuf->f_files = fs->sb.inodes_count; // 전체 아이노드 개수
@@ -615,26 +1675,236 @@ static int sfuse_getxattr_cb(const char *path, const char *name, char *value,
   return -ENODATA; // 해당 속성 없음 처리 (안정적으로 처리됨)
 }
 
+/* ioctl: 재배치 잠금을 잡고 호출 */
+static int sfuse_ioctl_inode(struct sfuse_fs *fs, uint32_t ino, int cmd,
+                             void *data) {
+  struct sfuse_inode inode;
+  if (inode_load(fs->backing_fd, &fs->sb, ino, &inode) < 0)
+    return -EIO;
+  if (!S_ISREG(inode.mode) && !S_ISDIR(inode.mode))
+    return -ENOTTY;
+
+  // 커널은 인자를 int 크기로 주고받는다.
+  int attr;
+  if ((unsigned int)cmd == FS_IOC_GETFLAGS) {
+    attr = inode.flags & SFUSE_INODE_FLAG_COMPRESS ? FS_COMPR_FL : 0;
+    memcpy(data, &attr, sizeof(attr));
+    return 0;
+  }
+  memcpy(&attr, data, sizeof(attr));
+  if (attr & ~FS_COMPR_FL)
+    return -EOPNOTSUPP;
+
+  bool want = attr & FS_COMPR_FL;
+  if (want == !!(inode.flags & SFUSE_INODE_FLAG_COMPRESS))
+    return 0;
+  if (want) {
+    // 압축 포인터를 기록할 수 있기 전에 슈퍼블록에 기능을 표시
+    int res = compress_feature_set(fs->backing_fd, &fs->sb);
+    if (res < 0)
+      return res;
+    inode.flags |= SFUSE_INODE_FLAG_COMPRESS;
+  } else {
+    inode.flags &= ~SFUSE_INODE_FLAG_COMPRESS;
+  }
+  inode.ctime = (int64_t)time(NULL);
+  return inode_sync(fs->backing_fd, &fs->sb, ino, &inode) < 0 ? -EIO : 0;
+}
+
+/*
+ * ioctl: FS_IOC_GETFLAGS/FS_IOC_SETFLAGS로 압축 플래그(chattr +c)만 다룬다.
+ * 플래그는 이후 기록되는 데이터부터 적용되며, 디렉터리에 주면 그 안에 새로
+ * 만드는 항목이 물려받는다.
+ */
+static int sfuse_ioctl_cb(const char *path, int cmd, void *arg,
+                          struct fuse_file_info *fi, unsigned int flags,
+                          void *data) {
+  struct sfuse_fs *fs = get_fs_context();
+  (void)arg;
+  if (ctl_node(path))
+    return -ENOTTY;
+  if (flags & FUSE_IOCTL_COMPAT)
+    return -ENOSYS;
+  if ((unsigned int)cmd != FS_IOC_GETFLAGS &&
+      (unsigned int)cmd != FS_IOC_SETFLAGS)
+    return -ENOTTY;
+
+  uint32_t ino;
+  if (sfuse_lookup(fs, path, fi, &ino) < 0)
+    return -ENOENT;
+
+  defrag_io_begin(ino);
+  int res = sfuse_ioctl_inode(fs, ino, cmd, data);
+  defrag_io_end(ino);
+  return res;
+}
+
+/*
+ * 통계 수집 래퍼
+ *
+ * 각 콜백을 감싸 호출 수, 오류 수, 처리 바이트 수, 지연 시간을 stats에
+ * 기록한다. 기록 비용은 clock_gettime() 두 번과 스레드 전용 카운터 갱신이다.
+ */
+#define SFUSE_TIMED(op, call)                                                  \
+  do {                                                                         \
+    uint64_t t0_ = stats_begin((op));                                          \
+    typeof(call) res_ = (call);                                                \
+    stats_record((op), t0_, (int64_t)res_);                                    \
+    return res_;                                                               \
+  } while (0)
+
+static int sfuse_getattr_timed(const char *path, struct stat *stbuf,
+                               struct fuse_file_info *fi) {
+  SFUSE_TIMED(SFUSE_OP_GETATTR, sfuse_getattr_cb(path, stbuf, fi));
+}
+
+static int sfuse_access_timed(const char *path, int mask) {
+  SFUSE_TIMED(SFUSE_OP_ACCESS, sfuse_access_cb(path, mask));
+}
+
+static int sfuse_readdir_timed(const char *path, void *buf,
+                               fuse_fill_dir_t filler, off_t offset,
+                               struct fuse_file_info *fi,
+                               enum fuse_readdir_flags flags) {
+  SFUSE_TIMED(SFUSE_OP_READDIR,
+              sfuse_readdir_cb(path, buf, filler, offset, fi, flags));
+}
+
+static int sfuse_open_timed(const char *path, struct fuse_file_info *fi) {
+  SFUSE_TIMED(SFUSE_OP_OPEN, sfuse_open_cb(path, fi));
+}
+
+static int sfuse_release_timed(const char *path, struct fuse_file_info *fi) {
+  SFUSE_TIMED(SFUSE_OP_RELEASE, sfuse_release_cb(path, fi));
+}
+
+static int sfuse_read_timed(const char *path, char *buf, size_t size,
+                            off_t offset, struct fuse_file_info *fi) {
+  SFUSE_TIMED(SFUSE_OP_READ, sfuse_read_cb(path, buf, size, offset, fi));
+}
+
+static int sfuse_write_timed(const char *path, const char *buf, size_t size,
+                             off_t offset, struct fuse_file_info *fi) {
+  SFUSE_TIMED(SFUSE_OP_WRITE, sfuse_write_cb(path, buf, size, offset, fi));
+}
+
+static int sfuse_create_timed(const char *path, mode_t mode,
+                              struct fuse_file_info *fi) {
+  SFUSE_TIMED(SFUSE_OP_CREATE, sfuse_create_cb(path, mode, fi));
+}
+
+static int sfuse_mkdir_timed(const char *path, mode_t mode) {
+  SFUSE_TIMED(SFUSE_OP_MKDIR, sfuse_mkdir_cb(path, mode));
+}
+
+static int sfuse_symlink_timed(const char *target, const char *linkpath) {
+  SFUSE_TIMED(SFUSE_OP_SYMLINK, sfuse_symlink_cb(target, linkpath));
+}
+
+static int sfuse_readlink_timed(const char *path, char *buf, size_t size) {
+  SFUSE_TIMED(SFUSE_OP_READLINK, sfuse_readlink_cb(path, buf, size));
+}
+
+static int sfuse_unlink_timed(const char *path) {
+  SFUSE_TIMED(SFUSE_OP_UNLINK, sfuse_unlink_cb(path));
+}
+
+static int sfuse_rmdir_timed(const char *path) {
+  SFUSE_TIMED(SFUSE_OP_RMDIR, sfuse_rmdir_cb(path));
+}
+
+static int sfuse_rename_timed(const char *oldpath, const char *newpath,
+                              unsigned int flags) {
+  SFUSE_TIMED(SFUSE_OP_RENAME, sfuse_rename_cb(oldpath, newpath, flags));
+}
+
+static int sfuse_truncate_timed(const char *path, off_t size,
+                                struct fuse_file_info *fi) {
+  SFUSE_TIMED(SFUSE_OP_TRUNCATE, sfuse_truncate_cb(path, size, fi));
+}
+
+static int sfuse_fallocate_timed(const char *path, int mode, off_t offset,
+                                 off_t length, struct fuse_file_info *fi) {
+  SFUSE_TIMED(SFUSE_OP_FALLOCATE,
+              sfuse_fallocate_cb(path, mode, offset, length, fi));
+}
+
+static off_t sfuse_lseek_timed(const char *path, off_t off, int whence,
+                               struct fuse_file_info *fi) {
+  SFUSE_TIMED(SFUSE_OP_LSEEK, sfuse_lseek_cb(path, off, whence, fi));
+}
+
+static ssize_t sfuse_copy_file_range_timed(const char *path_in,
+                                           struct fuse_file_info *fi_in,
+                                           off_t off_in, const char *path_out,
+                                           struct fuse_file_info *fi_out,
+                                           off_t off_out, size_t len,
+                                           int flags) {
+  SFUSE_TIMED(SFUSE_OP_COPY_FILE_RANGE,
+              sfuse_copy_file_range_cb(path_in, fi_in, off_in, path_out,
+                                       fi_out, off_out, len, flags));
+}
+
+static int sfuse_utimens_timed(const char *path, const struct timespec tv[2],
+                               struct fuse_file_info *fi) {
+  SFUSE_TIMED(SFUSE_OP_UTIMENS, sfuse_utimens_cb(path, tv, fi));
+}
+
+static int sfuse_flush_timed(const char *path, struct fuse_file_info *fi) {
+  SFUSE_TIMED(SFUSE_OP_FLUSH, sfuse_flush_cb(path, fi));
+}
+
+static int sfuse_fsync_timed(const char *path, int datasync,
+                             struct fuse_file_info *fi) {
+  SFUSE_TIMED(SFUSE_OP_FSYNC, sfuse_fsync_cb(path, datasync, fi));
+}
+
+static int sfuse_statfs_timed(const char *path, struct statvfs *stbuf) {
+  SFUSE_TIMED(SFUSE_OP_STATFS, sfuse_statfs_cb(path, stbuf));
+}
+
+static int sfuse_getxattr_timed(const char *path, const char *name,
+                                char *value, size_t size) {
+  SFUSE_TIMED(SFUSE_OP_GETXATTR, sfuse_getxattr_cb(path, name, value, size));
+}
+
+static int sfuse_listxattr_timed(const char *path, char *list, size_t size) {
+  SFUSE_TIMED(SFUSE_OP_LISTXATTR, sfuse_listxattr_cb(path, list, size));
+}
+
+static int sfuse_ioctl_timed(const char *path, int cmd, void *arg,
+                             struct fuse_file_info *fi, unsigned int flags,
+                             void *data) {
+  SFUSE_TIMED(SFUSE_OP_IOCTL, sfuse_ioctl_cb(path, cmd, arg, fi, flags, data));
+}
+
 // fuse_operations 구조체에 추가하여 최종 적용
 const struct fuse_operations sfuse_ops = {
     .init = sfuse_init_cb,
     .destroy = sfuse_destroy_cb,
-    .getattr = sfuse_getattr_cb,
-    .access = sfuse_access_cb,
-    .readdir = sfuse_readdir_cb,
-    .open = sfuse_open_cb,
-    .read = sfuse_read_cb,
-    .write = sfuse_write_cb,
-    .create = sfuse_create_cb,
-    .mkdir = sfuse_mkdir_cb,
-    .unlink = sfuse_unlink_cb,
-    .rmdir = sfuse_rmdir_cb,
-    .rename = sfuse_rename_cb,
-    .truncate = sfuse_truncate_cb,
-    .utimens = sfuse_utimens_cb,
-    .flush = sfuse_flush_cb,
-    .fsync = sfuse_fsync_cb,
-    .statfs = sfuse_statfs_cb,
-    .getxattr = sfuse_getxattr_cb,
-    .listxattr = sfuse_listxattr_cb,
+    .getattr = sfuse_getattr_timed,
+    .access = sfuse_access_timed,
+    .readdir = sfuse_readdir_timed,
+    .open = sfuse_open_timed,
+    .release = sfuse_release_timed,
+    .read = sfuse_read_timed,
+    .write = sfuse_write_timed,
+    .create = sfuse_create_timed,
+    .mkdir = sfuse_mkdir_timed,
+    .symlink = sfuse_symlink_timed,
+    .readlink = sfuse_readlink_timed,
+    .unlink = sfuse_unlink_timed,
+    .rmdir = sfuse_rmdir_timed,
+    .rename = sfuse_rename_timed,
+    .truncate = sfuse_truncate_timed,
+    .fallocate = sfuse_fallocate_timed,
+    .lseek = sfuse_lseek_timed,
+    .copy_file_range = sfuse_copy_file_range_timed,
+    .utimens = sfuse_utimens_timed,
+    .flush = sfuse_flush_timed,
+    .fsync = sfuse_fsync_timed,
+    .statfs = sfuse_statfs_timed,
+    .getxattr = sfuse_getxattr_timed,
+    .listxattr = sfuse_listxattr_timed,
+    .ioctl = sfuse_ioctl_timed,
 };
@@ -0,0 +1,282 @@
+/**
+ * @file src/orphan.c
+ * @brief 고아 아이노드 목록과 백그라운드 블록 회수 구현
+ *
+ * 회수 스레드는 목록의 첫 아이노드를 묶음 단위로 줄여 나가고, 다 비우면 목록에서
+ * 빼고 아이노드를 해제한다. 묶음마다 아이노드(줄어든 크기와 블록 포인터)를 먼저
+ * 기록한 뒤 비트맵을 기록하므로, 장애가 나도 해제된 블록을 아이노드가 가리키는
+ * 일은 없다. (해제했지만 비트맵에 반영되지 않은 블록이 남을 수는 있음)
+ */
+
+#include "orphan.h"
+#include "bitmap.h"
+#include "fs.h"
+#include "stats.h"
+#include "super.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * @brief 고아 아이노드의 목록 연결 필드(다음 아이노드 번호)
+ */
+static uint32_t orphan_next(const struct sfuse_inode *inode) {
+  return (uint32_t)inode->atime;
+}
+
+/**
+ * @brief 목록에서 ino를 뺀다. (o->lock을 잡은 상태에서 호출)
+ *
+ * @param next ino 다음 아이노드 번호
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ */
+static int orphan_unlink(struct sfuse_fs *fs, uint32_t ino, uint32_t next) {
+  if (fs->sb.last_orphan == ino) {
+    fs->sb.last_orphan = next;
+    return 0;
+  }
+
+  // 앞 아이노드를 찾아 연결을 건너뛰게 함 (목록 길이만큼만 탐색)
+  uint32_t cur = fs->sb.last_orphan;
+  for (uint32_t n = 0; cur && n < fs->orphan.count; n++) {
+    struct sfuse_inode prev;
+    int res = inode_load(fs->backing_fd, &fs->sb, cur, &prev);
+    if (res < 0)
+      return res;
+    if (orphan_next(&prev) == ino) {
+      prev.atime = next;
+      return inode_sync(fs->backing_fd, &fs->sb, cur, &prev);
+    }
+    cur = orphan_next(&prev);
+  }
+  return -ENOENT;
+}
+
+/**
+ * @brief 다 비운 고아를 목록에서 빼고 아이노드를 해제한다.
+ *
+ * @param next ino 다음 아이노드 번호
+ */
+static void orphan_release(struct sfuse_fs *fs, uint32_t ino, uint32_t next) {
+  struct sfuse_orphan *o = &fs->orphan;
+  pthread_mutex_lock(&o->lock);
+  int res = orphan_unlink(fs, ino, next);
+  if (res == 0) {
+    o->count--;
+    free_inode(&fs->sb, fs->inode_map, ino);
+    struct sfuse_inode empty = {0};
+    inode_sync(fs->backing_fd, &fs->sb, ino, &empty);
+    bitmap_sync(fs->backing_fd, fs->sb.inode_bitmap_start, fs->inode_map,
+                fs->sb.inodes_count / 8);
+    sb_sync(fs->backing_fd, &fs->sb);
+  } else {
+    // 목록이 손상됨: 남은 고아는 포기 (블록이 회수되지 않고 남음)
+    fprintf(stderr, "[SFUSE] 고아 목록에서 아이노드 %u를 뺄 수 없습니다 (%d)\n",
+            ino, res);
+    fs->sb.last_orphan = 0;
+    o->count = 0;
+    sb_sync(fs->backing_fd, &fs->sb);
+  }
+  pthread_mutex_unlock(&o->lock);
+}
+
+/**
+ * @brief 고아 아이노드 하나를 한 묶음만큼 줄인다.
+ *
+ * 파일 끝에서부터 SFUSE_ORPHAN_BATCH_BLOCKS개의 논리 블록을 해제하고 줄어든
+ * 크기를 기록한다. 첫 묶음은 크기 이후에 예약된 블록까지 함께 해제한다.
+ *
+ * @param next 목록의 다음 아이노드 번호를 받을 포인터
+ * @return 다 비웠으면 1, 남았으면 0, 실패 시 음수 오류 코드
+ */
+static int orphan_shrink(struct sfuse_fs *fs, uint32_t ino, uint32_t *next) {
+  struct sfuse_inode inode;
+  int res = inode_load(fs->backing_fd, &fs->sb, ino, &inode);
+  if (res < 0)
+    return res;
+  if (!(inode.flags & SFUSE_INODE_FLAG_ORPHAN))
+    return -EUCLEAN; // 목록이 고아가 아닌 아이노드를 가리킴
+  *next = orphan_next(&inode);
+
+  uint64_t nblocks = (inode.size + SFUSE_BLOCK_SIZE - 1) / SFUSE_BLOCK_SIZE;
+  uint64_t keep =
+      nblocks > SFUSE_ORPHAN_BATCH_BLOCKS ? nblocks - SFUSE_ORPHAN_BATCH_BLOCKS
+                                          : 0;
+  if (!inode_is_inline(&inode)) {
+    res = inode_free_blocks(fs->backing_fd, &fs->sb, fs->block_map, &inode,
+                            keep);
+    if (res < 0)
+      return res;
+  }
+
+  // 아이노드를 먼저 기록한 뒤 비트맵을 기록
+  inode.size = keep * SFUSE_BLOCK_SIZE;
+  res = inode_sync(fs->backing_fd, &fs->sb, ino, &inode);
+  if (res < 0)
+    return res;
+  bitmap_sync(fs->backing_fd, fs->sb.block_bitmap_start, fs->block_map,
+              fs->sb.blocks_count / 8);
+  sb_sync(fs->backing_fd, &fs->sb);
+  stats_event(SFUSE_EV_ORPHAN_BATCH, 1);
+  return keep == 0 ? 1 : 0;
+}
+
+/**
+ * @brief 회수 스레드: 목록이 빌 때까지 첫 고아를 묶음 단위로 회수한다.
+ */
+static void *orphan_worker(void *arg) {
+  struct sfuse_fs *fs = arg;
+  struct sfuse_orphan *o = &fs->orphan;
+
+  pthread_mutex_lock(&o->lock);
+  while (!o->stop) {
+    uint32_t ino = fs->sb.last_orphan;
+    if (ino == 0) {
+      pthread_cond_wait(&o->wake, &o->lock);
+      continue;
+    }
+    pthread_mutex_unlock(&o->lock);
+
+    // 재배치 잠금을 배타로 잡아 재배치와 겹치지 않고, 스냅숏을 만드는
+    // 동안(defrag_io_freeze)에는 멈추게 함
+    uint32_t next = 0;
+    defrag_io_lock(ino, true);
+    int res = orphan_shrink(fs, ino, &next);
+    if (res < 0)
+      fprintf(stderr, "[SFUSE] 고아 아이노드 %u 회수 실패 (%d)\n", ino, res);
+    if (res == -EUCLEAN) {
+      // 목록이 손상됨: 남은 고아는 포기
+      defrag_io_end(ino);
+      pthread_mutex_lock(&o->lock);
+      fs->sb.last_orphan = 0;
+      o->count = 0;
+      sb_sync(fs->backing_fd, &fs->sb);
+      continue;
+    }
+    if (res != 0)
+      orphan_release(fs, ino, next); // 다 비웠거나 더 줄일 수 없음
+    defrag_io_end(ino);
+    // 해제한 아이노드를 가리키는 경로가 커널 캐시에 남지 않게 함 (이름은
+    // 이미 지웠으므로 보통은 찾는 경로가 없음)
+    if (res != 0)
+      fs_invalidate_ino(fs, ino);
+
+    // 요청 처리의 지연이 늘지 않도록 묶음 사이에 쉼
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_nsec += SFUSE_ORPHAN_BATCH_DELAY_MS * 1000000L;
+    if (until.tv_nsec >= 1000000000L) {
+      until.tv_sec++;
+      until.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&o->lock);
+    if (!o->stop)
+      pthread_cond_timedwait(&o->wake, &o->lock, &until);
+  }
+  pthread_mutex_unlock(&o->lock);
+  return NULL;
+}
+
+void orphan_init(struct sfuse_fs *fs) {
+  struct sfuse_orphan *o = &fs->orphan;
+  pthread_mutex_init(&o->lock, NULL);
+  pthread_cond_init(&o->wake, NULL);
+  o->started = o->stop = false;
+  o->count = 0;
+
+  // 이전 마운트에서 남은 고아 수를 셈 (순환을 막기 위해 아이노드 수까지만)
+  uint32_t cur = fs->sb.last_orphan;
+  while (cur && o->count < fs->sb.inodes_count) {
+    struct sfuse_inode inode;
+    if (inode_load(fs->backing_fd, &fs->sb, cur, &inode) < 0 ||
+        !(inode.flags & SFUSE_INODE_FLAG_ORPHAN))
+      break;
+    o->count++;
+    cur = orphan_next(&inode);
+  }
+  if (o->count)
+    fprintf(stderr, "[SFUSE] 회수할 고아 아이노드 %u개를 이어서 회수합니다\n",
+            o->count);
+
+  // 스냅숏 마운트는 읽기 전용이므로 회수하지 않는다.
+  if (fs->opts.snapshot)
+    return;
+
+  int err = pthread_create(&o->thread, NULL, orphan_worker, fs);
+  if (err) {
+    fprintf(stderr, "[SFUSE] 고아 회수 스레드를 만들 수 없습니다 (%d)\n", err);
+    return;
+  }
+  o->started = true;
+}
+
+void orphan_destroy(struct sfuse_fs *fs) {
+  struct sfuse_orphan *o = &fs->orphan;
+  if (o->started) {
+    pthread_mutex_lock(&o->lock);
+    o->stop = true;
+    pthread_cond_signal(&o->wake);
+    pthread_mutex_unlock(&o->lock);
+    pthread_join(o->thread, NULL);
+    o->started = false;
+  }
+  pthread_cond_destroy(&o->wake);
+  pthread_mutex_destroy(&o->lock);
+}
+
+bool orphan_wanted(const struct sfuse_inode *inode) {
+  return !inode_is_inline(inode) &&
+         inode->size > (uint64_t)SFUSE_ORPHAN_BATCH_BLOCKS * SFUSE_BLOCK_SIZE;
+}
+
+int orphan_add(struct sfuse_fs *fs, uint32_t ino, struct sfuse_inode *inode) {
+  struct sfuse_orphan *o = &fs->orphan;
+  pthread_mutex_lock(&o->lock);
+
+  // 아이노드에 다음 고아를 연결해 먼저 기록한 뒤 목록의 머리로 삼음
+  inode->flags |= SFUSE_INODE_FLAG_ORPHAN;
+  inode->links = 0;
+  inode->atime = fs->sb.last_orphan;
+  int res = inode_sync(fs->backing_fd, &fs->sb, ino, inode);
+  if (res == 0) {
+    fs->sb.last_orphan = ino;
+    o->count++;
+    res = sb_sync(fs->backing_fd, &fs->sb);
+    pthread_cond_signal(&o->wake);
+  }
+  pthread_mutex_unlock(&o->lock);
+  return res;
+}
+
+int orphan_detach(struct sfuse_fs *fs, uint32_t ino,
+                  struct sfuse_inode *inode) {
+  int tmp = alloc_inode(&fs->sb, fs->inode_map);
+  if (tmp < 0)
+    return tmp;
+
+  // 원래 아이노드의 블록 포인터를 비워 먼저 기록
+  struct sfuse_inode orphan = *inode;
+  memset(inode->direct, 0, sizeof(inode->direct));
+  inode->indirect = inode->double_indirect = inode->triple_indirect = 0;
+  inode->size = 0;
+  int res = inode_sync(fs->backing_fd, &fs->sb, ino, inode);
+  if (res < 0) {
+    *inode = orphan;
+    free_inode(&fs->sb, fs->inode_map, (uint32_t)tmp);
+    return res;
+  }
+
+  // 블록 맵을 넘겨받은 새 아이노드를 고아 목록에 넣음
+  bitmap_sync(fs->backing_fd, fs->sb.inode_bitmap_start, fs->inode_map,
+              fs->sb.inodes_count / 8);
+  return orphan_add(fs, (uint32_t)tmp, &orphan);
+}
+
+uint32_t orphan_pending(struct sfuse_fs *fs) {
+  pthread_mutex_lock(&fs->orphan.lock);
+  uint32_t n = fs->orphan.count;
+  pthread_mutex_unlock(&fs->orphan.lock);
+  return n;
+}
@@ -0,0 +1,742 @@
+/**
+ * @file src/snap.c
+ * @brief 파일 시스템 전체의 읽기 전용 스냅숏 구현
+ *
+ * 원본 마운트는 disk_write()의 기록 전 함수(snap_before_write)로 스냅숏이
+ * 가리키는 블록을 처음 고칠 때 복사하고, 스냅숏 마운트는 disk_read()의 읽기
+ * 함수(snap_view_read)로 복사된 블록을 복사본에서 읽는다. 두 경우 모두
+ * {원래 블록 → 복사본} 해시 표를 메모리에 둔다.
+ *
+ * 데이터 블록을 스냅숏이 가리키는지는 스냅숏 시점의 블록 비트맵으로 판단한다.
+ * 비트맵 블록도 처음 고칠 때 복사되므로, 복사본이 있으면 복사본을, 없으면
+ * 장치의 비트맵 블록을 청크 단위로 읽어 둔다.
+ *
+ * 복사본과 테이블 블록은 원본의 블록 비트맵에서 할당하고 disk_write()를 거치지
+ * 않고 기록한다. 그래서 원본에서 해제되었지만 스냅숏이 아직 가리키는 블록을
+ * 할당받으면 그 블록에는 기록하지 않고 {블록, 블록} 항목으로 제자리에 보존한다.
+ */
+
+#include "snap.h"
+#include "bitmap.h"
+#include "dalloc.h" // SFUSE_DALLOC_META_SLACK
+#include "discard.h"
+#include "disk.h"
+#include "fs.h"
+#include "stats.h"
+#include "super.h"
+#include <endian.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/** @brief 예외 테이블 블록에서 항목이 시작하는 64비트 워드 위치 */
+#define SNAP_HDR_WORDS 2
+
+/** @brief 블록 비트맵 청크 하나가 다루는 블록 수 */
+#define SNAP_BITS_PER_CHUNK ((uint64_t)SFUSE_BLOCK_SIZE * 8)
+
+/**
+ * @struct snap_vec
+ * @brief 블록 번호 배열
+ */
+struct snap_vec {
+  uint64_t *v; /**< 블록 번호 */
+  size_t n;    /**< 개수 */
+  size_t cap;  /**< 용량 */
+};
+
+/**
+ * @struct snap_state
+ * @brief 스냅숏 모듈의 전역 상태 (snap_lock으로 보호)
+ */
+static struct snap_state {
+  int fd;                 /**< 디바이스 파일 디스크립터 */
+  struct sfuse_fs *fs;    /**< 원본 마운트 컨텍스트 (스냅숏 마운트면 NULL) */
+  _Atomic bool active;    /**< 원본 마운트에서 보호 중 */
+  bool invalid;           /**< 무효 표시를 읽었거나 기록함 */
+  uint64_t data_start;    /**< 데이터 영역 시작 블록 번호 */
+  uint64_t bitmap_start;  /**< 블록 비트맵 시작 블록 번호 */
+  uint64_t blocks_count;  /**< 전체 블록 수 */
+  uint64_t *keys;         /**< 해시 표 키 (원래 블록 + 1, 0이면 빈 칸) */
+  uint64_t *vals;         /**< 해시 표 값 (복사본 블록) */
+  size_t cap;             /**< 해시 표 크기 (2의 거듭제곱) */
+  size_t n;               /**< 해시 표 항목 수 */
+  struct snap_vec tables; /**< 예외 테이블 블록 (체인 순서) */
+  struct snap_vec pins;   /**< 테이블에 아직 기록하지 않은 제자리 보존 블록 */
+  uint32_t tail_n;        /**< 마지막 테이블 블록에서 쓴 항목 수 */
+  uint64_t saved;         /**< 지금까지 복사한 블록 수 (복사 순번) */
+  uint64_t durable;       /**< 장치 플러시로 반영된 복사 순번 */
+  uint64_t tail[SFUSE_BLOCK_SIZE / 8]; /**< 마지막 테이블 블록 (리틀 엔디언) */
+  uint8_t **bmap;         /**< 스냅숏 시점의 블록 비트맵 청크 (원본 마운트) */
+  size_t nchunks;         /**< 블록 비트맵 청크 수 */
+  uint8_t buf[SFUSE_BLOCK_SIZE]; /**< 복사와 새 테이블 블록에 쓰는 버퍼 */
+} sn;
+
+static pthread_mutex_t snap_lock = PTHREAD_MUTEX_INITIALIZER;
+/** @brief 스냅숏 만들기와 지우기를 직렬화 */
+static pthread_mutex_t snap_admin_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief 블록 하나를 disk_read()/disk_write()의 연결 함수를 거치지 않고 읽거나
+ * 쓴다.
+ */
+static int snap_io(bool write, void *buf, uint64_t blk) {
+  enum sfuse_stat_op op = write ? SFUSE_OP_DISK_WRITE : SFUSE_OP_DISK_READ;
+  uint64_t t0 = stats_begin(op);
+  off_t off = (off_t)blk * SFUSE_BLOCK_SIZE;
+  ssize_t ret = write ? pwrite(sn.fd, buf, SFUSE_BLOCK_SIZE, off)
+                      : pread(sn.fd, buf, SFUSE_BLOCK_SIZE, off);
+  if (ret < 0)
+    ret = -errno;
+  stats_record(op, t0, ret);
+  return ret < 0 ? (int)ret : ret == SFUSE_BLOCK_SIZE ? 0 : -EIO;
+}
+
+static int vec_push(struct snap_vec *vec, uint64_t x) {
+  if (vec->n == vec->cap) {
+    size_t cap = vec->cap ? vec->cap * 2 : 64;
+    uint64_t *v = realloc(vec->v, cap * sizeof(*v));
+    if (!v)
+      return -ENOMEM;
+    vec->v = v;
+    vec->cap = cap;
+  }
+  vec->v[vec->n++] = x;
+  return 0;
+}
+
+static size_t map_slot(uint64_t blk) {
+  uint64_t h = blk * 0x9E3779B97F4A7C15ULL;
+  return (size_t)(h ^ (h >> 32)) & (sn.cap - 1);
+}
+
+/**
+ * @brief 원래 블록의 복사본을 찾는다.
+ *
+ * @return 복사본 블록 번호, 없으면 0
+ */
+static uint64_t map_find(uint64_t blk) {
+  if (!sn.n)
+    return 0;
+  for (size_t i = map_slot(blk);; i = (i + 1) & (sn.cap - 1)) {
+    if (sn.keys[i] == blk + 1)
+      return sn.vals[i];
+    if (!sn.keys[i])
+      return 0;
+  }
+}
+
+/**
+ * @brief 원래 블록의 항목을 지운다. (뒤따르는 항목을 당겨 빈 칸을 메움)
+ */
+static void map_del(uint64_t blk) {
+  size_t mask = sn.cap - 1, i = map_slot(blk);
+  if (!sn.n)
+    return;
+  while (sn.keys[i] != blk + 1) {
+    if (!sn.keys[i])
+      return;
+    i = (i + 1) & mask;
+  }
+  for (size_t j = (i + 1) & mask; sn.keys[j]; j = (j + 1) & mask) {
+    size_t home = map_slot(sn.keys[j] - 1);
+    // home이 (i, j] 구간에 있으면 그대로 두어야 찾을 수 있음
+    if (((j - home) & mask) < ((j - i) & mask))
+      continue;
+    sn.keys[i] = sn.keys[j];
+    sn.vals[i] = sn.vals[j];
+    i = j;
+  }
+  sn.keys[i] = 0;
+  sn.n--;
+}
+
+static int map_put(uint64_t blk, uint64_t copy) {
+  if ((sn.n + 1) * 2 > sn.cap) {
+    size_t cap = sn.cap ? sn.cap * 2 : 1024;
+    uint64_t *keys = calloc(cap, sizeof(*keys));
+    uint64_t *vals = calloc(cap, sizeof(*vals));
+    if (!keys || !vals) {
+      free(keys);
+      free(vals);
+      return -ENOMEM;
+    }
+    uint64_t *old_keys = sn.keys, *old_vals = sn.vals;
+    size_t old_cap = sn.cap;
+    sn.keys = keys;
+    sn.vals = vals;
+    sn.cap = cap;
+    for (size_t i = 0; i < old_cap; i++) {
+      if (!old_keys[i])
+        continue;
+      size_t j = map_slot(old_keys[i] - 1);
+      while (sn.keys[j])
+        j = (j + 1) & (cap - 1);
+      sn.keys[j] = old_keys[i];
+      sn.vals[j] = old_vals[i];
+    }
+    free(old_keys);
+    free(old_vals);
+  }
+  size_t i = map_slot(blk);
+  while (sn.keys[i] && sn.keys[i] != blk + 1)
+    i = (i + 1) & (sn.cap - 1);
+  if (!sn.keys[i])
+    sn.n++;
+  sn.keys[i] = blk + 1;
+  sn.vals[i] = copy;
+  return 0;
+}
+
+/**
+ * @brief 해시 표, 테이블 목록, 비트맵 청크를 비운다. (snap_lock 안에서)
+ */
+static void snap_reset(void) {
+  free(sn.keys);
+  free(sn.vals);
+  free(sn.tables.v);
+  free(sn.pins.v);
+  for (size_t c = 0; sn.bmap && c < sn.nchunks; c++) {
+    free(sn.bmap[c]);
+    sn.bmap[c] = NULL;
+  }
+  sn.keys = sn.vals = NULL;
+  sn.cap = sn.n = 0;
+  memset(&sn.tables, 0, sizeof(sn.tables));
+  memset(&sn.pins, 0, sizeof(sn.pins));
+  sn.tail_n = 0;
+  sn.invalid = false;
+}
+
+/**
+ * @brief 마지막으로 읽은 테이블 블록부터 새 항목을 읽어 해시 표에 더한다.
+ *
+ * 마운트할 때 테이블 전체를 읽는 데 쓰고, 스냅숏 마운트에서는 원본이 그 사이
+ * 더한 항목을 반영하는 데 쓴다.
+ *
+ * @return 성공 시 0, 실패 시 음수 오류 코드 (-EIO: 테이블 손상)
+ */
+static int table_scan(void) {
+  for (;;) {
+    int res = snap_io(false, sn.tail, sn.tables.v[sn.tables.n - 1]);
+    if (res < 0)
+      return res;
+    uint64_t hdr = le64toh(sn.tail[0]);
+    if ((uint32_t)hdr != SFUSE_SNAP_MAGIC)
+      return -EIO;
+    if ((hdr >> 32) & SFUSE_SNAP_F_INVALID)
+      sn.invalid = true;
+    for (; sn.tail_n < SFUSE_SNAP_ENTRIES; sn.tail_n++) {
+      const uint64_t *e = &sn.tail[SNAP_HDR_WORDS + 2 * sn.tail_n];
+      uint64_t orig = le64toh(e[0]), copy = le64toh(e[1]);
+      if (!copy)
+        return 0; // 아직 쓰지 않은 자리
+      if (orig >= sn.blocks_count || copy < sn.data_start ||
+          copy >= sn.blocks_count)
+        return -EIO;
+      if ((res = map_put(orig, copy)) < 0)
+        return res;
+    }
+    uint64_t next = le64toh(sn.tail[1]);
+    if (!next)
+      return 0;
+    if (next < sn.data_start || next >= sn.blocks_count ||
+        sn.tables.n >= sn.blocks_count)
+      return -EIO;
+    if ((res = vec_push(&sn.tables, next)) < 0)
+      return res;
+    sn.tail_n = 0;
+  }
+}
+
+/**
+ * @brief 블록을 스냅숏이 가리키는지 확인한다. (원본 마운트)
+ *
+ * 메타데이터 영역은 모두 가리키고, 데이터 블록은 스냅숏 시점의 블록 비트맵에서
+ * 할당된 블록만 가리킨다.
+ */
+static int snap_owned(uint64_t blk, bool *owned) {
+  if (blk < sn.data_start) {
+    *owned = true;
+    return 0;
+  }
+  uint64_t bit = blk - sn.data_start;
+  size_t c = (size_t)(bit / SNAP_BITS_PER_CHUNK);
+  if (!sn.bmap[c]) {
+    uint8_t *m = malloc(SFUSE_BLOCK_SIZE);
+    if (!m)
+      return -ENOMEM;
+    uint64_t src = map_find(sn.bitmap_start + c);
+    int res = snap_io(false, m, src ? src : sn.bitmap_start + c);
+    if (res < 0) {
+      free(m);
+      return res;
+    }
+    sn.bmap[c] = m;
+  }
+  uint64_t i = bit % SNAP_BITS_PER_CHUNK;
+  *owned = sn.bmap[c][i / 8] & (1 << (i % 8));
+  return 0;
+}
+
+/**
+ * @brief 복사본이나 테이블 블록으로 쓸 빈 블록을 할당한다.
+ *
+ * 지연 할당이 예약한 블록은 남겨 둔다. 스냅숏이 아직 가리키는 블록을 받으면
+ * 그대로 할당해 둔 채 pins에 모으고 다른 블록을 찾는다.
+ *
+ * @return 블록 번호 (장치 기준), 실패 시 음수 오류 코드
+ */
+static int64_t snap_alloc(void) {
+  struct sfuse_fs *fs = sn.fs;
+  for (;;) {
+    if (__atomic_load_n(&fs->sb.free_blocks, __ATOMIC_RELAXED) <=
+        __atomic_load_n(&fs->dalloc.nblocks, __ATOMIC_RELAXED) +
+            SFUSE_DALLOC_META_SLACK)
+      return -ENOSPC;
+    int64_t i = alloc_block(&fs->sb, fs->block_map);
+    if (i < 0)
+      return i;
+    uint64_t blk = sn.data_start + (uint64_t)i;
+    bool owned;
+    int res = snap_owned(blk, &owned);
+    if (res == 0 && (!owned || map_find(blk)))
+      return (int64_t)blk;
+    if (res == 0 && (res = vec_push(&sn.pins, blk)) == 0 &&
+        (res = map_put(blk, blk)) < 0)
+      sn.pins.n--;
+    if (res < 0) {
+      free_block(&fs->sb, fs->block_map, (uint64_t)i);
+      return res;
+    }
+  }
+}
+
+/**
+ * @brief 예외 테이블에 항목 하나를 더해 기록한다.
+ *
+ * 마지막 블록이 차면 새 블록을 먼저 기록한 뒤 이전 블록에서 연결한다.
+ */
+static int table_append(uint64_t orig, uint64_t copy) {
+  int res;
+  if (sn.tail_n == SFUSE_SNAP_ENTRIES) {
+    int64_t blk = snap_alloc();
+    if (blk < 0)
+      return (int)blk;
+    memset(sn.buf, 0, sizeof(sn.buf));
+    *(uint64_t *)sn.buf = htole64(SFUSE_SNAP_MAGIC);
+    sn.tail[1] = htole64((uint64_t)blk);
+    res = snap_io(true, sn.buf, (uint64_t)blk);
+    if (res == 0 && (res = vec_push(&sn.tables, (uint64_t)blk)) == 0 &&
+        (res = snap_io(true, sn.tail, sn.tables.v[sn.tables.n - 2])) < 0)
+      sn.tables.n--;
+    if (res < 0) {
+      sn.tail[1] = 0;
+      free_block(&sn.fs->sb, sn.fs->block_map,
+                 (uint64_t)blk - sn.data_start);
+      return res;
+    }
+    memcpy(sn.tail, sn.buf, sizeof(sn.tail));
+    sn.tail_n = 0;
+  }
+
+  uint64_t *e = &sn.tail[SNAP_HDR_WORDS + 2 * sn.tail_n];
+  e[0] = htole64(orig);
+  e[1] = htole64(copy);
+  if ((res = snap_io(true, sn.tail, sn.tables.v[sn.tables.n - 1])) < 0) {
+    e[0] = e[1] = 0;
+    return res;
+  }
+  sn.tail_n++;
+  return 0;
+}
+
+/**
+ * @brief 제자리에 보존하기로 한 블록을 예외 테이블에 기록한다.
+ *
+ * 기록하지 못한 블록은 pins에 남아 snap_mark_invalid()가 해제한다.
+ */
+static int pins_flush(void) {
+  while (sn.pins.n) {
+    uint64_t blk = sn.pins.v[sn.pins.n - 1];
+    int res = table_append(blk, blk);
+    if (res < 0)
+      return res;
+    sn.pins.n--;
+  }
+  return 0;
+}
+
+/**
+ * @brief 마지막 테이블 블록에 무효 표시를 기록한다.
+ *
+ * 스냅숏 마운트는 무효 표시를 읽으면 더 이상 읽지 않는다. 테이블에 기록하지
+ * 못한 제자리 보존 블록은 더 지킬 필요가 없으므로 바로 해제한다.
+ */
+static void snap_mark_invalid(void) {
+  atomic_store(&sn.active, false);
+  sn.invalid = true;
+  sn.tail[0] |= htole64((uint64_t)SFUSE_SNAP_F_INVALID << 32);
+  int res = snap_io(true, sn.tail, sn.tables.v[sn.tables.n - 1]);
+  if (res < 0)
+    fprintf(stderr, "[SFUSE] 스냅숏 무효 표시 기록 실패 (%d)\n", res);
+  for (; sn.pins.n; sn.pins.n--) {
+    uint64_t blk = sn.pins.v[sn.pins.n - 1];
+    map_del(blk);
+    free_block(&sn.fs->sb, sn.fs->block_map, blk - sn.data_start);
+  }
+}
+
+/**
+ * @brief 복사하지 못한 스냅숏을 무효로 표시하고 보호를 멈춘다.
+ *
+ * 원본 파일 시스템의 기록을 막지 않도록 복사하지 못한 블록은 그대로 덮어쓰게
+ * 한다.
+ */
+static void snap_invalidate(int err) {
+  fprintf(stderr,
+          "[SFUSE] 스냅숏 블록을 복사하지 못해 (%d) 스냅숏을 무효로 "
+          "표시합니다\n",
+          err);
+  snap_mark_invalid();
+}
+
+/**
+ * @brief 블록의 원래 내용을 새 블록에 복사하고 테이블에 더한다.
+ */
+static int snap_save(uint64_t blk) {
+  int64_t copy = snap_alloc();
+  if (copy < 0)
+    return (int)copy;
+  int res = map_put(blk, (uint64_t)copy);
+  if (res < 0) {
+    free_block(&sn.fs->sb, sn.fs->block_map, (uint64_t)copy - sn.data_start);
+    return res;
+  }
+  // 실패하면 스냅숏이 무효가 되므로 테이블에 없는 복사본은 바로 해제
+  if ((res = snap_io(false, sn.buf, blk)) < 0 ||
+      (res = snap_io(true, sn.buf, (uint64_t)copy)) < 0 ||
+      (res = table_append(blk, (uint64_t)copy)) < 0) {
+    map_del(blk);
+    free_block(&sn.fs->sb, sn.fs->block_map, (uint64_t)copy - sn.data_start);
+    return res;
+  }
+  stats_event(SFUSE_EV_SNAP_COPY, 1);
+  return pins_flush();
+}
+
+/**
+ * @brief 기록 전에 스냅숏이 가리키는 블록의 원래 내용을 복사한다.
+ *
+ * 복사본과 테이블 항목은 원래 블록을 고치기 전에 장치에 반영해야 한다. 그
+ * 전에 장애가 나면 스냅숏이 이미 덮어쓴 원래 블록을 읽게 된다. 장치
+ * 플러시는 snap_lock 밖에서 fs_sync_device()로 하므로 동시에 복사한 기록들이
+ * 한 번의 플러시로 묶인다. 다른 스레드가 복사했지만 아직 반영되지 않은
+ * 블록을 고칠 때도 그 플러시를 기다린다.
+ */
+static int snap_before_write(int fd, off_t off, size_t size) {
+  (void)fd;
+  if (!atomic_load_explicit(&sn.active, memory_order_acquire) || size == 0)
+    return 0;
+  uint64_t first = (uint64_t)off / SFUSE_BLOCK_SIZE;
+  uint64_t last = ((uint64_t)off + size - 1) / SFUSE_BLOCK_SIZE;
+  bool touched = false;
+  int res = 0;
+
+  pthread_mutex_lock(&snap_lock);
+  for (uint64_t b = first; b <= last && b < sn.blocks_count; b++) {
+    if (!atomic_load_explicit(&sn.active, memory_order_relaxed))
+      break;
+    if (map_find(b)) {
+      touched = true; // 다른 스레드의 복사가 아직 반영 전일 수 있음
+      continue;
+    }
+    bool owned;
+    res = snap_owned(b, &owned);
+    if (res == 0 && !owned)
+      continue;
+    if (res == 0)
+      res = snap_save(b);
+    if (res < 0) {
+      snap_invalidate(res);
+      res = 0;
+      break;
+    }
+    sn.saved++;
+    touched = true;
+  }
+  uint64_t target = sn.saved;
+  bool flush = touched && sn.durable < target;
+  pthread_mutex_unlock(&snap_lock);
+  if (!flush)
+    return res;
+
+  // 플러시가 성공하면 지금까지의 복사가 모두 반영됨
+  res = fs_sync_device(sn.fs, true);
+  if (res == 0) {
+    pthread_mutex_lock(&snap_lock);
+    if (sn.durable < target)
+      sn.durable = target;
+    pthread_mutex_unlock(&snap_lock);
+  }
+  return res;
+}
+
+/**
+ * @brief 스냅숏 마운트의 읽기: 복사된 블록은 복사본에서 읽는다.
+ *
+ * 원본이 동시에 마운트되어 있을 수 있으므로 장치를 먼저 읽은 뒤 테이블을 다시
+ * 읽는다. 그 사이 복사된 블록은 복사본에서 다시 읽으므로, 원본이 블록을
+ * 고치기 전에 항목을 기록하는 한 언제나 스냅숏 시점의 내용을 얻는다.
+ */
+static ssize_t snap_view_read(int fd, void *buf, size_t size, off_t off) {
+  ssize_t ret = pread(fd, buf, size, off);
+  if (ret <= 0)
+    return ret < 0 ? -errno : 0;
+
+  pthread_mutex_lock(&snap_lock);
+  int res = table_scan();
+  if (res == 0 && sn.invalid)
+    res = -ESTALE;
+  uint64_t end = (uint64_t)off + (uint64_t)ret;
+  for (uint64_t b = (uint64_t)off / SFUSE_BLOCK_SIZE;
+       res == 0 && b * SFUSE_BLOCK_SIZE < end; b++) {
+    uint64_t copy = map_find(b);
+    if (!copy || copy == b)
+      continue;
+    uint64_t lo = b * SFUSE_BLOCK_SIZE, hi = lo + SFUSE_BLOCK_SIZE;
+    if (lo < (uint64_t)off)
+      lo = (uint64_t)off;
+    if (hi > end)
+      hi = end;
+    off_t src = (off_t)(copy * SFUSE_BLOCK_SIZE + lo % SFUSE_BLOCK_SIZE);
+    ssize_t n = pread(fd, (uint8_t *)buf + (lo - (uint64_t)off), hi - lo, src);
+    if (n != (ssize_t)(hi - lo))
+      res = n < 0 ? -errno : -EIO;
+  }
+  pthread_mutex_unlock(&snap_lock);
+  return res < 0 ? res : ret;
+}
+
+/**
+ * @brief 스냅숏 마운트의 기록은 모두 거부한다.
+ */
+static int snap_view_write(int fd, off_t off, size_t size) {
+  (void)fd;
+  (void)off;
+  (void)size;
+  return -EROFS;
+}
+
+static const struct disk_hooks snap_live_hooks = {.write = snap_before_write};
+static const struct disk_hooks snap_view_hooks = {.read = snap_view_read,
+                                                  .write = snap_view_write};
+
+/**
+ * @brief 첫 블록부터 예외 테이블을 모두 읽는다.
+ */
+static int snap_load(uint64_t head) {
+  int res = vec_push(&sn.tables, head);
+  return res < 0 ? res : table_scan();
+}
+
+int snap_init(struct sfuse_fs *fs) {
+  struct sfuse_super *sb = &fs->sb;
+  sn.fd = fs->backing_fd;
+  sn.fs = fs;
+  sn.data_start = sb->data_block_start;
+  sn.bitmap_start = sb->block_bitmap_start;
+  sn.blocks_count = sb->blocks_count;
+  sn.nchunks = (size_t)((sb->blocks_count - sb->data_block_start +
+                         SNAP_BITS_PER_CHUNK - 1) /
+                        SNAP_BITS_PER_CHUNK);
+  sn.bmap = calloc(sn.nchunks, sizeof(*sn.bmap));
+  if (!sn.bmap)
+    return -ENOMEM;
+  disk_set_hooks(&snap_live_hooks);
+  if (!(sb->feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_SNAPSHOT))
+    return 0;
+
+  int res = snap_load(sb->snap_table);
+  if (res < 0) {
+    fprintf(stderr, "[SFUSE] 스냅숏 예외 테이블을 읽을 수 없습니다 (%d)\n",
+            res);
+    return res;
+  }
+
+  // 장애로 비트맵에 기록되지 못한 복사본과 테이블 블록을 다시 표시
+  for (size_t i = 0; i < sn.tables.n && res >= 0; i++)
+    res = claim_block(sb, fs->block_map, sn.tables.v[i] - sn.data_start);
+  for (size_t i = 0; i < sn.cap && res >= 0; i++)
+    if (sn.keys[i])
+      res = claim_block(sb, fs->block_map, sn.vals[i] - sn.data_start);
+  if (res < 0)
+    return res;
+
+  discard_hold(true);
+  if (sn.invalid)
+    fprintf(stderr, "[SFUSE] 무효가 된 스냅숏이 있습니다. snapshot_delete로 "
+                    "지우세요\n");
+  else
+    atomic_store(&sn.active, true);
+  return 0;
+}
+
+int snap_open_view(int fd) {
+  struct sfuse_super raw;
+  ssize_t ret = pread(fd, &raw, sizeof(raw), SFUSE_SUPERBLOCK_OFFSET);
+  if (ret != (ssize_t)sizeof(raw))
+    return ret < 0 ? -errno : -EIO;
+  if (le32toh(raw.magic) != SFUSE_MAGIC)
+    return -EINVAL;
+  if (!(le32toh(raw.feature_ro_compat) & SFUSE_FEATURE_RO_COMPAT_SNAPSHOT))
+    return -ENOENT;
+
+  sn.fd = fd;
+  sn.data_start = le64toh(raw.data_block_start);
+  sn.bitmap_start = le64toh(raw.block_bitmap_start);
+  sn.blocks_count = le64toh(raw.blocks_count);
+  uint64_t head = le64toh(raw.snap_table);
+  if (head < sn.data_start || head >= sn.blocks_count)
+    return -EIO;
+
+  int res = snap_load(head);
+  if (res == 0 && sn.invalid)
+    res = -ESTALE;
+  if (res < 0) {
+    snap_reset();
+    return res;
+  }
+  disk_set_hooks(&snap_view_hooks);
+  return 0;
+}
+
+void snap_destroy(void) {
+  disk_set_hooks(NULL);
+  atomic_store(&sn.active, false);
+  pthread_mutex_lock(&snap_lock);
+  snap_reset();
+  free(sn.bmap);
+  sn.bmap = NULL;
+  sn.nchunks = 0;
+  sn.fs = NULL;
+  pthread_mutex_unlock(&snap_lock);
+}
+
+int snap_create(struct sfuse_fs *fs) {
+  if (sn.fs != fs || fs->opts.mmap_meta)
+    return -EOPNOTSUPP;
+  pthread_mutex_lock(&snap_admin_lock);
+  if (fs->sb.feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_SNAPSHOT) {
+    pthread_mutex_unlock(&snap_admin_lock);
+    return -EEXIST;
+  }
+
+  /* [1단계] 이후 해제하는 블록은 스냅숏이 가리킬 수 있으니 discard 보류 */
+  discard_hold(true);
+
+  /* [2단계] 예외 테이블의 첫 블록 */
+  int64_t i = alloc_block(&fs->sb, fs->block_map);
+  int res = i < 0 ? (int)i : 0;
+  uint64_t head = sn.data_start + (uint64_t)i;
+  pthread_mutex_lock(&snap_lock);
+  snap_reset();
+  memset(sn.tail, 0, sizeof(sn.tail));
+  sn.tail[0] = htole64(SFUSE_SNAP_MAGIC);
+  if (res == 0 && (res = vec_push(&sn.tables, head)) == 0)
+    res = snap_io(true, sn.tail, head);
+  pthread_mutex_unlock(&snap_lock);
+
+  /* [3단계] 데이터 요청과 백그라운드 작업을 막고 더티 데이터와 메타데이터를
+   *         기록해 장치를 한 시점의 상태로 맞춤 */
+  if (res == 0) {
+    fs->sb.snap_table = head;
+    fs->sb.snap_time = (int64_t)time(NULL);
+    __atomic_fetch_or(&fs->sb.feature_ro_compat,
+                      SFUSE_FEATURE_RO_COMPAT_SNAPSHOT, __ATOMIC_RELEASE);
+    res = fs_freeze(fs);
+    if (res < 0) {
+      __atomic_fetch_and(&fs->sb.feature_ro_compat,
+                         ~SFUSE_FEATURE_RO_COMPAT_SNAPSHOT, __ATOMIC_RELEASE);
+      fs->sb.snap_table = 0;
+      fs->sb.snap_time = 0;
+      sb_sync(fs->backing_fd, &fs->sb);
+    }
+  }
+  if (res < 0) {
+    if (i >= 0)
+      free_block(&fs->sb, fs->block_map, (uint64_t)i);
+    discard_hold(false);
+    pthread_mutex_unlock(&snap_admin_lock);
+    return res;
+  }
+
+  /* [4단계] 보호를 시작한 뒤 요청을 다시 받음 (이후 처음 고치는 블록은 먼저
+   *         복사됨) */
+  atomic_store(&sn.active, true);
+  fs_thaw(fs);
+  pthread_mutex_unlock(&snap_admin_lock);
+  return 0;
+}
+
+int snap_delete(struct sfuse_fs *fs) {
+  if (sn.fs != fs)
+    return -EOPNOTSUPP;
+  pthread_mutex_lock(&snap_admin_lock);
+  if (!(fs->sb.feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_SNAPSHOT)) {
+    pthread_mutex_unlock(&snap_admin_lock);
+    return -ENOENT;
+  }
+
+  /* [1단계] 보호를 멈추고, 마운트된 스냅숏이 더 읽지 않도록 무효 표시 */
+  pthread_mutex_lock(&snap_lock);
+  if (sn.tables.n && !sn.invalid)
+    snap_mark_invalid();
+  atomic_store(&sn.active, false);
+  pthread_mutex_unlock(&snap_lock);
+
+  /* [2단계] 슈퍼블록에서 먼저 지움 (그 뒤 장애가 나면 블록이 누수될 뿐) */
+  uint64_t head = fs->sb.snap_table;
+  int64_t when = fs->sb.snap_time;
+  __atomic_fetch_and(&fs->sb.feature_ro_compat,
+                     ~SFUSE_FEATURE_RO_COMPAT_SNAPSHOT, __ATOMIC_RELEASE);
+  fs->sb.snap_table = 0;
+  fs->sb.snap_time = 0;
+  int res = sb_sync(fs->backing_fd, &fs->sb);
+  if (res < 0) {
+    __atomic_fetch_or(&fs->sb.feature_ro_compat,
+                      SFUSE_FEATURE_RO_COMPAT_SNAPSHOT, __ATOMIC_RELEASE);
+    fs->sb.snap_table = head;
+    fs->sb.snap_time = when;
+    pthread_mutex_unlock(&snap_admin_lock);
+    return res;
+  }
+
+  /* [3단계] 복사본, 제자리 보존 블록, 테이블 블록 해제 */
+  discard_hold(false);
+  pthread_mutex_lock(&snap_lock);
+  for (size_t k = 0; k < sn.cap; k++)
+    if (sn.keys[k])
+      free_block(&fs->sb, fs->block_map, sn.vals[k] - sn.data_start);
+  for (size_t k = 0; k < sn.tables.n; k++)
+    free_block(&fs->sb, fs->block_map, sn.tables.v[k] - sn.data_start);
+  snap_reset();
+  pthread_mutex_unlock(&snap_lock);
+  pthread_mutex_unlock(&snap_admin_lock);
+  return 0;
+}
+
+bool snap_active(void) { return atomic_load(&sn.active); }
+
+uint64_t snap_blocks(void) {
+  pthread_mutex_lock(&snap_lock);
+  uint64_t n = sn.n + sn.tables.n;
+  pthread_mutex_unlock(&snap_lock);
+  return n;
+}
@@ -6,53 +6,170 @@
  */
 
 #include "super.h"
+#include "bitmap.h" // SFUSE_SUMMARY_PER_BLOCK
+#include "csum.h"
+#include "dedup.h" // SFUSE_REFCOUNT_PER_BLOCK
 #include "disk.h"
-#include <linux/errno.h>
+#include "inode.h" // struct sfuse_inode (아이노드 테이블 크기 계산)
+#include <endian.h>
+#include <errno.h>
+#include <pthread.h>
 #include <string.h>
 #include <unistd.h>
 
+/**
+ * @brief 슈퍼블록의 바이트 순서를 리틀 엔디언과 호스트 순서 사이에서 변환한다.
+ *
+ * 리틀 엔디언 변환은 양방향이 같은 연산이므로 로드(디스크 → 메모리)와
+ * 동기화(메모리 → 디스크) 모두 이 함수를 사용한다. 리틀 엔디언 호스트에서는
+ * 단순 복사가 된다.
+ *
+ * @param dst 변환 결과를 저장할 슈퍼블록
+ * @param src 변환할 슈퍼블록
+ */
+static void sb_swab(struct sfuse_super *dst, const struct sfuse_super *src) {
+  dst->magic = le32toh(src->magic);
+  dst->rev_level = le32toh(src->rev_level);
+  dst->feature_compat = le32toh(src->feature_compat);
+  dst->feature_incompat = le32toh(src->feature_incompat);
+  dst->feature_ro_compat = le32toh(src->feature_ro_compat);
+  dst->block_size = le32toh(src->block_size);
+  dst->inode_size = le32toh(src->inode_size);
+  dst->inode_ratio = le32toh(src->inode_ratio);
+  dst->inodes_count = le32toh(src->inodes_count);
+  dst->free_inodes = le32toh(src->free_inodes);
+  dst->blocks_count = le64toh(src->blocks_count);
+  dst->free_blocks = le64toh(src->free_blocks);
+  dst->inode_bitmap_start = le64toh(src->inode_bitmap_start);
+  dst->block_bitmap_start = le64toh(src->block_bitmap_start);
+  dst->inode_table_start = le64toh(src->inode_table_start);
+  dst->journal_start = le64toh(src->journal_start);
+  dst->journal_blocks = le64toh(src->journal_blocks);
+  dst->data_block_start = le64toh(src->data_block_start);
+  dst->blocks_per_group = le64toh(src->blocks_per_group);
+  dst->groups_count = le32toh(src->groups_count);
+  dst->csum_blocks = le32toh(src->csum_blocks);
+  dst->summary_blocks = le32toh(src->summary_blocks);
+  dst->last_orphan = le32toh(src->last_orphan);
+  dst->refcount_start = le64toh(src->refcount_start);
+  dst->refcount_blocks = le32toh(src->refcount_blocks);
+  dst->dedup_index_blocks = le32toh(src->dedup_index_blocks);
+  dst->snap_table = le64toh(src->snap_table);
+  dst->snap_time = (int64_t)le64toh((uint64_t)src->snap_time);
+}
+
 /**
  * @brief 디스크에서 슈퍼블록을 읽어오는 함수
  *
  * 디스크의 정해진 위치에서 슈퍼블록을 읽어 메모리로 로드하고,
  * 읽은 데이터가 정상적인지 유효성을 검사한다. 유효성 검사는 읽은
- * 데이터 크기와 슈퍼블록 매직 넘버를 이용하여 수행된다.
+ * 데이터 크기, 슈퍼블록 매직 넘버, 포맷 버전과 기능 플래그를 이용하여
+ * 수행된다.
  *
  * @param fd 디바이스 파일 디스크립터 (열린 블록 디바이스 파일)
  * @param sb 읽어온 슈퍼블록을 저장할 구조체 포인터
  * @return 성공 시 0을 반환, 실패 시 음수 오류 코드 반환
  *         -EIO: 디스크에서 읽은 바이트 수가 요청한 크기와 일치하지 않음
  *         -EINVAL: 슈퍼블록의 매직 넘버가 예상 값과 다름 (슈퍼블록이
- * 손상되었거나 올바르지 않은 디바이스) 기타 음수 값: disk_read 함수 자체가
- * 반환한 오류 코드
+ * 손상되었거나 올바르지 않은 디바이스) 또는 지원하지 않는 블록 크기로
+ * 포맷됨.
+ *         -EPROTO: 지원하지 않는 온디스크 포맷 버전 (이전 버전 포맷 포함)
+ *         -EOPNOTSUPP: 이 빌드가 모르는 incompat/ro_compat 기능이 켜져 있음
+ *         기타 음수 값: disk_read 함수 자체가 반환한 오류 코드
  */
 int sb_load(int fd, struct sfuse_super *sb) {
   ssize_t ret;
+  struct sfuse_super raw;
 
-  // 슈퍼블록을 디스크(SFUSE_SUPERBLOCK_OFFSET)에서 읽어 메모리(sb)에 저장한다.
-  ret = disk_read(fd, sb, sizeof(*sb), SFUSE_SUPERBLOCK_OFFSET);
+  // 슈퍼블록을 디스크(SFUSE_SUPERBLOCK_OFFSET)에서 읽어 메모리(raw)에 저장한다.
+  ret = disk_read(fd, &raw, sizeof(raw), SFUSE_SUPERBLOCK_OFFSET);
 
   // disk_read가 실패하면 반환된 음수 오류 값을 그대로 반환한다.
   if (ret < 0)
     return ret;
 
   // 요청한 슈퍼블록 크기만큼 정확히 읽었는지 확인한다.
-  if ((size_t)ret != sizeof(*sb))
+  if ((size_t)ret != sizeof(raw))
     return -EIO; // 읽은 데이터 크기가 슈퍼블록 크기와 다름 (입출력 오류)
 
+  // 디스크의 리틀 엔디언 값을 호스트 바이트 순서로 변환한다.
+  sb_swab(sb, &raw);
+
   // 슈퍼블록의 매직 넘버를 검사하여 슈퍼블록 유효성 검사를 수행한다.
   if (sb->magic != SFUSE_MAGIC)
     return -EINVAL; // 잘못된 매직 넘버
 
+  // 온디스크 포맷 버전을 확인한다. 32비트 레이아웃의 이전 포맷은 이 위치에
+  // 아이노드 수가 기록되어 있으므로 여기서 걸러진다.
+  if (sb->rev_level != SFUSE_REV_LEVEL)
+    return -EPROTO;
+
+  // 이 빌드가 모르는 기능 플래그가 켜져 있으면 안전하게 마운트할 수 없다.
+  if ((sb->feature_incompat & ~SFUSE_FEATURE_INCOMPAT_SUPP) ||
+      (sb->feature_ro_compat & ~SFUSE_FEATURE_RO_COMPAT_SUPP))
+    return -EOPNOTSUPP;
+
+  // mkfs.sfuse가 기록한 블록 크기가 현재 빌드의 블록 크기와 같은지 확인한다.
+  if (sb->block_size != SFUSE_BLOCK_SIZE)
+    return -EINVAL; // 지원하지 않는 블록 크기
+
+  // 아이노드 레코드는 고정 필드를 모두 담을 수 있어야 하고 최대 크기(블록
+  // 경계 이내)를 넘지 않아야 한다.
+  if (sb->inode_size < SFUSE_INODE_CORE_SIZE ||
+      sb->inode_size > SFUSE_MAX_INODE_SIZE ||
+      (sb->inode_size & (sb->inode_size - 1)))
+    return -EINVAL;
+
+  // 체크섬 테이블은 저널과 데이터 영역 사이에서 장치 전체 블록을 다뤄야 한다.
+  if ((sb->feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_METADATA_CSUM) &&
+      ((uint64_t)sb->csum_blocks * SFUSE_CSUM_PER_BLOCK < sb->blocks_count ||
+       sb->journal_start + sb->journal_blocks + sb->csum_blocks >
+           sb->data_block_start))
+    return -EINVAL;
+
+  // 그룹 요약 테이블은 블록 비트맵과 아이노드 비트맵 사이에서 모든 그룹을
+  // 다뤄야 한다.
+  if ((sb->feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_GROUP_SUMMARY) &&
+      ((uint64_t)sb->summary_blocks * SFUSE_SUMMARY_PER_BLOCK <
+           sb->groups_count ||
+       sb->block_bitmap_start + sb->summary_blocks > sb->inode_bitmap_start))
+    return -EINVAL;
+
+  // 고아 목록의 첫 아이노드는 아이노드 범위 안이어야 한다.
+  if (sb->last_orphan >= sb->inodes_count)
+    return -EINVAL;
+
+  // 참조 수 테이블과 지문 색인은 데이터 영역 안에서 모든 데이터 블록을
+  // 다뤄야 한다.
+  if ((sb->feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_REFCOUNT) &&
+      (sb->refcount_start < sb->data_block_start ||
+       sb->dedup_index_blocks == 0 ||
+       (uint64_t)sb->refcount_blocks * SFUSE_REFCOUNT_PER_BLOCK <
+           sb->blocks_count - sb->data_block_start ||
+       sb->refcount_start + sb->refcount_blocks + sb->dedup_index_blocks >
+           sb->blocks_count))
+    return -EINVAL;
+
+  // 스냅숏 예외 테이블의 첫 블록은 데이터 영역 안이어야 한다.
+  if ((sb->feature_ro_compat & SFUSE_FEATURE_RO_COMPAT_SNAPSHOT) &&
+      (sb->snap_table < sb->data_block_start ||
+       sb->snap_table >= sb->blocks_count))
+    return -EINVAL;
+
   // 성공적으로 슈퍼블록을 읽고 유효성을 확인했으므로 0 반환.
   return 0;
 }
 
+/** @brief 여러 스레드(요청 처리, 고아 회수)의 슈퍼블록 기록을 직렬화 */
+static pthread_mutex_t sb_sync_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /**
  * @brief 슈퍼블록 구조체를 디스크에 쓰기(동기화)하는 함수
  *
- * 메모리 상의 슈퍼블록 구조체의 내용을 디스크의 지정된 위치에 기록하여,
- * 파일 시스템의 메타데이터를 영구적으로 저장한다.
+ * 메모리 상의 슈퍼블록 구조체의 내용을 리틀 엔디언으로 변환하여 디스크의
+ * 지정된 위치에 기록하여, 파일 시스템의 메타데이터를 영구적으로 저장한다.
+ * 체크섬 테이블과 슈퍼블록 기록이 스레드 사이에 섞이지 않도록 잠금 안에서
+ * 기록한다.
  *
  * @param fd 디바이스 파일 디스크립터
  * @param sb 디스크에 기록할 슈퍼블록 구조체의 포인터
@@ -62,16 +179,32 @@ int sb_load(int fd, struct sfuse_super *sb) {
  */
 int sb_sync(int fd, const struct sfuse_super *sb) {
   ssize_t ret;
+  struct sfuse_super raw;
+
+  pthread_mutex_lock(&sb_sync_lock);
+
+  // 슈퍼블록이 가리키는 참조 수 테이블과 체크섬 테이블을 먼저 기록한다.
+  int res = dedup_sync(fd);
+  if (res == 0)
+    res = csum_sync(fd);
+  if (res < 0) {
+    pthread_mutex_unlock(&sb_sync_lock);
+    return res;
+  }
+
+  // 호스트 바이트 순서를 디스크의 리틀 엔디언으로 변환
+  sb_swab(&raw, sb);
 
   // 슈퍼블록 내용을 디스크(SFUSE_SUPERBLOCK_OFFSET)에 기록
-  ret = disk_write(fd, sb, sizeof(*sb), SFUSE_SUPERBLOCK_OFFSET);
+  ret = disk_write(fd, &raw, sizeof(raw), SFUSE_SUPERBLOCK_OFFSET);
+  pthread_mutex_unlock(&sb_sync_lock);
 
   // 쓰기 실패 시, disk_write 함수가 반환한 음수 오류 코드를 반환
   if (ret < 0)
     return ret;
 
   // 요청한 슈퍼블록 크기만큼 정확히 기록되었는지 확인
-  if ((size_t)ret != sizeof(*sb))
+  if ((size_t)ret != sizeof(raw))
     return -EIO;
 
   // 정상적으로 슈퍼블록이 디스크에 저장됨
@@ -79,22 +212,143 @@ int sb_sync(int fd, const struct sfuse_super *sb) {
 }
 
 /**
- * @brief 슈퍼블록 구조체를 기본값으로 초기화(포맷)하는 함수
+ * @brief 장치 크기와 구성 값으로 슈퍼블록의 레이아웃을 계산하는 함수
+ *
+ * 이 함수는 파일 시스템을 처음 생성할 때(mkfs.sfuse) 호출되며, 장치의 전체 블록
+ * 수와 mkfs 옵션(inode ratio, 저널 크기, 할당 그룹 수)을 바탕으로 각
+ * 메타데이터 영역의 위치와 크기를 계산하여 슈퍼블록에 기록한다.
  *
- * 이 함수는 파일 시스템을 처음 생성할 때 호출되며,
- * 슈퍼블록 구조체에 초기 설정값을 채워서 파일 시스템의 메타데이터를 초기화한다.
+ * 레이아웃 계산 순서:
+ *   1. 아이노드 수 = 장치 바이트 수 ÷ inode ratio (8의 배수로 올림)
+ *   2. 블록 비트맵 → 그룹 요약 테이블 → 아이노드 비트맵 → 아이노드 테이블
+ *      → 저널 → 체크섬 테이블 순으로 배치
+ *   3. 남은 데이터 영역을 groups_count개의 할당 그룹으로 나눔
  *
- * @param sb 초기화할 슈퍼블록 구조체의 포인터
+ * 그룹 요약 테이블의 크기는 그룹 수에 달려 있고 그룹 수는 데이터 영역 크기에
+ * 달려 있으므로, 처음에는 장치 전체를 데이터 영역으로 보고 그룹 수의 상한으로
+ * 테이블 크기를 정한다. (그룹 수가 실제보다 많게 잡힐 뿐이므로 안전하다)
+ *
+ * @param sb           초기화할 슈퍼블록 구조체의 포인터
+ * @param total_blocks 장치 전체 블록 수
+ * @param geo          mkfs 구성 값 (NULL이면 모두 기본값)
+ * @return 성공 시 0, 실패 시 음수 오류 코드 반환
+ *         -EINVAL: 지원하지 않는 블록 크기이거나 장치가 메타데이터보다 작음
  */
-void sb_format(struct sfuse_super *sb) {
+int sb_format(struct sfuse_super *sb, uint64_t total_blocks,
+              const struct sfuse_geometry *geo) {
+  struct sfuse_geometry def = {0};
+  if (!geo)
+    geo = &def;
+
+  // 입출력 경로가 SFUSE_BLOCK_SIZE로 컴파일되어 있으므로 다른 크기는 거부
+  uint32_t block_size = geo->block_size ? geo->block_size : SFUSE_BLOCK_SIZE;
+  if (block_size != SFUSE_BLOCK_SIZE)
+    return -EINVAL;
+
+  // 아이노드 레코드 크기: 고정 필드를 담는 2의 거듭제곱이어야 한다.
+  // 고정 필드 뒤의 남는 공간은 인라인 데이터 영역으로 쓰인다.
+  uint32_t inode_size =
+      geo->inode_size ? geo->inode_size : SFUSE_DEFAULT_INODE_SIZE;
+  if (inode_size < SFUSE_INODE_CORE_SIZE ||
+      inode_size > SFUSE_MAX_INODE_SIZE || (inode_size & (inode_size - 1)))
+    return -EINVAL;
+
   memset(sb, 0, sizeof(*sb));
   sb->magic = SFUSE_MAGIC;
-  sb->inodes_count = SFUSE_INODES_COUNT;
-  sb->blocks_count = SFUSE_BLOCKS_COUNT;
+  sb->rev_level = SFUSE_REV_LEVEL;
+  sb->feature_incompat =
+      SFUSE_FEATURE_INCOMPAT_64BIT | SFUSE_FEATURE_INCOMPAT_UNWRITTEN;
+  if (!geo->no_inline)
+    sb->feature_incompat |= SFUSE_FEATURE_INCOMPAT_INLINE_DATA;
+  sb->block_size = block_size;
+  sb->inode_size = inode_size;
+  sb->blocks_count = total_blocks;
+  sb->inode_ratio =
+      geo->inode_ratio ? geo->inode_ratio : SFUSE_DEFAULT_INODE_RATIO;
+
+  // 아이노드 수: 직접 지정하지 않았다면 장치 크기를 inode ratio로 나눈다.
+  // 비트맵을 바이트 단위로 다루므로 8의 배수로 올림한다.
+  uint64_t inodes = geo->inodes_count;
+  if (!inodes)
+    inodes = (uint64_t)total_blocks * SFUSE_BLOCK_SIZE / sb->inode_ratio;
+  if (inodes < SFUSE_MIN_INODES)
+    inodes = SFUSE_MIN_INODES;
+  inodes = (inodes + 7) & ~(uint64_t)7;
+  if (inodes > UINT32_MAX - 7)
+    return -EINVAL;
+  sb->inodes_count = (uint32_t)inodes;
+
+  // 각 메타데이터 영역이 차지하는 블록 수 (올림)
+  uint64_t block_bitmap_blocks =
+      (total_blocks / 8 + SFUSE_BLOCK_SIZE - 1) / SFUSE_BLOCK_SIZE;
+  uint64_t inode_bitmap_blocks =
+      (sb->inodes_count / 8 + SFUSE_BLOCK_SIZE - 1) / SFUSE_BLOCK_SIZE;
+  uint64_t inode_table_blocks =
+      ((uint64_t)sb->inodes_count * sb->inode_size + SFUSE_BLOCK_SIZE - 1) /
+      SFUSE_BLOCK_SIZE;
+
+  // 그룹 요약 테이블: 그룹 수의 상한(장치 전체를 데이터 영역으로 볼 때)으로
+  // 크기를 정한다.
+  uint64_t max_groups =
+      geo->groups_count
+          ? geo->groups_count
+          : (total_blocks + SFUSE_DEFAULT_BLOCKS_PER_GROUP - 1) /
+                SFUSE_DEFAULT_BLOCKS_PER_GROUP;
+  uint64_t summary_blocks =
+      (max_groups + SFUSE_SUMMARY_PER_BLOCK - 1) / SFUSE_SUMMARY_PER_BLOCK;
+
+  // 블록 비트맵 → 그룹 요약 테이블 → 아이노드 비트맵 → 아이노드 테이블 → 저널
+  // → 체크섬 테이블 → 데이터 순서
+  uint64_t next = SFUSE_BLOCK_BITMAP_BLOCK;
+  sb->block_bitmap_start = next;
+  next += block_bitmap_blocks;
+  sb->summary_blocks = (uint32_t)summary_blocks;
+  sb->feature_ro_compat |= SFUSE_FEATURE_RO_COMPAT_GROUP_SUMMARY;
+  next += summary_blocks;
+  sb->inode_bitmap_start = next;
+  next += inode_bitmap_blocks;
+  sb->inode_table_start = next;
+  next += inode_table_blocks;
+  sb->journal_start = next;
+  sb->journal_blocks = geo->journal_blocks;
+  next += geo->journal_blocks;
+
+  // 체크섬 테이블: 블록 하나당 4바이트
+  if (!geo->no_csum) {
+    uint64_t csum_blocks =
+        (total_blocks + SFUSE_CSUM_PER_BLOCK - 1) / SFUSE_CSUM_PER_BLOCK;
+    if (csum_blocks > UINT32_MAX)
+      return -EINVAL;
+    sb->csum_blocks = (uint32_t)csum_blocks;
+    sb->feature_ro_compat |= SFUSE_FEATURE_RO_COMPAT_METADATA_CSUM;
+    if (geo->data_csum)
+      sb->feature_ro_compat |= SFUSE_FEATURE_RO_COMPAT_DATA_CSUM;
+    next += csum_blocks;
+  }
+
+  // 메타데이터 뒤에 데이터 블록이 최소 하나(루트 디렉터리)는 있어야 한다.
+  if (next >= total_blocks)
+    return -EINVAL;
+  sb->data_block_start = next;
+
+  // 데이터 영역을 할당 그룹으로 분할 (그룹 크기는 비트맵 바이트 경계에 맞춤)
+  uint64_t data_blocks = total_blocks - sb->data_block_start;
+  uint64_t groups = geo->groups_count;
+  if (!groups)
+    groups = (data_blocks + SFUSE_DEFAULT_BLOCKS_PER_GROUP - 1) /
+             SFUSE_DEFAULT_BLOCKS_PER_GROUP;
+  if (groups == 0 || groups > data_blocks)
+    return -EINVAL;
+  uint64_t per_group = (data_blocks + groups - 1) / groups;
+  per_group = (per_group + 7) & ~(uint64_t)7;
+  groups = (data_blocks + per_group - 1) / per_group;
+  if (groups > UINT32_MAX)
+    return -EINVAL;
+  sb->blocks_per_group = per_group;
+  sb->groups_count = (uint32_t)groups;
+
+  // 아이노드 0번은 예약되어 있으므로 사용 가능한 아이노드에서 제외
   sb->free_inodes = sb->inodes_count - 1;
-  sb->free_blocks = sb->blocks_count - SFUSE_DATA_BLOCK_START;
-  sb->inode_bitmap_start = SFUSE_INODE_BITMAP_BLOCK;
-  sb->block_bitmap_start = SFUSE_BLOCK_BITMAP_BLOCK;
-  sb->inode_table_start = SFUSE_INODE_TABLE_BLOCK;
-  sb->data_block_start = SFUSE_DATA_BLOCK_START;
+  sb->free_blocks = data_blocks;
+  return 0;
 }
@@ -0,0 +1,559 @@
+/**
+ * @file tools/bench.c
+ * @brief FUSE 없이 저장 코어를 직접 측정하는 마이크로벤치마크(sfuse_bench)
+ *
+ * fio 결과에는 커널 FUSE 전송 비용이 섞여 있고 root 권한과 블록 장치가
+ * 필요하다. sfuse_bench는 비트맵, 디렉터리, 아이노드, 블록 입출력, 지연 할당
+ * 모듈을 이미지 파일이나 메모리(memfd) 위에 포맷한 파일 시스템에 직접 호출하여
+ * 다음 항목의 초당 처리량을 측정하고 JSON으로 출력한다.
+ *
+ *   - 블록/아이노드 할당·해제, 경로 탐색, 디렉터리 항목 추가·삭제
+ *   - 메타데이터 연산 (생성 + stat + 삭제)
+ *   - 순차/랜덤 읽기·쓰기
+ *
+ * 결과의 label 필드(-l)에 커밋 해시 등을 넣어 두면 커밋 사이의 결과를 비교할
+ * 수 있다.
+ */
+
+#define _GNU_SOURCE // memfd_create
+#include "bitmap.h"
+#include "block.h"
+#include "csum.h"
+#include "dalloc.h"
+#include "dir.h"
+#include "disk.h"
+#include "format.h"
+#include "fs.h"
+#include "inode.h"
+#include "stats.h"
+#include "super.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** @brief 기본 장치 크기 (MB) */
+#define BENCH_DEFAULT_DEV_MB 256
+
+/** @brief 기본 입출력 측정 파일 크기 (MB) */
+#define BENCH_DEFAULT_FILE_MB 64
+
+/** @brief 기본 반복 횟수 */
+#define BENCH_DEFAULT_ITERS 10000
+
+/** @brief 경로 탐색 측정용 디렉터리 깊이 */
+#define BENCH_PATH_DEPTH 8
+
+/** @brief 순차 입출력 단위 (블록 수, 1MiB) */
+#define BENCH_SEQ_BLOCKS 256
+
+/**
+ * @struct bench_ctx
+ * @brief 벤치마크 실행 상태
+ */
+struct bench_ctx {
+  struct sfuse_fs fs; /**< 측정 대상 파일 시스템 */
+  uint32_t iters;     /**< 반복 횟수 */
+  uint64_t file_mb;   /**< 입출력 측정 파일 크기 (MB) */
+  uint32_t file_ino;  /**< 입출력 측정 파일의 아이노드 */
+  uint64_t rng;       /**< 랜덤 입출력 위치용 xorshift 상태 */
+  int nresults;       /**< 지금까지 출력한 결과 수 */
+};
+
+/**
+ * @struct bench_run
+ * @brief 측정 구간 하나의 시작 상태
+ */
+struct bench_run {
+  uint64_t start_ns;                 /**< 시작 시각 */
+  struct sfuse_stats_snapshot stats; /**< 시작 시점의 장치 입출력 통계 */
+};
+
+/**
+ * @brief 사용법을 출력한다.
+ *
+ * @param prog 프로그램 이름 (argv[0])
+ * @param out  출력 스트림
+ */
+static void usage(const char *prog, FILE *out) {
+  fprintf(out,
+          "사용법 : %s [options] [image]\n"
+          "(사용예: %s -l $(git rev-parse --short HEAD) > result.json)\n"
+          "\nimage를 지정하면 그 파일을, 생략하면 메모리(memfd)를 장치로 "
+          "사용한다.\n"
+          "어느 경우든 측정 전에 새로 포맷하므로 image의 내용은 지워진다.\n"
+          "\n옵션들:\n"
+          "  -m MB   : 메모리 장치 크기 (기본값 %d)\n"
+          "  -s MB   : 순차/랜덤 입출력 파일 크기 (기본값 %d)\n"
+          "  -n COUNT: 메타데이터 측정 반복 횟수 (기본값 %d)\n"
+          "  -l LABEL: 결과에 기록할 이름 (예: 커밋 해시)\n"
+          "  -h      : 도움말 출력\n",
+          prog, prog, BENCH_DEFAULT_DEV_MB, BENCH_DEFAULT_FILE_MB,
+          BENCH_DEFAULT_ITERS);
+}
+
+/**
+ * @brief 양의 정수 옵션 값을 파싱한다.
+ *
+ * @param arg 옵션 문자열
+ * @param out 파싱 결과를 저장할 포인터
+ * @return 성공 시 0, 형식이 잘못되었으면 -1
+ */
+static int parse_u32(const char *arg, uint32_t *out) {
+  char *end;
+  errno = 0;
+  unsigned long long v = strtoull(arg, &end, 0);
+  if (errno || *end != '\0' || v == 0 || v > UINT32_MAX)
+    return -1;
+  *out = (uint32_t)v;
+  return 0;
+}
+
+/**
+ * @brief 재현 가능한 의사 난수 (xorshift64)
+ */
+static uint64_t bench_rand(struct bench_ctx *b) {
+  b->rng ^= b->rng << 13;
+  b->rng ^= b->rng >> 7;
+  b->rng ^= b->rng << 17;
+  return b->rng;
+}
+
+/**
+ * @brief 측정 구간을 시작한다.
+ */
+static void bench_begin(struct bench_run *run) {
+  stats_snapshot(&run->stats);
+  run->start_ns = stats_now();
+}
+
+/**
+ * @brief 측정 구간을 끝내고 결과 하나를 JSON 객체로 출력한다.
+ *
+ * @param b     벤치마크 상태
+ * @param run   bench_begin()으로 시작한 구간
+ * @param name  측정 항목 이름
+ * @param ops   구간 동안 수행한 연산 수
+ * @param bytes 구간 동안 처리한 데이터 바이트 수 (입출력 측정이 아니면 0)
+ */
+static void bench_end(struct bench_ctx *b, struct bench_run *run,
+                      const char *name, uint64_t ops, uint64_t bytes) {
+  double sec = (double)(stats_now() - run->start_ns) / 1e9;
+  static struct sfuse_stats_snapshot now;
+  stats_snapshot(&now);
+  stats_subtract(&now, &run->stats);
+  const struct sfuse_op_stats *rd = &now.op[SFUSE_OP_DISK_READ];
+  const struct sfuse_op_stats *wr = &now.op[SFUSE_OP_DISK_WRITE];
+
+  printf("%s    {\"name\": \"%s\", \"ops\": %" PRIu64 ", \"seconds\": %.6f, "
+         "\"ops_per_sec\": %.1f, \"mb_per_sec\": %.1f, "
+         "\"disk_reads\": %" PRIu64 ", \"disk_read_bytes\": %" PRIu64 ", "
+         "\"disk_writes\": %" PRIu64 ", \"disk_write_bytes\": %" PRIu64 "}",
+         b->nresults++ ? ",\n" : "", name, ops, sec,
+         sec > 0 ? (double)ops / sec : 0.0,
+         sec > 0 ? (double)bytes / sec / (1024 * 1024) : 0.0, rd->count,
+         rd->bytes, wr->count, wr->bytes);
+  fflush(stdout);
+}
+
+/**
+ * @brief 벤치마크 장치를 준비하고 포맷한다.
+ *
+ * @param image 이미지 파일 경로 (NULL이면 memfd)
+ * @param dev_mb memfd 장치 크기 (MB)
+ * @return 성공 시 파일 디스크립터, 실패 시 음수 오류 코드
+ */
+static int bench_open_device(const char *image, uint32_t dev_mb) {
+  int fd;
+  off_t bytes;
+  if (image) {
+    fd = open(image, O_RDWR);
+    if (fd < 0)
+      return -errno;
+    bytes = lseek(fd, 0, SEEK_END);
+  } else {
+    fd = memfd_create("sfuse_bench", 0);
+    if (fd < 0)
+      return -errno;
+    bytes = (off_t)dev_mb * 1024 * 1024;
+    if (ftruncate(fd, bytes) < 0) {
+      int err = -errno;
+      close(fd);
+      return err;
+    }
+  }
+
+  int res = bytes > 0 ? fs_format(fd, (uint64_t)bytes, NULL, getuid(),
+                                  getgid(), NULL)
+                      : -EINVAL;
+  if (res < 0) {
+    close(fd);
+    return res;
+  }
+  return fd;
+}
+
+/**
+ * @brief 포맷한 장치를 마운트 없이 불러온다. (fs_initialize()와 같은 과정)
+ */
+static int bench_mount(struct sfuse_fs *fs, int fd) {
+  memset(fs, 0, sizeof(*fs));
+  fs->backing_fd = fd;
+  int res = sb_load(fd, &fs->sb);
+  if (res < 0)
+    return res;
+  fs->block_map = calloc(1, fs->sb.blocks_count / 8);
+  fs->inode_map = calloc(1, fs->sb.inodes_count / 8);
+  if (!fs->block_map || !fs->inode_map)
+    return -ENOMEM;
+  res = csum_init(fd, &fs->sb, true);
+  if (res == 0)
+    res = bitmap_groups_init(fd, &fs->sb, fs->block_map);
+  if (res == 0)
+    res = bitmap_load(fd, fs->sb.inode_bitmap_start, fs->inode_map,
+                      fs->sb.inodes_count / 8);
+  if (res == 0)
+    res = dalloc_init(&fs->dalloc);
+  pthread_mutex_init(&fs->sync.lock, NULL);
+  pthread_cond_init(&fs->sync.done, NULL);
+  if (res == 0)
+    orphan_init(fs);
+  return res;
+}
+
+/**
+ * @brief 부모 디렉터리에 새 아이노드를 만들어 연결한다.
+ *
+ * 디렉터리이면 dir_blocks개의 직접 블록을 미리 할당하여 항목을 그만큼 담을
+ * 수 있게 한다. (dir_add_entry()는 기존 블록의 빈 슬롯만 사용한다)
+ *
+ * @return 성공 시 0, 실패 시 음수 오류 코드
+ */
+static int bench_create(struct sfuse_fs *fs, uint32_t parent, const char *name,
+                        mode_t mode, int dir_blocks, uint32_t *ino_out) {
+  int ino = alloc_inode(&fs->sb, fs->inode_map);
+  if (ino < 0)
+    return ino;
+
+  struct sfuse_inode inode;
+  fs_init_inode(&fs->sb, (uint32_t)ino, mode, getuid(), getgid(), &inode);
+  if (S_ISDIR(mode)) {
+    uint8_t block[SFUSE_BLOCK_SIZE] = {0};
+    struct sfuse_dirent *ents = (struct sfuse_dirent *)block;
+    ents[0].ino = (uint32_t)ino;
+    strcpy(ents[0].name, ".");
+    ents[1].ino = parent;
+    strcpy(ents[1].name, "..");
+    for (int i = 0; i < dir_blocks && i < SFUSE_NDIR_BLOCKS; i++) {
+      int64_t idx = alloc_block(&fs->sb, fs->block_map);
+      if (idx < 0)
+        return (int)idx;
+      inode.direct[i] = fs->sb.data_block_start + (uint64_t)idx;
+      if (write_block(fs->backing_fd, inode.direct[i], block) < 0)
+        return -EIO;
+      memset(block, 0, sizeof(block));
+      inode.size += SFUSE_BLOCK_SIZE;
+    }
+  }
+
+  int res = inode_sync(fs->backing_fd, &fs->sb, (uint32_t)ino, &inode);
+  if (res == 0)
+    res = dir_add_entry(fs->backing_fd, &fs->sb, parent, name, (uint32_t)ino,
+                        fs->block_map, fs->inode_map, &fs->sb);
+  if (res < 0)
+    return res;
+  *ino_out = (uint32_t)ino;
+  return 0;
+}
+
+/**
+ * @brief 블록 할당·해제와 아이노드 할당·해제 속도를 측정한다.
+ */
+static int bench_alloc(struct bench_ctx *b) {
+  struct sfuse_fs *fs = &b->fs;
+  uint64_t n = b->iters;
+  if (n > fs->sb.free_blocks / 2)
+    n = fs->sb.free_blocks / 2;
+  int64_t *idx = malloc(n * sizeof(*idx));
+  if (!idx)
+    return -ENOMEM;
+
+  struct bench_run run;
+  bench_begin(&run);
+  for (uint64_t i = 0; i < n; i++)
+    idx[i] = alloc_block(&fs->sb, fs->block_map);
+  for (uint64_t i = 0; i < n; i++)
+    if (idx[i] >= 0)
+      free_block(&fs->sb, fs->block_map, (uint64_t)idx[i]);
+  bench_end(b, &run, "block_alloc_free", 2 * n, 0);
+
+  uint64_t m = b->iters;
+  if (m > fs->sb.free_inodes)
+    m = fs->sb.free_inodes;
+  bench_begin(&run);
+  for (uint64_t i = 0; i < m; i++)
+    idx[i] = alloc_inode(&fs->sb, fs->inode_map);
+  for (uint64_t i = 0; i < m; i++)
+    if (idx[i] > 0)
+      free_inode(&fs->sb, fs->inode_map, (uint32_t)idx[i]);
+  bench_end(b, &run, "inode_alloc_free", 2 * m, 0);
+
+  free(idx);
+  return 0;
+}
+
+/**
+ * @brief 경로 탐색, 디렉터리 항목 추가·삭제, 생성+stat+삭제 속도를 측정한다.
+ */
+static int bench_meta(struct bench_ctx *b) {
+  struct sfuse_fs *fs = &b->fs;
+  struct bench_run run;
+  char path[256] = "";
+  uint32_t parent = SFUSE_ROOT_INO, ino;
+  int res;
+
+  /* [1단계] 깊이 BENCH_PATH_DEPTH의 경로 탐색 */
+  for (int d = 0; d < BENCH_PATH_DEPTH; d++) {
+    char name[16];
+    snprintf(name, sizeof(name), "d%d", d);
+    res = bench_create(fs, parent, name, S_IFDIR | 0755, 1, &parent);
+    if (res < 0)
+      return res;
+    strcat(path, "/");
+    strcat(path, name);
+  }
+  strcat(path, "/leaf");
+  res = bench_create(fs, parent, "leaf", S_IFREG | 0644, 0, &ino);
+  if (res < 0)
+    return res;
+
+  bench_begin(&run);
+  for (uint32_t i = 0; i < b->iters; i++)
+    if (fs_resolve_path(fs, path, &ino) < 0)
+      return -ENOENT;
+  bench_end(b, &run, "path_resolve", b->iters, 0);
+
+  /* [2단계] 직접 블록을 모두 가진 디렉터리에 항목 추가·삭제 */
+  uint32_t dir;
+  res = bench_create(fs, SFUSE_ROOT_INO, "dir", S_IFDIR | 0755,
+                     SFUSE_NDIR_BLOCKS, &dir);
+  if (res < 0)
+    return res;
+  uint32_t per_round = SFUSE_NDIR_BLOCKS *
+                           (SFUSE_BLOCK_SIZE / sizeof(struct sfuse_dirent)) -
+                       2;
+  uint64_t ops = 0;
+  bench_begin(&run);
+  while (ops < b->iters) {
+    char name[32];
+    for (uint32_t i = 0; i < per_round; i++) {
+      snprintf(name, sizeof(name), "e%u", i);
+      if ((res = dir_add_entry(fs->backing_fd, &fs->sb, dir, name, ino,
+                               fs->block_map, fs->inode_map, &fs->sb)) < 0)
+        return res;
+    }
+    for (uint32_t i = 0; i < per_round; i++) {
+      snprintf(name, sizeof(name), "e%u", i);
+      if ((res = dir_remove_entry(fs->backing_fd, &fs->sb, dir, name)) < 0)
+        return res;
+    }
+    ops += 2 * per_round;
+  }
+  bench_end(b, &run, "dir_add_remove", ops, 0);
+
+  /* [3단계] 파일 생성 + stat + 삭제 */
+  bench_begin(&run);
+  for (uint32_t i = 0; i < b->iters; i++) {
+    struct sfuse_inode inode;
+    if ((res = bench_create(fs, dir, "tmp", S_IFREG | 0644, 0, &ino)) < 0 ||
+        (res = inode_load(fs->backing_fd, &fs->sb, ino, &inode)) < 0 ||
+        (res = dir_remove_entry(fs->backing_fd, &fs->sb, dir, "tmp")) < 0)
+      return res;
+    free_inode(&fs->sb, fs->inode_map, ino);
+  }
+  bench_end(b, &run, "create_stat_unlink", b->iters, 0);
+  return 0;
+}
+
+/**
+ * @brief 순차/랜덤 읽기·쓰기 속도를 측정한다.
+ *
+ * 순차 쓰기는 실제 쓰기 경로처럼 지연 할당 버퍼를 거쳐 연속 할당되고, 랜덤
+ * 쓰기는 이미 할당된 블록을 제자리에서 덮어쓴다.
+ */
+static int bench_io(struct bench_ctx *b) {
+  struct sfuse_fs *fs = &b->fs;
+  int fd = fs->backing_fd;
+  uint64_t nblocks = b->file_mb * 1024 * 1024 / SFUSE_BLOCK_SIZE;
+  uint8_t *buf = malloc((size_t)BENCH_SEQ_BLOCKS * SFUSE_BLOCK_SIZE);
+  uint8_t tmp[SFUSE_BLOCK_SIZE];
+  struct sfuse_inode inode;
+  struct bench_run run;
+  int res;
+
+  if (!buf)
+    return -ENOMEM;
+  memset(buf, 0xA5, (size_t)BENCH_SEQ_BLOCKS * SFUSE_BLOCK_SIZE);
+  res = bench_create(fs, SFUSE_ROOT_INO, "data", S_IFREG | 0644, 0,
+                     &b->file_ino);
+  // 인라인으로 시작한 파일을 블록 방식으로 전환 (쓰기 경로와 같은 처리)
+  if (res == 0 && (res = inode_load(fd, &fs->sb, b->file_ino, &inode)) == 0 &&
+      inode_is_inline(&inode) &&
+      (res = inode_inline_migrate(fd, &fs->sb, fs->block_map, &inode)) == 0)
+    res = inode_sync(fd, &fs->sb, b->file_ino, &inode);
+  if (res < 0)
+    goto out;
+
+  /* [1단계] 순차 쓰기 (지연 할당 → 연속 할당 기록) */
+  bench_begin(&run);
+  for (uint64_t lbn = 0; lbn < nblocks; lbn++) {
+    if (lbn % BENCH_SEQ_BLOCKS == 0)
+      dalloc_writeback(fs);
+    res = dalloc_write(fs, b->file_ino, lbn, 0, buf, SFUSE_BLOCK_SIZE, true);
+    if (res < 0)
+      goto out;
+  }
+  if ((res = inode_load(fd, &fs->sb, b->file_ino, &inode)) < 0)
+    goto out;
+  inode.size = nblocks * SFUSE_BLOCK_SIZE;
+  if ((res = inode_sync(fd, &fs->sb, b->file_ino, &inode)) < 0 ||
+      (res = dalloc_flush_inode(fs, b->file_ino)) < 0 ||
+      (res = inode_load(fd, &fs->sb, b->file_ino, &inode)) < 0)
+    goto out;
+  bench_end(b, &run, "seq_write", nblocks, nblocks * SFUSE_BLOCK_SIZE);
+
+  /* [2단계] 순차 읽기 (물리적으로 이어진 블록을 모아 1MiB 단위로) */
+  bench_begin(&run);
+  for (uint64_t lbn = 0; lbn < nblocks;) {
+    uint64_t first, pbn, n = 0;
+    if ((res = logical_to_physical(fd, &fs->sb, &inode, lbn, tmp, &first)) <
+        0)
+      goto out;
+    while (n < BENCH_SEQ_BLOCKS && lbn + n < nblocks &&
+           logical_to_physical(fd, &fs->sb, &inode, lbn + n, tmp, &pbn) == 0 &&
+           pbn == first + n)
+      n++;
+    if (n == 0)
+      n = 1;
+    if (disk_read(fd, buf, n * SFUSE_BLOCK_SIZE,
+                  (off_t)(first * SFUSE_BLOCK_SIZE)) < 0) {
+      res = -EIO;
+      goto out;
+    }
+    lbn += n;
+  }
+  bench_end(b, &run, "seq_read", nblocks, nblocks * SFUSE_BLOCK_SIZE);
+
+  /* [3단계] 4KiB 랜덤 덮어쓰기 */
+  bench_begin(&run);
+  for (uint32_t i = 0; i < b->iters; i++) {
+    uint64_t pbn, lbn = bench_rand(b) % nblocks;
+    if ((res = logical_to_physical(fd, &fs->sb, &inode, lbn, tmp, &pbn)) < 0 ||
+        (res = write_block(fd, pbn, buf)) < 0)
+      goto out;
+  }
+  bench_end(b, &run, "rand_write", b->iters,
+            (uint64_t)b->iters * SFUSE_BLOCK_SIZE);
+
+  /* [4단계] 4KiB 랜덤 읽기 */
+  bench_begin(&run);
+  for (uint32_t i = 0; i < b->iters; i++) {
+    uint64_t pbn, lbn = bench_rand(b) % nblocks;
+    if ((res = logical_to_physical(fd, &fs->sb, &inode, lbn, tmp, &pbn)) < 0 ||
+        (res = read_block(fd, pbn, buf)) < 0)
+      goto out;
+  }
+  bench_end(b, &run, "rand_read", b->iters,
+            (uint64_t)b->iters * SFUSE_BLOCK_SIZE);
+  res = 0;
+
+out:
+  free(buf);
+  return res;
+}
+
+/**
+ * @brief 프로그램 메인 함수
+ *
+ * @param argc 명령줄 인자의 개수
+ * @param argv 명령줄 인자 배열
+ * @return 성공 시 EXIT_SUCCESS, 실패 시 EXIT_FAILURE
+ */
+int main(int argc, char *argv[]) {
+  static struct bench_ctx b;
+  uint32_t dev_mb = BENCH_DEFAULT_DEV_MB;
+  uint32_t file_mb = BENCH_DEFAULT_FILE_MB;
+  const char *label = "";
+  int opt;
+
+  b.iters = BENCH_DEFAULT_ITERS;
+  b.rng = 0x9E3779B97F4A7C15ULL;
+  while ((opt = getopt(argc, argv, "m:s:n:l:h")) != -1) {
+    uint32_t *dst = NULL;
+    switch (opt) {
+    case 'm':
+      dst = &dev_mb;
+      break;
+    case 's':
+      dst = &file_mb;
+      break;
+    case 'n':
+      dst = &b.iters;
+      break;
+    case 'l':
+      label = optarg;
+      continue;
+    case 'h':
+      usage(argv[0], stdout);
+      return EXIT_SUCCESS;
+    default:
+      usage(argv[0], stderr);
+      return EXIT_FAILURE;
+    }
+    if (parse_u32(optarg, dst) < 0) {
+      fprintf(stderr, "잘못된 옵션 값: -%c %s\n", opt, optarg);
+      return EXIT_FAILURE;
+    }
+  }
+  if (optind < argc - 1) {
+    usage(argv[0], stderr);
+    return EXIT_FAILURE;
+  }
+  const char *image = optind < argc ? argv[optind] : NULL;
+  b.file_mb = file_mb;
+
+  int fd = bench_open_device(image, dev_mb);
+  int res = fd < 0 ? fd : bench_mount(&b.fs, fd);
+  if (res < 0) {
+    fprintf(stderr, "장치 준비 실패: %s\n", strerror(-res));
+    return EXIT_FAILURE;
+  }
+  if (b.file_mb * 1024 * 1024 / SFUSE_BLOCK_SIZE >= b.fs.sb.free_blocks / 2) {
+    fprintf(stderr, "장치가 너무 작습니다. (-s는 장치의 절반 미만)\n");
+    return EXIT_FAILURE;
+  }
+
+  printf("{\n  \"label\": \"%s\",\n  \"backend\": \"%s\",\n"
+         "  \"device_mb\": %" PRIu64 ",\n  \"file_mb\": %" PRIu64 ",\n"
+         "  \"iterations\": %u,\n  \"results\": [\n",
+         label, image ? "image" : "memory",
+         b.fs.sb.blocks_count * SFUSE_BLOCK_SIZE / (1024 * 1024), b.file_mb,
+         b.iters);
+
+  if ((res = bench_alloc(&b)) == 0 && (res = bench_meta(&b)) == 0)
+    res = bench_io(&b);
+  printf("\n  ]\n}\n");
+
+  fs_destroy(&b.fs);
+  close(fd);
+  if (res < 0) {
+    fprintf(stderr, "측정 실패: %s\n", strerror(-res));
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+/**
+ * @file tools/fsck.c
+ * @brief SFUSE 파일 시스템 검사 도구(fsck.sfuse)의 메인 진입점
+ *
+ * 마운트되지 않은 장치나 이미지 파일을 검사하고, -y를 주면 찾은 문제를 고친다.
+ * 종료 코드는 e2fsck와 같다. (0: 문제 없음, 1: 모두 고침, 4: 남은 문제, 8: 실행
+ * 오류)
+ */
+
+#include "fsck.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/** @brief 종료 코드 */
+enum {
+  FSCK_EXIT_OK = 0,        /**< 문제 없음 */
+  FSCK_EXIT_FIXED = 1,     /**< 찾은 문제를 모두 고침 */
+  FSCK_EXIT_UNCORRECTED = 4, /**< 고치지 않은 문제가 남음 */
+  FSCK_EXIT_ERROR = 8,     /**< 실행 오류 */
+};
+
+/**
+ * @brief 사용법을 출력한다.
+ *
+ * @param prog 프로그램 이름 (argv[0])
+ * @param out  출력 스트림
+ */
+static void usage(const char *prog, FILE *out) {
+  fprintf(out,
+          "사용법 : %s [options] <device|image>\n"
+          "(사용예: sudo %s -y /dev/sdx)\n"
+          "\n옵션들:\n"
+          "  -n      : 검사만 하고 장치에 기록하지 않음 (기본값)\n"
+          "  -y      : 찾은 문제를 고침\n"
+          "  -j COUNT: 검사 스레드 수 (기본값: CPU 수, 최대 %d)\n"
+          "  -v      : 문제를 하나씩 출력\n"
+          "  -h      : 도움말 출력\n"
+          "\n마운트되지 않은 장치에서 실행해야 합니다.\n",
+          prog, prog, SFUSE_FSCK_MAX_THREADS);
+}
+
+/**
+ * @brief 양의 정수 옵션 값을 파싱한다.
+ *
+ * @param arg 옵션 문자열
+ * @param out 파싱 결과를 저장할 포인터
+ * @return 성공 시 0, 형식이 잘못되었으면 -1
+ */
+static int parse_u32(const char *arg, uint32_t *out) {
+  char *end;
+  errno = 0;
+  unsigned long long v = strtoull(arg, &end, 0);
+  if (errno || *end != '\0' || v == 0 || v > UINT32_MAX)
+    return -1;
+  *out = (uint32_t)v;
+  return 0;
+}
+
+/**
+ * @brief 프로그램 메인 함수
+ *
+ * @param argc 명령줄 인자의 개수
+ * @param argv 명령줄 인자 배열
+ * @return FSCK_EXIT_* 종료 코드
+ */
+int main(int argc, char *argv[]) {
+  struct sfuse_fsck_opts opts = {0};
+  int opt;
+
+  while ((opt = getopt(argc, argv, "nyj:vh")) != -1) {
+    switch (opt) {
+    case 'n':
+      opts.repair = false;
+      break;
+    case 'y':
+      opts.repair = true;
+      break;
+    case 'j':
+      if (parse_u32(optarg, &opts.threads) < 0) {
+        fprintf(stderr, "잘못된 옵션 값: -%c %s\n", opt, optarg);
+        return FSCK_EXIT_ERROR;
+      }
+      break;
+    case 'v':
+      opts.verbose = true;
+      break;
+    case 'h':
+      usage(argv[0], stdout);
+      return FSCK_EXIT_OK;
+    default:
+      usage(argv[0], stderr);
+      return FSCK_EXIT_ERROR;
+    }
+  }
+  if (optind != argc - 1) {
+    usage(argv[0], stderr);
+    return FSCK_EXIT_ERROR;
+  }
+
+  // 블록 디바이스를 고칠 때는 O_EXCL로 마운트된 장치를 거부한다.
+  const char *dev_path = argv[optind];
+  struct stat st;
+  int flags = opts.repair ? O_RDWR : O_RDONLY;
+  if (opts.repair && stat(dev_path, &st) == 0 && S_ISBLK(st.st_mode))
+    flags |= O_EXCL;
+  int fd = open(dev_path, flags);
+  if (fd < 0) {
+    perror("디바이스 열기 실패");
+    return FSCK_EXIT_ERROR;
+  }
+
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  struct sfuse_fsck_result r;
+  int res = fsck_run(fd, &opts, &r);
+  close(fd);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  if (res < 0) {
+    fprintf(stderr, "검사 실패: %s\n", strerror(-res));
+    return FSCK_EXIT_ERROR;
+  }
+
+  uint64_t total = 0;
+  for (int p = 0; p < SFUSE_FSCK_NR_PROBLEMS; p++) {
+    if (!r.problems[p])
+      continue;
+    printf("  %-14s: %" PRIu64 "\n", fsck_problem_name(p), r.problems[p]);
+    total += r.problems[p];
+  }
+  double secs = (double)(t1.tv_sec - t0.tv_sec) +
+                (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+  printf("%s: 아이노드 %" PRIu64 "개 (디렉터리 %" PRIu64 "개), 블록 %" PRIu64
+         "개 (공유 참조 %" PRIu64 "개), 빈 블록 %" PRIu64 "개, 빈 아이노드 "
+         "%u개\n"
+         "  문제 %" PRIu64 "개, 남은 문제 %" PRIu64
+         "개 (%.2f초, 스레드 %u개)\n",
+         dev_path, r.inodes, r.dirs, r.blocks, r.shared, r.free_blocks,
+         r.free_inodes, total, r.unfixed, secs, r.threads);
+
+  if (r.unfixed)
+    return FSCK_EXIT_UNCORRECTED;
+  return total ? FSCK_EXIT_FIXED : FSCK_EXIT_OK;
+}